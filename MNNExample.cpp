@@ -1,4 +1,4 @@
-//#define BOOST_ASIO_HAS_IO_URING 1 //Linux
+//io_uring file I/O is enabled with -DENABLE_IO_URING=ON, the library and its users must agree on it
 //#define BOOST_ASIO_DISABLE_EPOLL 0 //Maybe linux?
 #include <iostream>
 #include <string>
@@ -0,0 +1,86 @@
+/**
+ * Shared inputs of the benchmarks, the same on every run so results can be compared between versions
+ */
+#ifndef BENCHMARKDATA_HPP
+#define BENCHMARKDATA_HPP
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "LoadResult.hpp"
+
+namespace sgns::benchmarks
+{
+	/**
+	 * Bytes from a fixed seed, so content hashes and compressibility don't change between runs
+	 * @param size - Number of bytes
+	 * @param seed - Different seeds give different content, i.e. one per file
+	 */
+	inline std::vector<char> PatternBytes(size_t size, uint32_t seed = 1)
+	{
+		std::vector<char> bytes(size);
+		uint32_t state = seed * 2654435761u + 1;
+		for (auto& byte : bytes)
+		{
+			//xorshift32
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			byte = static_cast<char>(state);
+		}
+		return bytes;
+	}
+
+	/**
+	 * Result with count files of size bytes each, named like a directory load, "dir/file<i>.bin"
+	 */
+	inline std::shared_ptr<LoadResult> PatternResult(size_t count, size_t size)
+	{
+		auto result = std::make_shared<LoadResult>();
+		for (size_t i = 0; i < count; ++i)
+		{
+			result->Add("dir/file" + std::to_string(i) + ".bin", BufferSlice::FromVector(PatternBytes(size, static_cast<uint32_t>(i + 1))));
+		}
+		return result;
+	}
+
+	/**
+	 * Scratch directory under the system temp directory, created empty and removed with the object
+	 */
+	class ScratchDirectory {
+	public:
+		explicit ScratchDirectory(const std::string& name)
+			: path_(std::filesystem::temp_directory_path() / ("asyncio-benchmarks-" + name)) {
+			std::filesystem::remove_all(path_);
+			std::filesystem::create_directories(path_);
+		}
+		~ScratchDirectory() {
+			std::error_code ignored;
+			std::filesystem::remove_all(path_, ignored);
+		}
+		ScratchDirectory(const ScratchDirectory&) = delete;
+		ScratchDirectory& operator=(const ScratchDirectory&) = delete;
+
+		const std::filesystem::path& Path() const {
+			return path_;
+		}
+		/**
+		 * Write a file of pattern bytes into the directory
+		 * @return Full path of the file
+		 */
+		std::string WriteFile(const std::string& name, size_t size, uint32_t seed = 1) const {
+			auto file = (path_ / name).string();
+			auto bytes = PatternBytes(size, seed);
+			std::ofstream out(file, std::ios::binary | std::ios::trunc);
+			out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+			return file;
+		}
+
+	private:
+		std::filesystem::path path_;
+	};
+}
+
+#endif
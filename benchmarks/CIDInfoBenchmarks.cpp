@@ -0,0 +1,67 @@
+/**
+ * Reassembly of files from bitswap blocks by CIDInfo, over block and file counts
+ */
+#include <benchmark/benchmark.h>
+#include "BenchmarkData.hpp"
+#include "IPFSCommon.hpp"
+
+namespace sgns::benchmarks
+{
+    namespace
+    {
+        const size_t kBlockSize = 64 * 1024;
+
+        libp2p::multi::ContentIdentifier CIDOf(const std::vector<char>& bytes)
+        {
+            auto cidV0 = libp2p::multi::ContentIdentifierCodec::encodeCIDV0(bytes.data(), bytes.size());
+            return libp2p::multi::ContentIdentifierCodec::decode(gsl::span((uint8_t*)cidV0.data(), cidV0.size())).value();
+        }
+
+        void CIDInfoReassemble(benchmark::State& state)
+        {
+            auto blocks = static_cast<size_t>(state.range(0));
+            auto files = static_cast<size_t>(state.range(1));
+            //Blocks and their CIDs are made once, the loop times what happens as replies arrive
+            auto mainCID = CIDOf(PatternBytes(64, 0));
+            std::vector<libp2p::multi::ContentIdentifier> parentCIDs;
+            std::vector<std::string> directories;
+            for (size_t file = 0; file < files; ++file)
+            {
+                parentCIDs.push_back(CIDOf(PatternBytes(64, static_cast<uint32_t>(blocks + file + 1))));
+                directories.push_back("dir/file" + std::to_string(file) + ".bin");
+            }
+            std::vector<libp2p::multi::ContentIdentifier> blockCIDs;
+            std::vector<BufferSlice> contents;
+            for (size_t block = 0; block < blocks; ++block)
+            {
+                auto bytes = PatternBytes(kBlockSize, static_cast<uint32_t>(block + 1));
+                blockCIDs.push_back(CIDOf(bytes));
+                contents.push_back(BufferSlice::FromVector(std::move(bytes)));
+            }
+            for (auto _ : state)
+            {
+                CIDInfo info(mainCID);
+                for (size_t block = 0; block < blocks; ++block)
+                {
+                    info.linkedCIDs.emplace_back(blockCIDs[block], parentCIDs[block % files], directories[block % files]);
+                }
+                for (size_t block = 0; block < blocks; ++block)
+                {
+                    info.setContentForLinkedCID(blockCIDs[block], contents[block]);
+                }
+                info.groupLinkedCIDs();
+                benchmark::DoNotOptimize(info.finalcontents);
+                if (files == 1)
+                {
+                    //Single files are also flattened into one buffer
+                    auto combined = info.combineContents();
+                    benchmark::DoNotOptimize(combined);
+                }
+            }
+            state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * blocks * kBlockSize));
+        }
+    }
+
+    //Blocks by files they belong to
+    BENCHMARK(CIDInfoReassemble)->ArgsProduct({ { 16, 256, 1024 }, { 1, 16 } })->Unit(benchmark::kMicrosecond);
+}
@@ -0,0 +1,55 @@
+/**
+ * Local load throughput of MNNLoader over a range of file sizes
+ */
+#include <benchmark/benchmark.h>
+#include "BenchmarkData.hpp"
+#include "MNNLoader.hpp"
+
+namespace sgns::benchmarks
+{
+    namespace
+    {
+        void MNNLoaderLoadASync(benchmark::State& state)
+        {
+            auto size = static_cast<size_t>(state.range(0));
+            ScratchDirectory scratch("loader");
+            auto path = scratch.WriteFile("model.mnn", size);
+            auto loader = MNNLoader::GetInstance();
+            auto ioc = std::make_shared<boost::asio::io_context>();
+            for (auto _ : state)
+            {
+                std::shared_ptr<const LoadResult> loaded;
+                loader->LoadASync(path, false, false, ioc,
+                    [&loaded](std::shared_ptr<boost::asio::io_context>, std::shared_ptr<const LoadResult> buffers, bool, bool) { loaded = buffers; },
+                    [](const CustomResult&) {}, std::make_shared<LoadRequest>("file://" + path));
+                ioc->run();
+                ioc->restart();
+                if (!loaded || loaded->TotalSize() != size)
+                {
+                    state.SkipWithError("Load failed");
+                    break;
+                }
+                benchmark::DoNotOptimize(loaded);
+            }
+            state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * size));
+        }
+
+        void MNNLoaderLoadFile(benchmark::State& state)
+        {
+            auto size = static_cast<size_t>(state.range(0));
+            ScratchDirectory scratch("loader-sync");
+            auto path = scratch.WriteFile("model.mnn", size);
+            auto loader = MNNLoader::GetInstance();
+            for (auto _ : state)
+            {
+                auto loaded = loader->LoadFile(path);
+                benchmark::DoNotOptimize(loaded);
+            }
+            state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * size));
+        }
+    }
+
+    //4 KiB to 64 MiB, small configs up to large models
+    BENCHMARK(MNNLoaderLoadASync)->RangeMultiplier(16)->Range(4 << 10, 64 << 20)->Unit(benchmark::kMillisecond)->UseRealTime();
+    BENCHMARK(MNNLoaderLoadFile)->RangeMultiplier(16)->Range(4 << 10, 64 << 20)->Unit(benchmark::kMillisecond)->UseRealTime();
+}
@@ -0,0 +1,62 @@
+/**
+ * Multi-file write throughput of MNNSaver and the CID and RocksDB path of IPFSSaver
+ */
+#include <benchmark/benchmark.h>
+#include "BenchmarkData.hpp"
+#include "IPFSSaver.hpp"
+#include "MNNSaver.hpp"
+
+namespace sgns::benchmarks
+{
+    namespace
+    {
+        void MNNSaverSaveASync(benchmark::State& state)
+        {
+            auto count = static_cast<size_t>(state.range(0));
+            auto size = static_cast<size_t>(state.range(1));
+            ScratchDirectory scratch("mnnsaver");
+            auto data = PatternResult(count, size);
+            auto saver = MNNSaver::GetInstance();
+            auto ioc = std::make_shared<boost::asio::io_context>();
+            for (auto _ : state)
+            {
+                bool written = false;
+                saver->SaveASync(ioc, [&written](std::shared_ptr<boost::asio::io_context>) { written = true; },
+                    scratch.Path().string() + "/", data, "mnn");
+                ioc->run();
+                ioc->restart();
+                if (!written)
+                {
+                    state.SkipWithError("Save did not complete");
+                    break;
+                }
+            }
+            state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * count * size));
+            state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * count));
+        }
+
+        void IPFSSaverSaveASync(benchmark::State& state)
+        {
+            auto count = static_cast<size_t>(state.range(0));
+            auto size = static_cast<size_t>(state.range(1));
+            //The saver opens its database relative to the working directory
+            ScratchDirectory scratch("ipfssaver");
+            auto previous = std::filesystem::current_path();
+            std::filesystem::current_path(scratch.Path());
+            auto data = PatternResult(count, size);
+            auto saver = IPFSSaver::GetInstance();
+            auto ioc = std::make_shared<boost::asio::io_context>();
+            for (auto _ : state)
+            {
+                saver->SaveASync(ioc, [](std::shared_ptr<boost::asio::io_context>) {}, "", data, "");
+            }
+            std::filesystem::current_path(previous);
+            state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * count * size));
+            state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * count));
+        }
+    }
+
+    //Files per save by file size
+    BENCHMARK(MNNSaverSaveASync)->ArgsProduct({ { 1, 8, 64 }, { 4 << 10, 1 << 20 } })->Unit(benchmark::kMillisecond)->UseRealTime();
+    BENCHMARK(IPFSSaverSaveASync)->ArgsProduct({ { 1, 8 }, { 4 << 10, 256 << 10, 1 << 20 } })->Unit(benchmark::kMillisecond)->UseRealTime();
+}
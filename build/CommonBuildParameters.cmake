@@ -15,6 +15,13 @@ set(GTest_INCLUDE_DIR "${_THIRDPARTY_BUILD_DIR}/GTest/include")
 find_package(GTest CONFIG REQUIRED)
 include_directories(${GTest_INCLUDE_DIR})
 
+# --------------------------------------------------------
+# Set config of Google Benchmark
+if (BUILD_BENCHMARKS)
+  set(benchmark_DIR "${_THIRDPARTY_BUILD_DIR}/benchmark/lib/cmake/benchmark")
+  find_package(benchmark CONFIG REQUIRED)
+endif()
+
 # --------------------------------------------------------
 # Set config of protobuf project
 if (NOT DEFINED Protobuf_DIR)
@@ -257,11 +264,13 @@ set(MNN_INCLUDE_DIR "${CMAKE_CURRENT_SOURCE_DIR}/../MNN/include")
 
 # ----------------------BUILD EXTERNAL PROJECT------------------
 # Set config of LIBSSH2
-#set(Libssh2_DIR "${_THIRDPARTY_BUILD_DIR}/libssh2/lib/cmake/libssh2")
-#set(Libssh2_LIBRARY_DIR "${_THIRDPARTY_BUILD_DIR}/libssh2/lib")
-#set(Libssh2_INCLUDE_DIR "${_THIRDPARTY_BUILD_DIR}/libssh2/include")
-#find_package(Libssh2 CONFIG REQUIRED)
-#include_directories(${LIBSSH2_INCLUDE_DIR})
+if (ENABLE_SFTP)
+  set(Libssh2_DIR "${_THIRDPARTY_BUILD_DIR}/libssh2/lib/cmake/libssh2")
+  set(Libssh2_LIBRARY_DIR "${_THIRDPARTY_BUILD_DIR}/libssh2/lib")
+  set(Libssh2_INCLUDE_DIR "${_THIRDPARTY_BUILD_DIR}/libssh2/include")
+  find_package(Libssh2 CONFIG REQUIRED)
+  include_directories(${Libssh2_INCLUDE_DIR})
+endif()
 
 # --------------------------------------------------------
 include_directories(
@@ -305,6 +314,10 @@ if (BUILD_EXAMPLES)
     add_subdirectory(${PROJECT_ROOT}/example ${CMAKE_BINARY_DIR}/example)
 endif ()
 
+if (BUILD_BENCHMARKS)
+    add_subdirectory(${PROJECT_ROOT}/benchmarks ${CMAKE_BINARY_DIR}/benchmarks)
+endif ()
+
 #install(
 #  EXPORT supergeniusTargets
 #  DESTINATION ${CMAKE_INSTALL_LIBDIR}/cmake/SuperGenius
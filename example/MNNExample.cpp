@@ -1,4 +1,4 @@
-//#define BOOST_ASIO_HAS_IO_URING 1 //Linux
+//io_uring file I/O is enabled with -DENABLE_IO_URING=ON, the library and its users must agree on it
 //#define BOOST_ASIO_DISABLE_EPOLL 0 //Maybe linux?
 #include <iostream>
 #include <string>
@@ -117,42 +117,38 @@ int main(int argc, char **argv)
     //    // Do nothing
     //};
     FileManager::GetInstance().InitializeSingletons();
-    for (int i = 0; i < file_names.size(); i++)
-    {
-        std::cout << "LoadASync: " << file_names[i] << std::endl;
-        auto data = FileManager::GetInstance().LoadASync(file_names[i], false, true, ioc, [](const sgns::AsyncError::CustomResult& status)
+    //Nothing else shares this io_context, so let it stop once every load is finished
+    FileManager::GetInstance().SetStopOnIdle(true);
+    //Load everything as one batch, a few at a time per scheme so startup doesn't open every socket at once
+    sgns::LoadBatchOptions options;
+    options.maxInFlight = 8;
+    options.maxInFlightPerScheme = 4;
+    options.save = true;
+    options.savetype = "file";
+    auto batch = FileManager::GetInstance().LoadMany(file_names, options, ioc,
+        [](size_t index, const std::string& url, sgns::LoadRequest::State state, std::shared_ptr<const sgns::LoadResult> buffers)
         {
-                //std::cout << "status: " << status << std::endl;
-                if (status.has_value())
-                {
-                    std::cout << "Success: " << status.value().message << std::endl;
-                }
-                else {
-                    std::cout << "Error: " << status.error() << std::endl;
-                }
-            }, [](std::shared_ptr<std::pair<std::vector<std::string>, std::vector<std::vector<char>>>> buffers)
-                {
-                    std::cout << "Final Callback" << std::endl;
-                },"file");
-        //FileManager::GetInstance().IncrementOutstandingOperations();
-
-        //std::cout << "LoadFile: " << file_names[i] << std::endl;
-        //auto data = FileManager::GetInstance().LoadFile(file_names[i], false);
-
-        //std::cout << "LoadFile with Parse: " << file_names[i] << std::endl;
-        //data = FileManager::GetInstance().LoadFile(file_names[i], true);
-        //std::cout << "ParseFile: " << std::endl;
-        //FileManager::GetInstance().ParseData("mnn", data);
-        //std::cout << "SaveFile: Save to " << FILE_SAVE_NAME;
-        //FileManager::GetInstance().SaveFile(FILE_SAVE_NAME, data);
-        //std::cout << std::endl;
-        //boost::asio::post(ioc, postload);
-    }
+            std::cout << "Loaded " << url << (buffers ? "" : " (failed)") << std::endl;
+        },
+        [](const sgns::LoadBatch& batch)
+        {
+            std::cout << "Final Callback, " << batch.size() << " files" << std::endl;
+        },
+        [](size_t index, const sgns::AsyncError::CustomResult& status)
+        {
+            if (status.has_value())
+            {
+                std::cout << "Success: " << status.value().message << std::endl;
+            }
+            else {
+                std::cout << "Error: " << status.error() << std::endl;
+            }
+        });
     //std::thread([ioc]() {
     //    ioc->run();
     //    }).detach();
     ioc->reset();
-    ioc->run();
+    FileManager::RunIOContext(ioc);
 
     return 0;
 }
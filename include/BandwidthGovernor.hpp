@@ -0,0 +1,157 @@
+/**
+ * Header file for the BandwidthGovernor
+ */
+#ifndef BANDWIDTHGOVERNOR_HPP
+#define BANDWIDTHGOVERNOR_HPP
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "boost/asio/io_context.hpp"
+
+namespace sgns
+{
+	/**
+	 * Connection and bandwidth limits for one level of the governor, 0 means no limit
+	 */
+	struct GovernorLimits
+	{
+		/// @brief Maximum connections open at once
+		size_t maxConnections = 0;
+		/// @brief Sustained read rate, bursts of up to one second's worth are allowed
+		uint64_t bytesPerSecond = 0;
+	};
+
+	class BandwidthGovernor;
+
+	/**
+	 * A connection slot held by a loader, the slot is given back when the last copy is destroyed
+	 */
+	class ConnectionLease {
+	public:
+		ConnectionLease(BandwidthGovernor& governor, std::string scheme, std::string host);
+		~ConnectionLease();
+		ConnectionLease(const ConnectionLease&) = delete;
+		ConnectionLease& operator=(const ConnectionLease&) = delete;
+
+	private:
+		BandwidthGovernor& governor_;
+		std::string scheme_;
+		std::string host_;
+	};
+
+	/**
+	 * Limits how many connections the network loaders open and how fast they read, globally, per scheme and per host.
+	 * Connections wait in order for a slot that fits every level. Bandwidth uses token buckets that loaders charge
+	 * after each read, when a bucket is in debt the next read is held back until it has refilled.
+	 * All limits can be changed at runtime, i.e. to throttle background loads on a busy node.
+	 */
+	class BandwidthGovernor {
+	public:
+		using ConnectionHandler = std::function<void(std::shared_ptr<ConnectionLease> lease)>;
+
+		BandwidthGovernor() = default;
+
+		/**
+		 * Set the limits across every scheme and host
+		 */
+		void SetGlobalLimits(GovernorLimits limits);
+		/**
+		 * Set the limits for one scheme
+		 * @param scheme - Prefix, i.e. "https"
+		 */
+		void SetSchemeLimits(const std::string& scheme, GovernorLimits limits);
+		/**
+		 * Set the limits for one host, across every scheme
+		 * @param host - Host name as it appears in the URL
+		 */
+		void SetHostLimits(const std::string& host, GovernorLimits limits);
+
+		/**
+		 * Get a connection slot, the handler runs once there is room at every level
+		 * @param scheme - Scheme of the connection
+		 * @param host - Host being connected to
+		 * @param ioc - Context to run the handler on when it had to wait
+		 * @param handler - Receives the lease, hold it for as long as the connection is open
+		 * @return Id of the wait to withdraw it with, 0 if the slot was granted right away
+		 */
+		uint64_t AcquireConnection(const std::string& scheme, const std::string& host, std::shared_ptr<boost::asio::io_context> ioc, ConnectionHandler handler);
+		/**
+		 * Stop waiting for a slot, i.e. because the load was cancelled, the handler is dropped without running
+		 * @param id - Id AcquireConnection returned
+		 * @return False if the slot was already granted, the handler runs or has run
+		 */
+		bool WithdrawWaiting(uint64_t id);
+		/**
+		 * Charge bytes that were just read against the buckets
+		 * @return How long to wait before reading again, zero when no bucket is in debt
+		 */
+		std::chrono::steady_clock::duration Consume(const std::string& scheme, const std::string& host, size_t bytes);
+		/**
+		 * Charge bytes that were just read and run next once reading may continue
+		 * @param ioc - Context to wait on
+		 * @param next - Continues the read loop, called right away if no wait is needed
+		 */
+		void Throttle(const std::string& scheme, const std::string& host, size_t bytes, std::shared_ptr<boost::asio::io_context> ioc, std::function<void()> next);
+
+		/**
+		 * Number of connections holding a slot
+		 */
+		size_t GetActiveConnections() const;
+		/**
+		 * Number of connections waiting for a slot
+		 */
+		size_t GetWaitingConnections() const;
+
+	private:
+		friend class ConnectionLease;
+
+		struct Bucket
+		{
+			uint64_t rate = 0;
+			double tokens = 0;
+			std::chrono::steady_clock::time_point refilled;
+		};
+		struct Level
+		{
+			GovernorLimits limits;
+			size_t connections = 0;
+			Bucket bucket;
+		};
+		struct Waiter
+		{
+			uint64_t id = 0;
+			std::string scheme;
+			std::string host;
+			std::shared_ptr<boost::asio::io_context> ioc;
+			ConnectionHandler handler;
+		};
+
+		void SetLimitsLocked(Level& level, GovernorLimits limits);
+		bool FitsLocked(const std::string& scheme, const std::string& host) const;
+		void TakeLocked(const std::string& scheme, const std::string& host);
+		void ReleaseConnection(const std::string& scheme, const std::string& host);
+		/**
+		 * Forget a scheme or host that has no connections and no limits, so every host ever loaded from doesn't stay in the map
+		 */
+		void DropIdleLocked(std::map<std::string, Level>& levels, const std::string& key);
+		/**
+		 * Hand slots to waiters that now fit, in order, skipping ones whose host or scheme is still full
+		 */
+		void GrantWaiting();
+		static std::chrono::steady_clock::duration ChargeLocked(Bucket& bucket, size_t bytes);
+
+		mutable std::mutex mutex_;
+		Level global_;
+		std::map<std::string, Level> schemes_;
+		std::map<std::string, Level> hosts_;
+		std::deque<Waiter> waiters_;
+		uint64_t nextWaiterId_ = 1;
+	};
+}
+
+#endif
@@ -0,0 +1,141 @@
+/**
+ * Header file for the ContentCache
+ */
+#ifndef CONTENTCACHE_HPP
+#define CONTENTCACHE_HPP
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include "LoadResult.hpp"
+
+namespace sgns
+{
+	/**
+	 * In-memory cache of load results, keyed by normalized URL and optionally by content hash.
+	 * Entries are shared immutable LoadResults, so a hit hands out the same bytes without copying.
+	 * Eviction is GreedyDual-Size: an entry's priority is the cache's inflation value plus fetch cost over size,
+	 * so small entries that were expensive to fetch stay longest and cheap, large ones go first.
+	 */
+	class ContentCache {
+	public:
+		using Data = std::shared_ptr<const LoadResult>;
+
+		/**
+		 * Hit/miss counters, snapshot of the cache state
+		 */
+		struct Stats
+		{
+			uint64_t hits = 0;
+			uint64_t misses = 0;
+			uint64_t insertions = 0;
+			uint64_t evictions = 0;
+			size_t entries = 0;
+			size_t bytes = 0;
+			size_t byteBudget = 0;
+		};
+
+		/**
+		 * Create a cache
+		 * @param byteBudget - Maximum number of bytes held, 0 disables the cache
+		 */
+		explicit ContentCache(size_t byteBudget = 0);
+
+		/**
+		 * Change the byte budget, evicting as needed. 0 disables the cache and drops everything.
+		 * @param byteBudget - Maximum number of bytes held
+		 */
+		void SetByteBudget(size_t byteBudget);
+		bool IsEnabled() const {
+			return byteBudget_.load() != 0;
+		}
+		/**
+		 * Set how expensive a scheme is to fetch from, relative to a local file at 1.0
+		 * @param scheme - Prefix, i.e. "ipfs"
+		 * @param weight - Cost multiplier
+		 */
+		void SetSchemeWeight(const std::string& scheme, double weight);
+		/**
+		 * Work out the cost of a fetch from its scheme and how long it took
+		 * @param scheme - Prefix the data was loaded with
+		 * @param fetchMilliseconds - Time the load took
+		 */
+		double FetchCost(const std::string& scheme, double fetchMilliseconds) const;
+
+		/**
+		 * Look up by URL
+		 * @param url - URL as given to FileManager, normalized here
+		 * @param validator - Current version of the source, i.e. a local file's size and mtime. An entry stored
+		 *                    with a different one is stale, it is dropped and counted as a miss.
+		 * @return Cached data or nullptr
+		 */
+		Data Get(const std::string& url, const std::string& validator = "");
+		/**
+		 * Look up by content hash, i.e. an IPFS CID or a SHA-256
+		 * @param hash - Content hash the data was stored with
+		 * @return Cached data or nullptr
+		 */
+		Data GetByHash(const std::string& hash);
+		/**
+		 * Insert or replace an entry. Entries larger than the whole budget are not cached.
+		 * @param url - URL as given to FileManager, normalized here
+		 * @param data - Loaded data
+		 * @param cost - Cost to fetch it again, see FetchCost
+		 * @param hash - Content hash if known, empty otherwise
+		 * @param validator - Version of the source the data was loaded from, see Get
+		 */
+		void Put(const std::string& url, Data data, double cost, const std::string& hash = "", const std::string& validator = "");
+		/**
+		 * Drop an entry
+		 * @param url - URL as given to FileManager, normalized here
+		 */
+		void Erase(const std::string& url);
+		/**
+		 * Drop every entry, counters are kept
+		 */
+		void Clear();
+		Stats GetStats() const;
+
+	private:
+		struct Entry
+		{
+			Data data;
+			std::string hash;
+			std::string validator;
+			size_t bytes = 0;
+			double cost = 0;
+			double priority = 0;
+			uint64_t sequence = 0;
+		};
+		using PriorityKey = std::pair<double, uint64_t>;
+
+		/**
+		 * Bump an entry's priority after a hit. Called with the lock held.
+		 */
+		void Touch(const std::string& key, Entry& entry);
+		void EraseLocked(std::map<std::string, Entry>::iterator iter);
+		void EvictLocked(size_t byteBudget);
+
+		mutable std::mutex mutex_;
+		std::atomic<size_t> byteBudget_;
+		size_t bytes_ = 0;
+		/// @brief GreedyDual inflation value, raised to the priority of each evicted entry
+		double inflation_ = 0;
+		uint64_t sequence_ = 0;
+		std::map<std::string, Entry> entries_;
+		std::unordered_map<std::string, std::string> hashIndex_;
+		/// @brief Entries ordered by priority, lowest first, ties broken oldest first
+		std::set<std::pair<PriorityKey, std::string>> evictionOrder_;
+		std::map<std::string, double> schemeWeights_;
+
+		std::atomic<uint64_t> hits_{ 0 };
+		std::atomic<uint64_t> misses_{ 0 };
+		std::atomic<uint64_t> insertions_{ 0 };
+		std::atomic<uint64_t> evictions_{ 0 };
+	};
+}
+
+#endif
@@ -0,0 +1,110 @@
+/**
+ * Header file for the DiskCache
+ */
+#ifndef DISKCACHE_HPP
+#define DISKCACHE_HPP
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "LoadResult.hpp"
+
+namespace sgns
+{
+	/**
+	 * Persistent cache of remote loads in a local directory, so a restart doesn't download everything again.
+	 * Each entry is one blob file holding every file of a load back to back, plus a line in a text index
+	 * that is read once at startup. Blobs and the index are written to a temp file, synced and renamed into place,
+	 * so a crash never leaves a torn entry behind. Blobs and the index are read and written without holding the lock,
+	 * so a big store doesn't hold up lookups, but both block the calling thread and belong off the io_context.
+	 * Entries are stored with a scheme specific validator (ETag/Last-Modified, size:mtime, CID) that
+	 * FileManager uses to decide whether the copy is still current.
+	 */
+	class DiskCache {
+	public:
+		/**
+		 * Metadata of a cached load, available without touching the blob
+		 */
+		struct Entry
+		{
+			std::string validator;
+			/// @brief When the entry was stored, seconds since epoch
+			int64_t storedAt = 0;
+			/// @brief Last hit or store, seconds since epoch, used for eviction
+			int64_t lastUsed = 0;
+			uint64_t blobId = 0;
+			size_t bytes = 0;
+			/// @brief Name and size of each file in the blob, in order
+			std::vector<std::pair<std::string, size_t>> files;
+		};
+
+		DiskCache() = default;
+
+		/**
+		 * Open a cache directory, creating it if needed, and load its index
+		 * @param directory - Directory to keep the cache in
+		 * @param byteCap - Maximum bytes of blobs to keep, least recently used entries are evicted past it
+		 * @return False if the directory could not be used, the cache stays disabled
+		 */
+		bool Open(const std::string& directory, size_t byteCap);
+		bool IsEnabled() const;
+		/**
+		 * Get the metadata for a URL
+		 * @param url - URL as given to FileManager, normalized here
+		 * @param entry - Filled in on a hit
+		 * @return True if the URL is cached
+		 */
+		bool Lookup(const std::string& url, Entry& entry) const;
+		/**
+		 * Read a cached load back into memory
+		 * @param url - URL as given to FileManager, normalized here
+		 * @return Cached data, nullptr if missing or the blob is damaged (the entry is then dropped)
+		 */
+		std::shared_ptr<const LoadResult> Read(const std::string& url);
+		/**
+		 * Store a load, replacing any older copy
+		 * @param url - URL as given to FileManager, normalized here
+		 * @param data - Loaded data
+		 * @param validator - Scheme specific validator, may be empty
+		 * @return False if the entry could not be written
+		 */
+		bool Store(const std::string& url, const LoadResult& data, const std::string& validator);
+		/**
+		 * Drop an entry and its blob
+		 * @param url - URL as given to FileManager, normalized here
+		 */
+		void Erase(const std::string& url);
+		/**
+		 * Total bytes of blobs currently cached
+		 */
+		size_t GetBytes() const;
+
+	private:
+		std::string BlobPath(uint64_t blobId) const;
+		void LoadIndexLocked();
+		/**
+		 * Write the index if it changed since the last write, call without holding mutex_
+		 * @return False if it could not be written, it is tried again with the next change
+		 */
+		bool SaveIndex();
+		void EraseLocked(std::map<std::string, Entry>::iterator iter);
+		void EvictLocked(size_t byteCap);
+		static int64_t Now();
+
+		mutable std::mutex mutex_;
+		/// @brief Serializes index writes, taken before mutex_ and never while holding it
+		std::mutex indexWriteMutex_;
+		/// @brief Entries changed since the index was last written
+		bool indexDirty_ = false;
+		std::string directory_;
+		size_t byteCap_ = 0;
+		size_t bytes_ = 0;
+		uint64_t nextBlobId_ = 1;
+		std::map<std::string, Entry> entries_;
+	};
+}
+
+#endif
@@ -7,14 +7,51 @@
 #include <fcntl.h>
 #include "boost/asio/posix/stream_descriptor.hpp"
 #endif
+#include <atomic>
+#include <cstdint>
+#include <functional>
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
 #include "boost/asio.hpp"
 
 
 namespace sgns
 {
     using namespace boost::asio;
+/**
+ * A read-only memory mapping of a whole local file. Loaded slices point straight into the mapping and keep it
+ * alive, so a load needs no user-space copy and processes loading the same file share its page-cache pages.
+ * The file must not be truncated while mapped, reading past the new end faults.
+ */
+    class MappedFile {
+    public:
+        /**
+         * Map a file
+         * @param filename - Path to the file
+         * @param error - Why the file couldn't be mapped, operation_not_supported where mapping isn't available
+         * @return The mapping, empty on failure or for empty files
+         */
+        static std::shared_ptr<const MappedFile> Map(const std::string& filename, boost::system::error_code& error);
+        ~MappedFile();
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        const char* data() const {
+            return data_;
+        }
+        uint64_t size() const {
+            return size_;
+        }
+    private:
+        MappedFile(const char* data, uint64_t size) : data_(data), size_(size) {}
+
+        const char* data_;
+        uint64_t size_;
+    };
 /**
  * This class creates a FILE Device and has a function load a local file.
  * The class differs based on Windows, or POSIX based OS.
@@ -32,9 +69,17 @@ namespace sgns
             std::string filename, int writemode);
         ~FILEDevice() {
             // Cleanup
-            file_.close(ec_);
-            close(fd_);
+            Close();
         }
+        /**
+         * Close the file, reads still in flight complete with operation_aborted. Call it from the io_context.
+         */
+        void Close();
+        /**
+         * Size of the file, so reads can go into a buffer allocated once
+         * @return Empty if the file didn't open or isn't a regular file, i.e. a pipe
+         */
+        std::optional<uint64_t> Size() const;
         /**
          * Get the current file pointer for async operations
          */
@@ -60,8 +105,17 @@ namespace sgns
             std::string filename, int writemode);
         ~FILEDevice() {
             // Cleanup
-            file_.close();
+            Close();
         }
+        /**
+         * Close the file, reads still in flight complete with operation_aborted. Call it from the io_context.
+         */
+        void Close();
+        /**
+         * Size of the file, so reads can go into a buffer allocated once
+         * @return Empty if the file didn't open
+         */
+        std::optional<uint64_t> Size();
         /**
          * Get the current file pointer for async operations
          */
@@ -75,6 +129,210 @@ namespace sgns
     };
 #endif
 
+
+#if defined(BOOST_ASIO_HAS_IO_URING) && defined(BOOST_ASIO_HAS_FILE)
+/**
+ * A local file opened for positioned reads and writes through io_uring. Reads and writes are split into blocks
+ * with several in flight at once, since NVMe only reaches its rated throughput with a deep queue. Blocks issued
+ * from one handler go to the kernel in a single submission.
+ */
+    class FILERandomAccessDevice : public std::enable_shared_from_this<FILERandomAccessDevice> {
+    public:
+        /**
+         * Called once a whole transfer finished
+         * @param error - First error of any block, the file's end is an error for reads
+         * @param bytes - Length of the prefix that was transferred without a gap, blocks past a failed one don't count
+         */
+        using TransferHandler = std::function<void(const boost::system::error_code& error, uint64_t bytes)>;
+
+        /**
+         * Open a local file
+         * @param ioc - Boost asio io_context to use, built with io_uring support
+         * @param filename - Path to location of the file
+         * @param writemode - 0 for read, 1 to create or truncate and write
+         * @param blockSize - Bytes per positioned read or write
+         * @param queueDepth - Blocks in flight at once for one transfer
+         */
+        FILERandomAccessDevice(std::shared_ptr<boost::asio::io_context> ioc, std::string filename, int writemode,
+            size_t blockSize = 1024 * 1024, size_t queueDepth = 8);
+        /**
+         * Whether the file opened, the error is logged if it didn't
+         */
+        bool IsOpen() const {
+            return file_.is_open();
+        }
+        /**
+         * Size of the file, 0 if it can't be read
+         */
+        uint64_t Size();
+        /**
+         * Close the file, blocks still in flight complete with operation_aborted. Call it from the io_context.
+         */
+        void Close();
+        /**
+         * Fill a buffer from the file
+         * @param offset - Where in the file to start
+         * @param buffer - Memory to fill, it must stay valid until the handler runs
+         * @param handler - Called once the buffer is full or a block failed
+         */
+        void Read(uint64_t offset, boost::asio::mutable_buffer buffer, TransferHandler handler);
+        /**
+         * Write buffers one after the other into the file
+         * @param offset - Where in the file the first buffer goes
+         * @param buffers - Data to write, it must stay valid until the handler runs
+         * @param handler - Called once everything is written or a block failed
+         */
+        void Write(uint64_t offset, const std::vector<boost::asio::const_buffer>& buffers, TransferHandler handler);
+        /**
+         * Get the file for other positioned operations
+         */
+        boost::asio::random_access_file& getFile() {
+            return file_;
+        }
+    private:
+        boost::asio::random_access_file file_;
+        size_t blockSize_;
+        size_t queueDepth_;
+    };
+#endif
+
+
+#ifndef _WIN32
+/**
+ * Reusable page aligned buffers of one size, as direct I/O needs. A buffer goes back to the pool when its last
+ * reference does, so results built from pool buffers keep theirs for as long as they are held.
+ */
+    class AlignedBufferPool : public std::enable_shared_from_this<AlignedBufferPool> {
+    public:
+        /// @brief Alignment of every buffer, and of offsets and lengths of direct transfers
+        static const size_t kAlignment = 4096;
+
+        /**
+         * @param bufferSize - Bytes per buffer, rounded up to kAlignment
+         * @param maxFree - Buffers kept for reuse, more are freed when they come back
+         */
+        AlignedBufferPool(size_t bufferSize, size_t maxFree);
+        ~AlignedBufferPool();
+        AlignedBufferPool(const AlignedBufferPool&) = delete;
+        AlignedBufferPool& operator=(const AlignedBufferPool&) = delete;
+
+        /**
+         * Get a buffer of BufferSize bytes, the pool must be held by a shared_ptr
+         * @return The buffer, empty if memory ran out
+         */
+        std::shared_ptr<char> Acquire();
+        size_t BufferSize() const {
+            return bufferSize_;
+        }
+        /**
+         * Pool of 4 MiB buffers used by direct file I/O, never destroyed so results may outlive everything else
+         */
+        static std::shared_ptr<AlignedBufferPool> Direct();
+        /**
+         * One aligned buffer of any size, not pooled
+         * @param size - Bytes needed, rounded up to kAlignment
+         */
+        static std::shared_ptr<char> Allocate(size_t size);
+    private:
+        size_t bufferSize_;
+        size_t maxFree_;
+        std::mutex mutex_;
+        std::vector<char*> free_;
+    };
+
+/**
+ * A local file opened with O_DIRECT, so reading or writing it doesn't push other data out of the page cache.
+ * Transfers go through aligned buffers. Where the file system refuses direct I/O, the device quietly
+ * uses normal I/O instead. Regular files are always ready for epoll, so the blocking positioned reads and
+ * writes run on a separate executor and only the handlers run on the io_context.
+ */
+    class DirectFILEDevice : public std::enable_shared_from_this<DirectFILEDevice> {
+    public:
+        /**
+         * Called once a read finished
+         * @param error - Why the read failed, reaching the end of the file is not an error
+         * @param data - Aligned buffer holding the data
+         * @param bytes - Bytes read into it, short of the length only at the end of the file
+         */
+        using ReadHandler = std::function<void(const boost::system::error_code& error, std::shared_ptr<char> data, uint64_t bytes)>;
+        /**
+         * Called once a write finished
+         * @param error - Why the write failed
+         * @param bytes - Bytes written
+         */
+        using WriteHandler = std::function<void(const boost::system::error_code& error, uint64_t bytes)>;
+
+        /**
+         * Open a local file
+         * @param ioc - Boost asio io_context to use
+         * @param filename - Path to location of the file
+         * @param writemode - 0 for read, 1 to create or truncate and write
+         * @param diskExecutor - Where the blocking reads and writes run, i.e. FileManager::GetDiskExecutor
+         */
+        DirectFILEDevice(std::shared_ptr<boost::asio::io_context> ioc, std::string filename, int writemode,
+            boost::asio::thread_pool::executor_type diskExecutor);
+        ~DirectFILEDevice();
+        bool IsOpen() const {
+            return fd_ != -1;
+        }
+        /**
+         * Stop transfers, those in flight complete with operation_aborted before their next block.
+         * The descriptor itself is closed with the device, once no transfer uses it any more.
+         */
+        void Close();
+        /**
+         * Whether transfers bypass the page cache, false once the device fell back to normal I/O
+         */
+        bool IsDirect() const;
+        /**
+         * Size of the file
+         * @return Empty if the file didn't open or isn't a regular file
+         */
+        std::optional<uint64_t> Size() const;
+        /**
+         * Read the whole file into one aligned buffer
+         */
+        void ReadAll(ReadHandler handler);
+        /**
+         * Read the next block of the file into a buffer
+         * @param buffer - Aligned buffer, i.e. from AlignedBufferPool, filled up to length
+         * @param length - Multiple of AlignedBufferPool::kAlignment
+         */
+        void ReadBlock(std::shared_ptr<char> buffer, size_t length, ReadHandler handler);
+        /**
+         * Write buffers one after the other into the file. They are staged through two pool buffers, one filling
+         * while the other is written.
+         * @param buffers - Data to write, it must stay valid until the handler runs
+         */
+        void Write(std::vector<boost::asio::const_buffer> buffers, WriteHandler handler);
+    private:
+        /// @brief Progress of a Write through its two stages
+        struct StagedWrite;
+
+        /**
+         * Clear O_DIRECT, for the unaligned tail of a write or when the file system refused it
+         */
+        void DropDirect();
+        /**
+         * Blocking pread or pwrite of a whole range a block at a time, run on the disk executor
+         * @return Bytes transferred, short of length at the end of the file or on error
+         */
+        size_t TransferAt(bool write, char* data, size_t length, uint64_t offset, boost::system::error_code& error);
+        void WriteStage(std::shared_ptr<StagedWrite> write, int current);
+        /**
+         * One of the two halves of a stage finished, the write of one buffer or the fill of the other
+         */
+        void StageDone(std::shared_ptr<StagedWrite> write, int current);
+
+        boost::asio::strand<boost::asio::io_context::executor_type> strand_;
+        boost::asio::thread_pool::executor_type diskExecutor_;
+        int fd_ = -1;
+        /// @brief Where the next ReadBlock starts
+        std::atomic<uint64_t> readOffset_{ 0 };
+        std::atomic<bool> closed_{ false };
+    };
+#endif
+
 }
 
 #endif
\ No newline at end of file
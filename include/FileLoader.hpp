@@ -6,6 +6,8 @@
 #include <string>
 #include "boost/asio.hpp"
 #include "FILEError.hpp"
+#include "LoadResult.hpp"
+#include "LoadRequest.hpp"
 using Success = sgns::AsyncError::Success;
 using CustomResult = sgns::AsyncError::CustomResult;
 
@@ -18,7 +20,7 @@ public:
      * @param parse - Whether to parse file upon completion (for MNN)
      * @param save - Whether to save the file to local disk upon completion
      */
-    using CompletionCallback = std::function<void(std::shared_ptr<boost::asio::io_context> ioc, std::shared_ptr<std::pair<std::vector<std::string>, std::vector<std::vector<char>>>> buffers, bool parse, bool save)>;
+    using CompletionCallback = std::function<void(std::shared_ptr<boost::asio::io_context> ioc, std::shared_ptr<const sgns::LoadResult> buffers, bool parse, bool save)>;
 
     /**
      * Status callback returns an error code as an async load proceeds
@@ -39,9 +41,10 @@ public:
      * @param ioc - ASIO context for async loading
      * @param callback - Filemanager callback on completion
      * @param status - Status function that will be updated with status codes as operation progresses
+     * @param request - Request being loaded, for cancellation and cache revalidation
      * @return String indicating init
      */
-    virtual std::shared_ptr<void> LoadASync(std::string filename, bool parse, bool save, std::shared_ptr<boost::asio::io_context> ioc, CompletionCallback callback, StatusCallback status) = 0;
+    virtual std::shared_ptr<void> LoadASync(std::string filename, bool parse, bool save, std::shared_ptr<boost::asio::io_context> ioc, CompletionCallback callback, StatusCallback status, std::shared_ptr<sgns::LoadRequest> request) = 0;
 };
 
 #endif
@@ -8,13 +8,30 @@
 #include <cassert>
 #include <future>
 #include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
 #include "ASIOSingleton.hpp"
 #include "FileLoader.hpp"
 #include "FileParser.hpp"
 #include "FileSaver.hpp"
+#include "LoadRequest.hpp"
+#include "LoadBatch.hpp"
+#include "LoadRace.hpp"
+#include "ContentCache.hpp"
+#include "DiskCache.hpp"
+#include "LoadScheduler.hpp"
+#include "BandwidthGovernor.hpp"
+#include "RetryPolicy.hpp"
+#include "LoadMetrics.hpp"
+#include "LoadTracer.hpp"
 #include "boost/asio.hpp"
 #include "boost/bind.hpp"
 #include "FILEError.hpp"
+#include "URLStringUtil.h"
 using Success = sgns::AsyncError::Success;
 using CustomResult = sgns::AsyncError::CustomResult;
 
@@ -31,8 +48,129 @@ class FileManager
         map<std::string, FileParser*> parsers;
         /// @brief a map from std::string to saver handlers
         map<std::string, FileSaver*> savers;
+        /// @brief guards the loader/parser/saver maps so registration and lookup can happen from any io_context thread
+        mutable std::shared_mutex registryMutex_;
 
-        int outstandingOperations_ = 0;
+        std::atomic<int> outstandingOperations_{ 0 };
+        /// @brief whether the io_context is stopped once no operations are outstanding
+        std::atomic<bool> stopOnIdle_{ false };
+        /// @brief results of async loads, disabled until given a byte budget
+        sgns::ContentCache cache_;
+        /// @brief remote loads kept on disk across restarts, disabled until given a directory
+        sgns::DiskCache diskCache_;
+        /// @brief how long a disk cached load without a validator (wss) is trusted, in seconds
+        std::atomic<int64_t> diskCacheMaxAge_{ 24 * 60 * 60 };
+        /// @brief local files at least this big are memory mapped instead of read, 0 to never map
+        std::atomic<uint64_t> mappedLoadSize_{ 0 };
+        /// @brief local files at least this big are read and saved with direct I/O, 0 to never bypass the page cache
+        std::atomic<uint64_t> directIOSize_{ 0 };
+        /// @brief files of a local directory load that are read at the same time
+        std::atomic<size_t> directoryLoadFiles_{ 16 };
+        /// @brief bitswap block requests the ipfs loader has outstanding at once, 0 for no limit
+        std::atomic<size_t> maxOutstandingBlocks_{ 0 };
+        /// @brief admits transfers by priority class
+        sgns::LoadScheduler scheduler_;
+        /// @brief connection and bandwidth limits shared by the network loaders
+        sgns::BandwidthGovernor governor_;
+        /// @brief retry, backoff and hedging of transfers
+        sgns::RetryPolicy retryPolicy_;
+        /// @brief request, byte, error and phase latency metrics
+        sgns::LoadMetrics metrics_;
+        /// @brief timeline of loads and saves, off until enabled
+        sgns::LoadTracer tracer_;
+        /// @brief workers for CPU bound stages like parsing and hashing, created on first use
+        std::unique_ptr<boost::asio::thread_pool> cpuPool_;
+        /// @brief threads cpuPool_ is created with, 0 for one per core
+        size_t cpuThreads_ = 0;
+        /// @brief workers for blocking disk cache reads and writes, created on first use
+        std::unique_ptr<boost::asio::thread_pool> diskPool_;
+        /// @brief guards creating cpuPool_ and diskPool_
+        std::mutex cpuPoolMutex_;
+
+        /// @brief callers attached to one transfer, so concurrent loads of a URL share it
+        struct InFlightLoad
+        {
+            std::vector<std::function<void(std::shared_ptr<boost::asio::io_context> ioc, std::shared_ptr<const sgns::LoadResult> buffers)>> readers;
+            std::vector<std::function<void(const CustomResult&)>> statuses;
+            /// @brief requests of the attached callers
+            std::vector<std::shared_ptr<sgns::LoadRequest>> requests;
+            /// @brief attached callers with event handlers, replaced rather than changed so events are forwarded without the lock
+            std::shared_ptr<const std::vector<std::shared_ptr<sgns::LoadRequest>>> listeners;
+            /// @brief most urgent class of any attached caller
+            sgns::LoadPriority priority = sgns::LoadPriority::Normal;
+            /// @brief scheduler ticket the transfer was submitted with
+            sgns::LoadScheduler::Ticket ticket = 0;
+            /// @brief what the loader sees, cancelled once every attached caller has cancelled or timed out
+            std::shared_ptr<sgns::LoadRequest> transfer;
+            /// @brief set once the transfer finished or was abandoned, later results from the loader are dropped
+            bool done = false;
+            /// @brief served from a fresh disk cache copy instead of the loader, so it isn't stored again
+            bool fromDisk = false;
+        };
+        /// @brief retry and hedging state of one transfer
+        struct TransferAttempts
+        {
+            FileLoader* loader = nullptr;
+            std::string filePath;
+            std::string prefix;
+            /// @brief host the metrics are kept under, empty for schemes without one
+            std::string host;
+            bool parse = false;
+            bool save = false;
+            std::shared_ptr<boost::asio::io_context> ioc;
+            std::shared_ptr<InFlightLoad> flight;
+            /// @brief finishes the transfer, called once with the first good result or the last failure
+            FileLoader::CompletionCallback finish;
+            FileLoader::StatusCallback status;
+            sgns::RetryOptions options;
+            std::mutex mutex;
+            size_t started = 0;
+            /// @brief attempts that haven't reported yet by id, an attempt's id is its place in started,
+            ///         each runs on a request of its own that forwards to the transfer
+            std::map<size_t, std::shared_ptr<sgns::LoadRequest>> running;
+            bool finished = false;
+            std::chrono::steady_clock::time_point firstStart;
+        };
+        /// @brief guards inflight_ and the contents of every InFlightLoad
+        std::mutex inflightMutex_;
+        /// @brief transfers in progress by normalized URL
+        map<std::string, std::shared_ptr<InFlightLoad>> inflight_;
+
+        /// @brief Run one more attempt of a transfer, the first also arms the hedge timer
+        void StartAttempt(std::shared_ptr<TransferAttempts> attempts);
+        /// @brief Take the first good result of a transfer, otherwise retry with backoff until the attempts or the budget run out
+        void FinishAttempt(std::shared_ptr<TransferAttempts> attempts, size_t attempt, std::shared_ptr<const sgns::LoadResult> buffers, bool parse, bool save);
+        /// @brief Parse/save the loaded data for one caller and complete its request, called on the request strand.
+        ///         The parse runs on the CPU pool and the save on the saver, each continues back on the strand.
+        void FinishLoad(std::shared_ptr<sgns::LoadRequest> request, std::shared_ptr<boost::asio::io_context> ioc,
+            std::shared_ptr<boost::asio::strand<boost::asio::io_context::executor_type>> strand, std::shared_ptr<const sgns::LoadResult> buffers,
+            bool parse, bool save, const std::string& savetype, const std::string& suffix, std::function<void(const CustomResult&)> status,
+            std::function<void(std::shared_ptr<const sgns::LoadResult>)> finalcall);
+
+        /// @brief Run an asio completion handler with its result on the handler's associated executor
+        /// @param handler completion handler, shared so it can sit in the copyable callbacks LoadASync takes
+        /// @param ioc io_context to run on if the handler has no executor of its own
+        /// @param result value to complete with
+        template <typename Handler, typename Result>
+        static void PostCompletion(std::shared_ptr<Handler> handler, std::shared_ptr<boost::asio::io_context> ioc, Result result)
+        {
+            auto executor = boost::asio::get_associated_executor(*handler, ioc->get_executor());
+            boost::asio::post(executor, [handler, result = std::move(result)]() mutable {
+                std::move(*handler)(std::move(result));
+                });
+        }
+
+        /// @brief Thread safe lookup of a registered handler
+        /// @param handlers map to search
+        /// @param key prefix or suffix to find
+        /// @return handler pointer or nullptr if none was registered
+        template <typename Handler>
+        Handler* FindHandler(const map<std::string, Handler*>& handlers, const std::string& key) const
+        {
+            std::shared_lock<std::shared_mutex> lock(registryMutex_);
+            auto iter = handlers.find(key);
+            return iter == handlers.end() ? nullptr : iter->second;
+        }
     public:
         static void InitializeSingletons();
         /**
@@ -42,7 +180,7 @@ class FileManager
          * @param parse - Whether to parse file upon completion (for MNN)
          * @param save - Whether to save the file to local disk upon completion
          */
-        using CompletionCallback = std::function<void(std::shared_ptr<boost::asio::io_context> ioc, std::shared_ptr<std::pair<std::vector<std::string>, std::vector<std::vector<char>>>> buffers, bool parse, bool save)>;
+        using CompletionCallback = std::function<void(std::shared_ptr<boost::asio::io_context> ioc, std::shared_ptr<const sgns::LoadResult> buffers, bool parse, bool save)>;
         /**
          * Status callback returns an error code as an async load proceeds
          * @param int - Status code
@@ -50,15 +188,100 @@ class FileManager
         using StatusCallback = std::function<void(const CustomResult&)>;
         /**
          * Final callback returns data to application
-         * @param buffers - Contains path/data loaded
+         * @param buffers - Contains path/data loaded, and the parsed object in buffers->parsed when parsing was asked for
          */
-        using FinalCallback = std::function<void(std::shared_ptr<std::pair<std::vector<std::string>, std::vector<std::vector<char>>>> buffers)>;
+        using FinalCallback = std::function<void(std::shared_ptr<const sgns::LoadResult> buffers)>;
         /// @brief Decrement operations counter so io_context thread can be shut down when all are complete.
         /// @param The io_context that we have been reading on
         void DecrementOutstandingOperations(std::shared_ptr<boost::asio::io_context> ioc);
+        /// @brief Opt in to stopping the io_context once the outstanding operations counter reaches zero.
+        ///         Off by default so the io_context can be shared with other services and kept running.
+        /// @param stop true to stop the io_context when idle
+        void SetStopOnIdle(bool stop);
         /// @brief Increment operations counter so io_context thread can be shut down when all are complete.
         void IncrementOutstandingOperations();
         shared_ptr<int> GetOutstandingOperationsPointer();
+        /**
+         * Run an io_context on multiple threads and block until it stops. Handlers for a single
+         * LoadASync request are serialized on their own strand, so requests can proceed in parallel.
+         * @param ioc - asio io context to run
+         * @param threadCount - Number of threads to run on, 0 uses std::thread::hardware_concurrency()
+         */
+        static void RunIOContext(std::shared_ptr<boost::asio::io_context> ioc, size_t threadCount = 0);
+        /// @brief Enable the in-memory cache of async loads, LoadASync serves hits without going to the loader.
+        ///         Cached local files are checked against their size and modification time on every hit.
+        /// @param byteBudget maximum number of bytes to keep, 0 disables the cache
+        void SetCacheByteBudget(size_t byteBudget);
+        /// @brief Memory map local files instead of reading them. The loaded slices point into the read-only mapping,
+        ///         which stays until the last holder of the result lets go, so there is no user-space copy and processes
+        ///         loading the same file share its pages. The slices see the file as it is, not as it was loaded: an
+        ///         in-place edit changes the data under every holder and truncating the file makes reads past the new end
+        ///         raise SIGBUS. Only map files that are replaced by renaming a new copy over them, never rewritten.
+        ///         Mapped loads are not kept in the memory cache, which would hold on to the mapping for later callers.
+        /// @param minSize smallest file in bytes to map, smaller ones are cheaper to read, 0 to never map
+        void SetMappedLoads(uint64_t minSize);
+        /// @brief Smallest local file that is memory mapped, 0 if none are
+        uint64_t GetMappedLoadSize() const;
+        /// @brief Read and save big local files with direct I/O (O_DIRECT), so one-off loads of huge weight files don't
+        ///         evict everything else from the page cache. Data goes through pooled aligned buffers, and normal I/O is
+        ///         used where the file system can't do direct I/O. Takes precedence over SetMappedLoads.
+        /// @param minSize smallest file in bytes to transfer directly, 0 to always go through the page cache
+        void SetDirectIO(uint64_t minSize);
+        /// @brief Smallest local file that is transferred with direct I/O, 0 if none are
+        uint64_t GetDirectIOSize() const;
+        /// @brief Limit how many files of a local directory load ("file://dir/") are open and read at the same time
+        /// @param maxOpenFiles files read concurrently, at least 1
+        void SetDirectoryLoadConcurrency(size_t maxOpenFiles);
+        /// @brief Files of a local directory load that are read at the same time
+        size_t GetDirectoryLoadConcurrency() const;
+        /// @brief Get the in-memory cache, for stats, scheme weights or invalidation
+        sgns::ContentCache& GetCache();
+        /// @brief Drop a URL from the in-memory and disk caches, i.e. after its data failed verification
+        /// @param url URL whose cached copies to drop
+        void Evict(const std::string& url);
+        /// @brief Enable the persistent cache of https, wss, sftp and ipfs loads. HTTP entries are revalidated with
+        ///         ETag/Last-Modified and SFTP entries with size and mtime, IPFS entries are always current since the
+        ///         CID names the content, and WSS entries are trusted until they are older than maxAge.
+        /// @param directory where to keep the cache, created if needed
+        /// @param byteCap maximum bytes to keep on disk
+        /// @param maxAge how long entries without a validator are trusted
+        /// @return false if the directory could not be used
+        bool SetDiskCache(const std::string& directory, size_t byteCap, std::chrono::seconds maxAge = std::chrono::hours(24));
+        /// @brief Limit how many transfers run at once. Interactive loads always start right away, normal loads
+        ///         queue once maxActive transfers are running and prefetches only use what the others leave free.
+        /// @param maxActive maximum transfers at once, 0 for no limit
+        /// @param maxPrefetch maximum prefetch transfers at once, 0 for no limit
+        void SetSchedulerLimits(size_t maxActive, size_t maxPrefetch);
+        /// @brief Get the transfer scheduler, for queue and slot counts
+        sgns::LoadScheduler& GetScheduler();
+        /// @brief Limit how many bitswap block requests the ipfs loader has outstanding at once, the rest wait in priority
+        ///         order and interactive loads are never held back. A block only frees its slot once bitswap replies or
+        ///         gives up on it, so a cap low enough for every slot to wait on unresponsive peers stalls the other loads.
+        /// @param maxOutstanding maximum outstanding block requests, 0 for no limit (the default)
+        void SetMaxOutstandingBlocks(size_t maxOutstanding);
+        /// @brief Bitswap block requests the ipfs loader has outstanding at once, 0 if there is no limit
+        size_t GetMaxOutstandingBlocks() const;
+        /// @brief Get the governor the https, wss and sftp loaders take connection slots and bandwidth from,
+        ///         set global, per scheme or per host limits on it at any time
+        sgns::BandwidthGovernor& GetGovernor();
+        /// @brief Get the retry policy, set per scheme attempts, backoff and hedging or the retry budget on it.
+        ///         Transfers don't retry until a scheme is given more than one attempt.
+        sgns::RetryPolicy& GetRetryPolicy();
+        /// @brief Size the worker pool CPU bound stages run on, parsing loaded files and verifying digests.
+        ///         These never run on the io_context threads, so sockets keep being served while they do.
+        /// @param threads number of workers, 0 for one per core
+        /// @return false if the pool is already running, it can only be sized before the first load that uses it
+        bool SetCPUThreads(size_t threads);
+        /// @brief Get the executor of the CPU worker pool, post CPU bound work here and post results back to the io_context
+        boost::asio::thread_pool::executor_type GetCPUExecutor();
+        /// @brief Executor of the disk workers, for blocking file I/O like disk cache blobs and direct I/O transfers
+        boost::asio::thread_pool::executor_type GetDiskExecutor();
+        /// @brief Get the metrics of every load, request/byte/error counts per scheme and host and phase latencies
+        ///         per scheme. Snapshot them or dump them as Prometheus text.
+        sgns::LoadMetrics& GetMetrics();
+        /// @brief Get the tracer, enable it to record a span for every phase of every load and save, IPFS block
+        ///         requests and saved files included, and write them out as a Chrome trace for Perfetto.
+        sgns::LoadTracer& GetTracer();
         /// @brief Register a synchronous loader class to handle a specific prefix
         /// @param prefix = "https", "file", etc from https://xxxxx
         /// @param handlerLoader Handler class object that can load the data
@@ -76,16 +299,164 @@ class FileManager
                 FileSaver *handlerSaver);
 
         /**
-         * Asynchronously load a file based on type
+         * Asynchronously load a file based on type. Concurrent loads of the same URL share one transfer,
+         * each caller still gets its own request, status updates, parse/save and final callback.
          * @param url - URL to load, will determine loader we use
-         * @param parse - Whether to parse file upon completion (for MNN)
+         * @param parse - Whether to parse file upon completion with the parser registered for the URL suffix (for MNN),
+         *                on the CPU pool. A file that fails to parse fails the load.
          * @param save - Whether to save the file to local disk upon completion
          * @param ioc - ASIO context for async loading
          * @param callback - Filemanager callback on completion
-         * @param status - Status function that will be updated with status codes as operation progresses
-         * @return String indicating init
+         * @param status - Status function that will be updated with status codes as operation progresses, may be empty.
+         *                 Progress text is built from the typed events only when there is a status function to take it.
+         * @param finalcall - Called once with the data when the load (and save) finishes, or with nullptr on failure or cancel
+         * @param savetype - Prefix of the saver to use when save is set
+         * @param onChunk - Optional, receives the data in order as it arrives, the transfer waits for each chunk to be resumed
+         * @param priority - Priority class the transfer is admitted and scheduled with, see SetSchedulerLimits
+         * @param timeout - Time the request out if it hasn't finished by then, 0 for no deadline. The transfer itself,
+         *                  sockets included, is only torn down once every caller sharing it has cancelled or timed out.
+         * @param onEvent - Optional, receives typed progress events, a cheaper alternative to status for frequent updates
+         * @param statusProgress - Whether status gets the progress text as well as the failures
+         * @return Handle to poll, wait on or cancel the request
+         */
+        std::shared_ptr<sgns::LoadRequest> LoadASync(const std::string& url, bool parse, bool save, std::shared_ptr<boost::asio::io_context> ioc, StatusCallback status, FinalCallback finalcall, std::string savetype,
+            sgns::LoadRequest::ChunkHandler onChunk = nullptr, sgns::LoadPriority priority = sgns::LoadPriority::Normal, std::chrono::milliseconds timeout = std::chrono::milliseconds(0),
+            sgns::LoadRequest::EventHandler onEvent = nullptr, bool statusProgress = true);
+
+        /**
+         * Load a file with an asio completion token, i.e. a callback, boost::asio::use_future or boost::asio::use_awaitable.
+         * Same as LoadASync, but the result arrives once through the token instead of a final callback and request handle.
+         * @param url - URL to load, will determine loader we use
+         * @param options - Parse/save options and optional chunk handler
+         * @param ioc - ASIO context for async loading
+         * @param token - Completion token for the signature void(sgns::LoadOutcome), the error is the last failure status
+         */
+        template <typename CompletionToken>
+        auto AsyncLoad(const std::string& url, sgns::LoadOptions options, std::shared_ptr<boost::asio::io_context> ioc, CompletionToken&& token)
+        {
+            return boost::asio::async_initiate<CompletionToken, void(sgns::LoadOutcome)>(
+                [this, ioc](auto handler, const std::string& url, sgns::LoadOptions options) {
+                    auto shared = std::make_shared<decltype(handler)>(std::move(handler));
+                    //Remember why the load failed, the request itself only knows that it did. Only failures are
+                    //looked at, so no progress text is built for this status.
+                    struct Failure
+                    {
+                        std::mutex mutex;
+                        std::string message = "Load failed";
+                    };
+                    auto failure = std::make_shared<Failure>();
+                    auto status = [failure](const CustomResult& result) {
+                        if (result.has_error())
+                        {
+                            std::lock_guard<std::mutex> lock(failure->mutex);
+                            failure->message = result.error();
+                        }
+                    };
+                    std::shared_ptr<sgns::LoadRequest> request;
+                    try
+                    {
+                        request = LoadASync(url, options.parse, options.save, ioc, status, [](std::shared_ptr<const sgns::LoadResult>) {},
+                            options.savetype, std::move(options.onChunk), options.priority, options.timeout, std::move(options.onEvent), false);
+                    }
+                    catch (const std::exception& e)
+                    {
+                        PostCompletion(shared, ioc, sgns::LoadOutcome(sgns::AsyncError::outcome::failure(std::string(e.what()))));
+                        return;
+                    }
+                    request->OnComplete([shared, ioc, failure](sgns::LoadRequest::State state, sgns::LoadRequest::LoadBuffers buffers) {
+                        if (state == sgns::LoadRequest::State::Completed)
+                        {
+                            PostCompletion(shared, ioc, sgns::LoadOutcome(sgns::AsyncError::outcome::success(std::move(buffers))));
+                            return;
+                        }
+                        std::string message;
+                        {
+                            std::lock_guard<std::mutex> lock(failure->mutex);
+                            message = failure->message;
+                        }
+                        PostCompletion(shared, ioc, sgns::LoadOutcome(sgns::AsyncError::outcome::failure(std::move(message))));
+                        });
+                },
+                token, url, std::move(options));
+        }
+
+        /**
+         * Save data with an asio completion token, through the saver registered for the URL's prefix
+         * @param url - URL to save to, the prefix picks the saver and the path is passed on as the filename
+         * @param data - Files to save
+         * @param ioc - ASIO context for async saving
+         * @param token - Completion token for the signature void(CustomResult)
+         */
+        template <typename CompletionToken>
+        auto AsyncSave(const std::string& url, std::shared_ptr<const sgns::LoadResult> data, std::shared_ptr<boost::asio::io_context> ioc, CompletionToken&& token)
+        {
+            return boost::asio::async_initiate<CompletionToken, void(CustomResult)>(
+                [this, ioc](auto handler, const std::string& url, std::shared_ptr<const sgns::LoadResult> data) {
+                    auto shared = std::make_shared<decltype(handler)>(std::move(handler));
+                    std::string prefix;
+                    std::string filePath;
+                    std::string suffix;
+                    getURLComponents(url, prefix, filePath, suffix);
+                    auto saver = FindHandler(savers, prefix);
+                    if (saver == nullptr)
+                    {
+                        PostCompletion(shared, ioc, CustomResult(sgns::AsyncError::outcome::failure("No saver registered for prefix " + prefix)));
+                        return;
+                    }
+                    IncrementOutstandingOperations();
+                    saver->SaveASync(ioc, [this, shared](std::shared_ptr<boost::asio::io_context> ioc) {
+                        DecrementOutstandingOperations(ioc);
+                        PostCompletion(shared, ioc, CustomResult(sgns::AsyncError::outcome::success(Success{ "Saved" })));
+                        }, filePath, std::move(data), suffix);
+                },
+                token, url, std::move(data));
+        }
+
+#if defined(BOOST_ASIO_HAS_CO_AWAIT)
+        /**
+         * Load a file from a coroutine, co_await FileManager::GetInstance().Load(url, options).
+         * The coroutine must run on an io_context (or a strand of one), the load runs on the same context.
+         * @param url - URL to load, will determine loader we use
+         * @param options - Parse/save options and optional chunk handler
+         * @return The loaded data, or the reason there is none
+         */
+        boost::asio::awaitable<sgns::LoadOutcome> Load(std::string url, sgns::LoadOptions options = {});
+        /**
+         * Save data from a coroutine, co_await FileManager::GetInstance().Save(url, data)
+         * @param url - URL to save to, the prefix picks the saver
+         * @param data - Files to save
+         * @return Success or the reason the save did not start
+         */
+        boost::asio::awaitable<CustomResult> Save(std::string url, std::shared_ptr<const sgns::LoadResult> data);
+#endif
+
+        /**
+         * Asynchronously load a batch of files, with bounded concurrency overall and per scheme
+         * @param urls - URLs to load, each determines the loader used
+         * @param options - In flight limits and parse/save options applied to every item
+         * @param ioc - ASIO context for async loading
+         * @param onItem - Called as each item finishes, may be empty
+         * @param onDone - Called once when every item has finished, may be empty
+         * @param onStatus - Status updates for each item as it proceeds, may be empty
+         * @return Handle to poll, wait on or cancel the batch
+         */
+        std::shared_ptr<sgns::LoadBatch> LoadMany(std::vector<std::string> urls, sgns::LoadBatchOptions options, std::shared_ptr<boost::asio::io_context> ioc,
+            sgns::LoadBatch::ItemHandler onItem, sgns::LoadBatch::BatchHandler onDone, sgns::LoadBatch::StatusHandler onStatus = nullptr);
+
+        /**
+         * Asynchronously load content that is available from several sources, i.e. mirrors on https, sftp and ipfs.
+         * The sources are raced or tried in order as the options say, the first whose data matches the expected
+         * digest wins and the others are cancelled. Content already cached under the same digest is served from
+         * the cache whichever URL it was loaded from.
+         * @param urls - Alternative URLs of the same content, most preferred first
+         * @param options - Expected digest, parallelism, deadline and parse/save options
+         * @param ioc - ASIO context for async loading
+         * @param status - Status updates from every source
+         * @param finalcall - Called with the verified data, or empty if no source delivered it
+         * @return Handle to poll, wait on or cancel the whole race, its URL is the first source
          */
-        shared_ptr<void> LoadASync(const std::string& url, bool parse, bool save, std::shared_ptr<boost::asio::io_context> ioc, StatusCallback status, FinalCallback finalcall, std::string savetype);
+        std::shared_ptr<sgns::LoadRequest> LoadAny(std::vector<std::string> urls, sgns::LoadRaceOptions options, std::shared_ptr<boost::asio::io_context> ioc,
+            StatusCallback status, FinalCallback finalcall);
 
         /// @brief Load a file given a filePath and optional parse the data
         /// @param url the full path and filename to load
@@ -5,12 +5,17 @@
 
 #include <string>
 #include <memory>
+#include <vector>
+#include "LoadResult.hpp"
 
 class FileParser {
 public:
     virtual ~FileParser() {}
     virtual std::shared_ptr<void> ParseData(std::shared_ptr<void> data) = 0;
-    virtual std::shared_ptr<void> ParseASync(std::shared_ptr<std::vector<char>> data) = 0;
+    /// @brief Build an object from loaded data, called on the FileManager CPU pool, throws on data it can't parse
+    /// @param data files loaded, shared with the cache and other callers so it must not be changed
+    /// @return object built from the data, handed to the caller as LoadResult::parsed
+    virtual std::shared_ptr<void> ParseASync(std::shared_ptr<const sgns::LoadResult> data) = 0;
 };
 
 #endif
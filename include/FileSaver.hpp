@@ -5,6 +5,7 @@
 
 #include <string>
 #include <memory>
+#include "LoadResult.hpp"
 
 using namespace std;
 
@@ -12,7 +13,7 @@ class FileSaver {
 public:
     virtual ~FileSaver() {}
     virtual void SaveFile(std::string filename, shared_ptr<void> data) = 0;
-    virtual void SaveASync(std::shared_ptr<boost::asio::io_context> ioc, std::function<void(std::shared_ptr<boost::asio::io_context> ioc)> handle_write, std::string filename, std::shared_ptr<std::pair<std::vector<std::string>, std::vector<std::vector<char>>>> data, std::string suffix) = 0;
+    virtual void SaveASync(std::shared_ptr<boost::asio::io_context> ioc, std::function<void(std::shared_ptr<boost::asio::io_context> ioc)> handle_write, std::string filename, std::shared_ptr<const sgns::LoadResult> data, std::string suffix) = 0;
 };
 
 #endif
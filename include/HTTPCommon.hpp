@@ -10,11 +10,15 @@
 #include <streambuf>
 #include <string>
 #include <memory>
+#include <optional>
 #include "boost/asio/ssl.hpp"
 #include "boost/asio.hpp"
 #include "boost/bind.hpp"
 #include "URLStringUtil.h"
 #include "FILEError.hpp"
+#include "LoadResult.hpp"
+#include "LoadRequest.hpp"
+#include "BandwidthGovernor.hpp"
 using Success = sgns::AsyncError::Success;
 using CustomResult = sgns::AsyncError::CustomResult;
 
@@ -35,7 +39,7 @@ namespace sgns
 		 * @param parse - Whether to parse file upon completion (for MNN)
 		 * @param save - Whether to save the file to local disk upon completion
 		 */
-		using CompletionCallback = std::function<void(std::shared_ptr<boost::asio::io_context> ioc, std::shared_ptr<std::pair<std::vector<std::string>, std::vector<std::vector<char>>>> buffers, bool parse, bool save)>;
+		using CompletionCallback = std::function<void(std::shared_ptr<boost::asio::io_context> ioc, std::shared_ptr<const sgns::LoadResult> buffers, bool parse, bool save)>;
 		
 		/**
 		 * Status callback returns an error code as an async load proceeds
@@ -50,12 +54,14 @@ namespace sgns
 		 * @param http_port - Port for HTTPS Server
 		 * @param parse - Whether to parse file upon completion (for MNN currently)
 		 * @param save - Whether to save the file to local disk upon completion
+		 * @param request - Request being loaded, carries the cached validator to revalidate with, cancelling it closes the socket
 		 */
 		HTTPDevice(
 			std::string http_host,
 			std::string http_path,
 			std::string http_port,
-			bool parse, bool save);
+			bool parse, bool save,
+			std::shared_ptr<LoadRequest> request);
 		~HTTPDevice() {
 			// Cleanup
 		}
@@ -67,6 +73,13 @@ namespace sgns
 		 */
 		void StartHTTPDownload(std::shared_ptr<boost::asio::io_context> ioc, CompletionCallback handle_read, StatusCallback status);
 	private:
+		/**
+		 * Resolve, connect and handshake, once a connection slot has been granted
+		 * @param ioc - ASIO context for async loading
+		 * @param handle_read - Filemanager callback on completion
+		 * @param status - Status function that will be updated with status codes as operation progresses
+		 */
+		void StartHTTPConnect(std::shared_ptr<boost::asio::io_context> ioc, CompletionCallback handle_read, StatusCallback status);
 		/**
 		 * Post HTTP Get to download file
 		 * @param ioc - ASIO context for async loading
@@ -78,6 +91,92 @@ namespace sgns
 			std::shared_ptr<boost::asio::ssl::stream<boost::asio::ip::tcp::socket>> socket,
 			CompletionCallback handle_read,
 			StatusCallback status);
+		/**
+		 * Read the whole response into the streambuf until the server closes, throttled between reads
+		 * @param ioc - ASIO context for async loading
+		 * @param socket - SSL socket to read on, the GET has already been sent
+		 * @param headerbuff - Response read so far, header included
+		 * @param handle_read - Filemanager callback on completion
+		 * @param status - Status function that will be updated with status codes as operation progresses
+		 */
+		void ReadHTTPBody(std::shared_ptr<boost::asio::io_context> ioc,
+			std::shared_ptr<boost::asio::ssl::stream<boost::asio::ip::tcp::socket>> socket,
+			std::shared_ptr<boost::asio::streambuf> headerbuff,
+			CompletionCallback handle_read,
+			StatusCallback status);
+		/**
+		 * Split the header off a complete response and hand the body to the completion callback
+		 * @param ioc - ASIO context for async loading
+		 * @param headerbuff - Whole response
+		 * @param handle_read - Filemanager callback on completion
+		 * @param status - Status function that will be updated with status codes as operation progresses
+		 */
+		void FinishHTTPRead(std::shared_ptr<boost::asio::io_context> ioc,
+			std::shared_ptr<boost::asio::streambuf> headerbuff,
+			CompletionCallback handle_read,
+			StatusCallback status);
+		/**
+		 * Read the response header, then stream the body to the request's chunk handler
+		 * @param ioc - ASIO context for async loading
+		 * @param socket - SSL socket to read on, the GET has already been sent
+		 * @param handle_read - Filemanager callback on completion
+		 * @param status - Status function that will be updated with status codes as operation progresses
+		 */
+		void StartHTTPStream(std::shared_ptr<boost::asio::io_context> ioc,
+			std::shared_ptr<boost::asio::ssl::stream<boost::asio::ip::tcp::socket>> socket,
+			CompletionCallback handle_read,
+			StatusCallback status);
+		/**
+		 * Read the next chunk of the body, continues once the consumer resumes the previous one
+		 * @param ioc - ASIO context for async loading
+		 * @param socket - SSL socket to read on
+		 * @param name - Filename the chunks belong to
+		 * @param slices - Body read so far, becomes the final result
+		 * @param offset - Number of body bytes read so far
+		 * @param handle_read - Filemanager callback on completion
+		 * @param status - Status function that will be updated with status codes as operation progresses
+		 */
+		void ReadHTTPChunks(std::shared_ptr<boost::asio::io_context> ioc,
+			std::shared_ptr<boost::asio::ssl::stream<boost::asio::ip::tcp::socket>> socket,
+			std::string name,
+			std::shared_ptr<std::vector<BufferSlice>> slices,
+			uint64_t offset,
+			CompletionCallback handle_read,
+			StatusCallback status);
+		/**
+		 * Read the status code, the ETag/Last-Modified validator and the body length from a response header
+		 * @param header - Response header, without the final blank line
+		 * @param validator - Set to "etag:<ETag>" or "lm:<Last-Modified>", empty if neither is present
+		 * @param contentLength - Set to the Content-Length, empty if the header has none
+		 * @return HTTP status code, 0 if the status line could not be read
+		 */
+		static int ParseResponseHeader(const std::string& header, std::string& validator, std::optional<uint64_t>& contentLength);
+		/**
+		 * Whether a body of this many bytes is all of it, a connection closed early leaves it short of the Content-Length
+		 * @param bytes - Bytes of body read until the server closed
+		 */
+		bool IsWholeBody(uint64_t bytes) const {
+			return !contentLength_ || *contentLength_ == bytes;
+		}
+		/**
+		 * Fail the attempt on a response that wasn't a success, the status goes in the error event
+		 * @param statusCode - Status code of the response, 0 if the status line could not be read
+		 * @param ioc - Pointer to boost asio context
+		 * @param handle_read - Callback to report the failure to
+		 * @param status - Status function that will be updated with status codes as operation progresses
+		 */
+		void FailHTTPResponse(int statusCode,
+			std::shared_ptr<boost::asio::io_context> ioc,
+			CompletionCallback handle_read,
+			StatusCallback status);
+		/**
+		 * Report an event on the request, if there is one
+		 */
+		void Report(LoadPhase phase, uint64_t bytes = 0, uint64_t totalBytes = 0, boost::system::error_code error = {}) {
+			if (request_) {
+				request_->Report(phase, bytes, totalBytes, error);
+			}
+		}
 
 		//Common vars used for getting file from HTTP
 		std::string http_host_;
@@ -86,6 +185,14 @@ namespace sgns
 		bool parse_;
 		bool save_;
 		bool downloading_ = false;
+		std::shared_ptr<LoadRequest> request_;
+		/// @brief Connection slot from the governor, held until the device is done
+		std::shared_ptr<ConnectionLease> lease_;
+		/// @brief Start of the phase in progress, for the FileManager phase metrics
+		std::chrono::steady_clock::time_point phaseStart_;
+		bool firstByte_ = false;
+		/// @brief Content-Length of the response, empty if it didn't say
+		std::optional<uint64_t> contentLength_;
 	};
 }
 
@@ -33,7 +33,7 @@ namespace sgns
          * @param parse - Whether to parse file upon completion (for MNN)
          * @param save - Whether to save the file to local disk upon completion
          */
-        using CompletionCallback = std::function<void(std::shared_ptr<boost::asio::io_context> ioc, std::shared_ptr<std::pair<std::vector<std::string>, std::vector<std::vector<char>>>> buffers, bool parse, bool save)>;
+        using CompletionCallback = std::function<void(std::shared_ptr<boost::asio::io_context> ioc, std::shared_ptr<const sgns::LoadResult> buffers, bool parse, bool save)>;
         /**
          * Status callback returns an error code as an async load proceeds
          * @param int - Status code
@@ -53,9 +53,10 @@ namespace sgns
          * @param ioc - ASIO context for async loading
          * @param callback - Filemanager callback on completion
          * @param status - Status function that will be updated with status codes as operation progresses
+         * @param request - Request being loaded, for cancellation and cache revalidation
          * @return String indicating init
          */
-        std::shared_ptr<void> LoadASync(std::string filename, bool parse, bool save, std::shared_ptr<boost::asio::io_context> ioc, CompletionCallback callback, StatusCallback status) override;
+        std::shared_ptr<void> LoadASync(std::string filename, bool parse, bool save, std::shared_ptr<boost::asio::io_context> ioc, CompletionCallback callback, StatusCallback status, std::shared_ptr<sgns::LoadRequest> request) override;
     protected:
 
     };
@@ -8,6 +8,11 @@
 #include <vector>
 #include <algorithm>
 #include <unordered_map>
+#include <array>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <chrono>
 #include "logger.hpp"
 #include "bitswap.hpp"
 #include "boost/asio/io_context.hpp"
@@ -27,6 +32,8 @@
 #include <boost/lexical_cast.hpp>
 #include <boost/uuid/uuid_io.hpp>
 #include "FILEError.hpp"
+#include "LoadResult.hpp"
+#include "LoadRequest.hpp"
 using Success = sgns::AsyncError::Success;
 using CustomResult = sgns::AsyncError::CustomResult;
 
@@ -41,7 +48,7 @@ namespace sgns
 		libp2p::multi::ContentIdentifier mainCID;
 		std::vector<libp2p::multi::ContentIdentifier> mainCIDs;
 		std::vector<std::string> directories;
-		std::shared_ptr<std::pair<std::vector<std::string>, std::vector<std::vector<char>>>> finalcontents;
+		std::shared_ptr<LoadResult> finalcontents;
 
 		size_t outstandingRequests_;
 		struct LinkedCIDInfo
@@ -49,7 +56,7 @@ namespace sgns
 			libp2p::multi::ContentIdentifier linkedCID;
 			libp2p::multi::ContentIdentifier parentCID;
 			std::string directory;
-			std::vector<char> content;
+			BufferSlice content;
 
 			LinkedCIDInfo(const libp2p::multi::ContentIdentifier& cid, const libp2p::multi::ContentIdentifier& parentcid, std::string& dir)
 				: linkedCID(cid), content(), parentCID(parentcid), directory(dir) {}
@@ -57,34 +64,35 @@ namespace sgns
 		std::vector<LinkedCIDInfo> linkedCIDs;
 
 		CIDInfo(const libp2p::multi::ContentIdentifier& cid)
-			: mainCID(cid), mainCIDs(), linkedCIDs(), finalcontents(std::make_shared<std::pair<std::vector<std::string>, std::vector<std::vector<char>>>>()), outstandingRequests_() {}
+			: mainCID(cid), mainCIDs(), linkedCIDs(), finalcontents(std::make_shared<LoadResult>()), outstandingRequests_() {}
 
 		/**
-		 * Group data for linked CIDs to make a complete file
+		 * Group data for linked CIDs to make a complete file. The file is a chain of the linked block slices, nothing is copied.
 		 */
 		void groupLinkedCIDs() {
-			// Group by CID 
-			std::unordered_map<std::string, std::pair<std::string, std::vector<char>>> groupedData;
+			// Group by CID, keeping the order the files were first seen in
+			std::unordered_map<std::string, size_t> groupedIndex;
+			std::vector<BufferEntry> groupedData;
 			std::string cidbase;
 			// For each linked CID we will add data to group
 			for (const auto& linkedCID : linkedCIDs) {
 				//Use pretty string because CID can't be copied for unordered map
 				auto cidstring = linkedCID.parentCID.toPrettyString(cidbase);
-				auto it = groupedData.find(cidstring);
-				if (it == groupedData.end()) {
+				auto it = groupedIndex.find(cidstring);
+				if (it == groupedIndex.end()) {
 					//Nothing there, so add it.
-					groupedData.emplace(cidstring, std::make_pair(linkedCID.directory, linkedCID.content));
+					groupedIndex.emplace(cidstring, groupedData.size());
+					groupedData.push_back(BufferEntry{ linkedCID.directory, { linkedCID.content } });
 				}
 				else {
 					//Add it
-					it->second.second.insert(it->second.second.end(), linkedCID.content.begin(), linkedCID.content.end());
+					groupedData[it->second].slices.push_back(linkedCID.content);
 				}
 			}
 
 			// Populate finalcontents
-			for (const auto& entry : groupedData) {
-				finalcontents->first.push_back(entry.second.first);
-				finalcontents->second.push_back(entry.second.second);
+			for (auto& entry : groupedData) {
+				finalcontents->entries.push_back(std::move(entry));
 			}
 		}
 
@@ -94,9 +102,8 @@ namespace sgns
 		void writeFinalContentsToDirectories() {
 			auto basedir = boost::lexical_cast<std::string>((boost::uuids::random_generator())()) + "/";
 			//Iterate through finalcontents
-			for (size_t i = 0; i < finalcontents->first.size(); ++i) {
-				const std::string& directoryWithFile = basedir + finalcontents->first[i];
-				const std::vector<char>& content = finalcontents->second[i];
+			for (const auto& entry : finalcontents->entries) {
+				const std::string& directoryWithFile = basedir + entry.name;
 
 				//Extract the directory path from the full path including the filename
 				std::filesystem::path filePath(directoryWithFile);
@@ -108,7 +115,9 @@ namespace sgns
 				// Write the content to the file
 				std::ofstream outputFile(directoryWithFile, std::ios::binary);
 				if (outputFile.is_open()) {
-					outputFile.write(content.data(), content.size());
+					for (const auto& slice : entry.slices) {
+						outputFile.write(slice.data, slice.size);
+					}
 					outputFile.close();
 				}
 				else {
@@ -122,7 +131,7 @@ namespace sgns
 		 * @param linkedCID - Linked CID to set content to
 		 * @param content - Content to insert
 		 */
-		bool setContentForLinkedCID(const libp2p::multi::ContentIdentifier& linkedCID, const std::vector<char>& content)
+		bool setContentForLinkedCID(const libp2p::multi::ContentIdentifier& linkedCID, const BufferSlice& content)
 		{
 			auto it = std::find_if(linkedCIDs.begin(), linkedCIDs.end(),
 				[&linkedCID](const LinkedCIDInfo& info) {
@@ -161,8 +170,8 @@ namespace sgns
 			for (const auto& linkedCIDInfo : linkedCIDs)
 			{
 				combinedContent->insert(combinedContent->end(),
-					linkedCIDInfo.content.begin(),
-					linkedCIDInfo.content.end());
+					linkedCIDInfo.content.data,
+					linkedCIDInfo.content.data + linkedCIDInfo.content.size);
 			}
 
 			return combinedContent;
@@ -189,7 +198,7 @@ namespace sgns
 		 * @param parse - Whether to parse file upon completion (for MNN)
 		 * @param save - Whether to save the file to local disk upon completion
 		 */
-		using CompletionCallback = std::function<void(std::shared_ptr<boost::asio::io_context> ioc, std::shared_ptr<std::pair<std::vector<std::string>, std::vector<std::vector<char>>>> buffers, bool parse, bool save)>;
+		using CompletionCallback = std::function<void(std::shared_ptr<boost::asio::io_context> ioc, std::shared_ptr<const sgns::LoadResult> buffers, bool parse, bool save)>;
 		/**
 		 * Status callback returns an error code as an async load proceeds
 		 * @param int - Status code
@@ -224,6 +233,8 @@ namespace sgns
 		 * @param save - Whether to save the file to local disk upon completion
 		 * @param handle_read - Filemanager callback on completion
 		 * @param status - Status function that will be updated with status codes as operation progresses
+		 * @param request - Load the blocks are for, its priority class orders them against other loads and cancelling it drops them
+		 * @param attempt - Provider lookups made so far, retries back off by the "ipfs-dht" options of FileManager's RetryPolicy
 		 */
 		bool StartFindingPeers(
 			std::shared_ptr<boost::asio::io_context> ioc,
@@ -233,8 +244,13 @@ namespace sgns
 			bool parse,
 			bool save,
 			CompletionCallback handle_read,
-			StatusCallback status
+			StatusCallback status,
+			std::shared_ptr<LoadRequest> request,
+			size_t attempt = 0
 		);
+		/**
+		 * Look for providers again after a backoff, or fail the load once the lookups are used up
+		 */
 		void StartFindingPeersWithRetry(
 			std::shared_ptr<boost::asio::io_context> ioc,
 			const sgns::ipfs_bitswap::CID& cid,
@@ -243,7 +259,9 @@ namespace sgns
 			bool parse,
 			bool save,
 			CompletionCallback handle_read,
-			StatusCallback status);
+			StatusCallback status,
+			std::shared_ptr<LoadRequest> request,
+			size_t attempt);
 		/**
 		 * Add the Main CID for a file to bitswap wantlist to get information or file(if small enough)
 		 * @param ioc - Asio io context to use
@@ -254,6 +272,7 @@ namespace sgns
 		 * @param save - Whether to save the file to local disk upon completion
 		 * @param handle_read - Filemanager callback on completion
 		 * @param status - Status function that will be updated with status codes as operation progresses
+		 * @param request - Load the blocks are for, its priority class orders them against other loads and cancelling it drops them
 		 */
 		bool RequestBlockMain(
 			std::shared_ptr<boost::asio::io_context> ioc,
@@ -263,7 +282,8 @@ namespace sgns
 			bool parse,
 			bool save,
 			CompletionCallback handle_read,
-			StatusCallback status);
+			StatusCallback status,
+			std::shared_ptr<LoadRequest> request);
 
 		/**
 		 * Add an address to pool of addresses to try to get file using IPFS bitswap
@@ -282,7 +302,7 @@ namespace sgns
 		 */
 		bool setContentForLinkedCID(const sgns::ipfs_bitswap::CID& mainCID,
 			const sgns::ipfs_bitswap::CID& linkedCID,
-			const std::vector<char>& content);
+			const BufferSlice& content);
 
 		bool CheckIfAllSet(const sgns::ipfs_bitswap::CID& mainCID);
 		/**
@@ -296,13 +316,57 @@ namespace sgns
 		 * @param cidInfo - A CIDInfo object struct as defined above
 		 */
 		size_t addCID(CIDInfo& cidInfo);
+
+		/**
+		 * Drop the queued block requests of a cancelled load, replies to the ones already sent are ignored
+		 * @param request - Load that was cancelled
+		 */
+		void withdrawBlocks(const LoadRequest* request);
 	private:
+		/**
+		 * Bitswap block reply handler
+		 */
+		using BlockCallback = std::function<bool(libp2p::outcome::result<std::string>)>;
+		/**
+		 * A block request waiting for a free slot
+		 */
+		struct PendingBlock
+		{
+			libp2p::peer::PeerInfo peer;
+			sgns::ipfs_bitswap::CID cid;
+			BlockCallback callback;
+			std::shared_ptr<LoadRequest> request;
+			/// @brief when the request was made, for the tracer
+			std::chrono::steady_clock::time_point queuedAt;
+		};
 		/**
 		 * Create an IPFSDevice along with associated bitswap and host on an asio io_context
 		 * @param ioc - Asio io context to use
 		 */
 		IPFSDevice(std::shared_ptr<boost::asio::io_context> ioc);
 
+		/**
+		 * Get a copy of a peer address, safe to call while other threads add addresses
+		 * @param addressoffset - Offset from list of addresses to get
+		 * @return The peer, or nothing if we ran out of addresses
+		 */
+		std::optional<libp2p::peer::PeerInfo> getPeerAddress(size_t addressoffset);
+
+		/**
+		 * Send a block request now if there is a free slot or the load is interactive, otherwise queue it by priority.
+		 * Dropped if the load was already cancelled.
+		 * @param request - Load the block belongs to
+		 * @param peer - Peer to request from
+		 * @param cid - Block to request
+		 * @param callback - Called with the block or an error
+		 */
+		void sendBlockRequest(std::shared_ptr<LoadRequest> request, const libp2p::peer::PeerInfo& peer, const sgns::ipfs_bitswap::CID& cid, BlockCallback callback);
+		/**
+		 * Hand the block request to bitswap, the slot is freed once the reply arrives
+		 * @param block - Request to send
+		 */
+		void dispatchBlockRequest(PendingBlock block);
+
 		/**
 		 * Add the sub CID for a file to bitswap wantlist to get part of file
 		 * @param ioc - Asio io context to use
@@ -315,6 +379,7 @@ namespace sgns
 		 * @param save - Whether to save the file to local disk upon completion
 		 * @param handle_read - Filemanager callback on completion
 		 * @param status - Status function that will be updated with status codes as operation progresses
+		 * @param request - Load the blocks are for, its priority class orders them against other loads and cancelling it drops them
 		 */
 		bool RequestBlockSub(
 			std::shared_ptr<boost::asio::io_context> ioc,
@@ -326,17 +391,23 @@ namespace sgns
 			bool parse,
 			bool save,
 			CompletionCallback handle_read,
-			StatusCallback status);
+			StatusCallback status,
+			std::shared_ptr<LoadRequest> request);
 
 
 		//Common vars used for getting file from IPFS
 		static std::shared_ptr<IPFSDevice> instance_;
 		static std::mutex mutex_;
+		//Bitswap callbacks can arrive on any io_context thread, guards requestedCIDs_ and peerAddresses_
+		std::mutex requestMutex_;
 
 		std::shared_ptr<sgns::ipfs_lite::ipfs::dht::IpfsDHT> dht_;
 		std::shared_ptr<libp2p::Host> host_;
 		std::shared_ptr<sgns::ipfs_bitswap::Bitswap> bitswap_;
-		boost::asio::deadline_timer dhtretry_;
+		//Block requests waiting for a slot, per priority class, guarded by blockMutex_
+		std::mutex blockMutex_;
+		std::array<std::deque<PendingBlock>, 3> pendingBlocks_;
+		size_t outstandingBlocks_ = 0;
 		//std::shared_ptr<std::vector<libp2p::multi::Multiaddress>> peerAddresses_;
 		std::shared_ptr<std::vector<libp2p::peer::PeerInfo>> peerAddresses_;
 
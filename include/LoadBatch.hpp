@@ -0,0 +1,170 @@
+/**
+ * Header file for the LoadBatch
+ */
+#ifndef LOADBATCH_HPP
+#define LOADBATCH_HPP
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "boost/asio/io_context.hpp"
+#include "FILEError.hpp"
+#include "LoadRequest.hpp"
+
+namespace sgns
+{
+	/**
+	 * Options for FileManager::LoadMany
+	 */
+	struct LoadBatchOptions
+	{
+		/// @brief Maximum number of loads in flight for the whole batch, 0 for no limit
+		size_t maxInFlight = 16;
+		/// @brief Maximum number of loads in flight for any one scheme, 0 for no limit
+		size_t maxInFlightPerScheme = 0;
+		/// @brief Overrides maxInFlightPerScheme for specific schemes, i.e. { "ipfs", 4 }
+		std::map<std::string, size_t> schemeLimits;
+		/// @brief Whether to parse each file upon completion (for MNN)
+		bool parse = false;
+		/// @brief Whether to save each file upon completion
+		bool save = false;
+		/// @brief Prefix of the saver to use when save is set
+		std::string savetype;
+		/// @brief Priority class of every item, i.e. Prefetch for warming the caches in the background
+		LoadPriority priority = LoadPriority::Normal;
+	};
+
+	/**
+	 * A batch of loads started by FileManager::LoadMany. Items are queued per scheme and started
+	 * round-robin across the schemes, so a slow scheme can use at most its own limit and never holds up the others.
+	 */
+	class LoadBatch : public std::enable_shared_from_this<LoadBatch> {
+	public:
+		/**
+		 * Called once per item when it finishes
+		 * @param index - Position of the URL in the batch
+		 * @param url - URL that was loaded
+		 * @param state - Final state of the item
+		 * @param buffers - Contains path/data loaded, empty unless state is Completed
+		 */
+		using ItemHandler = std::function<void(size_t index, const std::string& url, LoadRequest::State state, LoadRequest::LoadBuffers buffers)>;
+		/**
+		 * Status updates for an item as it proceeds
+		 * @param index - Position of the URL in the batch
+		 * @param status - Status reported by the loader
+		 */
+		using StatusHandler = std::function<void(size_t index, const sgns::AsyncError::CustomResult& status)>;
+		/**
+		 * Called once when every item has finished
+		 * @param batch - The finished batch, results can be read from it
+		 */
+		using BatchHandler = std::function<void(const LoadBatch& batch)>;
+
+		/**
+		 * Create a batch, call Start to begin loading
+		 * @param urls - URLs to load
+		 * @param options - Concurrency limits and load options
+		 * @param ioc - ASIO context for async loading
+		 */
+		LoadBatch(std::vector<std::string> urls, LoadBatchOptions options, std::shared_ptr<boost::asio::io_context> ioc);
+
+		/**
+		 * Set the per item handlers, must be called before Start
+		 */
+		void SetItemHandlers(ItemHandler onItem, StatusHandler onStatus);
+		/**
+		 * Set the handler for when the whole batch is done, must be called before Start
+		 */
+		void SetBatchHandler(BatchHandler onDone);
+		/**
+		 * Start as many items as the limits allow, the rest start as earlier ones finish
+		 */
+		void Start();
+		/**
+		 * Cancel every queued and in flight item
+		 */
+		void Cancel();
+
+		/**
+		 * Number of URLs in the batch
+		 */
+		size_t size() const {
+			return items_.size();
+		}
+		/**
+		 * Number of items that have finished, in any state
+		 */
+		size_t GetFinishedCount() const;
+		/**
+		 * Poll whether every item has finished
+		 */
+		bool IsDone() const;
+		/**
+		 * Block until every item has finished and the batch handler has returned. Do not call from a thread running the io_context.
+		 */
+		void Wait() const;
+		/**
+		 * Get the final state of an item, Pending while it is queued or loading
+		 * @param index - Position of the URL in the batch
+		 */
+		LoadRequest::State GetState(size_t index) const;
+		/**
+		 * Get the data an item loaded, empty unless it Completed
+		 * @param index - Position of the URL in the batch
+		 */
+		LoadRequest::LoadBuffers GetResult(size_t index) const;
+
+	private:
+		struct Item
+		{
+			std::string url;
+			std::string scheme;
+			std::shared_ptr<LoadRequest> request;
+			LoadRequest::State state = LoadRequest::State::Pending;
+			LoadRequest::LoadBuffers result;
+		};
+
+		/**
+		 * Pick the next items to run, round-robin over schemes with queued items. Called with the lock held.
+		 * @return Indices of items to start
+		 */
+		std::vector<size_t> TakeRunnable();
+		/**
+		 * Start the next runnable items, outside the lock since requests can complete synchronously
+		 */
+		void Pump();
+		void StartItem(size_t index);
+		void FinishItem(size_t index, LoadRequest::State state, LoadRequest::LoadBuffers buffers);
+		/**
+		 * Run the batch handler, then release Wait
+		 */
+		void FinishBatch();
+		size_t SchemeLimit(const std::string& scheme) const;
+
+		LoadBatchOptions options_;
+		std::shared_ptr<boost::asio::io_context> ioc_;
+		ItemHandler onItem_;
+		StatusHandler onStatus_;
+		BatchHandler onDone_;
+
+		mutable std::mutex mutex_;
+		mutable std::condition_variable done_;
+		std::vector<Item> items_;
+		/// @brief Queued item indices per scheme
+		std::map<std::string, std::deque<size_t>> queues_;
+		/// @brief Schemes in the order they are served, the front is served next
+		std::deque<std::string> schemeOrder_;
+		std::map<std::string, size_t> inFlightPerScheme_;
+		size_t inFlight_ = 0;
+		size_t finished_ = 0;
+		bool cancelled_ = false;
+		/// @brief Set once the batch handler has returned, what Wait waits for
+		bool handled_ = false;
+	};
+}
+
+#endif
@@ -0,0 +1,68 @@
+/**
+ * Header file for the LoadEvent
+ */
+#ifndef LOADEVENT_HPP
+#define LOADEVENT_HPP
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include "boost/system/error_code.hpp"
+
+namespace sgns
+{
+	/**
+	 * Steps a load goes through, not every scheme has every step
+	 */
+	enum class LoadPhase : uint8_t
+	{
+		Queued,    ///< Waiting for a scheduler or connection slot
+		Resolve,   ///< DNS lookup of the host, or the provider lookup for IPFS
+		Connect,   ///< TCP connect
+		Handshake, ///< TLS handshake, plus the WebSocket upgrade or SSH auth where there is one
+		FirstByte, ///< From sending the request to the first byte of the response
+		Transfer,  ///< From the first byte to the last
+		Parse,     ///< Parser for the suffix, on the CPU pool
+		Save,      ///< Saver for the savetype
+		Done,      ///< Finished, error says whether it worked
+		Retry      ///< Another attempt is coming, after delay for a retry or right away for a hedge
+	};
+
+	/**
+	 * Progress of a load, small and trivially copyable so loaders can report every step and every read
+	 * without allocating. Text for people is only built by ToString.
+	 */
+	struct LoadEvent
+	{
+		/// @brief Phase the load just entered, or Transfer for progress within it
+		LoadPhase phase = LoadPhase::Queued;
+		/// @brief Bytes transferred so far
+		uint64_t bytes = 0;
+		/// @brief Size of the file if the source told us, 0 if unknown
+		uint64_t totalBytes = 0;
+		std::chrono::steady_clock::time_point time;
+		/// @brief Backoff before the next attempt, Retry only
+		std::chrono::milliseconds delay{ 0 };
+		/// @brief Set when the phase failed, operation_canceled and timed_out on Done for aborted loads
+		boost::system::error_code error;
+
+		/**
+		 * Describe the event, i.e. "Transfer 1048576/4194304 bytes"
+		 */
+		std::string ToString() const;
+	};
+
+	/**
+	 * Error category for HTTP status codes, lets a failed response carry its status in LoadEvent::error
+	 */
+	const boost::system::error_category& HTTPStatusCategory();
+	/**
+	 * Make an error for a response that wasn't a success, i.e. 404
+	 * @param statusCode - Status code from the response's status line
+	 */
+	inline boost::system::error_code MakeHTTPStatusError(int statusCode)
+	{
+		return boost::system::error_code(statusCode, HTTPStatusCategory());
+	}
+}
+
+#endif
@@ -0,0 +1,112 @@
+/**
+ * Header file for the LoadMetrics
+ */
+#ifndef LOADMETRICS_HPP
+#define LOADMETRICS_HPP
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "LoadEvent.hpp"
+
+namespace sgns
+{
+	/**
+	 * Latency histogram with fixed buckets, the same for every phase so they can be compared and summed
+	 */
+	struct LatencyHistogram
+	{
+		/**
+		 * Upper bounds of the buckets in seconds, an implicit +Inf bucket follows the last
+		 */
+		static const std::vector<double>& Bounds();
+
+		/// @brief Observations per bucket, not cumulative, one more entry than Bounds for +Inf
+		std::vector<uint64_t> buckets = std::vector<uint64_t>(Bounds().size() + 1, 0);
+		uint64_t count = 0;
+		/// @brief Sum of every observation in seconds
+		double sum = 0;
+
+		void Observe(double seconds);
+	};
+
+	/**
+	 * Counters of one scheme and host
+	 */
+	struct TargetCounters
+	{
+		/// @brief Transfer attempts started, retries and hedged requests included
+		uint64_t requests = 0;
+		/// @brief Bytes delivered by successful transfers
+		uint64_t bytes = 0;
+		/// @brief Attempts that failed, cancellations excluded
+		uint64_t errors = 0;
+	};
+
+	/**
+	 * Copy of every metric at one point in time
+	 */
+	struct MetricsSnapshot
+	{
+		/// @brief Counters by scheme and host
+		std::map<std::pair<std::string, std::string>, TargetCounters> targets;
+		/// @brief Latencies by scheme and phase
+		std::map<std::pair<std::string, LoadPhase>, LatencyHistogram> phases;
+	};
+
+	/**
+	 * Request, byte and error counts per scheme and host, and latency histograms per scheme and phase.
+	 * Hosts are only kept on the counters, per host histograms would grow without bound.
+	 */
+	class LoadMetrics {
+	public:
+		void RecordRequest(const std::string& scheme, const std::string& host);
+		void RecordBytes(const std::string& scheme, const std::string& host, uint64_t bytes);
+		void RecordError(const std::string& scheme, const std::string& host);
+		/**
+		 * Add a phase latency
+		 * @param scheme - Scheme of the load, i.e. "https"
+		 * @param phase - Phase that took this long
+		 * @param elapsed - Duration of the phase
+		 */
+		void RecordPhase(const std::string& scheme, LoadPhase phase, std::chrono::steady_clock::duration elapsed);
+		/**
+		 * Record the time since start as a phase and restart the clock for the next one
+		 * @param start - When the phase started, set to now
+		 */
+		void EndPhase(const std::string& scheme, LoadPhase phase, std::chrono::steady_clock::time_point& start);
+
+		/**
+		 * Copy every metric
+		 */
+		MetricsSnapshot Snapshot() const;
+		/**
+		 * Every metric in the Prometheus text exposition format, to serve from a /metrics endpoint
+		 */
+		std::string PrometheusText() const;
+		/**
+		 * Clear every metric
+		 */
+		void Reset();
+
+		/**
+		 * Lowercase name of a phase as used in the "phase" label, i.e. "first_byte"
+		 */
+		static const char* PhaseName(LoadPhase phase);
+		/**
+		 * Host part of a URL path as getURLComponents splits it, without user info or port
+		 * @param scheme - Prefix of the URL, schemes without hosts (file, ipfs) get an empty host
+		 * @param path - Rest of the URL after "://"
+		 */
+		static std::string HostOf(const std::string& scheme, const std::string& path);
+
+	private:
+		mutable std::mutex mutex_;
+		MetricsSnapshot metrics_;
+	};
+}
+
+#endif
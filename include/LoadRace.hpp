@@ -0,0 +1,154 @@
+/**
+ * Header file for the LoadRace
+ */
+#ifndef LOADRACE_HPP
+#define LOADRACE_HPP
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "boost/asio/io_context.hpp"
+#include "boost/asio/steady_timer.hpp"
+#include "boost/asio/strand.hpp"
+#include "FILEError.hpp"
+#include "LoadRequest.hpp"
+
+namespace sgns
+{
+	/**
+	 * Options for FileManager::LoadAny
+	 */
+	struct LoadRaceOptions
+	{
+		/// @brief Expected SHA-256 of the data as lowercase hex, empty takes the first complete result unverified
+		std::string sha256;
+		/// @brief Candidates loading at once, 1 tries them strictly in order, 0 starts them all
+		size_t maxParallel = 0;
+		/// @brief Start the next candidate after this long even if the running ones haven't failed, 0 waits for a failure
+		std::chrono::milliseconds stagger{ 0 };
+		/// @brief Whether to parse the winning file (for MNN)
+		bool parse = false;
+		/// @brief Whether to save the winning file
+		bool save = false;
+		/// @brief Prefix of the saver to use when save is set
+		std::string savetype;
+		/// @brief Priority class every candidate is admitted with
+		LoadPriority priority = LoadPriority::Normal;
+		/// @brief Time the whole race out if no candidate won by then, 0 for no deadline
+		std::chrono::milliseconds timeout{ 0 };
+	};
+
+	/**
+	 * Loads the same content from a list of alternative URLs, i.e. mirrors on different schemes.
+	 * Candidates are started in list order, up to maxParallel at a time and every stagger interval,
+	 * and each failure starts the next one. The first result whose digest matches wins and the
+	 * candidates still loading are cancelled.
+	 */
+	class LoadRace : public std::enable_shared_from_this<LoadRace> {
+	public:
+		/// @brief Index reported when there is no winner
+		static constexpr size_t npos = static_cast<size_t>(-1);
+
+		/**
+		 * Called once when the race is decided
+		 * @param index - Position of the winning URL, npos when every candidate failed or the race was cancelled
+		 * @param buffers - Verified data of the winner, empty if there is none
+		 */
+		using WinnerHandler = std::function<void(size_t index, LoadRequest::LoadBuffers buffers)>;
+		/**
+		 * Status updates of a candidate as it proceeds
+		 * @param index - Position of the URL in the list
+		 * @param status - Status reported by the loader or the verification
+		 */
+		using StatusHandler = std::function<void(size_t index, const sgns::AsyncError::CustomResult& status)>;
+
+		/**
+		 * Create a race, call Start to begin loading
+		 * @param urls - Alternative URLs of the same content, most preferred first
+		 * @param options - Expected digest, parallelism and load options
+		 * @param ioc - ASIO context for async loading
+		 */
+		LoadRace(std::vector<std::string> urls, LoadRaceOptions options, std::shared_ptr<boost::asio::io_context> ioc);
+
+		/**
+		 * Set the handlers, must be called before Start
+		 */
+		void SetHandlers(WinnerHandler onWinner, StatusHandler onStatus);
+		/**
+		 * Start the first candidates
+		 */
+		void Start();
+		/**
+		 * Cancel every running candidate and decide the race without a winner
+		 */
+		void Cancel();
+
+		/**
+		 * Get the URL of a candidate
+		 * @param index - Position of the URL in the list
+		 */
+		const std::string& GetURL(size_t index) const {
+			return candidates_.at(index).url;
+		}
+		/**
+		 * Number of candidates
+		 */
+		size_t size() const {
+			return candidates_.size();
+		}
+
+		/**
+		 * SHA-256 over the bytes of every file in the result, in entry order
+		 * @param buffers - Loaded data
+		 * @return Lowercase hex digest, empty if hashing failed
+		 */
+		static std::string Sha256Hex(const LoadResult& buffers);
+
+	private:
+		struct Candidate
+		{
+			std::string url;
+			std::shared_ptr<LoadRequest> request;
+		};
+
+		/**
+		 * Start candidates until maxParallel are running, then arm the stagger timer for the one after
+		 * @param one - Start at most one candidate, for staggered starts and failovers
+		 */
+		void Pump(bool one);
+		void StartCandidate(size_t index);
+		/**
+		 * Verify a finished candidate on the CPU pool when there is a digest to check
+		 */
+		void FinishCandidate(size_t index, LoadRequest::State state, LoadRequest::LoadBuffers buffers);
+		/**
+		 * Take a verified result as the winner, or fail over to the next candidate
+		 * @param buffers - Verified data, empty if the candidate failed
+		 */
+		void Settle(size_t index, LoadRequest::LoadBuffers buffers);
+		/**
+		 * Decide the race once, cancelling whatever is still running
+		 */
+		void Decide(size_t index, LoadRequest::LoadBuffers buffers);
+		void ReportStatus(size_t index, const sgns::AsyncError::CustomResult& status);
+
+		LoadRaceOptions options_;
+		std::shared_ptr<boost::asio::io_context> ioc_;
+		/// @brief Serializes the stagger timer, which is armed from whichever thread a candidate finished on
+		boost::asio::strand<boost::asio::io_context::executor_type> strand_;
+		boost::asio::steady_timer staggerTimer_;
+		WinnerHandler onWinner_;
+		StatusHandler onStatus_;
+
+		std::mutex mutex_;
+		std::vector<Candidate> candidates_;
+		/// @brief Next candidate to start
+		size_t next_ = 0;
+		size_t running_ = 0;
+		bool decided_ = false;
+	};
+}
+
+#endif
@@ -0,0 +1,314 @@
+/**
+ * Header file for the LoadRequest
+ */
+#ifndef LOADREQUEST_HPP
+#define LOADREQUEST_HPP
+#include <atomic>
+#include <cstdint>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "FILEError.hpp"
+#include "LoadEvent.hpp"
+#include "LoadResult.hpp"
+
+namespace sgns
+{
+	/**
+	 * An ordered byte range of a file, delivered while the transfer is still running
+	 */
+	struct LoadChunk
+	{
+		/// @brief Name of the file the chunk belongs to, as in the final LoadResult
+		std::string name;
+		/// @brief Offset of the chunk in the file
+		uint64_t offset = 0;
+		/// @brief The bytes, shares ownership with the final LoadResult so nothing is copied
+		BufferSlice data;
+		/// @brief True on the final chunk of the file, which may be empty when the loader only finds the end by reading it
+		bool last = false;
+	};
+
+	/**
+	 * Priority class of a load, most urgent first
+	 */
+	enum class LoadPriority
+	{
+		Interactive, ///< Someone is waiting on the result, never queued
+		Normal,      ///< Default for loads that are not marked otherwise
+		Prefetch     ///< Background loads, only run on capacity the others leave free
+	};
+
+	/**
+	 * Handle returned by FileManager::LoadASync. Tracks the completion state of a single
+	 * request so it can be polled, waited on or cancelled independently of the io_context.
+	 */
+	class LoadRequest : public std::enable_shared_from_this<LoadRequest> {
+	public:
+		/**
+		 * Data loaded by the request, names and contents of each file
+		 */
+		using LoadBuffers = std::shared_ptr<const LoadResult>;
+
+		enum class State
+		{
+			Pending,   ///< Still loading, parsing or saving
+			Completed, ///< Finished with data
+			Failed,    ///< Finished without data
+			Cancelled, ///< Cancelled before it finished
+			TimedOut   ///< Deadline passed before it finished
+		};
+
+		/**
+		 * Completion handler, called once when the request leaves the Pending state
+		 * @param state - Final state of the request
+		 * @param buffers - Contains path/data loaded, empty unless state is Completed
+		 */
+		using CompleteHandler = std::function<void(State state, LoadBuffers buffers)>;
+		/**
+		 * Chunk handler, called with each chunk in order. No further chunk is read until resume is called,
+		 * which gives the consumer backpressure over the transfer.
+		 * @param chunk - Next byte range
+		 * @param resume - Call once the chunk has been dealt with, from any thread
+		 */
+		using ChunkHandler = std::function<void(const LoadChunk& chunk, std::function<void()> resume)>;
+		/**
+		 * Event handler, called with every step and read of the load, from whichever thread it happened on
+		 * @param event - What happened, build text with event.ToString() only if it is shown
+		 */
+		using EventHandler = std::function<void(const LoadEvent& event)>;
+
+		/**
+		 * Create a pending request
+		 * @param url - URL being loaded
+		 */
+		explicit LoadRequest(std::string url);
+
+		/**
+		 * Get the URL this request is loading
+		 */
+		const std::string& GetURL() const {
+			return url_;
+		}
+		/**
+		 * Get the current state of the request
+		 */
+		State GetState() const;
+		/**
+		 * Poll whether the request has left the Pending state
+		 */
+		bool IsDone() const;
+		/**
+		 * Whether Cancel or Expire was called before the request finished
+		 */
+		bool IsCancelled() const {
+			return cancelled_.load();
+		}
+		/**
+		 * Get the loaded data, empty until the request is Completed
+		 */
+		LoadBuffers GetResult() const;
+
+		/**
+		 * Block until the request is done. Do not call from a thread running the io_context the request
+		 * is on, the request would never complete.
+		 * @return Final state of the request
+		 */
+		State Wait() const;
+		/**
+		 * Block until the request is done or the timeout expires
+		 * @param timeout - Maximum time to wait
+		 * @return True if the request finished in time
+		 */
+		template <typename Rep, typename Period>
+		bool WaitFor(const std::chrono::duration<Rep, Period>& timeout) const
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			return done_.wait_for(lock, timeout, [this] { return state_ != State::Pending; });
+		}
+
+		/**
+		 * Cancel the request. Runs all handlers registered with OnCancel and completes the request as Cancelled.
+		 * @return False if the request had already finished
+		 */
+		bool Cancel();
+		/**
+		 * Time the request out, same as Cancel but it completes as TimedOut
+		 * @return False if the request had already finished
+		 */
+		bool Expire();
+		/**
+		 * Register a function to run when the request is cancelled, runs immediately if it already was
+		 * @param handler - Function to abort whatever work is in progress
+		 */
+		void OnCancel(std::function<void()> handler);
+		/**
+		 * Register a function to run when the request finishes, runs immediately if it already has
+		 * @param handler - Completion handler
+		 */
+		void OnComplete(CompleteHandler handler);
+		/**
+		 * Finish the request with the loaded data, called by FileManager
+		 * @param buffers - Contains path/data loaded, empty on failure
+		 * @return False if the request had already finished, i.e. it was cancelled
+		 */
+		bool Complete(LoadBuffers buffers);
+
+		/**
+		 * Stream the data as it arrives, must be set before the load starts
+		 * @param handler - Called with each chunk in order
+		 */
+		void SetChunkHandler(ChunkHandler handler);
+		/**
+		 * Whether a chunk handler was set, loaders only read in chunks when one was
+		 */
+		bool IsStreaming() const;
+		/**
+		 * Whether any chunk was delivered, loaders that can't stream leave this false and
+		 * FileManager delivers their whole files as chunks instead
+		 */
+		bool HasDeliveredChunks() const;
+		/**
+		 * Hand a chunk to the consumer, called by loaders
+		 * @param chunk - Next byte range
+		 * @param resume - Continues the transfer, called right away if the request has no handler or was cancelled
+		 */
+		void DeliverChunk(const LoadChunk& chunk, std::function<void()> resume);
+		/**
+		 * Hand a run of chunks that are all at hand to the consumer, i.e. the slices of a finished load or of a mapped file.
+		 * Chunks resumed before DeliverChunk returns (right away, or when cancelled) are delivered by a loop rather than
+		 * from inside resume, so any number of them takes constant stack.
+		 * @param next - Fills in the next chunk, returns false once there are none left
+		 * @param done - Called once the consumer has resumed after the last chunk
+		 */
+		void DeliverChunks(std::function<bool(LoadChunk& chunk)> next, std::function<void()> done);
+
+		/**
+		 * Receive typed progress events, must be set before the load starts
+		 * @param handler - Called with each event
+		 */
+		void SetEventHandler(EventHandler handler);
+		/**
+		 * Whether anyone listens to events, so callers can skip building them
+		 */
+		bool HasEventHandler() const {
+			return hasEventHandler_.load(std::memory_order_acquire);
+		}
+		/**
+		 * Report an event, called by loaders and FileManager. Costs a flag check when nobody listens.
+		 * @param phase - Phase entered, or Transfer for progress
+		 * @param bytes - Bytes transferred so far
+		 * @param totalBytes - Size of the file if known
+		 * @param error - Set if the phase failed
+		 */
+		void Report(LoadPhase phase, uint64_t bytes = 0, uint64_t totalBytes = 0, boost::system::error_code error = {}) {
+			if (HasEventHandler())
+			{
+				LoadEvent event;
+				event.phase = phase;
+				event.bytes = bytes;
+				event.totalBytes = totalBytes;
+				event.time = std::chrono::steady_clock::now();
+				event.error = error;
+				eventHandler_(event);
+			}
+		}
+		/**
+		 * Hand on an event reported elsewhere, i.e. by the transfer this request is attached to
+		 */
+		void Forward(const LoadEvent& event) {
+			if (HasEventHandler())
+			{
+				eventHandler_(event);
+			}
+		}
+
+		/**
+		 * Set the validator of a copy the caller already holds, i.e. a cached ETag. Loaders that can revalidate
+		 * send it and call SetNotModified instead of transferring the data again.
+		 * @param validator - Scheme specific validator, empty for none
+		 */
+		void SetCachedValidator(std::string validator);
+		std::string GetCachedValidator() const;
+		/**
+		 * Set the validator of the data the loader delivered, so it can be stored alongside it
+		 * @param validator - Scheme specific validator, i.e. an ETag or size and mtime
+		 */
+		void SetValidator(std::string validator);
+		std::string GetValidator() const;
+		/**
+		 * Mark that the source confirmed the cached copy is current, the loader then completes without data
+		 */
+		void SetNotModified();
+		bool IsNotModified() const;
+
+		/**
+		 * Set the priority class, loaders read it when ordering their own queues
+		 * @param priority - Priority class of the load
+		 */
+		void SetPriority(LoadPriority priority) {
+			priority_ = priority;
+		}
+		LoadPriority GetPriority() const {
+			return priority_.load();
+		}
+
+	private:
+		/**
+		 * Run the cancel handlers and complete the request in the given state
+		 * @param state - Cancelled or TimedOut
+		 */
+		bool Abort(State state);
+
+		std::string url_;
+		std::atomic<bool> cancelled_{ false };
+		mutable std::mutex mutex_;
+		mutable std::condition_variable done_;
+		State state_ = State::Pending;
+		LoadBuffers result_;
+		std::vector<std::function<void()>> cancelHandlers_;
+		std::vector<CompleteHandler> completeHandlers_;
+		std::string cachedValidator_;
+		std::string validator_;
+		bool notModified_ = false;
+		ChunkHandler chunkHandler_;
+		/// @brief Not changed once the load started, so it is called without the lock
+		EventHandler eventHandler_;
+		std::atomic<bool> hasEventHandler_{ false };
+		std::atomic<bool> deliveredChunks_{ false };
+		std::atomic<LoadPriority> priority_{ LoadPriority::Normal };
+	};
+
+	/**
+	 * Options for a single load through FileManager::AsyncLoad/Load
+	 */
+	struct LoadOptions
+	{
+		/// @brief Whether to parse the file upon completion (for MNN)
+		bool parse = false;
+		/// @brief Whether to save the file upon completion
+		bool save = false;
+		/// @brief Prefix of the saver to use when save is set
+		std::string savetype;
+		/// @brief Optional, receives the data in order as it arrives
+		LoadRequest::ChunkHandler onChunk;
+		/// @brief Priority class the load is admitted and scheduled with
+		LoadPriority priority = LoadPriority::Normal;
+		/// @brief Time the load out if it hasn't finished by then, 0 for no deadline
+		std::chrono::milliseconds timeout{ 0 };
+		/// @brief Optional, receives typed progress events
+		LoadRequest::EventHandler onEvent;
+	};
+
+	/**
+	 * Outcome of FileManager::AsyncLoad/Load, the loaded data or why there is none
+	 */
+	using LoadOutcome = AsyncError::outcome::result<LoadRequest::LoadBuffers, std::string>;
+}
+
+#endif
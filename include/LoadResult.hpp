@@ -0,0 +1,132 @@
+/**
+ * Header file for the LoadResult
+ */
+#ifndef LOADRESULT_HPP
+#define LOADRESULT_HPP
+#include <memory>
+#include <string>
+#include <vector>
+#include "boost/asio/buffer.hpp"
+#include "boost/asio/streambuf.hpp"
+
+namespace sgns
+{
+	/**
+	 * A view into a ref-counted segment of memory. The segment is kept alive for as long as any
+	 * slice refers to it, so slices can be handed from loaders to savers and callers without copying.
+	 */
+	struct BufferSlice
+	{
+		/// @brief Keeps the memory the slice points into alive, whatever type it is
+		std::shared_ptr<const void> owner;
+		const char* data = nullptr;
+		size_t size = 0;
+
+		BufferSlice() = default;
+		/**
+		 * Create a slice of memory owned by some ref-counted object
+		 * @param sliceowner - Object owning the memory
+		 * @param slicedata - Start of the slice
+		 * @param slicesize - Number of bytes in the slice
+		 */
+		BufferSlice(std::shared_ptr<const void> sliceowner, const char* slicedata, size_t slicesize)
+			: owner(std::move(sliceowner)), data(slicedata), size(slicesize) {}
+
+		/**
+		 * Take ownership of a vector without copying it
+		 * @param content - Data to own
+		 */
+		static BufferSlice FromVector(std::vector<char>&& content);
+		/**
+		 * Slice the readable area of a streambuf without copying it
+		 * @param buffer - Streambuf that a read completed into, must not be written to afterwards
+		 * @param offset - Offset into the readable area
+		 * @param length - Number of bytes to include
+		 */
+		static BufferSlice FromStreambuf(std::shared_ptr<boost::asio::streambuf> buffer, size_t offset, size_t length);
+
+		/**
+		 * Get a narrower view into the same segment
+		 * @param offset - Offset into this slice
+		 * @param length - Number of bytes to include
+		 */
+		BufferSlice SubSlice(size_t offset, size_t length) const;
+		/**
+		 * Get the slice as an asio buffer for gather writes
+		 */
+		boost::asio::const_buffer AsBuffer() const {
+			return boost::asio::const_buffer(data, size);
+		}
+		bool empty() const {
+			return size == 0;
+		}
+	};
+
+	/**
+	 * A named file in a load result, made of a chain of slices in file order
+	 */
+	struct BufferEntry
+	{
+		/// @brief Relative path of the file, i.e. "model.mnn" or "dir/model.mnn"
+		std::string name;
+		std::vector<BufferSlice> slices;
+
+		/**
+		 * Total number of bytes in the file
+		 */
+		size_t Size() const;
+		/**
+		 * Get the file as a single slice, only copies when it spans multiple slices
+		 */
+		BufferSlice Contiguous() const;
+		/**
+		 * Copy the file to a destination of at least Size() bytes
+		 * @param dest - Memory to copy to
+		 */
+		void CopyTo(void* dest) const;
+		/**
+		 * Get a buffer sequence over every slice for gather writes
+		 */
+		std::vector<boost::asio::const_buffer> AsBuffers() const;
+	};
+
+	/**
+	 * Result of a load, a list of named files whose contents point into ref-counted segments.
+	 * Loaders build one of these and hand it on as a shared_ptr to const, so every consumer shares the same bytes.
+	 */
+	class LoadResult
+	{
+	public:
+		/**
+		 * Add a file consisting of one slice
+		 * @param name - Relative path of the file
+		 * @param slice - Contents
+		 */
+		void Add(std::string name, BufferSlice slice);
+		/**
+		 * Add a file consisting of a chain of slices
+		 * @param name - Relative path of the file
+		 * @param slices - Contents in file order
+		 */
+		void Add(std::string name, std::vector<BufferSlice> slices);
+		/**
+		 * Total number of bytes over every file
+		 */
+		size_t TotalSize() const;
+		/**
+		 * Number of files
+		 */
+		size_t size() const {
+			return entries.size();
+		}
+		bool empty() const {
+			return entries.empty();
+		}
+
+		std::vector<BufferEntry> entries;
+		/// @brief Object the parser for the URL suffix built from the files, i.e. an MNNModel, empty unless the load asked to parse
+		std::shared_ptr<void> parsed;
+	};
+}
+
+#endif
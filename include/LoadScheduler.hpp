@@ -0,0 +1,96 @@
+/**
+ * Header file for the LoadScheduler
+ */
+#ifndef LOADSCHEDULER_HPP
+#define LOADSCHEDULER_HPP
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <vector>
+#include "LoadRequest.hpp"
+
+namespace sgns
+{
+	/**
+	 * Admission control for the transfers FileManager starts, by priority class.
+	 * Interactive transfers always start right away. Normal ones wait for a free slot once maxActive transfers
+	 * are running. Prefetches also stay under their own cap and only start when no normal transfer is waiting,
+	 * so a bulk prefetch can never fill the slots an interactive or normal load needs.
+	 * Waiting transfers start in class order, oldest first within a class.
+	 */
+	class LoadScheduler {
+	public:
+		using Ticket = uint64_t;
+
+		LoadScheduler() = default;
+
+		/**
+		 * Change the limits, waiting transfers that now fit are started
+		 * @param maxActive - Maximum transfers running at once, interactive ones excepted, 0 for no limit
+		 * @param maxPrefetch - Maximum prefetch transfers running at once, 0 for no limit
+		 */
+		void SetLimits(size_t maxActive, size_t maxPrefetch);
+		/**
+		 * Reserve a ticket, so it can be recorded before Submit can start anything
+		 */
+		Ticket NewTicket();
+		/**
+		 * Start a transfer now if its class has room, otherwise queue it
+		 * @param ticket - Ticket from NewTicket
+		 * @param priority - Priority class to admit it under
+		 * @param start - Starts the transfer, runs outside the scheduler lock, possibly on the thread that calls Release
+		 * @return True if it was started right away
+		 */
+		bool Submit(Ticket ticket, LoadPriority priority, std::function<void()> start);
+		/**
+		 * Move a waiting transfer to a more urgent class, i.e. when an interactive load attaches to a queued prefetch.
+		 * Does nothing if the transfer already started or the class is not more urgent.
+		 * @param ticket - Ticket the transfer was submitted with
+		 * @param priority - New priority class
+		 */
+		void Promote(Ticket ticket, LoadPriority priority);
+		/**
+		 * Free the slot of a finished transfer, or drop it from the queue if it never started
+		 * @param ticket - Ticket the transfer was submitted with
+		 */
+		void Release(Ticket ticket);
+		/**
+		 * Number of transfers running
+		 */
+		size_t GetActiveCount() const;
+		/**
+		 * Number of transfers waiting for a slot
+		 */
+		size_t GetQueuedCount() const;
+
+	private:
+		struct Waiting
+		{
+			Ticket ticket;
+			std::function<void()> start;
+		};
+
+		bool CanStartLocked(LoadPriority priority) const;
+		void ActivateLocked(Ticket ticket, LoadPriority priority);
+		/**
+		 * Pull every waiting transfer that now fits, most urgent first
+		 */
+		std::vector<std::function<void()>> TakeRunnableLocked();
+		void StartAll(std::vector<std::function<void()>> runnable);
+
+		mutable std::mutex mutex_;
+		size_t maxActive_ = 0;
+		size_t maxPrefetch_ = 4;
+		Ticket nextTicket_ = 1;
+		/// @brief Waiting transfers per priority class
+		std::array<std::deque<Waiting>, 3> queues_;
+		/// @brief Running transfers and the class they were admitted under
+		std::map<Ticket, LoadPriority> active_;
+		std::array<size_t, 3> activeCount_{};
+	};
+}
+
+#endif
@@ -0,0 +1,120 @@
+/**
+ * Header file for the LoadTracer
+ */
+#ifndef LOADTRACER_HPP
+#define LOADTRACER_HPP
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "LoadEvent.hpp"
+
+namespace sgns
+{
+	/**
+	 * Records timed spans of loads and exports them as Chrome trace JSON, which Perfetto and chrome://tracing open.
+	 * Every track (a URL, or a file being saved) is shown as its own row. Off until Enable is called, and then
+	 * only a flag check for code that records spans.
+	 */
+	class LoadTracer {
+	public:
+		using Clock = std::chrono::steady_clock;
+		/**
+		 * Extra key/value pairs shown with a span
+		 */
+		using Args = std::vector<std::pair<std::string, std::string>>;
+
+		/**
+		 * Start recording, dropping whatever was recorded before
+		 * @param maxSpans - Spans kept before new ones are dropped, so a forgotten tracer can't grow without bound
+		 */
+		void Enable(size_t maxSpans = 1000000);
+		/**
+		 * Stop recording, what was recorded stays until the next Enable
+		 */
+		void Disable();
+		bool IsEnabled() const {
+			return enabled_.load(std::memory_order_relaxed);
+		}
+
+		/**
+		 * Record a finished span
+		 * @param name - What ran, i.e. "parse"
+		 * @param category - Group for filtering in the viewer, i.e. "load", "ipfs" or "save"
+		 * @param track - Row the span is shown on, usually the URL
+		 * @param start - When it started
+		 * @param end - When it finished
+		 * @param args - Optional details
+		 */
+		void Span(std::string name, const char* category, const std::string& track, Clock::time_point start, Clock::time_point end, Args args = {});
+		/**
+		 * Turn the events of a transfer into spans, each phase lasting until the next one of the same attempt starts.
+		 * Events of the phase already open, i.e. transfer progress, extend it. Hedged and retried attempts of a
+		 * transfer, and transfers of the same URL, keep phases of their own even though they share a row.
+		 * @param track - Row the spans are shown on, usually the URL
+		 * @param transfer - Transfer the event belongs to, any address unique while it runs, i.e. its request
+		 * @param attempt - Attempt of the transfer that reported the event, 0 for the transfer itself, i.e. queued
+		 *                  or waiting to retry. An attempt's first event ends such a wait.
+		 * @param event - Event reported by the loader, Done closes the open phase. Done for attempt 0 ends the
+		 *                transfer and closes the phases its attempts left open.
+		 */
+		void OnEvent(const std::string& track, const void* transfer, size_t attempt, const LoadEvent& event);
+
+		/**
+		 * Every recorded span as Chrome trace JSON
+		 */
+		std::string ChromeTraceJSON() const;
+		/**
+		 * Write ChromeTraceJSON to a file
+		 * @return False if the file could not be written
+		 */
+		bool WriteChromeTrace(const std::string& path) const;
+		/**
+		 * Spans dropped because maxSpans was reached
+		 */
+		size_t GetDroppedCount() const;
+
+	private:
+		struct Record
+		{
+			std::string name;
+			const char* category;
+			uint32_t track;
+			Clock::time_point start;
+			Clock::time_point end;
+			Args args;
+		};
+		/// @brief Phase an attempt is in since OnEvent last saw it change
+		struct OpenPhase
+		{
+			LoadPhase phase;
+			Clock::time_point start;
+			uint64_t bytes = 0;
+			uint64_t totalBytes = 0;
+			uint32_t track = 0;
+		};
+		/// @brief Transfer and attempt a phase is open for
+		using OpenKey = std::pair<const void*, size_t>;
+
+		uint32_t TrackLocked(const std::string& track);
+		void AddLocked(Record record);
+		/// @brief Record the open phase as a span ending with event, returns the next open phase
+		std::map<OpenKey, OpenPhase>::iterator CloseLocked(std::map<OpenKey, OpenPhase>::iterator iter, const LoadEvent& event);
+
+		std::atomic<bool> enabled_{ false };
+		mutable std::mutex mutex_;
+		Clock::time_point epoch_ = Clock::now();
+		size_t maxSpans_ = 0;
+		size_t dropped_ = 0;
+		std::vector<Record> records_;
+		std::map<std::string, uint32_t> tracks_;
+		std::vector<std::string> trackNames_;
+		std::map<OpenKey, OpenPhase> open_;
+	};
+}
+
+#endif
@@ -6,6 +6,16 @@
 #include "MNNCommon.hpp"
 namespace sgns
 {
+    /**
+     * A model ready for inference, what MNNParser::ParseASync delivers in LoadResult::parsed
+     */
+    struct MNNModel
+    {
+        std::shared_ptr<MNN::Interpreter> interpreter;
+        /// @brief Session created with the input resized to the model dims, owned by the interpreter
+        MNN::Session* session = nullptr;
+    };
+
     class MNNParser: public FileParser
     {
             SINGLETON_PTR (MNNParser);
@@ -13,7 +23,7 @@ namespace sgns
             static void InitializeSingleton();
             virtual shared_ptr<void> ParseData(shared_ptr<void> data)
                     override;
-            virtual shared_ptr<void> ParseASync(std::shared_ptr<std::vector<char>> data)
+            virtual shared_ptr<void> ParseASync(std::shared_ptr<const sgns::LoadResult> data)
                 override;
     };
 } // End namespace sgns
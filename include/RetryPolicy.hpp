@@ -0,0 +1,106 @@
+/**
+ * Header file for the RetryPolicy
+ */
+#ifndef RETRYPOLICY_HPP
+#define RETRYPOLICY_HPP
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+
+namespace sgns
+{
+	/**
+	 * How the transfers of one scheme are retried and hedged
+	 */
+	struct RetryOptions
+	{
+		/// @brief Attempts per transfer including the first, hedged ones included, 1 never retries
+		size_t maxAttempts = 1;
+		/// @brief Backoff before the first retry
+		std::chrono::milliseconds initialBackoff{ 200 };
+		/// @brief Backoff growth per retry
+		double multiplier = 2.0;
+		/// @brief Backoff never grows past this
+		std::chrono::milliseconds maxBackoff{ 10000 };
+		/// @brief Fraction of the backoff that is randomized, 0 waits exactly, 1 waits anywhere from 0 to the full backoff
+		double jitter = 0.5;
+		/// @brief Latency percentile after which a duplicate request is sent, i.e. 0.95, 0 disables hedging
+		double hedgePercentile = 0;
+		/// @brief Successful loads to see before hedging, the percentile means little before that
+		size_t hedgeMinSamples = 20;
+	};
+
+	/**
+	 * Retry and hedging decisions for FileManager transfers and loaders with retries of their own.
+	 * Options are kept per scheme. All retries and hedges draw from one budget, every first attempt adds
+	 * budgetRatio of a token and every extra attempt takes a whole one, so a failing source can't multiply
+	 * the load on itself.
+	 */
+	class RetryPolicy {
+	public:
+		RetryPolicy();
+
+		/**
+		 * Set the options of a scheme
+		 * @param scheme - Prefix, i.e. "https", or "ipfs-dht" for the IPFS provider lookups
+		 */
+		void SetOptions(const std::string& scheme, RetryOptions options);
+		/**
+		 * Get the options of a scheme, the defaults (no retries, no hedging) if none were set
+		 */
+		RetryOptions GetOptions(const std::string& scheme) const;
+		/**
+		 * Set the retry budget
+		 * @param ratio - Tokens each first attempt adds, i.e. 0.1 allows one extra attempt per ten transfers
+		 * @param cap - Most tokens the budget holds, which is also how many retries a burst of failures can use
+		 */
+		void SetBudget(double ratio, double cap);
+
+		/**
+		 * Count a first attempt towards the budget
+		 */
+		void RecordAttempt();
+		/**
+		 * Take a token for a retry or a hedged request
+		 * @return False if the budget is spent and the attempt should not be made
+		 */
+		bool TryWithdraw();
+		/**
+		 * Backoff before a retry, with jitter
+		 * @param scheme - Scheme whose options to use
+		 * @param retry - Retries made so far, 0 for the first one
+		 */
+		std::chrono::milliseconds Backoff(const std::string& scheme, size_t retry);
+
+		/**
+		 * Record how long a successful load took, for the hedging percentile
+		 * @param scheme - Scheme of the load
+		 * @param latency - Time from the first attempt to the data
+		 */
+		void RecordLatency(const std::string& scheme, std::chrono::milliseconds latency);
+		/**
+		 * How long to wait before hedging a transfer
+		 * @param scheme - Scheme of the transfer
+		 * @return The configured percentile of recent latencies, zero when hedging is off or there are too few samples
+		 */
+		std::chrono::milliseconds HedgeDelay(const std::string& scheme) const;
+
+	private:
+		/// @brief Latencies kept per scheme
+		static constexpr size_t kLatencySamples = 256;
+
+		mutable std::mutex mutex_;
+		std::map<std::string, RetryOptions> options_;
+		std::map<std::string, std::deque<std::chrono::milliseconds>> latencies_;
+		double budgetRatio_ = 0.1;
+		double budgetCap_ = 10;
+		double budget_ = 10;
+		std::mt19937 random_;
+	};
+}
+
+#endif
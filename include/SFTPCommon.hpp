@@ -19,6 +19,8 @@
 #include "libssh2_sftp.h"
 #include <thread>
 #include "FILEError.hpp"
+#include "LoadResult.hpp"
+#include "LoadRequest.hpp"
 using Success = sgns::AsyncError::Success;
 using CustomResult = sgns::AsyncError::CustomResult;
 
@@ -39,7 +41,7 @@ namespace sgns
 		 * @param parse - Whether to parse file upon completion (for MNN)
 		 * @param save - Whether to save the file to local disk upon completion
 		 */
-		using CompletionCallback = std::function<void(std::shared_ptr<boost::asio::io_context> ioc, std::shared_ptr<std::pair<std::vector<std::string>, std::vector<std::vector<char>>>> buffers, bool parse, bool save)>;
+		using CompletionCallback = std::function<void(std::shared_ptr<boost::asio::io_context> ioc, std::shared_ptr<const sgns::LoadResult> buffers, bool parse, bool save)>;
 		/**
 		 * Status callback returns an error code as an async load proceeds
 		 * @param int - Status code
@@ -59,6 +61,7 @@ namespace sgns
 		 * @param status - Status function that will be updated with status codes as operation progresses
 		 * @param parse - Whether to parse file upon completion (for MNN currently)
 		 * @param save - Whether to save the file to local disk upon completion
+		 * @param request - Request being loaded, carries the cached validator to revalidate with, cancelling it aborts the download
 		 */
 		SFTPDevice(
 			std::string sftp_host,
@@ -68,7 +71,8 @@ namespace sgns
 			std::string sftp_pubkeyfile,
 			std::string sftp_privkeyfile,
 			std::string sftp_privkeypass,
-			bool parse, bool save);
+			bool parse, bool save,
+			std::shared_ptr<LoadRequest> request);
 		~SFTPDevice() {
 			// Cleanup
 		}
@@ -83,73 +87,80 @@ namespace sgns
 		void StartSFTPDownload(std::shared_ptr<boost::asio::io_context> ioc, std::shared_ptr<boost::asio::ip::tcp::socket> tcpSocket, LIBSSH2_SESSION* sftp2session, CompletionCallback handle_read, StatusCallback status);
 	private:
 		/**
-		 * Do a SFTP Handshake
-		 * @param ioc - ASIO context for async loading
-		 * @param sftp2session - SFTP session
-		 * @param tcpSocket - tcp socket for network
-		 * @param sock - native handle socket for operations
-		 * @param handle_read - Filemanager callback on completion
-		 * @param status - Status function that will be updated with status codes as operation progresses
+		 * Advance the download, the whole connect/handshake/auth/open/stat/read chain is one stackless
+		 * coroutine. Each wait on the socket or the consumer re-enters it where it left off, the state lives in members.
+		 * @param ec - Result of the wait that resumed the coroutine
 		 */
-		void StartSFTPHandshake(std::shared_ptr<boost::asio::io_context> ioc, LIBSSH2_SESSION* sftp2session, std::shared_ptr<boost::asio::ip::tcp::socket> tcpSocket, basic_socket<ip::tcp, any_io_executor>::native_handle_type sock, CompletionCallback handle_read, StatusCallback status);
+		void Step(const boost::system::error_code& ec = boost::system::error_code());
 		/**
-		 * Authenticate SFTP
-		 * @param ioc - ASIO context for async loading
-		 * @param sftp2session - SFTP session
-		 * @param tcpSocket - tcp socket for network
-		 * @param handle_read - Filemanager callback on completion
-		 * @param status - Status function that will be updated with status codes as operation progresses
+		 * Resolve and connect, once a connection slot has been granted
 		 */
-		void StartSFTPAuth(std::shared_ptr<boost::asio::io_context> ioc, LIBSSH2_SESSION* sftp2session, std::shared_ptr<boost::asio::ip::tcp::socket> tcpSocket, CompletionCallback handle_read, StatusCallback status);
+		void StartSFTPConnect();
 		/**
-		 * Create SFTP 
-		 * @param ioc - ASIO context for async loading
-		 * @param sftp2session - SFTP session
-		 * @param tcpSocket - tcp socket for network
-		 * @param handle_read - Filemanager callback on completion
-		 * @param status - Status function that will be updated with status codes as operation progresses
+		 * Wait until libssh2 can make progress, on whichever direction it is blocked on
 		 */
-		void StartCreateSFTP(std::shared_ptr<boost::asio::io_context> ioc, LIBSSH2_SESSION* sftp2session, std::shared_ptr<boost::asio::ip::tcp::socket> tcpSocket, CompletionCallback handle_read, StatusCallback status);
+		void WaitSocket();
 		/**
-		 * Create SFTP Handler to open file for read
-		 * @param ioc - ASIO context for async loading
-		 * @param sftp2session - SFTP session
-		 * @param tcpSocket - tcp socket for network
-		 * @param sftp - sftp 
-		 * @param handle_read - Filemanager callback on completion
-		 * @param status - Status function that will be updated with status codes as operation progresses
+		 * Wait out throttleDelay_ before the next read
 		 */
-		void StartSFTPOpen(std::shared_ptr<boost::asio::io_context> ioc, LIBSSH2_SESSION* sftp2session, std::shared_ptr<boost::asio::ip::tcp::socket> tcpSocket, LIBSSH2_SFTP* sftp, CompletionCallback handle_read, StatusCallback status);
+		void WaitThrottle();
 		/**
-		 * Get file size to create appropriate buffer
-		 * @param ioc - ASIO context for async loading
-		 * @param sftp2session - SFTP session
-		 * @param tcpSocket - tcp socket for network
-		 * @param sftp - sftp
-		 * @param sftpHandle - sftp handler that opened file for read
-		 * @param handle_read - Filemanager callback on completion
-		 * @param status - Status function that will be updated with status codes as operation progresses
+		 * Try to authenticate, with priority towards private key, public key, and lastly user/pass
+		 * @return libssh2 result, LIBSSH2_ERROR_EAGAIN if it has to be called again
 		 */
-		void StartSFTPGetSize(std::shared_ptr<boost::asio::io_context> ioc, LIBSSH2_SESSION* sftp2session, std::shared_ptr<boost::asio::ip::tcp::socket> tcpSocket, LIBSSH2_SFTP* sftp, LIBSSH2_SFTP_HANDLE* sftpHandle, CompletionCallback handle_read, StatusCallback status);
+		int Authenticate();
 		/**
-		 * Download the file
-		 * @param ioc - ASIO context for async loading
-		 * @param sftp2session - SFTP session
-		 * @param tcpSocket - tcp socket for network
-		 * @param sftp - sftp
-		 * @param sftpHandle - sftp handler that opened file for read
-		 * @param buffer - buffer created based on file size
-		 * @param handle_read - Filemanager callback on completion
-		 * @param status - Status function that will be updated with status codes as operation progresses
+		 * Check the stat result against the cached validator, and record the new validator
+		 * @return True if the cached copy is current and the read can be skipped
+		 */
+		bool CheckNotModified();
+		/**
+		 * Wrap the part of the file buffer that was just read for the chunk handler
+		 * @param offset - Offset of the block in the file
+		 * @param size - Size of the block
+		 */
+		LoadChunk MakeChunk(size_t offset, size_t size) const;
+		/**
+		 * Report an error, clean up and complete without data
+		 * @param message - Status message
+		 */
+		void Fail(const std::string& message);
+		/**
+		 * Hand the finished buffer on
 		 */
-		void StartSFTPGetBlocks(std::shared_ptr<boost::asio::io_context> ioc, LIBSSH2_SESSION* sftp2session, std::shared_ptr<boost::asio::ip::tcp::socket> tcpSocket, LIBSSH2_SFTP* sftp, LIBSSH2_SFTP_HANDLE* sftpHandle, std::shared_ptr<std::vector<char>> buffer, size_t totalBytesRead, CompletionCallback handle_read, StatusCallback status);
+		void FinishSFTPRead();
 		/**
-		 * Clean up SFTP2 items
-		 * @param sftp2session - SFTP session
-		 * @param sftp - sftp
-		 * @param sftpHandle - sftp handler that opened file for read
+		 * Report an event on the request, if there is one
 		 */
-		void StartSFTPCleanup(LIBSSH2_SESSION* sftp2session, LIBSSH2_SFTP_HANDLE* sftpHandle, LIBSSH2_SFTP* sftp);
+		void Report(LoadPhase phase, uint64_t bytes = 0, uint64_t totalBytes = 0, boost::system::error_code error = {}) {
+			if (request_) {
+				request_->Report(phase, bytes, totalBytes, error);
+			}
+		}
+		/**
+		 * Clean up SFTP2 items, whichever have been created
+		 */
+		void StartSFTPCleanup();
+
+		//State of the download coroutine
+		boost::asio::coroutine coro_;
+		std::shared_ptr<boost::asio::io_context> ioc_;
+		std::shared_ptr<boost::asio::ip::tcp::socket> tcpSocket_;
+		LIBSSH2_SESSION* sftp2session_ = nullptr;
+		LIBSSH2_SFTP* sftp_ = nullptr;
+		LIBSSH2_SFTP_HANDLE* sftpHandle_ = nullptr;
+		LIBSSH2_SFTP_ATTRIBUTES sftpAttrs_;
+		std::shared_ptr<std::vector<char>> buffer_;
+		size_t totalBytesRead_ = 0;
+		std::chrono::steady_clock::duration throttleDelay_{};
+		std::unique_ptr<boost::asio::steady_timer> throttleTimer_;
+		/// @brief Connection slot from the governor, held until the device is done
+		std::shared_ptr<ConnectionLease> lease_;
+		/// @brief Start of the phase in progress, for the FileManager phase metrics
+		std::chrono::steady_clock::time_point phaseStart_;
+		bool firstByte_ = false;
+		CompletionCallback handle_read_;
+		StatusCallback status_;
 
 		//Common vars used for getting file from SFTP
 		std::size_t file_size_;
@@ -163,6 +174,7 @@ namespace sgns
 		bool parse_;
 		bool save_;
 		bool downloading_ = false;
+		std::shared_ptr<LoadRequest> request_;
 	};
 }
 
@@ -14,5 +14,9 @@ extern void getURLComponents(std::string url, std::string &prefix, std::string&
 extern void parseHTTPUrl(std::string url, std::string& host, std::string& path, std::string& port);
 extern void parseSFTPUrl(std::string url, std::string& host, std::string& path, std::string& user, std::string& pass, std::string& publickey_file, std::string& privatekey_file, std::string& privatekey_pass);
 extern void parseIPFSUrl(std::string url, std::string& cid, std::string& file);
+/// @brief normalize a URL so equivalent spellings compare equal, i.e. for use as a cache key
+/// @param url full url, i.e. "HTTPS://Host:443/a/./b//c.mnn#frag"
+/// @return normalized url, i.e. "https://host/a/b/c.mnn"
+extern std::string normalizeURL(const std::string& url);
 
 #endif // URLSTRINGUTIL_H
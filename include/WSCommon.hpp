@@ -15,6 +15,9 @@
 #include "boost/asio.hpp"
 #include "URLStringUtil.h"
 #include "FILEError.hpp"
+#include "LoadResult.hpp"
+#include "LoadRequest.hpp"
+#include "BandwidthGovernor.hpp"
 using Success = sgns::AsyncError::Success;
 using CustomResult = sgns::AsyncError::CustomResult;
 
@@ -35,7 +38,7 @@ namespace sgns
 		 * @param parse - Whether to parse file upon completion (for MNN)
 		 * @param save - Whether to save the file to local disk upon completion
 		 */
-		using CompletionCallback = std::function<void(std::shared_ptr<boost::asio::io_context> ioc, std::shared_ptr<std::pair<std::vector<std::string>, std::vector<std::vector<char>>>> buffers, bool parse, bool save)>;
+		using CompletionCallback = std::function<void(std::shared_ptr<boost::asio::io_context> ioc, std::shared_ptr<const sgns::LoadResult> buffers, bool parse, bool save)>;
 		/**
 		 * Status callback returns an error code as an async load proceeds
 		 * @param int - Status code
@@ -49,12 +52,14 @@ namespace sgns
 		 * @param ws_port - Port for WS Server
 		 * @param parse - Whether to parse file upon completion (for MNN currently)
 		 * @param save - Whether to save the file to local disk upon completion
+		 * @param request - Request being loaded, cancelling it closes the socket
 		 */
 		WSDevice(
 			std::string ws_host,
 			std::string ws_path,
 			std::string ws_port,
-			bool parse, bool save);
+			bool parse, bool save,
+			std::shared_ptr<LoadRequest> request);
 		~WSDevice() {
 			// Cleanup
 		}
@@ -66,6 +71,13 @@ namespace sgns
 		 */
 		void StartWSDownload(std::shared_ptr<boost::asio::io_context> ioc, CompletionCallback handle_read, StatusCallback status);
 	private:
+		/**
+		 * Resolve, connect and handshake, once a connection slot has been granted
+		 * @param ioc - ASIO context for async loading
+		 * @param handle_read - Filemanager callback on completion
+		 * @param status - Status function that will be updated with status codes as operation progresses
+		 */
+		void StartWSConnect(std::shared_ptr<boost::asio::io_context> ioc, CompletionCallback handle_read, StatusCallback status);
 		/**
 		 * Post WS GET_FILE to download file
 		 * @param ioc - ASIO context for async loading
@@ -77,6 +89,28 @@ namespace sgns
 			std::shared_ptr<boost::beast::websocket::stream<boost::asio::ssl::stream<boost::asio::ip::tcp::socket>>> ws,
 			CompletionCallback handle_read,
 			StatusCallback status);
+		/**
+		 * Read until the WSEOF marker, throttled between reads
+		 * @param ioc - ASIO context for async loading
+		 * @param ws - Websock item to read from
+		 * @param buffer - File read so far
+		 * @param handle_read - Filemanager callback on completion
+		 * @param status - Status function that will be updated with status codes as operation progresses
+		 */
+		void ReadWSFile(std::shared_ptr<boost::asio::io_context> ioc,
+			std::shared_ptr<boost::beast::websocket::stream<boost::asio::ssl::stream<boost::asio::ip::tcp::socket>>> ws,
+			std::shared_ptr<boost::asio::streambuf> buffer,
+			CompletionCallback handle_read,
+			StatusCallback status);
+
+		/**
+		 * Report an event on the request, if there is one
+		 */
+		void Report(LoadPhase phase, uint64_t bytes = 0, uint64_t totalBytes = 0, boost::system::error_code error = {}) {
+			if (request_) {
+				request_->Report(phase, bytes, totalBytes, error);
+			}
+		}
 
 		//Common vars used for getting file from SFTP
 		std::string ws_host_;
@@ -85,6 +119,12 @@ namespace sgns
 		bool parse_;
 		bool save_;
 		bool downloading_ = false;
+		std::shared_ptr<LoadRequest> request_;
+		/// @brief Connection slot from the governor, held until the device is done
+		std::shared_ptr<ConnectionLease> lease_;
+		/// @brief Start of the phase in progress, for the FileManager phase metrics
+		std::chrono::steady_clock::time_point phaseStart_;
+		bool firstByte_ = false;
 	};
 }
 
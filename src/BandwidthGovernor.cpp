@@ -0,0 +1,229 @@
+/**
+ * Source file for the BandwidthGovernor
+ */
+#include <algorithm>
+#include <vector>
+#include "boost/asio/post.hpp"
+#include "boost/asio/steady_timer.hpp"
+#include "BandwidthGovernor.hpp"
+
+namespace sgns
+{
+    ConnectionLease::ConnectionLease(BandwidthGovernor& governor, std::string scheme, std::string host)
+        : governor_(governor), scheme_(std::move(scheme)), host_(std::move(host))
+    {
+    }
+
+    ConnectionLease::~ConnectionLease()
+    {
+        governor_.ReleaseConnection(scheme_, host_);
+    }
+
+    void BandwidthGovernor::SetGlobalLimits(GovernorLimits limits)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            SetLimitsLocked(global_, limits);
+        }
+        GrantWaiting();
+    }
+
+    void BandwidthGovernor::SetSchemeLimits(const std::string& scheme, GovernorLimits limits)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            SetLimitsLocked(schemes_[scheme], limits);
+            DropIdleLocked(schemes_, scheme);
+        }
+        GrantWaiting();
+    }
+
+    void BandwidthGovernor::SetHostLimits(const std::string& host, GovernorLimits limits)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            SetLimitsLocked(hosts_[host], limits);
+            DropIdleLocked(hosts_, host);
+        }
+        GrantWaiting();
+    }
+
+    uint64_t BandwidthGovernor::AcquireConnection(const std::string& scheme, const std::string& host, std::shared_ptr<boost::asio::io_context> ioc, ConnectionHandler handler)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            //Waiters are granted as soon as they fit, so anything still queued is blocked on a full level
+            if (!FitsLocked(scheme, host))
+            {
+                auto id = nextWaiterId_++;
+                waiters_.push_back(Waiter{ id, scheme, host, std::move(ioc), std::move(handler) });
+                return id;
+            }
+            TakeLocked(scheme, host);
+        }
+        handler(std::make_shared<ConnectionLease>(*this, scheme, host));
+        return 0;
+    }
+
+    bool BandwidthGovernor::WithdrawWaiting(uint64_t id)
+    {
+        Waiter withdrawn;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto iter = std::find_if(waiters_.begin(), waiters_.end(), [id](const Waiter& waiter) { return waiter.id == id; });
+            if (iter == waiters_.end())
+            {
+                return false;
+            }
+            withdrawn = std::move(*iter);
+            waiters_.erase(iter);
+        }
+        //The handler may hold the last reference to its loader, let it go outside the lock
+        return true;
+    }
+
+    std::chrono::steady_clock::duration BandwidthGovernor::Consume(const std::string& scheme, const std::string& host, size_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto wait = ChargeLocked(global_.bucket, bytes);
+        auto schemeIter = schemes_.find(scheme);
+        if (schemeIter != schemes_.end())
+        {
+            wait = std::max(wait, ChargeLocked(schemeIter->second.bucket, bytes));
+        }
+        auto hostIter = hosts_.find(host);
+        if (hostIter != hosts_.end())
+        {
+            wait = std::max(wait, ChargeLocked(hostIter->second.bucket, bytes));
+        }
+        return wait;
+    }
+
+    void BandwidthGovernor::Throttle(const std::string& scheme, const std::string& host, size_t bytes, std::shared_ptr<boost::asio::io_context> ioc, std::function<void()> next)
+    {
+        auto wait = Consume(scheme, host, bytes);
+        if (wait <= std::chrono::steady_clock::duration::zero())
+        {
+            next();
+            return;
+        }
+        auto timer = std::make_shared<boost::asio::steady_timer>(*ioc, wait);
+        timer->async_wait([timer, next](const boost::system::error_code&) {
+            next();
+            });
+    }
+
+    size_t BandwidthGovernor::GetActiveConnections() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return global_.connections;
+    }
+
+    size_t BandwidthGovernor::GetWaitingConnections() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return waiters_.size();
+    }
+
+    void BandwidthGovernor::SetLimitsLocked(Level& level, GovernorLimits limits)
+    {
+        level.limits = limits;
+        auto& bucket = level.bucket;
+        if (bucket.rate == 0)
+        {
+            //Newly limited, start with a full second's burst
+            bucket.tokens = static_cast<double>(limits.bytesPerSecond);
+            bucket.refilled = std::chrono::steady_clock::now();
+        }
+        bucket.rate = limits.bytesPerSecond;
+        bucket.tokens = std::min(bucket.tokens, static_cast<double>(bucket.rate));
+    }
+
+    bool BandwidthGovernor::FitsLocked(const std::string& scheme, const std::string& host) const
+    {
+        auto fits = [](const Level& level) {
+            return level.limits.maxConnections == 0 || level.connections < level.limits.maxConnections;
+        };
+        auto schemeIter = schemes_.find(scheme);
+        auto hostIter = hosts_.find(host);
+        return fits(global_) && (schemeIter == schemes_.end() || fits(schemeIter->second)) && (hostIter == hosts_.end() || fits(hostIter->second));
+    }
+
+    void BandwidthGovernor::TakeLocked(const std::string& scheme, const std::string& host)
+    {
+        //Counts are kept for every scheme and host, so limits set later see the connections already open
+        ++global_.connections;
+        ++schemes_[scheme].connections;
+        ++hosts_[host].connections;
+    }
+
+    void BandwidthGovernor::ReleaseConnection(const std::string& scheme, const std::string& host)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            --global_.connections;
+            --schemes_[scheme].connections;
+            --hosts_[host].connections;
+            DropIdleLocked(schemes_, scheme);
+            DropIdleLocked(hosts_, host);
+        }
+        GrantWaiting();
+    }
+
+    void BandwidthGovernor::DropIdleLocked(std::map<std::string, Level>& levels, const std::string& key)
+    {
+        auto iter = levels.find(key);
+        if (iter != levels.end() && iter->second.connections == 0 && iter->second.limits.maxConnections == 0 && iter->second.limits.bytesPerSecond == 0)
+        {
+            levels.erase(iter);
+        }
+    }
+
+    void BandwidthGovernor::GrantWaiting()
+    {
+        std::vector<Waiter> granted;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto iter = waiters_.begin(); iter != waiters_.end();)
+            {
+                if (FitsLocked(iter->scheme, iter->host))
+                {
+                    TakeLocked(iter->scheme, iter->host);
+                    granted.push_back(std::move(*iter));
+                    iter = waiters_.erase(iter);
+                }
+                else
+                {
+                    ++iter;
+                }
+            }
+        }
+        //Leases are often released from deep inside a loader's completion, start the next connection fresh
+        for (auto& waiter : granted)
+        {
+            auto lease = std::make_shared<ConnectionLease>(*this, waiter.scheme, waiter.host);
+            boost::asio::post(*waiter.ioc, [handler = std::move(waiter.handler), lease]() {
+                handler(lease);
+                });
+        }
+    }
+
+    std::chrono::steady_clock::duration BandwidthGovernor::ChargeLocked(Bucket& bucket, size_t bytes)
+    {
+        if (bucket.rate == 0)
+        {
+            return std::chrono::steady_clock::duration::zero();
+        }
+        auto now = std::chrono::steady_clock::now();
+        std::chrono::duration<double> elapsed = now - bucket.refilled;
+        bucket.refilled = now;
+        auto rate = static_cast<double>(bucket.rate);
+        bucket.tokens = std::min(rate, bucket.tokens + elapsed.count() * rate) - static_cast<double>(bytes);
+        if (bucket.tokens >= 0)
+        {
+            return std::chrono::steady_clock::duration::zero();
+        }
+        //Wait until the debt is paid off
+        return std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(-bucket.tokens / rate));
+    }
+}
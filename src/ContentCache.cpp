@@ -0,0 +1,198 @@
+/**
+ * Source file for the ContentCache
+ */
+#include <algorithm>
+#include "ContentCache.hpp"
+#include "URLStringUtil.h"
+
+namespace sgns
+{
+    ContentCache::ContentCache(size_t byteBudget) : byteBudget_(byteBudget)
+    {
+        //Rough cost of going back to each source compared to a local file
+        schemeWeights_["file"] = 1.0;
+        schemeWeights_["https"] = 4.0;
+        schemeWeights_["wss"] = 4.0;
+        schemeWeights_["sftp"] = 4.0;
+        schemeWeights_["ipfs"] = 16.0;
+    }
+
+    void ContentCache::SetByteBudget(size_t byteBudget)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        byteBudget_ = byteBudget;
+        EvictLocked(byteBudget);
+    }
+
+    void ContentCache::SetSchemeWeight(const std::string& scheme, double weight)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        schemeWeights_[scheme] = weight;
+    }
+
+    double ContentCache::FetchCost(const std::string& scheme, double fetchMilliseconds) const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto iter = schemeWeights_.find(scheme);
+        double weight = iter == schemeWeights_.end() ? 1.0 : iter->second;
+        //Anything under a millisecond still costs a system call or two
+        return weight * std::max(1.0, fetchMilliseconds);
+    }
+
+    ContentCache::Data ContentCache::Get(const std::string& url, const std::string& validator)
+    {
+        if (!IsEnabled())
+        {
+            return nullptr;
+        }
+        auto key = normalizeURL(url);
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto iter = entries_.find(key);
+        if (iter == entries_.end())
+        {
+            ++misses_;
+            return nullptr;
+        }
+        if (iter->second.validator != validator)
+        {
+            //The source changed since it was cached
+            EraseLocked(iter);
+            ++misses_;
+            return nullptr;
+        }
+        ++hits_;
+        Touch(iter->first, iter->second);
+        return iter->second.data;
+    }
+
+    ContentCache::Data ContentCache::GetByHash(const std::string& hash)
+    {
+        if (!IsEnabled() || hash.empty())
+        {
+            return nullptr;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto hashIter = hashIndex_.find(hash);
+        if (hashIter == hashIndex_.end())
+        {
+            ++misses_;
+            return nullptr;
+        }
+        auto iter = entries_.find(hashIter->second);
+        ++hits_;
+        Touch(iter->first, iter->second);
+        return iter->second.data;
+    }
+
+    void ContentCache::Put(const std::string& url, Data data, double cost, const std::string& hash, const std::string& validator)
+    {
+        auto byteBudget = byteBudget_.load();
+        if (byteBudget == 0 || data == nullptr)
+        {
+            return;
+        }
+        auto bytes = data->TotalSize();
+        if (bytes > byteBudget)
+        {
+            return;
+        }
+        auto key = normalizeURL(url);
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto existing = entries_.find(key);
+        if (existing != entries_.end())
+        {
+            EraseLocked(existing);
+        }
+        //Make room before inserting so the new entry can't evict itself
+        EvictLocked(byteBudget - bytes);
+
+        Entry entry;
+        entry.data = std::move(data);
+        entry.hash = hash;
+        entry.validator = validator;
+        entry.bytes = bytes;
+        entry.cost = cost;
+        entry.priority = inflation_ + cost / std::max<size_t>(1, bytes);
+        entry.sequence = sequence_++;
+        evictionOrder_.emplace(PriorityKey(entry.priority, entry.sequence), key);
+        if (!hash.empty())
+        {
+            hashIndex_[hash] = key;
+        }
+        bytes_ += bytes;
+        entries_.emplace(key, std::move(entry));
+        ++insertions_;
+    }
+
+    void ContentCache::Erase(const std::string& url)
+    {
+        auto key = normalizeURL(url);
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto iter = entries_.find(key);
+        if (iter != entries_.end())
+        {
+            EraseLocked(iter);
+        }
+    }
+
+    void ContentCache::Clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_.clear();
+        hashIndex_.clear();
+        evictionOrder_.clear();
+        bytes_ = 0;
+        inflation_ = 0;
+    }
+
+    ContentCache::Stats ContentCache::GetStats() const
+    {
+        Stats stats;
+        stats.hits = hits_;
+        stats.misses = misses_;
+        stats.insertions = insertions_;
+        stats.evictions = evictions_;
+        stats.byteBudget = byteBudget_;
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats.entries = entries_.size();
+        stats.bytes = bytes_;
+        return stats;
+    }
+
+    void ContentCache::Touch(const std::string& key, Entry& entry)
+    {
+        //Re-rank from the current inflation value, entries that keep getting hit stay ahead of it
+        evictionOrder_.erase(std::make_pair(PriorityKey(entry.priority, entry.sequence), key));
+        entry.priority = inflation_ + entry.cost / std::max<size_t>(1, entry.bytes);
+        entry.sequence = sequence_++;
+        evictionOrder_.emplace(PriorityKey(entry.priority, entry.sequence), key);
+    }
+
+    void ContentCache::EraseLocked(std::map<std::string, Entry>::iterator iter)
+    {
+        auto& entry = iter->second;
+        evictionOrder_.erase(std::make_pair(PriorityKey(entry.priority, entry.sequence), iter->first));
+        if (!entry.hash.empty())
+        {
+            auto hashIter = hashIndex_.find(entry.hash);
+            if (hashIter != hashIndex_.end() && hashIter->second == iter->first)
+            {
+                hashIndex_.erase(hashIter);
+            }
+        }
+        bytes_ -= entry.bytes;
+        entries_.erase(iter);
+    }
+
+    void ContentCache::EvictLocked(size_t byteBudget)
+    {
+        while (bytes_ > byteBudget && !evictionOrder_.empty())
+        {
+            auto victim = evictionOrder_.begin();
+            inflation_ = victim->first.first;
+            auto iter = entries_.find(victim->second);
+            EraseLocked(iter);
+            ++evictions_;
+        }
+    }
+}
@@ -0,0 +1,410 @@
+/**
+ * Source file for the DiskCache
+ */
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <set>
+#include <sstream>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include "DiskCache.hpp"
+#include "URLStringUtil.h"
+
+namespace sgns
+{
+    namespace
+    {
+        const char* const kIndexName = "index";
+        const char* const kIndexHeader = "diskcache 1";
+
+        /// Index lines are tab separated, so fields can't hold tabs or newlines
+        bool IsIndexSafe(const std::string& field)
+        {
+            return field.find_first_of("\t\r\n") == std::string::npos;
+        }
+
+        /// Write a file and flush it to the disk before returning, so renaming it into place afterwards can't
+        /// publish a file whose data was still only in memory when the machine went down
+        bool WriteSynced(const std::string& path, const std::function<bool(std::FILE*)>& write)
+        {
+            std::FILE* file = std::fopen(path.c_str(), "wb");
+            if (file == nullptr)
+            {
+                return false;
+            }
+            bool ok = write(file) && std::fflush(file) == 0;
+#ifdef _WIN32
+            ok = ok && _commit(_fileno(file)) == 0;
+#else
+            ok = ok && fsync(fileno(file)) == 0;
+#endif
+            ok = std::fclose(file) == 0 && ok;
+            if (!ok)
+            {
+                std::error_code ec;
+                std::filesystem::remove(path, ec);
+            }
+            return ok;
+        }
+
+        /// Make the renames in a directory durable, Windows commits them with the file
+        void SyncDirectory(const std::string& directory)
+        {
+#ifndef _WIN32
+            int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+            if (fd != -1)
+            {
+                fsync(fd);
+                close(fd);
+            }
+#endif
+        }
+    }
+
+    bool DiskCache::Open(const std::string& directory, size_t byteCap)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            std::error_code ec;
+            std::filesystem::create_directories(directory, ec);
+            if (ec)
+            {
+                directory_.clear();
+                return false;
+            }
+            directory_ = directory;
+            byteCap_ = byteCap;
+            LoadIndexLocked();
+
+            //Clear out temp files from interrupted writes and blobs the index no longer knows about
+            std::set<std::string> known;
+            for (const auto& entry : entries_)
+            {
+                known.insert(std::filesystem::path(BlobPath(entry.second.blobId)).filename().string());
+            }
+            for (const auto& file : std::filesystem::directory_iterator(directory_, ec))
+            {
+                auto name = file.path().filename().string();
+                if (name != kIndexName && known.count(name) == 0)
+                {
+                    std::filesystem::remove(file.path(), ec);
+                }
+            }
+            EvictLocked(byteCap_);
+            indexDirty_ = true;
+        }
+        SaveIndex();
+        return true;
+    }
+
+    bool DiskCache::IsEnabled() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return !directory_.empty();
+    }
+
+    bool DiskCache::Lookup(const std::string& url, Entry& entry) const
+    {
+        auto key = normalizeURL(url);
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto iter = entries_.find(key);
+        if (iter == entries_.end())
+        {
+            return false;
+        }
+        entry = iter->second;
+        return true;
+    }
+
+    std::shared_ptr<const LoadResult> DiskCache::Read(const std::string& url)
+    {
+        auto key = normalizeURL(url);
+        Entry entry;
+        std::string blobPath;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto iter = entries_.find(key);
+            if (iter == entries_.end())
+            {
+                return nullptr;
+            }
+            iter->second.lastUsed = Now();
+            entry = iter->second;
+            blobPath = BlobPath(entry.blobId);
+        }
+        //Read without the lock, blobs are never rewritten in place so a concurrent store can't tear this one
+        std::vector<char> blob(entry.bytes);
+        std::ifstream input(blobPath, std::ios::binary);
+        if (!input.read(blob.data(), blob.size()) || input.peek() != std::ifstream::traits_type::eof())
+        {
+            //Missing or truncated, don't hand out bad data, unless the entry was replaced while reading
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto iter = entries_.find(key);
+                if (iter != entries_.end() && iter->second.blobId == entry.blobId)
+                {
+                    EraseLocked(iter);
+                }
+            }
+            SaveIndex();
+            return nullptr;
+        }
+
+        //One segment for the blob, each file slices into it
+        auto whole = BufferSlice::FromVector(std::move(blob));
+        auto result = std::make_shared<LoadResult>();
+        size_t offset = 0;
+        for (const auto& file : entry.files)
+        {
+            result->Add(file.first, whole.SubSlice(offset, file.second));
+            offset += file.second;
+        }
+        return result;
+    }
+
+    bool DiskCache::Store(const std::string& url, const LoadResult& data, const std::string& validator)
+    {
+        auto key = normalizeURL(url);
+        if (!IsIndexSafe(key) || !IsIndexSafe(validator))
+        {
+            return false;
+        }
+        Entry entry;
+        entry.validator = validator;
+        entry.bytes = data.TotalSize();
+        for (const auto& file : data.entries)
+        {
+            if (!IsIndexSafe(file.name))
+            {
+                return false;
+            }
+            entry.files.emplace_back(file.name, file.Size());
+        }
+
+        std::string blobPath;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (directory_.empty() || entry.bytes > byteCap_)
+            {
+                return false;
+            }
+            entry.blobId = nextBlobId_++;
+            blobPath = BlobPath(entry.blobId);
+        }
+        entry.storedAt = entry.lastUsed = Now();
+
+        //Write the blob without the lock beside its final name and rename it in, readers never see a partial blob
+        auto tempPath = blobPath + ".tmp";
+        bool written = WriteSynced(tempPath, [&data](std::FILE* output) {
+            for (const auto& file : data.entries)
+            {
+                for (const auto& slice : file.slices)
+                {
+                    if (slice.size != 0 && std::fwrite(slice.data, 1, slice.size, output) != slice.size)
+                    {
+                        return false;
+                    }
+                }
+            }
+            return true;
+            });
+        if (!written)
+        {
+            return false;
+        }
+        std::error_code ec;
+        std::filesystem::rename(tempPath, blobPath, ec);
+        if (ec)
+        {
+            std::filesystem::remove(tempPath, ec);
+            return false;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            //The cache may have been closed or its cap lowered while the blob was written
+            if (directory_.empty() || entry.bytes > byteCap_)
+            {
+                std::filesystem::remove(blobPath, ec);
+                return false;
+            }
+            auto existing = entries_.find(key);
+            if (existing != entries_.end())
+            {
+                EraseLocked(existing);
+            }
+            EvictLocked(byteCap_ - entry.bytes);
+            bytes_ += entry.bytes;
+            entries_.emplace(key, std::move(entry));
+            indexDirty_ = true;
+        }
+        return SaveIndex();
+    }
+
+    void DiskCache::Erase(const std::string& url)
+    {
+        auto key = normalizeURL(url);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto iter = entries_.find(key);
+            if (iter == entries_.end())
+            {
+                return;
+            }
+            EraseLocked(iter);
+        }
+        SaveIndex();
+    }
+
+    size_t DiskCache::GetBytes() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return bytes_;
+    }
+
+    std::string DiskCache::BlobPath(uint64_t blobId) const
+    {
+        return (std::filesystem::path(directory_) / (std::to_string(blobId) + ".blob")).string();
+    }
+
+    void DiskCache::LoadIndexLocked()
+    {
+        entries_.clear();
+        bytes_ = 0;
+        std::ifstream input((std::filesystem::path(directory_) / kIndexName).string());
+        std::string line;
+        if (!std::getline(input, line) || line != kIndexHeader)
+        {
+            return;
+        }
+        //One entry per line: key, validator, storedAt, lastUsed, blobId, file count, then name/size pairs
+        while (std::getline(input, line))
+        {
+            std::vector<std::string> fields;
+            std::istringstream stream(line);
+            std::string field;
+            while (std::getline(stream, field, '\t'))
+            {
+                fields.push_back(field);
+            }
+            if (fields.size() < 6)
+            {
+                continue;
+            }
+            try
+            {
+                Entry entry;
+                entry.validator = fields[1];
+                entry.storedAt = std::stoll(fields[2]);
+                entry.lastUsed = std::stoll(fields[3]);
+                entry.blobId = std::stoull(fields[4]);
+                auto fileCount = std::stoull(fields[5]);
+                if (fields.size() != 6 + fileCount * 2)
+                {
+                    continue;
+                }
+                for (size_t i = 0; i < fileCount; ++i)
+                {
+                    auto size = std::stoull(fields[7 + i * 2]);
+                    entry.files.emplace_back(fields[6 + i * 2], size);
+                    entry.bytes += size;
+                }
+                nextBlobId_ = std::max(nextBlobId_, entry.blobId + 1);
+                bytes_ += entry.bytes;
+                entries_[fields[0]] = std::move(entry);
+            }
+            catch (const std::exception&)
+            {
+                //Skip damaged lines, their blobs are cleaned up as orphans
+            }
+        }
+    }
+
+    bool DiskCache::SaveIndex()
+    {
+        //One writer at a time, and each writes whatever the index is when it gets its turn. Changes made while a
+        //write is running mark the index dirty again and go out together with the next write, so a burst of stores
+        //costs a few index writes instead of one each.
+        std::lock_guard<std::mutex> writeLock(indexWriteMutex_);
+        std::string directory;
+        std::ostringstream output;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!indexDirty_ || directory_.empty())
+            {
+                return true;
+            }
+            indexDirty_ = false;
+            directory = directory_;
+            output << kIndexHeader << '\n';
+            for (const auto& item : entries_)
+            {
+                const auto& entry = item.second;
+                output << item.first << '\t' << entry.validator << '\t' << entry.storedAt << '\t' << entry.lastUsed << '\t'
+                    << entry.blobId << '\t' << entry.files.size();
+                for (const auto& file : entry.files)
+                {
+                    output << '\t' << file.first << '\t' << file.second;
+                }
+                output << '\n';
+            }
+        }
+        //Written and synced without the lock, so lookups never wait on the disk
+        auto indexPath = (std::filesystem::path(directory) / kIndexName).string();
+        auto tempPath = indexPath + ".tmp";
+        auto index = output.str();
+        bool written = WriteSynced(tempPath, [&index](std::FILE* file) { return std::fwrite(index.data(), 1, index.size(), file) == index.size(); });
+        std::error_code ec;
+        if (written)
+        {
+            std::filesystem::rename(tempPath, indexPath, ec);
+        }
+        if (!written || ec)
+        {
+            //Try again with the next change
+            std::lock_guard<std::mutex> lock(mutex_);
+            indexDirty_ = true;
+            return false;
+        }
+        //The blobs renamed in before it become durable with the index
+        SyncDirectory(directory);
+        return true;
+    }
+
+    void DiskCache::EraseLocked(std::map<std::string, Entry>::iterator iter)
+    {
+        std::error_code ec;
+        std::filesystem::remove(BlobPath(iter->second.blobId), ec);
+        bytes_ -= iter->second.bytes;
+        entries_.erase(iter);
+        indexDirty_ = true;
+    }
+
+    void DiskCache::EvictLocked(size_t byteCap)
+    {
+        while (bytes_ > byteCap && !entries_.empty())
+        {
+            auto oldest = entries_.begin();
+            for (auto iter = entries_.begin(); iter != entries_.end(); ++iter)
+            {
+                if (iter->second.lastUsed < oldest->second.lastUsed)
+                {
+                    oldest = iter;
+                }
+            }
+            EraseLocked(oldest);
+        }
+    }
+
+    int64_t DiskCache::Now()
+    {
+        return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+}
@@ -2,6 +2,18 @@
  * Source file for the FILECommon
  */
 #include "FILECommon.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <type_traits>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 
 namespace sgns
@@ -27,6 +39,30 @@ namespace sgns
             std::cerr << "Failed to assign file descriptor: " << ec_.message() << std::endl;
         }
     }
+
+    void FILEDevice::Close()
+    {
+        if (file_.is_open())
+        {
+            //The descriptor belongs to file_ once assigned
+            file_.close(ec_);
+        }
+        else if (fd_ != -1)
+        {
+            close(fd_);
+        }
+        fd_ = -1;
+    }
+
+    std::optional<uint64_t> FILEDevice::Size() const
+    {
+        struct stat info;
+        if (fd_ == -1 || fstat(fd_, &info) != 0 || !S_ISREG(info.st_mode))
+        {
+            return std::nullopt;
+        }
+        return static_cast<uint64_t>(info.st_size);
+    }
 #else
     FILEDevice::FILEDevice(std::shared_ptr<boost::asio::io_context> ioc,
         std::string filename, int writemode) : file_(*ioc)
@@ -44,5 +80,529 @@ namespace sgns
             std::cerr << "Error: " << er.what() << std::endl;
         }
     }
+
+    void FILEDevice::Close()
+    {
+        boost::system::error_code ec;
+        file_.close(ec);
+    }
+
+    std::optional<uint64_t> FILEDevice::Size()
+    {
+        boost::system::error_code ec;
+        auto size = file_.is_open() ? file_.size(ec) : 0;
+        if (!file_.is_open() || ec)
+        {
+            return std::nullopt;
+        }
+        return size;
+    }
+#endif
+
+#ifndef _WIN32
+    std::shared_ptr<const MappedFile> MappedFile::Map(const std::string& filename, boost::system::error_code& error)
+    {
+        error.clear();
+        int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd == -1)
+        {
+            error = boost::system::error_code(errno, boost::system::system_category());
+            return nullptr;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0)
+        {
+            error = boost::system::error_code(errno, boost::system::system_category());
+            close(fd);
+            return nullptr;
+        }
+        //Empty files can't be mapped, and devices or pipes have no fixed size to map
+        if (!S_ISREG(info.st_mode) || info.st_size == 0)
+        {
+            error = boost::system::errc::make_error_code(boost::system::errc::operation_not_supported);
+            close(fd);
+            return nullptr;
+        }
+        auto size = static_cast<uint64_t>(info.st_size);
+        void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        //The mapping keeps the file referenced on its own
+        close(fd);
+        if (data == MAP_FAILED)
+        {
+            error = boost::system::error_code(errno, boost::system::system_category());
+            return nullptr;
+        }
+        //Loads go through the file front to back, start the readahead now rather than on the first fault
+        madvise(data, size, MADV_SEQUENTIAL);
+        madvise(data, size, MADV_WILLNEED);
+        return std::shared_ptr<const MappedFile>(new MappedFile(static_cast<const char*>(data), size));
+    }
+
+    MappedFile::~MappedFile()
+    {
+        munmap(const_cast<char*>(data_), size_);
+    }
+#else
+    std::shared_ptr<const MappedFile> MappedFile::Map(const std::string& filename, boost::system::error_code& error)
+    {
+        error = boost::system::errc::make_error_code(boost::system::errc::operation_not_supported);
+        return nullptr;
+    }
+
+    MappedFile::~MappedFile()
+    {
+    }
+#endif
+
+#if defined(BOOST_ASIO_HAS_IO_URING) && defined(BOOST_ASIO_HAS_FILE)
+    namespace
+    {
+        /**
+         * Blocks of one positioned read or write, kept queueDepth deep until all are done
+         */
+        template <typename Buffer>
+        struct PositionedTransfer
+        {
+            std::shared_ptr<FILERandomAccessDevice> device;
+            std::deque<std::pair<uint64_t, Buffer>> pending;
+            size_t inflight = 0;
+            /// @brief Where the transfer starts in the file
+            uint64_t start = 0;
+            /// @brief Bytes from start that are all done, blocks finish out of order
+            uint64_t prefix = 0;
+            /// @brief Finished ranges past the prefix by offset, each with its end
+            std::map<uint64_t, uint64_t> done;
+            boost::system::error_code error;
+            FILERandomAccessDevice::TransferHandler handler;
+            std::mutex mutex;
+        };
+
+        template <typename Buffer>
+        void IssueBlocks(std::shared_ptr<PositionedTransfer<Buffer>> transfer, size_t queueDepth)
+        {
+            std::vector<std::pair<uint64_t, Buffer>> next;
+            {
+                std::lock_guard<std::mutex> lock(transfer->mutex);
+                while (!transfer->error && transfer->inflight < queueDepth && !transfer->pending.empty())
+                {
+                    next.push_back(transfer->pending.front());
+                    transfer->pending.pop_front();
+                    ++transfer->inflight;
+                }
+            }
+            //Everything issued here goes to the kernel together on the next submit
+            for (const auto& [offset, buffer] : next)
+            {
+                auto completion = [transfer, queueDepth, offset = offset, buffer = buffer](const boost::system::error_code& error, std::size_t bytes) {
+                    bool finished;
+                    {
+                        std::lock_guard<std::mutex> lock(transfer->mutex);
+                        --transfer->inflight;
+                        if (bytes != 0)
+                        {
+                            transfer->done.emplace(offset, offset + bytes);
+                            //Grow the prefix over the ranges that now follow on from it
+                            for (auto next = transfer->done.begin(); next != transfer->done.end() && next->first == transfer->start + transfer->prefix; next = transfer->done.erase(next))
+                            {
+                                transfer->prefix = next->second - transfer->start;
+                            }
+                        }
+                        if (error && !transfer->error)
+                        {
+                            transfer->error = error;
+                        }
+                        else if (!error && bytes < buffer.size())
+                        {
+                            //Short transfer, the rest of the block goes first
+                            transfer->pending.emplace_front(offset + bytes, buffer + bytes);
+                        }
+                        finished = transfer->inflight == 0 && (transfer->error || transfer->pending.empty());
+                    }
+                    if (finished)
+                    {
+                        transfer->handler(transfer->error, transfer->prefix);
+                        return;
+                    }
+                    IssueBlocks(transfer, queueDepth);
+                };
+                if constexpr (std::is_same_v<Buffer, boost::asio::mutable_buffer>)
+                {
+                    transfer->device->getFile().async_read_some_at(offset, buffer, completion);
+                }
+                else
+                {
+                    transfer->device->getFile().async_write_some_at(offset, buffer, completion);
+                }
+            }
+        }
+
+        template <typename Buffer>
+        void StartTransfer(std::shared_ptr<PositionedTransfer<Buffer>> transfer, size_t queueDepth)
+        {
+            if (transfer->pending.empty())
+            {
+                boost::asio::post(transfer->device->getFile().get_executor(), [transfer]() {
+                    transfer->handler(boost::system::error_code(), 0);
+                    });
+                return;
+            }
+            IssueBlocks(transfer, queueDepth);
+        }
+    }
+
+    FILERandomAccessDevice::FILERandomAccessDevice(std::shared_ptr<boost::asio::io_context> ioc, std::string filename, int writemode,
+        size_t blockSize, size_t queueDepth) : file_(*ioc), blockSize_(blockSize), queueDepth_(queueDepth)
+    {
+        boost::system::error_code ec;
+        if (writemode == 0)
+        {
+            file_.open(filename, boost::asio::random_access_file::read_only, ec);
+        }
+        else {
+            file_.open(filename, boost::asio::random_access_file::write_only | boost::asio::random_access_file::create | boost::asio::random_access_file::truncate, ec);
+        }
+        if (ec) {
+            std::cerr << "Failed to open file: " << ec.message() << std::endl;
+        }
+    }
+
+    uint64_t FILERandomAccessDevice::Size()
+    {
+        boost::system::error_code ec;
+        auto size = file_.size(ec);
+        return ec ? 0 : size;
+    }
+
+    void FILERandomAccessDevice::Close()
+    {
+        boost::system::error_code ec;
+        file_.close(ec);
+    }
+
+    void FILERandomAccessDevice::Read(uint64_t offset, boost::asio::mutable_buffer buffer, TransferHandler handler)
+    {
+        auto transfer = std::make_shared<PositionedTransfer<boost::asio::mutable_buffer>>();
+        transfer->device = shared_from_this();
+        transfer->handler = std::move(handler);
+        transfer->start = offset;
+        for (size_t position = 0; position < buffer.size(); position += blockSize_)
+        {
+            transfer->pending.emplace_back(offset + position, boost::asio::buffer(buffer + position, blockSize_));
+        }
+        StartTransfer(transfer, queueDepth_);
+    }
+
+    void FILERandomAccessDevice::Write(uint64_t offset, const std::vector<boost::asio::const_buffer>& buffers, TransferHandler handler)
+    {
+        auto transfer = std::make_shared<PositionedTransfer<boost::asio::const_buffer>>();
+        transfer->device = shared_from_this();
+        transfer->handler = std::move(handler);
+        transfer->start = offset;
+        for (const auto& buffer : buffers)
+        {
+            for (size_t position = 0; position < buffer.size(); position += blockSize_)
+            {
+                transfer->pending.emplace_back(offset, boost::asio::buffer(buffer + position, blockSize_));
+                offset += transfer->pending.back().second.size();
+            }
+        }
+        StartTransfer(transfer, queueDepth_);
+    }
+#endif
+
+#ifndef _WIN32
+    namespace
+    {
+        //Bytes per read or write of a direct transfer, a multiple of the alignment
+        const size_t kDirectReadSize = 4 * 1024 * 1024;
+
+        size_t AlignUp(size_t size)
+        {
+            return (size + AlignedBufferPool::kAlignment - 1) / AlignedBufferPool::kAlignment * AlignedBufferPool::kAlignment;
+        }
+    }
+
+    AlignedBufferPool::AlignedBufferPool(size_t bufferSize, size_t maxFree) : bufferSize_(AlignUp(bufferSize)), maxFree_(maxFree)
+    {
+    }
+
+    AlignedBufferPool::~AlignedBufferPool()
+    {
+        for (auto data : free_)
+        {
+            std::free(data);
+        }
+    }
+
+    std::shared_ptr<char> AlignedBufferPool::Acquire()
+    {
+        char* data = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!free_.empty())
+            {
+                data = free_.back();
+                free_.pop_back();
+            }
+        }
+        if (data == nullptr && posix_memalign(reinterpret_cast<void**>(&data), kAlignment, bufferSize_) != 0)
+        {
+            return nullptr;
+        }
+        auto pool = shared_from_this();
+        return std::shared_ptr<char>(data, [pool](char* data) {
+            {
+                std::lock_guard<std::mutex> lock(pool->mutex_);
+                if (pool->free_.size() < pool->maxFree_)
+                {
+                    pool->free_.push_back(data);
+                    return;
+                }
+            }
+            std::free(data);
+            });
+    }
+
+    std::shared_ptr<AlignedBufferPool> AlignedBufferPool::Direct()
+    {
+        static auto pool = new std::shared_ptr<AlignedBufferPool>(std::make_shared<AlignedBufferPool>(kDirectReadSize, 8));
+        return *pool;
+    }
+
+    std::shared_ptr<char> AlignedBufferPool::Allocate(size_t size)
+    {
+        char* data = nullptr;
+        if (posix_memalign(reinterpret_cast<void**>(&data), kAlignment, AlignUp(std::max<size_t>(size, 1))) != 0)
+        {
+            return nullptr;
+        }
+        return std::shared_ptr<char>(data, [](char* data) { std::free(data); });
+    }
+
+    struct DirectFILEDevice::StagedWrite
+    {
+        std::vector<boost::asio::const_buffer> source;
+        size_t sourceIndex = 0;
+        size_t sourceOffset = 0;
+        std::shared_ptr<char> stage[2];
+        size_t filled[2] = { 0, 0 };
+        size_t stageSize = 0;
+        uint64_t written = 0;
+        boost::system::error_code error;
+        /// @brief Halves of the current stage still running, its write and the fill of the other buffer
+        std::atomic<int> pending{ 0 };
+        WriteHandler handler;
+
+        /**
+         * Copy the next stage's worth of source data into a stage
+         */
+        void Fill(int index)
+        {
+            size_t length = 0;
+            while (length < stageSize && sourceIndex < source.size())
+            {
+                const auto& buffer = source[sourceIndex];
+                auto count = std::min(stageSize - length, buffer.size() - sourceOffset);
+                std::memcpy(stage[index].get() + length, static_cast<const char*>(buffer.data()) + sourceOffset, count);
+                length += count;
+                sourceOffset += count;
+                if (sourceOffset == buffer.size())
+                {
+                    ++sourceIndex;
+                    sourceOffset = 0;
+                }
+            }
+            filled[index] = length;
+        }
+    };
+
+    DirectFILEDevice::DirectFILEDevice(std::shared_ptr<boost::asio::io_context> ioc, std::string filename, int writemode,
+        boost::asio::thread_pool::executor_type diskExecutor)
+        : strand_(boost::asio::make_strand(*ioc)), diskExecutor_(diskExecutor)
+    {
+        int flags = writemode == 0 ? O_RDONLY : O_WRONLY | O_CREAT | O_TRUNC;
+#ifdef O_DIRECT
+        fd_ = open(filename.c_str(), flags | O_DIRECT | O_CLOEXEC, 0644);
+#endif
+        if (fd_ == -1)
+        {
+            //tmpfs and some other file systems refuse O_DIRECT when opening
+            fd_ = open(filename.c_str(), flags | O_CLOEXEC, 0644);
+        }
+        if (fd_ == -1) {
+            std::cerr << "Failed to open file" << std::endl;
+        }
+    }
+
+    DirectFILEDevice::~DirectFILEDevice()
+    {
+        if (fd_ != -1)
+        {
+            close(fd_);
+        }
+    }
+
+    void DirectFILEDevice::Close()
+    {
+        closed_ = true;
+    }
+
+    bool DirectFILEDevice::IsDirect() const
+    {
+#ifdef O_DIRECT
+        return fd_ != -1 && (fcntl(fd_, F_GETFL) & O_DIRECT) != 0;
+#else
+        return false;
+#endif
+    }
+
+    void DirectFILEDevice::DropDirect()
+    {
+#ifdef O_DIRECT
+        fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL) & ~O_DIRECT);
+#endif
+    }
+
+    std::optional<uint64_t> DirectFILEDevice::Size() const
+    {
+        struct stat info;
+        if (fd_ == -1 || fstat(fd_, &info) != 0 || !S_ISREG(info.st_mode))
+        {
+            return std::nullopt;
+        }
+        return static_cast<uint64_t>(info.st_size);
+    }
+
+    size_t DirectFILEDevice::TransferAt(bool write, char* data, size_t length, uint64_t offset, boost::system::error_code& error)
+    {
+        size_t done = 0;
+        while (done < length)
+        {
+            if (closed_)
+            {
+                error = boost::asio::error::operation_aborted;
+                break;
+            }
+            auto count = std::min(length - done, kDirectReadSize);
+            //Only the last block of a write can be short, its length isn't aligned so it goes out without O_DIRECT
+            if (write && count % AlignedBufferPool::kAlignment != 0 && IsDirect())
+            {
+                DropDirect();
+            }
+            auto result = write ? pwrite(fd_, data + done, count, static_cast<off_t>(offset + done))
+                : pread(fd_, data + done, count, static_cast<off_t>(offset + done));
+            if (result < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                //The file system can't do direct I/O after all, carry on from where it stopped without it
+                if (errno == EINVAL && IsDirect())
+                {
+                    DropDirect();
+                    continue;
+                }
+                error = boost::system::error_code(errno, boost::system::system_category());
+                break;
+            }
+            if (result == 0)
+            {
+                //The end of the file for reads, a write that makes no progress won't make any
+                if (write)
+                {
+                    error = boost::asio::error::broken_pipe;
+                }
+                break;
+            }
+            done += static_cast<size_t>(result);
+        }
+        return done;
+    }
+
+    void DirectFILEDevice::ReadAll(ReadHandler handler)
+    {
+        auto size = Size();
+        auto buffer = size ? AlignedBufferPool::Allocate(*size) : nullptr;
+        if (!buffer)
+        {
+            auto error = size ? boost::system::errc::make_error_code(boost::system::errc::not_enough_memory)
+                : boost::system::errc::make_error_code(boost::system::errc::bad_file_descriptor);
+            boost::asio::post(strand_, [handler, error]() { handler(error, nullptr, 0); });
+            return;
+        }
+        //Rounded up, the last read stops short at the end of the file
+        ReadBlock(buffer, AlignUp(*size), std::move(handler));
+    }
+
+    void DirectFILEDevice::ReadBlock(std::shared_ptr<char> buffer, size_t length, ReadHandler handler)
+    {
+        auto self = shared_from_this();
+        boost::asio::post(diskExecutor_, [self, buffer, length, handler]() {
+            boost::system::error_code error;
+            auto bytes = self->TransferAt(false, buffer.get(), length, self->readOffset_, error);
+            self->readOffset_ += bytes;
+            boost::asio::post(self->strand_, [handler, error, buffer, bytes]() {
+                handler(error, buffer, bytes);
+                });
+            });
+    }
+
+    void DirectFILEDevice::Write(std::vector<boost::asio::const_buffer> buffers, WriteHandler handler)
+    {
+        auto pool = AlignedBufferPool::Direct();
+        auto write = std::make_shared<StagedWrite>();
+        write->source = std::move(buffers);
+        write->handler = std::move(handler);
+        write->stageSize = pool->BufferSize();
+        write->stage[0] = pool->Acquire();
+        write->stage[1] = pool->Acquire();
+        if (!write->stage[0] || !write->stage[1])
+        {
+            boost::asio::post(strand_, [write]() {
+                write->handler(boost::system::errc::make_error_code(boost::system::errc::not_enough_memory), 0);
+                });
+            return;
+        }
+        auto self = shared_from_this();
+        boost::asio::post(strand_, [self, write]() {
+            write->Fill(0);
+            self->WriteStage(write, 0);
+            });
+    }
+
+    void DirectFILEDevice::WriteStage(std::shared_ptr<StagedWrite> write, int current)
+    {
+        if (write->error || write->filled[current] == 0)
+        {
+            write->handler(write->error, write->written);
+            return;
+        }
+        //The disk writes this stage while the strand fills the other one, the next stage starts once both are done
+        write->pending = 2;
+        auto self = shared_from_this();
+        boost::asio::post(diskExecutor_, [self, write, current]() {
+            boost::system::error_code error;
+            write->written += self->TransferAt(true, write->stage[current].get(), write->filled[current], write->written, error);
+            write->error = error;
+            self->StageDone(write, current);
+            });
+        boost::asio::post(strand_, [self, write, current]() {
+            write->Fill(1 - current);
+            self->StageDone(write, current);
+            });
+    }
+
+    void DirectFILEDevice::StageDone(std::shared_ptr<StagedWrite> write, int current)
+    {
+        if (write->pending.fetch_sub(1) != 1)
+        {
+            return;
+        }
+        auto self = shared_from_this();
+        boost::asio::post(strand_, [self, write, current]() {
+            self->WriteStage(write, 1 - current);
+            });
+    }
 #endif
-}
\ No newline at end of file
+}
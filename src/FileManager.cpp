@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cctype>
 #include "FileManager.hpp"
 #include "URLStringUtil.h"
 #include "MNNLoader.hpp"
@@ -9,21 +11,157 @@
 #include "SFTPLoader.hpp"
 #include "WSLoader.hpp"
 
+namespace
+{
+    /// Schemes whose loads go over the network and are worth keeping on disk
+    bool IsDiskCacheable(const std::string& prefix)
+    {
+        return prefix == "https" || prefix == "wss" || prefix == "sftp" || prefix == "ipfs";
+    }
+
+    /// Schemes whose disk cache entries are only ever served after the source confirms their validator,
+    /// storing one without a validator would just be rewritten by every load
+    bool NeedsDiskValidator(const std::string& prefix)
+    {
+        return prefix == "https" || prefix == "sftp";
+    }
+
+    /// Status text for callers that take strings, built from the typed events and only when there is a callback to take it.
+    /// Failures aren't repeated, they are reported with a message of their own where they happen.
+    sgns::LoadRequest::EventHandler StatusFromEvents(FileManager::StatusCallback status, sgns::LoadRequest::EventHandler onEvent)
+    {
+        if (!status)
+        {
+            return onEvent;
+        }
+        return [status, onEvent](const sgns::LoadEvent& event) {
+            if (onEvent)
+            {
+                onEvent(event);
+            }
+            if (!event.error)
+            {
+                status(CustomResult(sgns::AsyncError::outcome::success(Success{ event.ToString() })));
+            }
+        };
+    }
+
+    /// Tell the callers sharing a transfer that it waits, i.e. queued or for another attempt, traced as the transfer's own phase
+    void ReportTransferPhase(sgns::LoadTracer& tracer, sgns::LoadRequest& transfer, sgns::LoadPhase phase, std::chrono::milliseconds delay = std::chrono::milliseconds(0))
+    {
+        if (transfer.HasEventHandler() || tracer.IsEnabled())
+        {
+            sgns::LoadEvent event;
+            event.phase = phase;
+            event.time = std::chrono::steady_clock::now();
+            event.delay = delay;
+            tracer.OnEvent(transfer.GetURL(), &transfer, 0, event);
+            transfer.Forward(event);
+        }
+    }
+
+    /// Whether a local load would be memory mapped, see SetMappedLoads
+    bool IsMappedLoad(const std::string& path, uint64_t mapSize)
+    {
+        std::error_code ec;
+        auto size = std::filesystem::file_size(path, ec);
+        return mapSize != 0 && !ec && size >= mapSize;
+    }
+
+    /// Size and modification time of a local file, so a cached copy is dropped once the file is rewritten.
+    /// Empty for directories and anything else that isn't a regular file, those aren't cached.
+    std::string LocalFileValidator(const std::string& path)
+    {
+        std::error_code ec;
+        if (!std::filesystem::is_regular_file(path, ec))
+        {
+            return std::string();
+        }
+        auto size = std::filesystem::file_size(path, ec);
+        if (ec)
+        {
+            return std::string();
+        }
+        auto modified = std::filesystem::last_write_time(path, ec);
+        if (ec)
+        {
+            return std::string();
+        }
+        return std::to_string(size) + ":" + std::to_string(modified.time_since_epoch().count());
+    }
+
+    /// Feed a finished load to a streaming request one slice at a time, for loaders and cache hits that
+    /// only have whole files. Calls done once the consumer has resumed after the last chunk.
+    void DeliverAsChunks(std::shared_ptr<sgns::LoadRequest> request, std::shared_ptr<const sgns::LoadResult> buffers, std::function<void()> done)
+    {
+        struct Position
+        {
+            size_t entryIndex = 0;
+            size_t sliceIndex = 0;
+            uint64_t offset = 0;
+        };
+        auto position = std::make_shared<Position>();
+        request->DeliverChunks([buffers, position](sgns::LoadChunk& chunk) {
+            if (position->entryIndex >= buffers->entries.size())
+            {
+                return false;
+            }
+            const auto& entry = buffers->entries[position->entryIndex];
+            chunk.name = entry.name;
+            chunk.offset = position->offset;
+            //Empty files still get their last chunk
+            if (!entry.slices.empty())
+            {
+                chunk.data = entry.slices[position->sliceIndex];
+            }
+            chunk.last = entry.slices.empty() || position->sliceIndex + 1 == entry.slices.size();
+            position->offset += chunk.data.size;
+            ++position->sliceIndex;
+            if (chunk.last)
+            {
+                ++position->entryIndex;
+                position->sliceIndex = 0;
+                position->offset = 0;
+            }
+            return true;
+            }, std::move(done));
+    }
+
+#if defined(BOOST_ASIO_HAS_CO_AWAIT)
+    /// The io_context behind a coroutine's executor, not owned since the coroutine itself runs on it
+    std::shared_ptr<boost::asio::io_context> CurrentIOContext(const boost::asio::any_io_executor& executor)
+    {
+        if (auto io = executor.target<boost::asio::io_context::executor_type>())
+        {
+            return std::shared_ptr<boost::asio::io_context>(std::shared_ptr<void>(), &io->context());
+        }
+        if (auto strand = executor.target<boost::asio::strand<boost::asio::io_context::executor_type>>())
+        {
+            return std::shared_ptr<boost::asio::io_context>(std::shared_ptr<void>(), &strand->get_inner_executor().context());
+        }
+        return nullptr;
+    }
+#endif
+}
+
 void FileManager::RegisterLoader(const std::string &prefix,
         FileLoader *handlerLoader)
 {   
+    std::unique_lock<std::shared_mutex> lock(registryMutex_);
     loaders[prefix] = handlerLoader;
 }
 
 void FileManager::RegisterParser(const std::string &suffix,
         FileParser *handlerParser)
 {
+    std::unique_lock<std::shared_mutex> lock(registryMutex_);
     parsers[suffix] = handlerParser;
 }
 
 void FileManager::RegisterSaver(const std::string &prefix,
         FileSaver *handlerSaver)
 {
+    std::unique_lock<std::shared_mutex> lock(registryMutex_);
     savers[prefix] = handlerSaver;
 }
 
@@ -34,15 +172,18 @@ void AsyncHandler(boost::system::error_code ec, std::size_t n, std::vector<char>
 
 void FileManager::InitializeSingletons() {
     sgns::MNNLoader::InitializeSingleton();
-    //sgns::MNNParser::InitializeSingleton();
-    //sgns::SFTPLoader::InitializeSingleton();
+    sgns::MNNParser::InitializeSingleton();
+#ifdef ENABLE_SFTP
+    sgns::SFTPLoader::InitializeSingleton();
+#endif
     sgns::HTTPLoader::InitializeSingleton();
     //sgns::WSLoader::InitializeSingleton();
     sgns::IPFSLoader::InitializeSingleton();
     sgns::IPFSSaver::InitializeSingleton();
     sgns::MNNSaver::InitializeSingleton();
 }
-shared_ptr<void> FileManager::LoadASync(const std::string& url, bool parse, bool save, std::shared_ptr<boost::asio::io_context> ioc, StatusCallback status, FinalCallback finalcall, std::string savetype)
+std::shared_ptr<sgns::LoadRequest> FileManager::LoadASync(const std::string& url, bool parse, bool save, std::shared_ptr<boost::asio::io_context> ioc, StatusCallback status, FinalCallback finalcall, std::string savetype, sgns::LoadRequest::ChunkHandler onChunk, sgns::LoadPriority priority, std::chrono::milliseconds timeout,
+    sgns::LoadRequest::EventHandler onEvent, bool statusProgress)
 {
     std::string prefix;
     std::string filePath;
@@ -52,45 +193,731 @@ shared_ptr<void> FileManager::LoadASync(const std::string& url, bool parse, bool
 #if 0
     std::cout << "DEBUG: URL: " << url << " -prefix: " << prefix << " -filePath: " << filePath << " -suffix: " << suffix << std::endl;
 #endif
-    auto loaderIter = loaders.find(prefix);
-    if (loaderIter == loaders.end())
+    auto loader = FindHandler(loaders, prefix);
+    if (loader == nullptr)
     {
         throw std::range_error("No loader registered for prefix " + prefix);
     }
+    auto request = std::make_shared<sgns::LoadRequest>(url);
+    request->SetPriority(priority);
+    if (onChunk)
+    {
+        request->SetChunkHandler(std::move(onChunk));
+    }
+    auto eventHandler = statusProgress ? StatusFromEvents(status, std::move(onEvent)) : std::move(onEvent);
+    if (eventHandler)
+    {
+        request->SetEventHandler(std::move(eventHandler));
+    }
+    if (!status)
+    {
+        status = [](const CustomResult&) {};
+    }
+    //IPFS paths start with the CID, which is already a content hash
+    auto contentHash = prefix == "ipfs" ? filePath : std::string();
+    //Local files are only served from memory while they are unchanged
+    auto cacheValidator = prefix == "file" ? LocalFileValidator(filePath) : std::string();
+    //Mapped loads aren't kept either, their slices see whatever is done to the file for as long as they are held
+    bool memoryCacheable = prefix != "file" || (!cacheValidator.empty() && !IsMappedLoad(filePath, mappedLoadSize_));
+    auto cached = memoryCacheable ? cache_.Get(url, cacheValidator) : nullptr;
+    bool diskFresh = false;
+    bool diskCacheable = IsDiskCacheable(prefix) && diskCache_.IsEnabled();
+    if (!cached && diskCacheable)
+    {
+        sgns::DiskCache::Entry diskEntry;
+        if (diskCache_.Lookup(url, diskEntry))
+        {
+            auto age = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count() - diskEntry.storedAt;
+            if ((prefix == "ipfs" && diskEntry.validator == contentHash) || (prefix == "wss" && age < diskCacheMaxAge_))
+            {
+                //Read on the disk workers once the transfer is set up, so concurrent callers share the read
+                diskFresh = true;
+            }
+            else if (!diskEntry.validator.empty())
+            {
+                //Let the loader ask the source whether our copy is still current
+                request->SetCachedValidator(diskEntry.validator);
+            }
+        }
+    }
     //Increment Operations
     IncrementOutstandingOperations();
-    //Create a handler
-    auto handle_read = [this, savetype, suffix, finalcall](std::shared_ptr<boost::asio::io_context> ioc, std::shared_ptr<std::pair<std::vector<std::string>, std::vector<std::vector<char>>>> buffers, bool parse, bool save) {
-        std::cout << "Callback!" << std::endl;
-        //Parse Data
-        if (parse)
-        {
-            auto parserIter = parsers.find("mnn");
-            auto parser = dynamic_cast<FileParser*>(parserIter->second);
-            //shared_ptr<void> data = parser->ParseASync(buffer);
-        }
-        //Save data or otherwise decrement counter of operations
-        if (save)
-        {
-            auto handle_write = [this](std::shared_ptr<boost::asio::io_context> ioc) {
-                DecrementOutstandingOperations(ioc);
-            };
-            auto saverIter = savers.find(savetype);
-            auto saver = saverIter->second;
-            saver->SaveASync(ioc,handle_write,"",buffers, suffix);
-        }
-        else {
-            // Handle completion
-            DecrementOutstandingOperations(ioc);
+    //Cancelling or timing out reports back to the caller right away, whatever the loader delivers afterwards is dropped
+    request->OnCancel([this, ioc, status, finalcall, request]() {
+        bool timedOut = request->GetState() == sgns::LoadRequest::State::TimedOut;
+        status(CustomResult(sgns::AsyncError::outcome::failure(timedOut ? "Load timed out" : "Load cancelled")));
+        request->Report(sgns::LoadPhase::Done, 0, 0, boost::system::errc::make_error_code(timedOut ? boost::system::errc::timed_out : boost::system::errc::operation_canceled));
+        DecrementOutstandingOperations(ioc);
+        finalcall(nullptr);
+        });
+    //Each request gets its own strand so completion handlers never run concurrently with each other
+    auto strand = std::make_shared<boost::asio::strand<boost::asio::io_context::executor_type>>(boost::asio::make_strand(*ioc));
+    if (timeout.count() > 0)
+    {
+        //The deadline timer lives on the request strand, so expiry and the cancel on completion never race
+        auto deadline = std::make_shared<boost::asio::steady_timer>(*strand, timeout);
+        deadline->async_wait([request](const boost::system::error_code& ec) {
+            if (!ec)
+            {
+                request->Expire();
+            }
+            });
+        request->OnComplete([deadline, strand](sgns::LoadRequest::State, sgns::LoadRequest::LoadBuffers) {
+            boost::asio::post(*strand, [deadline]() {
+                deadline->cancel();
+                });
+            });
+    }
+    //Create a handler for this caller's own parse/save/completion once the data is in
+    auto handle_read = [this, request, savetype, suffix, status, finalcall, parse, save, strand](std::shared_ptr<boost::asio::io_context> ioc, std::shared_ptr<const sgns::LoadResult> buffers) {
+        if (request->IsCancelled())
+        {
+            return;
         }
-        finalcall(buffers);
+        //Streaming consumers get whole files as chunks when the data didn't arrive that way
+        if (buffers && request->IsStreaming() && !request->HasDeliveredChunks())
+        {
+            //The consumer may resume from any thread, finish back on the strand
+            DeliverAsChunks(request, buffers, [this, request, buffers, ioc, strand, savetype, suffix, status, finalcall, parse, save]() {
+                boost::asio::post(*strand, [this, request, buffers, ioc, strand, savetype, suffix, status, finalcall, parse, save]() {
+                    FinishLoad(request, ioc, strand, buffers, parse, save, savetype, suffix, status, finalcall);
+                    });
+                });
+            return;
+        }
+        FinishLoad(request, ioc, strand, buffers, parse, save, savetype, suffix, status, finalcall);
+    };
+    //Loaders may complete on any thread running the io_context, hop onto the request strand first
+    auto handle_read_strand = [strand, handle_read](std::shared_ptr<boost::asio::io_context> ioc, std::shared_ptr<const sgns::LoadResult> buffers) {
+        boost::asio::post(*strand, [handle_read, ioc, buffers]() {
+            handle_read(ioc, buffers);
+            });
+    };
+    if (cached)
+    {
+        //Hits share the cached buffers, still completing asynchronously like a load would
+        handle_read_strand(ioc, cached);
+        return request;
+    }
 
+    //Attach to a transfer of the same URL that is already running, or start one.
+    //Streaming requests always run their own, a transfer already underway has passed chunks they would need.
+    auto flightKey = normalizeURL(url);
+    auto flight = std::make_shared<InFlightLoad>();
+    bool shareable = !request->IsStreaming();
+    bool attached = false;
+    bool promote = false;
+    {
+        std::lock_guard<std::mutex> lock(inflightMutex_);
+        auto iter = shareable ? inflight_.find(flightKey) : inflight_.end();
+        if (iter != inflight_.end())
+        {
+            flight = iter->second;
+            attached = true;
+            //An urgent caller pulls a waiting transfer forward with it
+            promote = priority < flight->priority;
+            if (promote)
+            {
+                flight->priority = priority;
+            }
+        }
+        else
+        {
+            flight->priority = priority;
+            flight->ticket = scheduler_.NewTicket();
+            //The loader gets a request of its own, so one caller giving up doesn't end the transfer for the rest
+            flight->transfer = std::make_shared<sgns::LoadRequest>(url);
+            flight->transfer->SetPriority(priority);
+            flight->transfer->SetCachedValidator(request->GetCachedValidator());
+            flight->fromDisk = diskFresh;
+            if (request->IsStreaming())
+            {
+                flight->transfer->SetChunkHandler([request](const sgns::LoadChunk& chunk, std::function<void()> resume) {
+                    request->DeliverChunk(chunk, std::move(resume));
+                    });
+            }
+            //Loader events go to every attached caller that listens, callers attaching later included
+            flight->transfer->SetEventHandler([weakFlight = std::weak_ptr<InFlightLoad>(flight)](const sgns::LoadEvent& event) {
+                auto flight = weakFlight.lock();
+                auto listeners = flight ? std::atomic_load(&flight->listeners) : nullptr;
+                if (listeners)
+                {
+                    for (auto& listener : *listeners)
+                    {
+                        listener->Forward(event);
+                    }
+                }
+                });
+            if (shareable)
+            {
+                inflight_[flightKey] = flight;
+            }
+        }
+        flight->readers.push_back(handle_read_strand);
+        flight->statuses.push_back(status);
+        flight->requests.push_back(request);
+        if (request->HasEventHandler())
+        {
+            auto listeners = flight->listeners ? std::make_shared<std::vector<std::shared_ptr<sgns::LoadRequest>>>(*flight->listeners)
+                : std::make_shared<std::vector<std::shared_ptr<sgns::LoadRequest>>>();
+            listeners->push_back(request);
+            std::atomic_store(&flight->listeners, std::shared_ptr<const std::vector<std::shared_ptr<sgns::LoadRequest>>>(listeners));
+        }
+    }
+    //Once nobody is waiting on the transfer, tear it down and free its slot instead of letting it run on
+    request->OnCancel([this, flight, flightKey]() {
+        {
+            std::lock_guard<std::mutex> lock(inflightMutex_);
+            bool abandoned = std::all_of(flight->requests.begin(), flight->requests.end(),
+                [](const std::shared_ptr<sgns::LoadRequest>& attached) { return attached->IsCancelled(); });
+            if (flight->done || !abandoned)
+            {
+                return;
+            }
+            flight->done = true;
+            auto iter = inflight_.find(flightKey);
+            if (iter != inflight_.end() && iter->second == flight)
+            {
+                inflight_.erase(iter);
+            }
+            flight->readers.clear();
+        }
+        //Loaders close their sockets and drop their queued work from their cancel handlers
+        flight->transfer->Cancel();
+        if (tracer_.IsEnabled())
+        {
+            sgns::LoadEvent event;
+            event.phase = sgns::LoadPhase::Done;
+            event.time = std::chrono::steady_clock::now();
+            event.error = boost::system::errc::make_error_code(boost::system::errc::operation_canceled);
+            tracer_.OnEvent(flight->transfer->GetURL(), flight->transfer.get(), 0, event);
+        }
+        scheduler_.Release(flight->ticket);
+        });
+    if (attached)
+    {
+        if (promote)
+        {
+            scheduler_.Promote(flight->ticket, priority);
+        }
+        return request;
+    }
+    //Every attached caller sees the transfer's status updates
+    auto flight_status = [this, flight](const CustomResult& result) {
+        std::vector<StatusCallback> statuses;
+        {
+            std::lock_guard<std::mutex> lock(inflightMutex_);
+            statuses = flight->statuses;
+        }
+        for (auto& callerStatus : statuses)
+        {
+            callerStatus(result);
+        }
+    };
+    auto loadStart = std::chrono::steady_clock::now();
+    //Hands the same immutable result to every attached caller, then keeps it for later ones
+    auto deliver = [this, flight, flightKey, prefix, contentHash, loadStart, diskCacheable, memoryCacheable, cacheValidator](std::shared_ptr<boost::asio::io_context> ioc, std::shared_ptr<const sgns::LoadResult> buffers, bool fromDisk) {
+        auto request = flight->transfer;
+        if (buffers && memoryCacheable && cache_.IsEnabled())
+        {
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - loadStart;
+            cache_.Put(request->GetURL(), buffers, cache_.FetchCost(prefix, elapsed.count()), contentHash, cacheValidator);
+        }
+        //Later callers start a fresh transfer (or hit the cache) from here on
+        std::vector<std::function<void(std::shared_ptr<boost::asio::io_context>, std::shared_ptr<const sgns::LoadResult>)>> readers;
+        {
+            std::lock_guard<std::mutex> lock(inflightMutex_);
+            auto iter = inflight_.find(flightKey);
+            if (iter != inflight_.end() && iter->second == flight)
+            {
+                inflight_.erase(iter);
+            }
+            readers.swap(flight->readers);
+        }
+        for (auto& reader : readers)
+        {
+            reader(ioc, buffers);
+        }
+        request->Complete(buffers);
+        auto diskValidator = prefix == "ipfs" ? contentHash : request->GetValidator();
+        if (buffers && diskCacheable && !fromDisk && (!diskValidator.empty() || !NeedsDiskValidator(prefix)))
+        {
+            //Writing a big blob takes a while, the callers already have their data and the io_context carries on
+            boost::asio::post(GetDiskExecutor(), [this, request, buffers, diskValidator]() {
+                auto storeStart = std::chrono::steady_clock::now();
+                diskCache_.Store(request->GetURL(), *buffers, diskValidator);
+                tracer_.Span("disk cache store", "cache", request->GetURL(), storeStart, std::chrono::steady_clock::now());
+                });
+        }
+    };
+    //Runs once per transfer, reads back a revalidated disk copy if needed and delivers the result
+    auto handle_transfer = [this, flight, flight_status, deliver](std::shared_ptr<boost::asio::io_context> ioc, std::shared_ptr<const sgns::LoadResult> buffers, bool parse, bool save) {
+        auto request = flight->transfer;
+        {
+            //Abandoned transfers were already cleaned up, and some loaders report more than one failure
+            std::lock_guard<std::mutex> lock(inflightMutex_);
+            if (flight->done)
+            {
+                return;
+            }
+            flight->done = true;
+        }
+        //Let the next waiting transfer have the slot
+        scheduler_.Release(flight->ticket);
+        if (tracer_.IsEnabled())
+        {
+            sgns::LoadEvent event;
+            event.phase = sgns::LoadPhase::Done;
+            event.bytes = buffers ? buffers->TotalSize() : 0;
+            event.time = std::chrono::steady_clock::now();
+            tracer_.OnEvent(request->GetURL(), request.get(), 0, event);
+        }
+        //Source confirmed the disk copy is current, read it back on the disk workers
+        if (!buffers && request->IsNotModified())
+        {
+            boost::asio::post(GetDiskExecutor(), [this, request, ioc, flight_status, deliver]() {
+                auto buffers = diskCache_.Read(request->GetURL());
+                if (!buffers)
+                {
+                    flight_status(CustomResult(sgns::AsyncError::outcome::failure("Disk cache entry missing after revalidation")));
+                }
+                deliver(ioc, buffers, true);
+                });
+            return;
+        }
+        deliver(ioc, buffers, flight->fromDisk);
     };
-    auto loader = loaderIter->second;
     // double check pointer is to a FileLoader class
     assert(dynamic_cast<FileLoader*>(loader));
-    shared_ptr<void> data = loader->LoadASync(filePath,parse,save,ioc,handle_read,status);
-    return data;
+    //Start once the scheduler admits the transfer, unless every attached caller gave up while it waited
+    auto attempts = std::make_shared<TransferAttempts>();
+    attempts->loader = loader;
+    attempts->filePath = filePath;
+    attempts->prefix = prefix;
+    attempts->host = sgns::LoadMetrics::HostOf(prefix, filePath);
+    attempts->parse = parse;
+    attempts->save = save;
+    attempts->ioc = ioc;
+    attempts->flight = flight;
+    attempts->finish = handle_transfer;
+    attempts->status = flight_status;
+    attempts->options = retryPolicy_.GetOptions(prefix);
+    auto start_transfer = [attempts, flight, this]() {
+        {
+            std::lock_guard<std::mutex> lock(inflightMutex_);
+            if (flight->done)
+            {
+                //Abandoned while a damaged disk copy was read, the slot was taken after the cancel freed it
+                scheduler_.Release(flight->ticket);
+                return;
+            }
+            //Loaders order their own queues by the transfer's class, which may have been promoted while waiting
+            flight->transfer->SetPriority(flight->priority);
+        }
+        StartAttempt(attempts);
+    };
+    auto submit_transfer = [this, flight, priority, start_transfer]() {
+        if (!scheduler_.Submit(flight->ticket, priority, start_transfer))
+        {
+            //Through the transfer, so the tracer sees the wait along with the listening caller
+            ReportTransferPhase(tracer_, *flight->transfer, sgns::LoadPhase::Queued);
+        }
+    };
+    if (flight->fromDisk)
+    {
+        //Fresh disk copies don't need a transfer slot, a damaged one falls back to the loader
+        boost::asio::post(GetDiskExecutor(), [this, flight, attempts, submit_transfer]() {
+            auto buffers = diskCache_.Read(flight->transfer->GetURL());
+            if (!buffers)
+            {
+                flight->fromDisk = false;
+                submit_transfer();
+                return;
+            }
+            attempts->finish(attempts->ioc, buffers, attempts->parse, attempts->save);
+            });
+        return request;
+    }
+    submit_transfer();
+    return request;
+}
+
+void FileManager::StartAttempt(std::shared_ptr<TransferAttempts> attempts)
+{
+    {
+        std::lock_guard<std::mutex> lock(inflightMutex_);
+        if (attempts->flight->done)
+        {
+            return;
+        }
+    }
+    auto transfer = attempts->flight->transfer;
+    //Each attempt runs on a request of its own, so the one that loses a hedge can be cancelled on its own
+    auto request = std::make_shared<sgns::LoadRequest>(transfer->GetURL());
+    request->SetPriority(transfer->GetPriority());
+    request->SetCachedValidator(transfer->GetCachedValidator());
+    if (transfer->IsStreaming())
+    {
+        request->SetChunkHandler([transfer](const sgns::LoadChunk& chunk, std::function<void()> resume) {
+            transfer->DeliverChunk(chunk, std::move(resume));
+            });
+    }
+    bool first;
+    size_t attempt;
+    bool abandoned = false;
+    {
+        std::lock_guard<std::mutex> lock(attempts->mutex);
+        //A hedge sent during a retry's backoff may have used up the last attempt
+        if (attempts->finished || attempts->started >= std::max<size_t>(1, attempts->options.maxAttempts))
+        {
+            return;
+        }
+        first = attempts->started == 0;
+        //Cancelled while waiting to retry or hedge, the first attempt is cancelled by the handler registered below
+        if (!first && transfer->IsCancelled())
+        {
+            //With nothing left running there's no failure report coming to finish the load
+            abandoned = attempts->running.empty();
+            attempts->finished = abandoned;
+            attempt = 0;
+        }
+        else
+        {
+            if (first)
+            {
+                attempts->firstStart = std::chrono::steady_clock::now();
+            }
+            attempt = ++attempts->started;
+            attempts->running.emplace(attempt, request);
+        }
+    }
+    if (attempt == 0)
+    {
+        if (abandoned)
+        {
+            attempts->finish(attempts->ioc, nullptr, false, false);
+        }
+        return;
+    }
+    //Attempts share the transfer's row in the trace but keep phases of their own, a hedge doesn't cut its rival's short
+    request->SetEventHandler([this, transfer, attempt](const sgns::LoadEvent& event) {
+        tracer_.OnEvent(transfer->GetURL(), transfer.get(), attempt, event);
+        transfer->Forward(event);
+        });
+    if (first)
+    {
+        //Abandoning the transfer aborts whichever attempts are still running, they report back as failures
+        transfer->OnCancel([attempts]() {
+            std::map<size_t, std::shared_ptr<sgns::LoadRequest>> running;
+            {
+                std::lock_guard<std::mutex> lock(attempts->mutex);
+                running = attempts->running;
+            }
+            for (auto& item : running)
+            {
+                item.second->Cancel();
+            }
+            });
+        retryPolicy_.RecordAttempt();
+        //Streamed chunks can't come from two sources at once, so only whole loads are hedged
+        auto hedgeDelay = retryPolicy_.HedgeDelay(attempts->prefix);
+        if (hedgeDelay.count() > 0 && attempts->options.maxAttempts > 1 && !transfer->IsStreaming())
+        {
+            auto hedge = std::make_shared<boost::asio::steady_timer>(*attempts->ioc, hedgeDelay);
+            hedge->async_wait([this, attempts, hedge](const boost::system::error_code& ec) {
+                {
+                    std::lock_guard<std::mutex> lock(attempts->mutex);
+                    if (ec || attempts->finished || attempts->started >= attempts->options.maxAttempts)
+                    {
+                        return;
+                    }
+                }
+                if (!retryPolicy_.TryWithdraw())
+                {
+                    return;
+                }
+                ReportTransferPhase(tracer_, *attempts->flight->transfer, sgns::LoadPhase::Retry);
+                StartAttempt(attempts);
+                });
+        }
+    }
+    auto attempt_done = [this, attempts, attempt](std::shared_ptr<boost::asio::io_context> ioc, std::shared_ptr<const sgns::LoadResult> buffers, bool parse, bool save) {
+        FinishAttempt(attempts, attempt, buffers, parse, save);
+    };
+    metrics_.RecordRequest(attempts->prefix, attempts->host);
+    attempts->loader->LoadASync(attempts->filePath, attempts->parse, attempts->save, attempts->ioc, attempt_done, attempts->status, request);
+}
+
+void FileManager::FinishAttempt(std::shared_ptr<TransferAttempts> attempts, size_t attempt, std::shared_ptr<const sgns::LoadResult> buffers, bool parse, bool save)
+{
+    auto transfer = attempts->flight->transfer;
+    std::shared_ptr<sgns::LoadRequest> request;
+    bool good = false;
+    bool retry = false;
+    size_t retries = 0;
+    std::map<size_t, std::shared_ptr<sgns::LoadRequest>> losers;
+    {
+        std::lock_guard<std::mutex> lock(attempts->mutex);
+        //Some loaders report more than one failure, only the first report of an attempt counts.
+        //A hedged attempt that lost the race isn't running anymore either.
+        auto iter = attempts->running.find(attempt);
+        if (iter == attempts->running.end())
+        {
+            return;
+        }
+        request = iter->second;
+        attempts->running.erase(iter);
+        good = buffers != nullptr || request->IsNotModified();
+        if (buffers)
+        {
+            metrics_.RecordBytes(attempts->prefix, attempts->host, buffers->TotalSize());
+        }
+        else if (!good && !request->IsCancelled())
+        {
+            metrics_.RecordError(attempts->prefix, attempts->host);
+        }
+        if (!good && !attempts->running.empty())
+        {
+            //The other attempt may still come through
+            request->Complete(nullptr);
+            return;
+        }
+        retry = !good && attempts->started < attempts->options.maxAttempts && !transfer->IsCancelled() && !transfer->HasDeliveredChunks();
+        attempts->finished = !retry;
+        retries = attempts->started - 1;
+        if (good)
+        {
+            losers.swap(attempts->running);
+        }
+    }
+    //Done with the attempt's request, which drops the cancel handlers holding on to its loader
+    request->Complete(buffers);
+    if (good)
+    {
+        //The winner's validator goes with the data into the disk cache
+        transfer->SetValidator(request->GetValidator());
+        if (request->IsNotModified())
+        {
+            transfer->SetNotModified();
+        }
+        //Stop the hedge that lost, it would otherwise hold its connection and bandwidth until it finished
+        for (auto& loser : losers)
+        {
+            loser.second->Cancel();
+        }
+        if (buffers)
+        {
+            retryPolicy_.RecordLatency(attempts->prefix, std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - attempts->firstStart));
+        }
+        attempts->finish(attempts->ioc, buffers, parse, save);
+        return;
+    }
+    if (retry && retryPolicy_.TryWithdraw())
+    {
+        auto backoff = retryPolicy_.Backoff(attempts->prefix, retries);
+        ReportTransferPhase(tracer_, *transfer, sgns::LoadPhase::Retry, backoff);
+        auto timer = std::make_shared<boost::asio::steady_timer>(*attempts->ioc, backoff);
+        timer->async_wait([this, attempts, timer](const boost::system::error_code&) {
+            StartAttempt(attempts);
+            });
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(attempts->mutex);
+        attempts->finished = true;
+    }
+    attempts->finish(attempts->ioc, nullptr, false, false);
+}
+
+void FileManager::FinishLoad(std::shared_ptr<sgns::LoadRequest> request, std::shared_ptr<boost::asio::io_context> ioc,
+    std::shared_ptr<boost::asio::strand<boost::asio::io_context::executor_type>> strand, std::shared_ptr<const sgns::LoadResult> buffers,
+    bool parse, bool save, const std::string& savetype, const std::string& suffix, StatusCallback status, FinalCallback finalcall)
+{
+    //Phase metrics are kept per scheme
+    auto scheme = request->GetURL().substr(0, request->GetURL().find("://"));
+    //Parse Data on the CPU pool with the parser for the suffix, then come back to the request strand for the save
+    auto parser = parse && buffers ? FindHandler(parsers, suffix) : nullptr;
+    if (parser != nullptr)
+    {
+        boost::asio::post(GetCPUExecutor(), [this, scheme, parser, request, ioc, strand, buffers, save, savetype, suffix, status, finalcall]() {
+            std::shared_ptr<const sgns::LoadResult> parsed;
+            if (!request->IsCancelled())
+            {
+                request->Report(sgns::LoadPhase::Parse);
+                auto parseStart = std::chrono::steady_clock::now();
+                try
+                {
+                    //The loaded result is shared with the cache and other callers, the parsed object goes on this caller's copy
+                    auto result = std::make_shared<sgns::LoadResult>(*buffers);
+                    result->parsed = parser->ParseASync(buffers);
+                    parsed = result;
+                }
+                catch (const std::exception& e)
+                {
+                    //The caller finds out why the load failed, not just that it did
+                    std::cerr << "Parsing " << request->GetURL() << " failed: " << e.what() << std::endl;
+                    status(CustomResult(sgns::AsyncError::outcome::failure(std::string("Parse failed: ") + e.what())));
+                    request->Report(sgns::LoadPhase::Parse, 0, 0, boost::system::errc::make_error_code(boost::system::errc::bad_message));
+                }
+                auto parseEnd = std::chrono::steady_clock::now();
+                metrics_.RecordPhase(scheme, sgns::LoadPhase::Parse, parseEnd - parseStart);
+                tracer_.Span("parse", "load", request->GetURL(), parseStart, parseEnd, { { "parser", suffix }, { "ok", parsed ? "true" : "false" } });
+            }
+            boost::asio::post(*strand, [this, request, ioc, strand, parsed, save, savetype, suffix, status, finalcall]() {
+                FinishLoad(request, ioc, strand, parsed, false, save, savetype, suffix, status, finalcall);
+                });
+            });
+        return;
+    }
+    //Finish the request, unless it was cancelled while saving
+    auto handle_complete = [this, request, buffers, finalcall](std::shared_ptr<boost::asio::io_context> ioc) {
+        if (request->Complete(buffers))
+        {
+            request->Report(sgns::LoadPhase::Done, buffers ? buffers->TotalSize() : 0, 0,
+                buffers ? boost::system::error_code() : boost::system::errc::make_error_code(boost::system::errc::io_error));
+            DecrementOutstandingOperations(ioc);
+            finalcall(buffers);
+        }
+    };
+    //Save data or otherwise complete the request
+    auto saver = FindHandler(savers, savetype);
+    if (save && buffers && saver != nullptr)
+    {
+        request->Report(sgns::LoadPhase::Save);
+        auto saveStart = std::chrono::steady_clock::now();
+        saver->SaveASync(ioc, [this, request, strand, scheme, savetype, saveStart, handle_complete](std::shared_ptr<boost::asio::io_context> ioc) {
+            auto saveEnd = std::chrono::steady_clock::now();
+            metrics_.RecordPhase(scheme, sgns::LoadPhase::Save, saveEnd - saveStart);
+            tracer_.Span("save", "save", request->GetURL(), saveStart, saveEnd, { { "saver", savetype } });
+            //Savers finish on any io_context thread, complete on the request strand
+            boost::asio::post(*strand, [handle_complete, ioc]() {
+                handle_complete(ioc);
+                });
+            }, "", buffers, suffix);
+    }
+    else {
+        // Handle completion
+        handle_complete(ioc);
+    }
+}
+
+#if defined(BOOST_ASIO_HAS_CO_AWAIT)
+boost::asio::awaitable<sgns::LoadOutcome> FileManager::Load(std::string url, sgns::LoadOptions options)
+{
+    auto ioc = CurrentIOContext(co_await boost::asio::this_coro::executor);
+    if (ioc == nullptr)
+    {
+        co_return sgns::LoadOutcome(sgns::AsyncError::outcome::failure("Load must be awaited on an io_context"));
+    }
+    co_return co_await AsyncLoad(url, std::move(options), ioc, boost::asio::use_awaitable);
+}
+
+boost::asio::awaitable<CustomResult> FileManager::Save(std::string url, std::shared_ptr<const sgns::LoadResult> data)
+{
+    auto ioc = CurrentIOContext(co_await boost::asio::this_coro::executor);
+    if (ioc == nullptr)
+    {
+        co_return CustomResult(sgns::AsyncError::outcome::failure("Save must be awaited on an io_context"));
+    }
+    co_return co_await AsyncSave(url, std::move(data), ioc, boost::asio::use_awaitable);
+}
+#endif
+
+std::shared_ptr<sgns::LoadBatch> FileManager::LoadMany(std::vector<std::string> urls, sgns::LoadBatchOptions options, std::shared_ptr<boost::asio::io_context> ioc,
+    sgns::LoadBatch::ItemHandler onItem, sgns::LoadBatch::BatchHandler onDone, sgns::LoadBatch::StatusHandler onStatus)
+{
+    auto batch = std::make_shared<sgns::LoadBatch>(std::move(urls), std::move(options), ioc);
+    batch->SetItemHandlers(std::move(onItem), std::move(onStatus));
+    batch->SetBatchHandler(std::move(onDone));
+    batch->Start();
+    return batch;
+}
+
+std::shared_ptr<sgns::LoadRequest> FileManager::LoadAny(std::vector<std::string> urls, sgns::LoadRaceOptions options, std::shared_ptr<boost::asio::io_context> ioc,
+    StatusCallback status, FinalCallback finalcall)
+{
+    if (urls.empty())
+    {
+        throw std::range_error("No URLs to load");
+    }
+    std::string prefix;
+    std::string filePath;
+    std::string suffix;
+    getURLComponents(urls.front(), prefix, filePath, suffix);
+    auto request = std::make_shared<sgns::LoadRequest>(urls.front());
+    request->SetPriority(options.priority);
+    auto race = std::make_shared<sgns::LoadRace>(urls, options, ioc);
+    //Sources only build status text for a race that has someone to show it to
+    sgns::LoadRace::StatusHandler raceStatus = nullptr;
+    if (status)
+    {
+        raceStatus = [status](size_t, const CustomResult& result) {
+            status(result);
+        };
+    }
+    else
+    {
+        status = [](const CustomResult&) {};
+    }
+    IncrementOutstandingOperations();
+    //Parse, save and completion of the winner run on their own strand, like a single load's
+    auto strand = std::make_shared<boost::asio::strand<boost::asio::io_context::executor_type>>(boost::asio::make_strand(*ioc));
+    request->OnCancel([this, ioc, status, finalcall, request, race]() {
+        race->Cancel();
+        bool timedOut = request->GetState() == sgns::LoadRequest::State::TimedOut;
+        status(CustomResult(sgns::AsyncError::outcome::failure(timedOut ? "Load timed out" : "Load cancelled")));
+        DecrementOutstandingOperations(ioc);
+        finalcall(nullptr);
+        });
+    //The digest names the content, a copy loaded from any of the sources will do
+    std::transform(options.sha256.begin(), options.sha256.end(), options.sha256.begin(), [](unsigned char c) {
+        return static_cast<char>(std::tolower(c));
+        });
+    auto cached = options.sha256.empty() ? nullptr : cache_.GetByHash(options.sha256);
+    if (cached)
+    {
+        boost::asio::post(*strand, [this, request, ioc, strand, cached, options, suffix, status, finalcall]() {
+            FinishLoad(request, ioc, strand, cached, options.parse, options.save, options.savetype, suffix, status, finalcall);
+            });
+        return request;
+    }
+    if (options.timeout.count() > 0)
+    {
+        auto deadline = std::make_shared<boost::asio::steady_timer>(*ioc, options.timeout);
+        deadline->async_wait([request](const boost::system::error_code& ec) {
+            if (!ec)
+            {
+                request->Expire();
+            }
+            });
+        request->OnComplete([deadline, ioc](sgns::LoadRequest::State, sgns::LoadRequest::LoadBuffers) {
+            boost::asio::post(*ioc, [deadline]() {
+                deadline->cancel();
+                });
+            });
+    }
+    auto raceStart = std::chrono::steady_clock::now();
+    race->SetHandlers([this, request, ioc, strand, urls, options, status, finalcall, raceStart](size_t index, sgns::LoadRequest::LoadBuffers buffers) {
+        std::string winnerSuffix;
+        if (buffers)
+        {
+            std::string winnerPrefix;
+            std::string winnerPath;
+            getURLComponents(urls[index], winnerPrefix, winnerPath, winnerSuffix);
+            bool mapped = winnerPrefix == "file" && IsMappedLoad(winnerPath, mappedLoadSize_);
+            if (!options.sha256.empty() && cache_.IsEnabled() && !mapped)
+            {
+                //Re-file the winner under its digest so later races for the same content hit
+                std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - raceStart;
+                cache_.Put(urls[index], buffers, cache_.FetchCost(winnerPrefix, elapsed.count()), options.sha256);
+            }
+        }
+        boost::asio::post(*strand, [this, request, ioc, strand, buffers, options, winnerSuffix, status, finalcall]() {
+            FinishLoad(request, ioc, strand, buffers, options.parse, options.save, options.savetype, winnerSuffix, status, finalcall);
+            });
+        }, raceStatus);
+    race->Start();
+    return request;
 }
 
 shared_ptr<void> FileManager::LoadFile(const std::string &url, bool parse)
@@ -103,12 +930,11 @@ shared_ptr<void> FileManager::LoadFile(const std::string &url, bool parse)
 #if 0
     std::cout << "DEBUG: URL: " << url << " -prefix: " << prefix << " -filePath: " << filePath << " -suffix: " << suffix << std::endl;
 #endif
-    auto loaderIter = loaders.find(prefix);
-    if (loaderIter == loaders.end())
+    auto loader = FindHandler(loaders, prefix);
+    if (loader == nullptr)
     {
         throw std::range_error("No loader registered for prefix " + prefix);
     }
-    auto loader = loaderIter->second;
     // double check pointer is to a FileLoader class
     assert(dynamic_cast<FileLoader*>(loader));
 
@@ -124,13 +950,12 @@ shared_ptr<void> FileManager::LoadFile(const std::string &url, bool parse)
 shared_ptr<void> FileManager::ParseData(const std::string &suffix,
         shared_ptr<void> data)
 {
-    auto parserIter = parsers.find(suffix);
-    if (parserIter == parsers.end())
+    auto parser = FindHandler(parsers, suffix);
+    if (parser == nullptr)
     {
         throw std::range_error("No parser registered for suffix " + suffix);
     }
 
-    auto parser = dynamic_cast<FileParser*>(parserIter->second);
     data = parser->ParseData(data);
     return data;
 }
@@ -143,14 +968,13 @@ void FileManager::SaveFile(const std::string &url, std::shared_ptr<void> data)
 
     getURLComponents(url, prefix, filePath, suffix);
 
-    auto saverIter = savers.find(prefix);
+    auto saver = FindHandler(savers, prefix);
 
-    if (saverIter == savers.end())
+    if (saver == nullptr)
     {
         throw std::range_error("No saver registered for prefix " + prefix);
     }
 
-    auto saver = saverIter->second;
     // double check pointer is to a FileSaver class
     assert(dynamic_cast<FileSaver*>(saver));
 
@@ -160,25 +984,173 @@ void FileManager::SaveFile(const std::string &url, std::shared_ptr<void> data)
 /// @brief Function to decrement operation count
 void FileManager::DecrementOutstandingOperations(std::shared_ptr<boost::asio::io_context> ioc)
 {
-    // Decrement the counter
-    outstandingOperations_--;
-
-    // If all operations are complete, perform additional cleanup
-    if (outstandingOperations_ == 0) {
+    // Decrement the counter, only the thread that takes it to zero does the cleanup
+    if (outstandingOperations_.fetch_sub(1) == 1 && stopOnIdle_) {
         // Clean up io_context
         ioc->stop();
     }
 }
 
+void FileManager::SetStopOnIdle(bool stop)
+{
+    stopOnIdle_ = stop;
+}
+
+void FileManager::SetCacheByteBudget(size_t byteBudget)
+{
+    cache_.SetByteBudget(byteBudget);
+}
+
+void FileManager::SetSchedulerLimits(size_t maxActive, size_t maxPrefetch)
+{
+    scheduler_.SetLimits(maxActive, maxPrefetch);
+}
+
+sgns::LoadScheduler& FileManager::GetScheduler()
+{
+    return scheduler_;
+}
+
+sgns::BandwidthGovernor& FileManager::GetGovernor()
+{
+    return governor_;
+}
+
+sgns::RetryPolicy& FileManager::GetRetryPolicy()
+{
+    return retryPolicy_;
+}
+
+bool FileManager::SetCPUThreads(size_t threads)
+{
+    std::lock_guard<std::mutex> lock(cpuPoolMutex_);
+    if (cpuPool_)
+    {
+        //Executors handed out refer to the running pool, it can't be swapped under them
+        return false;
+    }
+    cpuThreads_ = threads;
+    return true;
+}
+
+boost::asio::thread_pool::executor_type FileManager::GetCPUExecutor()
+{
+    std::lock_guard<std::mutex> lock(cpuPoolMutex_);
+    if (!cpuPool_)
+    {
+        auto threads = cpuThreads_ != 0 ? cpuThreads_ : std::max(1u, std::thread::hardware_concurrency());
+        cpuPool_ = std::make_unique<boost::asio::thread_pool>(threads);
+    }
+    return cpuPool_->get_executor();
+}
+
+boost::asio::thread_pool::executor_type FileManager::GetDiskExecutor()
+{
+    std::lock_guard<std::mutex> lock(cpuPoolMutex_);
+    if (!diskPool_)
+    {
+        //Two, so a disk cache hit doesn't queue behind the store of a huge blob
+        diskPool_ = std::make_unique<boost::asio::thread_pool>(2);
+    }
+    return diskPool_->get_executor();
+}
+
+sgns::LoadMetrics& FileManager::GetMetrics()
+{
+    return metrics_;
+}
+
+sgns::LoadTracer& FileManager::GetTracer()
+{
+    return tracer_;
+}
+
+sgns::ContentCache& FileManager::GetCache()
+{
+    return cache_;
+}
+
+void FileManager::Evict(const std::string& url)
+{
+    cache_.Erase(url);
+    diskCache_.Erase(url);
+}
+
+void FileManager::SetMappedLoads(uint64_t minSize)
+{
+    mappedLoadSize_ = minSize;
+}
+
+uint64_t FileManager::GetMappedLoadSize() const
+{
+    return mappedLoadSize_;
+}
+
+void FileManager::SetDirectIO(uint64_t minSize)
+{
+    directIOSize_ = minSize;
+}
+
+uint64_t FileManager::GetDirectIOSize() const
+{
+    return directIOSize_;
+}
+
+void FileManager::SetDirectoryLoadConcurrency(size_t maxOpenFiles)
+{
+    directoryLoadFiles_ = std::max<size_t>(maxOpenFiles, 1);
+}
+
+size_t FileManager::GetDirectoryLoadConcurrency() const
+{
+    return directoryLoadFiles_;
+}
+
+void FileManager::SetMaxOutstandingBlocks(size_t maxOutstanding)
+{
+    maxOutstandingBlocks_ = maxOutstanding;
+}
+
+size_t FileManager::GetMaxOutstandingBlocks() const
+{
+    return maxOutstandingBlocks_;
+}
+
+bool FileManager::SetDiskCache(const std::string& directory, size_t byteCap, std::chrono::seconds maxAge)
+{
+    diskCacheMaxAge_ = maxAge.count();
+    return diskCache_.Open(directory, byteCap);
+}
+
 /// @brief Function to increment operation count
 void FileManager::IncrementOutstandingOperations() 
 {
     // Increment the counter
-    outstandingOperations_++;
+    outstandingOperations_.fetch_add(1);
 }
 
 std::shared_ptr<int> FileManager::GetOutstandingOperationsPointer() 
 {
     // Return a shared pointer to the outstandingOperations counter
-    return std::make_shared<int>(outstandingOperations_);
-}
\ No newline at end of file
+    return std::make_shared<int>(outstandingOperations_.load());
+}
+
+void FileManager::RunIOContext(std::shared_ptr<boost::asio::io_context> ioc, size_t threadCount)
+{
+    if (threadCount == 0)
+    {
+        threadCount = std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+    // The calling thread is one of the workers
+    std::vector<std::thread> threads;
+    threads.reserve(threadCount - 1);
+    for (size_t i = 1; i < threadCount; ++i)
+    {
+        threads.emplace_back([ioc]() { ioc->run(); });
+    }
+    ioc->run();
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+}
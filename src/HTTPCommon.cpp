@@ -1,17 +1,28 @@
 /**
  * Source file for the HTTPCommon
  */
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
 #include "HTTPCommon.hpp"
+#include "FileManager.hpp"
 
 namespace sgns
 {
     using namespace boost::asio;
+    namespace
+    {
+        const size_t kHTTPChunkSize = 256 * 1024;
+    }
+
     HTTPDevice::HTTPDevice(
         std::string http_host,
         std::string http_path,
         std::string http_port,
-        bool parse, bool save) 
+        bool parse, bool save,
+        std::shared_ptr<LoadRequest> request)
     {
+        request_ = std::move(request);
         http_host_ = http_host;
         http_path_ = http_path;
         http_port_ = http_port;
@@ -20,18 +31,45 @@ namespace sgns
     }
 
     void HTTPDevice::StartHTTPDownload(std::shared_ptr<boost::asio::io_context> ioc, CompletionCallback handle_read, StatusCallback status)
+    {
+        //Wait for a connection slot before touching the network
+        Report(LoadPhase::Queued);
+        auto waiting = FileManager::GetInstance().GetGovernor().AcquireConnection("https", http_host_, ioc, [self = shared_from_this(), ioc, handle_read, status](std::shared_ptr<ConnectionLease> lease) {
+            self->lease_ = std::move(lease);
+            if (self->request_ && self->request_->IsCancelled()) {
+                handle_read(ioc, std::shared_ptr<const sgns::LoadResult>(), false, false);
+                return;
+            }
+            self->StartHTTPConnect(ioc, handle_read, status);
+            });
+        if (waiting != 0 && request_) {
+            //Leave the queue on cancel, so the slot goes to a load that still wants it
+            request_->OnCancel([ioc, handle_read, waiting]() {
+                if (FileManager::GetInstance().GetGovernor().WithdrawWaiting(waiting)) {
+                    boost::asio::post(*ioc, [ioc, handle_read]() {
+                        handle_read(ioc, std::shared_ptr<const sgns::LoadResult>(), false, false);
+                        });
+                }
+                });
+        }
+    }
+
+    void HTTPDevice::StartHTTPConnect(std::shared_ptr<boost::asio::io_context> ioc, CompletionCallback handle_read, StatusCallback status)
     {
         //Get DNS result for hostname
 
         boost::asio::ip::tcp::resolver resolver(*ioc);
         boost::asio::ip::tcp::endpoint endpoint;
+        phaseStart_ = std::chrono::steady_clock::now();
+        Report(LoadPhase::Resolve);
         try {
-            std::cout << "resolving address" << std::endl;
             boost::asio::ip::tcp::resolver::results_type results = resolver.resolve(http_host_, "https");
             endpoint = *results.begin();
+            FileManager::GetInstance().GetMetrics().EndPhase("https", LoadPhase::Resolve, phaseStart_);
         }
         catch (const boost::system::system_error& e) {
             std::cerr << "Error resolving address: " << e.what() << std::endl;
+            Report(LoadPhase::Resolve, 0, 0, e.code());
             status(CustomResult(sgns::AsyncError::outcome::failure("HTTP Could not resolve address")));
         }
         catch (const std::exception& e) {
@@ -61,30 +99,45 @@ namespace sgns
             throw std::runtime_error("Failed to set SNI: " + std::string(ERR_reason_error_string(err)));
             status(CustomResult(sgns::AsyncError::outcome::failure("Could not set SNI")));
         }
+        //Closing the socket fails whatever operation is pending, which ends the chain below
+        if (request_) {
+            request_->OnCancel([ioc, weakSocket = std::weak_ptr<boost::asio::ssl::stream<boost::asio::ip::tcp::socket>>(socket)]() {
+                boost::asio::post(*ioc, [weakSocket]() {
+                    if (auto socket = weakSocket.lock()) {
+                        boost::system::error_code ec;
+                        socket->lowest_layer().close(ec);
+                    }
+                    });
+                });
+        }
         
         //Connect socket
-        status(CustomResult(sgns::AsyncError::outcome::success(Success{ "Starting HTTP Connection" })));
+        Report(LoadPhase::Connect);
         socket->lowest_layer().async_connect(endpoint, [self = shared_from_this(), ioc, socket, handle_read, status](const boost::system::error_code& connect_error)
             {
                 if (!connect_error)
                 {
-                    status(CustomResult(sgns::AsyncError::outcome::success(Success{ "SSL Handshake Started" })));
+                    FileManager::GetInstance().GetMetrics().EndPhase("https", LoadPhase::Connect, self->phaseStart_);
+                    self->Report(LoadPhase::Handshake);
                     socket->async_handshake(boost::asio::ssl::stream_base::client, [self , ioc, socket, handle_read, status](const boost::system::error_code& handshake_error) {
                         if (!handshake_error) {
+                            FileManager::GetInstance().GetMetrics().EndPhase("https", LoadPhase::Handshake, self->phaseStart_);
                             // Start the asynchronous download for a specific path
                             self->StartHTTPGet(ioc, socket, handle_read, status);
                         }
                         else {
                             std::cerr << "Handshake error: " << handshake_error.message() << std::endl;
+                            self->Report(LoadPhase::Handshake, 0, 0, handshake_error);
                             status(CustomResult(sgns::AsyncError::outcome::failure("HTTP Handshake Error")));
-                            handle_read(ioc, std::shared_ptr<std::pair<std::vector<std::string>, std::vector<std::vector<char>>>>(), false, false);
+                            handle_read(ioc, std::shared_ptr<const sgns::LoadResult>(), false, false);
                         }
                         });
                 }
                 else {
                     std::cerr << "Connection error: " << connect_error.message() << std::endl;
+                    self->Report(LoadPhase::Connect, 0, 0, connect_error);
                     status(CustomResult(sgns::AsyncError::outcome::failure("HTTP Connection Error")));
-                    handle_read(ioc, std::shared_ptr<std::pair<std::vector<std::string>, std::vector<std::vector<char>>>>(), false, false);
+                    handle_read(ioc, std::shared_ptr<const sgns::LoadResult>(), false, false);
                 }
             });
     }
@@ -95,52 +148,280 @@ namespace sgns
         StatusCallback status)
     {
         //Create HTTP Get request and write to server
-        status(CustomResult(sgns::AsyncError::outcome::success(Success{ "Starting HTTP Get Request" })));
-        std::string get_request = "GET " + http_path_ + " HTTP/1.1\r\nHost: " + http_host_ + "\r\nConnection: close\r\n\r\n";
-        boost::asio::async_write(*socket, boost::asio::buffer(get_request), [self = shared_from_this(), ioc, handle_read, status, socket](const boost::system::error_code& write_error, std::size_t) {
+        Report(LoadPhase::FirstByte);
+        std::string get_request = "GET " + http_path_ + " HTTP/1.1\r\nHost: " + http_host_ + "\r\nConnection: close\r\n";
+        //Revalidate a cached copy instead of downloading it again
+        auto cachedValidator = request_ ? request_->GetCachedValidator() : std::string();
+        if (cachedValidator.rfind("etag:", 0) == 0) {
+            get_request += "If-None-Match: " + cachedValidator.substr(5) + "\r\n";
+        }
+        else if (cachedValidator.rfind("lm:", 0) == 0) {
+            get_request += "If-Modified-Since: " + cachedValidator.substr(3) + "\r\n";
+        }
+        get_request += "\r\n";
+        //The request string has to outlive the write
+        auto request_buffer = std::make_shared<std::string>(std::move(get_request));
+        boost::asio::async_write(*socket, boost::asio::buffer(*request_buffer), [self = shared_from_this(), ioc, handle_read, status, socket, request_buffer](const boost::system::error_code& write_error, std::size_t) {
             if (!write_error) {
+                if (self->request_ && self->request_->IsStreaming()) {
+                    self->StartHTTPStream(ioc, socket, handle_read, status);
+                    return;
+                }
                 //Create a buffer for returned data and read from server
                 auto headerbuff = std::make_shared<boost::asio::streambuf>();
-                status(CustomResult(sgns::AsyncError::outcome::success(Success{ "Starting HTTP File Read" })));
-                boost::asio::async_read(*socket, *headerbuff, boost::asio::transfer_all(), [self, ioc, handle_read, status, headerbuff, socket](const boost::system::error_code& read_error, std::size_t bytes_transferred) {
-                    //Make a vector buffer from data
-                    auto buffer = std::make_shared<std::vector<char>>(boost::asio::buffers_begin(headerbuff->data()), boost::asio::buffers_end(headerbuff->data()));
-
-                    //Copy to a string
-                    std::string bufferStr(buffer->begin(), buffer->end());
-
-                    //Find end of header 
-                    size_t headerEnd = bufferStr.find("\r\n\r\n");
-
-                    //Check if we found an end
-                    if (headerEnd != std::string::npos) {
-                        //Create vector of binary data by cutting off the header.
-                        //auto binaryData = std::make_shared<std::vector<char>>(buffer->begin() + headerEnd + 4, buffer->end());
-
-                        //Send this to handler to be processed.
-                        //std::cout << "HTTPS Finish" << std::endl;
-                        status(CustomResult(sgns::AsyncError::outcome::success(Success{ "HTTP Get finished" })));
-                        auto finaldata = std::make_shared<std::pair<std::vector<std::string>, std::vector<std::vector<char>>>>();
-                        std::filesystem::path p(self->http_path_);
-                        finaldata->first.push_back(p.filename().string());
-                        //finaldata->second.push_back(*binaryData);
-                        finaldata->second.emplace_back(
-                            buffer->begin() + headerEnd + 4,  
-                            buffer->end()                     
-                        );
-                        handle_read(ioc, finaldata, self->parse_, self->save_);
-                    }
-                    else {
-                        status(CustomResult(sgns::AsyncError::outcome::failure("HTTP Data Read failed. No header.")));
-                        handle_read(ioc, std::shared_ptr<std::pair<std::vector<std::string>, std::vector<std::vector<char>>>>(), false, false);
-                    }
-                    });
+                self->ReadHTTPBody(ioc, socket, headerbuff, handle_read, status);
             }
             else {
                 std::cerr << "Error in async_write: " << write_error.message() << std::endl;
                 status(CustomResult(sgns::AsyncError::outcome::failure("HTTP Data Read failed. Get Request Fail.")));
-                handle_read(ioc, std::shared_ptr<std::pair<std::vector<std::string>, std::vector<std::vector<char>>>>(), false, false);
+                handle_read(ioc, std::shared_ptr<const sgns::LoadResult>(), false, false);
+            }
+            });
+    }
+
+    void HTTPDevice::ReadHTTPBody(std::shared_ptr<boost::asio::io_context> ioc,
+        std::shared_ptr<boost::asio::ssl::stream<boost::asio::ip::tcp::socket>> socket,
+        std::shared_ptr<boost::asio::streambuf> headerbuff,
+        CompletionCallback handle_read,
+        StatusCallback status)
+    {
+        socket->async_read_some(headerbuff->prepare(kHTTPChunkSize), [self = shared_from_this(), ioc, socket, headerbuff, handle_read, status](const boost::system::error_code& read_error, std::size_t bytes_transferred) {
+            headerbuff->commit(bytes_transferred);
+            if (bytes_transferred > 0 && !self->firstByte_) {
+                self->firstByte_ = true;
+                FileManager::GetInstance().GetMetrics().EndPhase("https", LoadPhase::FirstByte, self->phaseStart_);
+            }
+            if (self->request_ && self->request_->IsCancelled()) {
+                //Closed under us, what we have is only part of the response
+                status(CustomResult(sgns::AsyncError::outcome::failure("HTTP Load cancelled")));
+                handle_read(ioc, std::shared_ptr<const sgns::LoadResult>(), false, false);
+                return;
+            }
+            //Connection: close, the whole response is in once the server closes. Servers that skip the TLS
+            //close_notify end with stream_truncated, the Content-Length check catches a body cut short.
+            if (read_error == boost::asio::error::eof || read_error == boost::asio::ssl::error::stream_truncated) {
+                self->FinishHTTPRead(ioc, headerbuff, handle_read, status);
+                return;
+            }
+            if (read_error) {
+                std::cerr << "Error in async_read_some: " << read_error.message() << std::endl;
+                status(CustomResult(sgns::AsyncError::outcome::failure("HTTP Data Read failed.")));
+                handle_read(ioc, std::shared_ptr<const sgns::LoadResult>(), false, false);
+                return;
+            }
+            self->Report(LoadPhase::Transfer, headerbuff->size());
+            FileManager::GetInstance().GetGovernor().Throttle("https", self->http_host_, bytes_transferred, ioc, [self, ioc, socket, headerbuff, handle_read, status]() {
+                self->ReadHTTPBody(ioc, socket, headerbuff, handle_read, status);
+                });
+            });
+    }
+
+    void HTTPDevice::FinishHTTPRead(std::shared_ptr<boost::asio::io_context> ioc,
+        std::shared_ptr<boost::asio::streambuf> headerbuff,
+        CompletionCallback handle_read,
+        StatusCallback status)
+    {
+        FileManager::GetInstance().GetMetrics().EndPhase("https", LoadPhase::Transfer, phaseStart_);
+        //Search the streambuf in place for the end of header
+        const char* begin = static_cast<const char*>(headerbuff->data().data());
+        const char* end = begin + headerbuff->size();
+        const char headerDelim[] = "\r\n\r\n";
+        const char* headerPos = std::search(begin, end, headerDelim, headerDelim + 4);
+
+        //Check if we found an end
+        if (headerPos != end) {
+            size_t headerEnd = headerPos - begin;
+            std::string validator;
+            int statusCode = ParseResponseHeader(std::string(begin, headerPos), validator, contentLength_);
+            if (statusCode == 304 && request_) {
+                //Cached copy is still current, nothing was sent
+                request_->SetNotModified();
+                handle_read(ioc, std::shared_ptr<const sgns::LoadResult>(), parse_, save_);
+                return;
+            }
+            if (statusCode < 200 || statusCode > 299) {
+                //Error pages, redirects and the like are not the file
+                FailHTTPResponse(statusCode, ioc, handle_read, status);
+                return;
+            }
+            size_t bodyLength = headerbuff->size() - headerEnd - 4;
+            if (!IsWholeBody(bodyLength)) {
+                std::cerr << "HTTP body ended after " << bodyLength << " of " << *contentLength_ << " bytes" << std::endl;
+                status(CustomResult(sgns::AsyncError::outcome::failure("HTTP Data Read failed. Body length does not match Content-Length.")));
+                handle_read(ioc, std::shared_ptr<const sgns::LoadResult>(), false, false);
+                return;
+            }
+            if (statusCode == 200 && request_) {
+                request_->SetValidator(validator);
+            }
+            //Create vector of binary data by cutting off the header.
+            //auto binaryData = std::make_shared<std::vector<char>>(buffer->begin() + headerEnd + 4, buffer->end());
+
+            //Send this to handler to be processed.
+            //std::cout << "HTTPS Finish" << std::endl;
+            auto finaldata = std::make_shared<LoadResult>();
+            std::filesystem::path p(http_path_);
+            //Slice the body out of the streambuf, no copy
+            finaldata->Add(p.filename().string(), BufferSlice::FromStreambuf(headerbuff, headerEnd + 4, bodyLength));
+            handle_read(ioc, finaldata, parse_, save_);
+        }
+        else {
+            status(CustomResult(sgns::AsyncError::outcome::failure("HTTP Data Read failed. No header.")));
+            handle_read(ioc, std::shared_ptr<const sgns::LoadResult>(), false, false);
+        }
+    }
+
+    void HTTPDevice::StartHTTPStream(std::shared_ptr<boost::asio::io_context> ioc,
+        std::shared_ptr<boost::asio::ssl::stream<boost::asio::ip::tcp::socket>> socket,
+        CompletionCallback handle_read,
+        StatusCallback status)
+    {
+        auto headerbuff = std::make_shared<boost::asio::streambuf>();
+        boost::asio::async_read_until(*socket, *headerbuff, "\r\n\r\n", [self = shared_from_this(), ioc, socket, handle_read, status, headerbuff](const boost::system::error_code& read_error, std::size_t headerLength) {
+            if (read_error) {
+                status(CustomResult(sgns::AsyncError::outcome::failure("HTTP Data Read failed. No header.")));
+                handle_read(ioc, std::shared_ptr<const sgns::LoadResult>(), false, false);
+                return;
+            }
+            FileManager::GetInstance().GetMetrics().EndPhase("https", LoadPhase::FirstByte, self->phaseStart_);
+            const char* begin = static_cast<const char*>(headerbuff->data().data());
+            std::string validator;
+            int statusCode = ParseResponseHeader(std::string(begin, headerLength - 4), validator, self->contentLength_);
+            if (statusCode == 304) {
+                //Cached copy is still current, nothing was sent
+                self->request_->SetNotModified();
+                handle_read(ioc, std::shared_ptr<const sgns::LoadResult>(), self->parse_, self->save_);
+                return;
+            }
+            if (statusCode < 200 || statusCode > 299) {
+                self->FailHTTPResponse(statusCode, ioc, handle_read, status);
+                return;
+            }
+            if (statusCode == 200) {
+                self->request_->SetValidator(validator);
+            }
+            std::filesystem::path p(self->http_path_);
+            auto name = p.filename().string();
+            auto slices = std::make_shared<std::vector<BufferSlice>>();
+            //Anything read past the header is the start of the body
+            size_t leftover = headerbuff->size() - headerLength;
+            if (leftover == 0) {
+                self->ReadHTTPChunks(ioc, socket, name, slices, 0, handle_read, status);
+                return;
+            }
+            LoadChunk first;
+            first.name = name;
+            first.data = BufferSlice::FromStreambuf(headerbuff, headerLength, leftover);
+            slices->push_back(first.data);
+            self->request_->DeliverChunk(first, [self, ioc, socket, name, slices, leftover, handle_read, status]() {
+                self->ReadHTTPChunks(ioc, socket, name, slices, leftover, handle_read, status);
+                });
+            });
+    }
+
+    void HTTPDevice::ReadHTTPChunks(std::shared_ptr<boost::asio::io_context> ioc,
+        std::shared_ptr<boost::asio::ssl::stream<boost::asio::ip::tcp::socket>> socket,
+        std::string name,
+        std::shared_ptr<std::vector<BufferSlice>> slices,
+        uint64_t offset,
+        CompletionCallback handle_read,
+        StatusCallback status)
+    {
+        auto chunk = std::make_shared<std::vector<char>>(kHTTPChunkSize);
+        socket->async_read_some(boost::asio::buffer(*chunk), [self = shared_from_this(), ioc, socket, name, slices, offset, handle_read, status, chunk](const boost::system::error_code& read_error, std::size_t bytes_transferred) {
+            if (bytes_transferred > 0) {
+                LoadChunk next;
+                next.name = name;
+                next.offset = offset;
+                next.data = BufferSlice(chunk, chunk->data(), bytes_transferred);
+                slices->push_back(next.data);
+                self->Report(LoadPhase::Transfer, offset + bytes_transferred);
+                self->request_->DeliverChunk(next, [self, ioc, socket, name, slices, offset, bytes_transferred, handle_read, status]() {
+                    FileManager::GetInstance().GetGovernor().Throttle("https", self->http_host_, bytes_transferred, ioc, [self, ioc, socket, name, slices, offset, bytes_transferred, handle_read, status]() {
+                        self->ReadHTTPChunks(ioc, socket, name, slices, offset + bytes_transferred, handle_read, status);
+                        });
+                    });
+                return;
+            }
+            //Connection: close, so the body ends when the server closes, unless it closed short of the Content-Length
+            bool closed = read_error == boost::asio::error::eof || read_error == boost::asio::ssl::error::stream_truncated;
+            if (closed && !self->IsWholeBody(offset)) {
+                std::cerr << "HTTP body ended after " << offset << " of " << *self->contentLength_ << " bytes" << std::endl;
+                status(CustomResult(sgns::AsyncError::outcome::failure("HTTP Data Read failed. Body length does not match Content-Length.")));
+                handle_read(ioc, std::shared_ptr<const sgns::LoadResult>(), false, false);
+            }
+            else if (closed) {
+                FileManager::GetInstance().GetMetrics().EndPhase("https", LoadPhase::Transfer, self->phaseStart_);
+                LoadChunk last;
+                last.name = name;
+                last.offset = offset;
+                last.last = true;
+                self->request_->DeliverChunk(last, [self, ioc, name, slices, handle_read]() {
+                    auto finaldata = std::make_shared<LoadResult>();
+                    finaldata->Add(name, std::move(*slices));
+                    handle_read(ioc, finaldata, self->parse_, self->save_);
+                    });
+            }
+            else {
+                std::cerr << "Error in async_read_some: " << read_error.message() << std::endl;
+                status(CustomResult(sgns::AsyncError::outcome::failure("HTTP Data Read failed.")));
+                handle_read(ioc, std::shared_ptr<const sgns::LoadResult>(), false, false);
             }
             });
     }
+
+    void HTTPDevice::FailHTTPResponse(int statusCode,
+        std::shared_ptr<boost::asio::io_context> ioc,
+        CompletionCallback handle_read,
+        StatusCallback status)
+    {
+        auto error = statusCode == 0 ? boost::system::errc::make_error_code(boost::system::errc::bad_message) : MakeHTTPStatusError(statusCode);
+        Report(LoadPhase::FirstByte, 0, 0, error);
+        status(CustomResult(sgns::AsyncError::outcome::failure("HTTP Get failed: " + error.message())));
+        handle_read(ioc, std::shared_ptr<const sgns::LoadResult>(), false, false);
+    }
+
+    int HTTPDevice::ParseResponseHeader(const std::string& header, std::string& validator, std::optional<uint64_t>& contentLength)
+    {
+        validator.clear();
+        contentLength.reset();
+        std::string lastModified;
+        std::istringstream lines(header);
+        std::string line;
+        //Status line, i.e. "HTTP/1.1 200 OK"
+        int statusCode = 0;
+        if (std::getline(lines, line)) {
+            auto space = line.find(' ');
+            if (space != std::string::npos) {
+                statusCode = std::atoi(line.c_str() + space + 1);
+            }
+        }
+        while (std::getline(lines, line)) {
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            auto colon = line.find(':');
+            if (colon == std::string::npos) {
+                continue;
+            }
+            std::string name = line.substr(0, colon);
+            std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::tolower(c); });
+            auto valueStart = line.find_first_not_of(' ', colon + 1);
+            std::string value = valueStart == std::string::npos ? std::string() : line.substr(valueStart);
+            if (name == "etag") {
+                validator = "etag:" + value;
+            }
+            else if (name == "last-modified") {
+                lastModified = value;
+            }
+            else if (name == "content-length" && !value.empty() && std::all_of(value.begin(), value.end(), [](unsigned char c) { return std::isdigit(c); })) {
+                contentLength = std::strtoull(value.c_str(), nullptr, 10);
+            }
+        }
+        //ETag is the stronger validator, use it when both are sent
+        if (validator.empty() && !lastModified.empty()) {
+            validator = "lm:" + lastModified;
+        }
+        return statusCode;
+    }
 }
\ No newline at end of file
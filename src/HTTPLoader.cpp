@@ -27,7 +27,7 @@ namespace sgns
     }
 
 
-    std::shared_ptr<void> HTTPLoader::LoadASync(std::string filename, bool parse, bool save, std::shared_ptr<boost::asio::io_context> ioc, CompletionCallback handle_read, StatusCallback status)
+    std::shared_ptr<void> HTTPLoader::LoadASync(std::string filename, bool parse, bool save, std::shared_ptr<boost::asio::io_context> ioc, CompletionCallback handle_read, StatusCallback status, std::shared_ptr<sgns::LoadRequest> request)
     {
         //Parse hostname and path
         std::string http_host;
@@ -35,7 +35,7 @@ namespace sgns
         std::string http_port;
         parseHTTPUrl(filename, http_host, http_path, http_port);
 
-        auto httpDevice = std::make_shared<HTTPDevice>(http_host, http_path, http_port, parse, save);
+        auto httpDevice = std::make_shared<HTTPDevice>(http_host, http_path, http_port, parse, save, request);
         httpDevice->StartHTTPDownload(ioc, handle_read, status);
         std::shared_ptr<string> result = std::make_shared < string>("test");
         return result;
@@ -1,5 +1,6 @@
 //IPFSCommon.cpp
 #include "IPFSCommon.hpp"
+#include "FileManager.hpp"
 
 
 namespace sgns
@@ -31,7 +32,7 @@ namespace sgns
         return instance_;
     }
 
-    IPFSDevice::IPFSDevice(std::shared_ptr<boost::asio::io_context> ioc) : dhtretry_(*ioc)
+    IPFSDevice::IPFSDevice(std::shared_ptr<boost::asio::io_context> ioc)
     {
         //Make Kademlia Injector
         libp2p::protocol::kademlia::Config kademlia_config;
@@ -67,17 +68,22 @@ namespace sgns
         bool parse,
         bool save,
         CompletionCallback handle_read,
-        StatusCallback status
+        StatusCallback status,
+        std::shared_ptr<LoadRequest> request,
+        size_t attempt
     )
     {
-        status(CustomResult(sgns::AsyncError::outcome::success(Success{ "Starting Bitswap DHT" })));
+        if (request)
+        {
+            request->Report(LoadPhase::Resolve);
+        }
         auto peer_id =
             libp2p::peer::PeerId::fromHash(cid.content_address).value();
         dht_->FindProviders(cid, [=](libp2p::outcome::result<std::vector<libp2p::peer::PeerInfo>> res) {
-            status(CustomResult(sgns::AsyncError::outcome::success(Success{ "Got Provider Results" })));
             if (!res) {
                 std::cerr << "Cannot find providers: " << res.error().message() << std::endl;
                 status(CustomResult(sgns::AsyncError::outcome::failure("DHT Failed, no address")));
+                StartFindingPeersWithRetry(ioc, cid, filename, addressoffset, parse, save, handle_read, status, request, attempt);
                 return false;
             }
             std::cout << "Providers: " << std::endl;
@@ -100,13 +106,13 @@ namespace sgns
                     //}
                 //}
                 
-                return RequestBlockMain(ioc, cid, filename, 0, parse, save, handle_read, status);
+                return RequestBlockMain(ioc, cid, filename, 0, parse, save, handle_read, status, request);
             }
             else
             {
                 std::cout << "Empty providers list received" << std::endl;
                 status(CustomResult(sgns::AsyncError::outcome::failure("DHT Failed, no providers.")));
-                StartFindingPeersWithRetry(ioc, cid, filename, addressoffset, parse, save, handle_read, status);
+                StartFindingPeersWithRetry(ioc, cid, filename, addressoffset, parse, save, handle_read, status, request, attempt);
                 return false;
             }
             });
@@ -122,15 +128,28 @@ namespace sgns
         bool parse,
         bool save,
         CompletionCallback handle_read,
-        StatusCallback status)
+        StatusCallback status,
+        std::shared_ptr<LoadRequest> request,
+        size_t attempt)
     {
-        boost::asio::deadline_timer dhtretry(*ioc.get());
-        boost::posix_time::time_duration timeout(boost::posix_time::milliseconds(10000));
-        dhtretry_.expires_from_now(timeout);
-        dhtretry_.async_wait([ioc, cid, filename, addressoffset, parse, save, handle_read, status, this](const boost::system::error_code& ec) {
+        if (request && request->IsCancelled())
+        {
+            return;
+        }
+        //Lookups are bounded by their own attempt count, they don't draw from the transfer retry budget
+        auto& retryPolicy = FileManager::GetInstance().GetRetryPolicy();
+        if (attempt + 1 >= retryPolicy.GetOptions("ipfs-dht").maxAttempts)
+        {
+            status(CustomResult(sgns::AsyncError::outcome::failure("DHT Failed, gave up looking for providers")));
+            handle_read(ioc, std::shared_ptr<const sgns::LoadResult>(), false, false);
+            return;
+        }
+        //Each lookup gets its own timer, so concurrent loads don't reset each other's retries
+        auto dhtretry = std::make_shared<boost::asio::steady_timer>(*ioc, retryPolicy.Backoff("ipfs-dht", attempt));
+        dhtretry->async_wait([ioc, cid, filename, addressoffset, parse, save, handle_read, status, request, attempt, dhtretry, this](const boost::system::error_code& ec) {
             if (!ec) {
                 // Timer expired, call StartFindingPeers again with captured parameters
-                this->StartFindingPeers(ioc, cid, filename, addressoffset, parse, save, handle_read, status);
+                this->StartFindingPeers(ioc, cid, filename, addressoffset, parse, save, handle_read, status, request, attempt + 1);
             }
             else {
                 // Handle error
@@ -147,13 +166,18 @@ namespace sgns
         bool parse,
         bool save,
         CompletionCallback handle_read,
-        StatusCallback status)
+        StatusCallback status,
+        std::shared_ptr<LoadRequest> request)
     {
         //std::cout << "request main block" << filename << std::endl;
-        status(CustomResult(sgns::AsyncError::outcome::success(Success{ "Reading IPFS Blocks" })));
-        if (addressoffset < peerAddresses_->size())
+        if (request)
         {
-            bitswap_->RequestBlock(peerAddresses_->at(addressoffset), cid,
+            request->Report(LoadPhase::Transfer);
+        }
+        auto peer = getPeerAddress(addressoffset);
+        if (peer)
+        {
+            sendBlockRequest(request, *peer, cid,
                 [=](libp2p::outcome::result<std::string> data)
                 {
                     if (data)
@@ -173,13 +197,14 @@ namespace sgns
                         {
                             //Handle Error
                             status(CustomResult(sgns::AsyncError::outcome::failure("Bitswap failed, could not decode")));
-                            handle_read(ioc, std::shared_ptr<std::pair<std::vector<std::string>, std::vector<std::vector<char>>>>(), false, false);
+                            handle_read(ioc, std::shared_ptr<const sgns::LoadResult>(), false, false);
                             return false;
                         }
                         //std::cout << "ContentTest" << decoder.getContent() << std::endl;
-                        status(CustomResult(sgns::AsyncError::outcome::success(Success{ "Reading IPFS Sub-Blocks" })));
                         //Start Adding to list
                         CIDInfo cidInfo(maincid.value());
+                        //Sub requests are only sent once the CIDInfo is in the list, otherwise a fast reply could arrive before it exists
+                        std::vector<std::pair<sgns::ipfs_bitswap::CID, std::string>> subRequests;
                         for (size_t i = 0; i < decoder.getLinksCount(); ++i) {
                             auto subcid = libp2p::multi::ContentIdentifierCodec::decode(gsl::span((uint8_t*)decoder.getLinkCID(i).data(), decoder.getLinkCID(i).size()));
                             auto scid = libp2p::multi::ContentIdentifierCodec::fromString(libp2p::multi::ContentIdentifierCodec::toString(subcid.value()).value()).value();
@@ -200,45 +225,57 @@ namespace sgns
                             }
                             //Increment Outstanding
                             cidInfo.outstandingRequests_++;
-                            //Request Additional CID
-                            RequestBlockSub(ioc, cid, cid, scid, passfilename, 0, parse, save, handle_read, status);
+                            subRequests.emplace_back(scid, passfilename);
                         }
 
                         //Add to list in IPFSDevice
-                        addCID(cidInfo);
+                        size_t mainindex = addCID(cidInfo);
+
+                        //Request Additional CIDs
+                        for (auto& subRequest : subRequests)
+                        {
+                            RequestBlockSub(ioc, cid, cid, subRequest.first, subRequest.second, 0, parse, save, handle_read, status, request);
+                        }
 
                         //If there are no links, this was a single file with 1 block containing all the data, so we can write it out
                         if (decoder.getLinksCount() <= 0)
                         {
                             //Get data, ignoring bytes at beginning or end TODO: need a better way to do this, some contexts the offset is not 6/4.
                             //auto bindata = std::make_shared<std::vector<char>>(decoder.getContent().begin() + 4, decoder.getContent().end() - 2);
-                            ::unixfs_pb::Data unixfs;
+                            //The slice points straight into the parsed protobuf, which it keeps alive
+                            auto unixfs = std::make_shared<::unixfs_pb::Data>();
                             //unixfs.set_data(decoder.getContent());
-                            unixfs.ParseFromString(decoder.getContent());
-                            auto bindata = std::vector<char>(unixfs.data().begin(), unixfs.data().end());
-                            std::cout << "REQCIDS: " << requestedCIDs_.size() << std::endl;
+                            unixfs->ParseFromString(decoder.getContent());
+                            BufferSlice bindata(unixfs, unixfs->data().data(), unixfs->data().size());
                             std::string passfilename = filename;
-                            size_t mainindex = findRequestedCIDIndex(cid);
-                            requestedCIDs_[mainindex].finalcontents->first.push_back(passfilename);
-                            requestedCIDs_[mainindex].finalcontents->second.push_back(bindata);
-                            //bool allset = CheckIfAllSet(cid);
-                            if (requestedCIDs_[mainindex].outstandingRequests_ <= 0)
+                            std::shared_ptr<const sgns::LoadResult> finalcontents;
+                            {
+                                std::lock_guard<std::mutex> lock(requestMutex_);
+                                std::cout << "REQCIDS: " << requestedCIDs_.size() << std::endl;
+                                requestedCIDs_[mainindex].finalcontents->Add(passfilename, std::move(bindata));
+                                //bool allset = CheckIfAllSet(cid);
+                                if (requestedCIDs_[mainindex].outstandingRequests_ <= 0)
+                                {
+                                    requestedCIDs_[mainindex].groupLinkedCIDs();
+                                    finalcontents = requestedCIDs_[mainindex].finalcontents;
+                                }
+                            }
+                            if (finalcontents)
                             {
-                                requestedCIDs_[mainindex].groupLinkedCIDs();
-                                handle_read(ioc, requestedCIDs_[mainindex].finalcontents, parse, save);
+                                handle_read(ioc, finalcontents, parse, save);
                             }
                         }
                         return true;
                     }
                     else
                     {
-                        return RequestBlockMain(ioc, cid, filename, addressoffset + 1, parse, save, handle_read, status);
+                        return RequestBlockMain(ioc, cid, filename, addressoffset + 1, parse, save, handle_read, status, request);
                     }
                 });
         }
         else {
             status(CustomResult(sgns::AsyncError::outcome::failure("Bitswap failed, ran out of addresses to get from")));
-            handle_read(ioc, std::shared_ptr<std::pair<std::vector<std::string>, std::vector<std::vector<char>>>>(), false, false);
+            handle_read(ioc, std::shared_ptr<const sgns::LoadResult>(), false, false);
             return false;
         }
         return false;
@@ -254,22 +291,18 @@ namespace sgns
         bool parse,
         bool save,
         CompletionCallback handle_read,
-        StatusCallback status)
+        StatusCallback status,
+        std::shared_ptr<LoadRequest> request)
     {
         //std::cout << "directory: " << directory << std::endl;
-        if (addressoffset < peerAddresses_->size())
+        auto peer = getPeerAddress(addressoffset);
+        if (peer)
         {
-            bitswap_->RequestBlock(peerAddresses_->at(addressoffset), scid,
+            sendBlockRequest(request, *peer, scid,
                 [=](libp2p::outcome::result<std::string> data)
                 {
                     if (data)
                     {
-                        //Get CIDInfo Index
-                        size_t mainindex = findRequestedCIDIndex(cid);
-                        //Decrement 
-                        requestedCIDs_[mainindex].outstandingRequests_--;
-
-
                         auto cidV0 = libp2p::multi::ContentIdentifierCodec::encodeCIDV0(data.value().data(), data.value().size());
                         auto maincid = libp2p::multi::ContentIdentifierCodec::decode(gsl::span((uint8_t*)cidV0.data(), cidV0.size()));
 
@@ -288,50 +321,71 @@ namespace sgns
                         {
                             //Handle Error
                             status(CustomResult(sgns::AsyncError::outcome::failure("Bitswap failed, could not decode data")));
-                            handle_read(ioc, std::shared_ptr<std::pair<std::vector<std::string>, std::vector<std::vector<char>>>>(), false, false);
+                            handle_read(ioc, std::shared_ptr<const sgns::LoadResult>(), false, false);
                             return false;
                         }
-                        for (size_t i = 0; i < decoder.getLinksCount(); ++i) {
-                            auto subcid = libp2p::multi::ContentIdentifierCodec::decode(gsl::span((uint8_t*)decoder.getLinkCID(i).data(), decoder.getLinkCID(i).size()));
-                            auto sscid = libp2p::multi::ContentIdentifierCodec::fromString(libp2p::multi::ContentIdentifierCodec::toString(subcid.value()).value()).value();
-                            std::string newdir = directory + "/" + decoder.getLinkName(i);
-                            if (!decoder.getLinkName(i).empty())
-                            {
-                                requestedCIDs_[mainindex].directories.push_back(newdir);
-                                requestedCIDs_[mainindex].mainCIDs.push_back(subcid.value());
-                            }
-                            else {
-                                newdir = directory;
-                                CIDInfo::LinkedCIDInfo linkedCID(subcid.value(), scid, newdir);
-                                requestedCIDs_[mainindex].linkedCIDs.push_back(linkedCID);
-                            }
-                            requestedCIDs_[mainindex].outstandingRequests_++;
-                            RequestBlockSub(ioc, cid, scid, sscid, newdir, 0, parse, save, handle_read, status);
-                        }
-                        //If there are no links, this block is complete and we can see if we have all blocks for writing
+                        //Get data, ignoring bytes at beginning or end TODO: need a better way to do this, some contexts the offset is not 6/4.
+                        BufferSlice bindata;
                         if (decoder.getLinksCount() <= 0)
                         {
-                            //Get data, ignoring bytes at beginning or end TODO: need a better way to do this, some contexts the offset is not 6/4.
-                            ::unixfs_pb::Data unixfs;
-                            unixfs.ParseFromString(decoder.getContent());
-                            auto bindata = std::vector<char>(unixfs.data().begin(), unixfs.data().end());
-                            //Set Content for linked CID, or otherwise push data to final contents if it has none
-                            bool setsubdata = setContentForLinkedCID(cid, scid, bindata);
-                            if (!setsubdata)
-                            {
-                                requestedCIDs_[mainindex].finalcontents->first.push_back(directory);
-                                requestedCIDs_[mainindex].finalcontents->second.push_back(bindata);
+                            //The slice points straight into the parsed protobuf, which it keeps alive
+                            auto unixfs = std::make_shared<::unixfs_pb::Data>();
+                            unixfs->ParseFromString(decoder.getContent());
+                            bindata = BufferSlice(unixfs, unixfs->data().data(), unixfs->data().size());
+                        }
+                        std::vector<std::pair<sgns::ipfs_bitswap::CID, std::string>> subRequests;
+                        std::shared_ptr<const sgns::LoadResult> finalcontents;
+                        {
+                            std::lock_guard<std::mutex> lock(requestMutex_);
+                            //Get CIDInfo Index
+                            size_t mainindex = findRequestedCIDIndex(cid);
+                            auto& cidInfo = requestedCIDs_[mainindex];
+                            //Decrement 
+                            cidInfo.outstandingRequests_--;
+                            for (size_t i = 0; i < decoder.getLinksCount(); ++i) {
+                                auto subcid = libp2p::multi::ContentIdentifierCodec::decode(gsl::span((uint8_t*)decoder.getLinkCID(i).data(), decoder.getLinkCID(i).size()));
+                                auto sscid = libp2p::multi::ContentIdentifierCodec::fromString(libp2p::multi::ContentIdentifierCodec::toString(subcid.value()).value()).value();
+                                std::string newdir = directory + "/" + decoder.getLinkName(i);
+                                if (!decoder.getLinkName(i).empty())
+                                {
+                                    cidInfo.directories.push_back(newdir);
+                                    cidInfo.mainCIDs.push_back(subcid.value());
+                                }
+                                else {
+                                    newdir = directory;
+                                    CIDInfo::LinkedCIDInfo linkedCID(subcid.value(), scid, newdir);
+                                    cidInfo.linkedCIDs.push_back(linkedCID);
+                                }
+                                cidInfo.outstandingRequests_++;
+                                subRequests.emplace_back(sscid, newdir);
                             }
-                            //bool allset = CheckIfAllSet(cid);
-                            if (requestedCIDs_[mainindex].outstandingRequests_ <= 0)
+                            //If there are no links, this block is complete and we can see if we have all blocks for writing
+                            if (decoder.getLinksCount() <= 0)
                             {
-                                requestedCIDs_[mainindex].groupLinkedCIDs();
-                                //requestedCIDs_[mainindex].writeFinalContentsToDirectories();
-                                //std::cout << "IPFS Finish" << std::endl;
-                                status(CustomResult(sgns::AsyncError::outcome::success(Success{ "Bitswap Completed" })));
-                                handle_read(ioc, requestedCIDs_[mainindex].finalcontents, parse, save);
+                                //Set Content for linked CID, or otherwise push data to final contents if it has none
+                                bool setsubdata = cidInfo.setContentForLinkedCID(scid, bindata);
+                                if (!setsubdata)
+                                {
+                                    cidInfo.finalcontents->Add(directory, std::move(bindata));
+                                }
+                                //bool allset = CheckIfAllSet(cid);
+                                if (cidInfo.outstandingRequests_ <= 0)
+                                {
+                                    cidInfo.groupLinkedCIDs();
+                                    //cidInfo.writeFinalContentsToDirectories();
+                                    finalcontents = cidInfo.finalcontents;
+                                }
                             }
                         }
+                        for (auto& subRequest : subRequests)
+                        {
+                            RequestBlockSub(ioc, cid, scid, subRequest.first, subRequest.second, 0, parse, save, handle_read, status, request);
+                        }
+                        if (finalcontents)
+                        {
+                            //std::cout << "IPFS Finish" << std::endl;
+                            handle_read(ioc, finalcontents, parse, save);
+                        }
 
 
                         return true;
@@ -339,7 +393,7 @@ namespace sgns
                     else
                     {
                         //Request Block on next address
-                        return RequestBlockSub(ioc, cid, parentcid, scid, directory, addressoffset + 1, parse, save, handle_read, status);
+                        return RequestBlockSub(ioc, cid, parentcid, scid, directory, addressoffset + 1, parse, save, handle_read, status, request);
                     }
                 });
         }
@@ -348,8 +402,9 @@ namespace sgns
 
     bool IPFSDevice::setContentForLinkedCID(const sgns::ipfs_bitswap::CID& mainCID,
         const sgns::ipfs_bitswap::CID& linkedCID,
-        const std::vector<char>& content)
+        const BufferSlice& content)
     {
+        std::lock_guard<std::mutex> lock(requestMutex_);
         auto it = std::find_if(requestedCIDs_.begin(), requestedCIDs_.end(),
             [&mainCID](const CIDInfo& info) {
                 return info.mainCID == mainCID;
@@ -365,6 +420,7 @@ namespace sgns
 
     bool IPFSDevice::CheckIfAllSet(const sgns::ipfs_bitswap::CID& mainCID)
     {
+        std::lock_guard<std::mutex> lock(requestMutex_);
         auto it = std::find_if(requestedCIDs_.begin(), requestedCIDs_.end(),
             [&mainCID](const CIDInfo& info) {
                 return info.mainCID == mainCID;
@@ -378,6 +434,7 @@ namespace sgns
 
     std::shared_ptr<std::vector<char>> IPFSDevice::combineLinkedCIDs(const sgns::ipfs_bitswap::CID& mainCID)
     {
+        std::lock_guard<std::mutex> lock(requestMutex_);
         auto it = std::find_if(requestedCIDs_.begin(), requestedCIDs_.end(),
             [&mainCID](const CIDInfo& info) {
                 return info.mainCID == mainCID;
@@ -394,7 +451,7 @@ namespace sgns
     size_t IPFSDevice::addCID(CIDInfo& cidInfo)
     {
         // Acquire lock to safely modify the list
-        std::lock_guard<std::mutex> lock(mutex_);
+        std::lock_guard<std::mutex> lock(requestMutex_);
 
         // Add the CIDInfo to the list
         requestedCIDs_.push_back(std::move(cidInfo));
@@ -412,13 +469,115 @@ namespace sgns
         auto peerInfo = sgns::Peer{
             libp2p::peer::PeerInfo{peerId.value(), std::move(addresses)}
         };
+        std::lock_guard<std::mutex> lock(requestMutex_);
         peerAddresses_->push_back(peerInfo.info);
     }
 
     void IPFSDevice::addAddresses(const std::vector<libp2p::peer::PeerInfo>& addresses) {
+        std::lock_guard<std::mutex> lock(requestMutex_);
         peerAddresses_->insert(peerAddresses_->end(), addresses.begin(), addresses.end());
     }
 
+    void IPFSDevice::withdrawBlocks(const LoadRequest* request)
+    {
+        std::lock_guard<std::mutex> lock(blockMutex_);
+        for (auto& queue : pendingBlocks_)
+        {
+            queue.erase(std::remove_if(queue.begin(), queue.end(), [request](const PendingBlock& block) { return block.request.get() == request; }), queue.end());
+        }
+    }
+
+    void IPFSDevice::sendBlockRequest(std::shared_ptr<LoadRequest> request, const libp2p::peer::PeerInfo& peer, const sgns::ipfs_bitswap::CID& cid, BlockCallback callback)
+    {
+        if (request && request->IsCancelled())
+        {
+            //Nobody wants the load any more, don't put more of it on the wire
+            return;
+        }
+        auto priority = request ? request->GetPriority() : LoadPriority::Normal;
+        PendingBlock block{ peer, cid, std::move(callback), std::move(request), std::chrono::steady_clock::now() };
+        auto maxOutstanding = FileManager::GetInstance().GetMaxOutstandingBlocks();
+        {
+            std::lock_guard<std::mutex> lock(blockMutex_);
+            bool full = maxOutstanding != 0 && outstandingBlocks_ >= maxOutstanding;
+            if (priority != LoadPriority::Interactive && full)
+            {
+                pendingBlocks_[static_cast<size_t>(priority)].push_back(std::move(block));
+                return;
+            }
+            ++outstandingBlocks_;
+        }
+        dispatchBlockRequest(std::move(block));
+    }
+
+    void IPFSDevice::dispatchBlockRequest(PendingBlock block)
+    {
+        auto callback = std::move(block.callback);
+        auto request = std::move(block.request);
+        //Each block gets a span from the want going out to the reply, on the row of the load it belongs to
+        std::string track;
+        std::string cid;
+        auto& tracer = FileManager::GetInstance().GetTracer();
+        auto sentAt = std::chrono::steady_clock::now();
+        if (tracer.IsEnabled())
+        {
+            track = request ? request->GetURL() : "ipfs";
+            auto cidString = libp2p::multi::ContentIdentifierCodec::toString(block.cid);
+            cid = cidString ? cidString.value() : "";
+            if (sentAt - block.queuedAt >= std::chrono::milliseconds(1))
+            {
+                tracer.Span("bitswap queued", "ipfs", track, block.queuedAt, sentAt, { { "cid", cid } });
+            }
+        }
+        bitswap_->RequestBlock(block.peer, block.cid, [this, callback, request, track, cid, sentAt](libp2p::outcome::result<std::string> data) {
+            {
+                std::lock_guard<std::mutex> lock(blockMutex_);
+                --outstandingBlocks_;
+            }
+            if (!track.empty())
+            {
+                FileManager::GetInstance().GetTracer().Span("bitswap block", "ipfs", track, sentAt, std::chrono::steady_clock::now(),
+                    { { "cid", cid }, { "bytes", data ? std::to_string(data.value().size()) : "0" }, { "ok", data ? "true" : "false" } });
+            }
+            //Bitswap can't take a want back once sent, so replies for a cancelled load are dropped here.
+            //Otherwise replies queue more requests for the links they hold, let them in before picking what goes next
+            bool result = false;
+            if (!request || !request->IsCancelled())
+            {
+                result = callback(std::move(data));
+            }
+            std::vector<PendingBlock> next;
+            auto maxOutstanding = FileManager::GetInstance().GetMaxOutstandingBlocks();
+            {
+                std::lock_guard<std::mutex> lock(blockMutex_);
+                for (auto& queue : pendingBlocks_)
+                {
+                    while (!queue.empty() && (maxOutstanding == 0 || outstandingBlocks_ < maxOutstanding))
+                    {
+                        next.push_back(std::move(queue.front()));
+                        queue.pop_front();
+                        ++outstandingBlocks_;
+                    }
+                }
+            }
+            for (auto& block : next)
+            {
+                dispatchBlockRequest(std::move(block));
+            }
+            return result;
+            });
+    }
+
+    std::optional<libp2p::peer::PeerInfo> IPFSDevice::getPeerAddress(size_t addressoffset)
+    {
+        std::lock_guard<std::mutex> lock(requestMutex_);
+        if (addressoffset < peerAddresses_->size())
+        {
+            return peerAddresses_->at(addressoffset);
+        }
+        return std::nullopt;
+    }
+
     std::shared_ptr<sgns::ipfs_bitswap::Bitswap> IPFSDevice::getBitswap() const {
         return bitswap_;
     }
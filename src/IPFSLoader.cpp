@@ -73,7 +73,7 @@ namespace sgns
     # ----------------
       )");
 
-    std::shared_ptr<void> IPFSLoader::LoadASync(std::string filename, bool parse, bool save, std::shared_ptr<boost::asio::io_context> ioc, CompletionCallback handle_read, StatusCallback status)
+    std::shared_ptr<void> IPFSLoader::LoadASync(std::string filename, bool parse, bool save, std::shared_ptr<boost::asio::io_context> ioc, CompletionCallback handle_read, StatusCallback status, std::shared_ptr<sgns::LoadRequest> request)
     {
         auto logging_system = std::make_shared<soralog::LoggingSystem>(
             std::make_shared<soralog::ConfiguratorFromYAML>(
@@ -103,7 +103,7 @@ namespace sgns
             //Error Listening
             status(CustomResult(sgns::AsyncError::outcome::failure("Bitswap failed, cannot listen on address")));
             std::cerr << "Cannot listen address " << ". Error: " << ipfsDeviceResult.error().message() << std::endl;
-            handle_read(ioc, std::shared_ptr<std::pair<std::vector<std::string>, std::vector<std::vector<char>>>>(), false, false);
+            handle_read(ioc, std::shared_ptr<const sgns::LoadResult>(), false, false);
             return result;
         }
         auto ipfsDevice = ipfsDeviceResult.value();
@@ -118,10 +118,15 @@ namespace sgns
         //ipfsDevice->addAddress(libp2p::multi::Multiaddress::create("/dnsaddr/nyc1-3.hostnodes.pinata.cloud/ipfs/QmSarArpxemsPESa6FNkmuu9iSE1QWqPX2R3Aw6f5jq4D5").value());
         //CID of File
         auto cid = libp2p::multi::ContentIdentifierCodec::fromString(ipfs_cid).value();
-        status(CustomResult(sgns::AsyncError::outcome::success(Success{ "Starting IPFS Bitswap" })));
+        if (request)
+        {
+            request->OnCancel([ipfsDevice, owner = request.get()]() {
+                ipfsDevice->withdrawBlocks(owner);
+                });
+        }
         ioc->post([=] {
-            ipfsDevice->RequestBlockMain(ioc, cid, ipfs_file, 0, parse, save, handle_read, status);
-            //ipfsDevice->StartFindingPeers(ioc, cid, ipfs_file, 0, parse, save, handle_read, status);
+            ipfsDevice->RequestBlockMain(ioc, cid, ipfs_file, 0, parse, save, handle_read, status, request);
+            //ipfsDevice->StartFindingPeers(ioc, cid, ipfs_file, 0, parse, save, handle_read, status, request);
             });
         
         return result;
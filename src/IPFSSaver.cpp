@@ -25,9 +25,9 @@ namespace sgns
     inline std::vector<uint8_t> operator""_unhex(const char* c, size_t s) {
         return sgns::common::unhex(std::string_view(c, s)).value();
     }
-    void IPFSSaver::SaveASync(std::shared_ptr<boost::asio::io_context> ioc, std::function<void(std::shared_ptr<boost::asio::io_context> ioc)> handle_write, std::string filename, std::shared_ptr<std::pair<std::vector<std::string>, std::vector<std::vector<char>>>> data, std::string suffix) {
+    void IPFSSaver::SaveASync(std::shared_ptr<boost::asio::io_context> ioc, std::function<void(std::shared_ptr<boost::asio::io_context> ioc)> handle_write, std::string filename, std::shared_ptr<const sgns::LoadResult> data, std::string suffix) {
         std::cout << "Inside the IPFSSaver::SaveASync Function" << std::endl;
-        if (data->first.data() == nullptr)
+        if (data == nullptr)
         {
             throw range_error("Can not save with null data");
         }
@@ -41,9 +41,12 @@ namespace sgns
         //r.value()->setReadOptions(readoptions);
         
         auto datastore = sgns::ipfs_lite::ipfs::RocksdbDatastore(r.value());
-        for (size_t i = 0; i < data->first.size(); ++i) {
-            auto cid = sgns::common::getCidOf(std::vector<uint8_t>(data->second[i].begin(), data->second[i].end()));
-            common::Buffer buffer(std::vector<uint8_t>(data->second[i].begin(), data->second[i].end()));
+        for (const auto& entry : data->entries) {
+            //One contiguous copy for hashing, then moved into the block
+            std::vector<uint8_t> bytes(entry.Size());
+            entry.CopyTo(bytes.data());
+            auto cid = sgns::common::getCidOf(bytes);
+            common::Buffer buffer(std::move(bytes));
             datastore.set(cid.value(), buffer);
 
         }
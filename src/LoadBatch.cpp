@@ -0,0 +1,268 @@
+/**
+ * Source file for the LoadBatch
+ */
+#include "LoadBatch.hpp"
+#include "FileManager.hpp"
+#include "URLStringUtil.h"
+
+namespace sgns
+{
+    LoadBatch::LoadBatch(std::vector<std::string> urls, LoadBatchOptions options, std::shared_ptr<boost::asio::io_context> ioc)
+        : options_(std::move(options)), ioc_(std::move(ioc))
+    {
+        items_.reserve(urls.size());
+        for (auto& url : urls)
+        {
+            Item item;
+            std::string filePath;
+            std::string suffix;
+            getURLComponents(url, item.scheme, filePath, suffix);
+            item.url = std::move(url);
+            auto& queue = queues_[item.scheme];
+            if (queue.empty())
+            {
+                schemeOrder_.push_back(item.scheme);
+            }
+            queue.push_back(items_.size());
+            items_.push_back(std::move(item));
+        }
+    }
+
+    void LoadBatch::SetItemHandlers(ItemHandler onItem, StatusHandler onStatus)
+    {
+        onItem_ = std::move(onItem);
+        onStatus_ = std::move(onStatus);
+    }
+
+    void LoadBatch::SetBatchHandler(BatchHandler onDone)
+    {
+        onDone_ = std::move(onDone);
+    }
+
+    void LoadBatch::Start()
+    {
+        if (items_.empty())
+        {
+            FinishBatch();
+            return;
+        }
+        Pump();
+    }
+
+    size_t LoadBatch::SchemeLimit(const std::string& scheme) const
+    {
+        auto iter = options_.schemeLimits.find(scheme);
+        return iter == options_.schemeLimits.end() ? options_.maxInFlightPerScheme : iter->second;
+    }
+
+    std::vector<size_t> LoadBatch::TakeRunnable()
+    {
+        std::vector<size_t> runnable;
+        if (cancelled_)
+        {
+            return runnable;
+        }
+        //Keep going round the schemes one item at a time until the global limit is hit or no scheme can start anything
+        size_t idleSchemes = 0;
+        while (!schemeOrder_.empty() && idleSchemes < schemeOrder_.size())
+        {
+            if (options_.maxInFlight != 0 && inFlight_ >= options_.maxInFlight)
+            {
+                break;
+            }
+            auto scheme = schemeOrder_.front();
+            schemeOrder_.pop_front();
+            auto& queue = queues_[scheme];
+            auto limit = SchemeLimit(scheme);
+            if (limit != 0 && inFlightPerScheme_[scheme] >= limit)
+            {
+                //Scheme is full, let the others have a turn
+                schemeOrder_.push_back(scheme);
+                ++idleSchemes;
+                continue;
+            }
+            idleSchemes = 0;
+            runnable.push_back(queue.front());
+            queue.pop_front();
+            ++inFlight_;
+            ++inFlightPerScheme_[scheme];
+            if (!queue.empty())
+            {
+                schemeOrder_.push_back(scheme);
+            }
+        }
+        return runnable;
+    }
+
+    void LoadBatch::Pump()
+    {
+        std::vector<size_t> runnable;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            runnable = TakeRunnable();
+        }
+        for (auto index : runnable)
+        {
+            StartItem(index);
+        }
+    }
+
+    void LoadBatch::StartItem(size_t index)
+    {
+        auto self = shared_from_this();
+        auto onStatus = [self, index](const CustomResult& status) {
+            if (self->onStatus_)
+            {
+                self->onStatus_(index, status);
+            }
+        };
+        std::shared_ptr<LoadRequest> request;
+        try
+        {
+            //The item finishes through the request, so the final callback has nothing to do.
+            //Without a status handler the load is spared building status text.
+            request = FileManager::GetInstance().LoadASync(items_[index].url, options_.parse, options_.save, ioc_, onStatus_ ? FileManager::StatusCallback(onStatus) : nullptr,
+                [](std::shared_ptr<const LoadResult>) {}, options_.savetype, nullptr, options_.priority);
+        }
+        catch (const std::exception& e)
+        {
+            onStatus(CustomResult(sgns::AsyncError::outcome::failure(e.what())));
+            FinishItem(index, LoadRequest::State::Failed, nullptr);
+            return;
+        }
+        bool cancelled;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            items_[index].request = request;
+            cancelled = cancelled_;
+        }
+        if (cancelled)
+        {
+            //Batch was cancelled while this was starting
+            request->Cancel();
+        }
+        request->OnComplete([self, index](LoadRequest::State state, LoadRequest::LoadBuffers buffers) {
+            self->FinishItem(index, state, std::move(buffers));
+            });
+    }
+
+    void LoadBatch::FinishItem(size_t index, LoadRequest::State state, LoadRequest::LoadBuffers buffers)
+    {
+        bool batchDone;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto& item = items_[index];
+            item.state = state;
+            item.result = buffers;
+            --inFlight_;
+            --inFlightPerScheme_[item.scheme];
+            ++finished_;
+            batchDone = finished_ == items_.size();
+        }
+        if (onItem_)
+        {
+            onItem_(index, items_[index].url, state, buffers);
+        }
+        if (batchDone)
+        {
+            FinishBatch();
+            return;
+        }
+        //A slot opened up
+        Pump();
+    }
+
+    void LoadBatch::Cancel()
+    {
+        std::vector<size_t> queued;
+        std::vector<std::shared_ptr<LoadRequest>> running;
+        bool batchDone;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (cancelled_)
+            {
+                return;
+            }
+            cancelled_ = true;
+            for (auto& scheme : schemeOrder_)
+            {
+                auto& queue = queues_[scheme];
+                queued.insert(queued.end(), queue.begin(), queue.end());
+                queue.clear();
+            }
+            schemeOrder_.clear();
+            for (auto index : queued)
+            {
+                items_[index].state = LoadRequest::State::Cancelled;
+                ++finished_;
+            }
+            for (auto& item : items_)
+            {
+                if (item.request && item.state == LoadRequest::State::Pending)
+                {
+                    running.push_back(item.request);
+                }
+            }
+            batchDone = !queued.empty() && finished_ == items_.size();
+        }
+        if (onItem_)
+        {
+            for (auto index : queued)
+            {
+                onItem_(index, items_[index].url, LoadRequest::State::Cancelled, nullptr);
+            }
+        }
+        //Running items finish through their own completion handlers
+        for (auto& request : running)
+        {
+            request->Cancel();
+        }
+        if (batchDone)
+        {
+            FinishBatch();
+        }
+    }
+
+    void LoadBatch::FinishBatch()
+    {
+        if (onDone_)
+        {
+            onDone_(*this);
+        }
+        //Only wake waiters once the handler returned, so they can drop what it uses
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            handled_ = true;
+        }
+        done_.notify_all();
+    }
+
+    size_t LoadBatch::GetFinishedCount() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return finished_;
+    }
+
+    bool LoadBatch::IsDone() const
+    {
+        return GetFinishedCount() == items_.size();
+    }
+
+    void LoadBatch::Wait() const
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this] { return handled_; });
+    }
+
+    LoadRequest::State LoadBatch::GetState(size_t index) const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return items_.at(index).state;
+    }
+
+    LoadRequest::LoadBuffers LoadBatch::GetResult(size_t index) const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return items_.at(index).result;
+    }
+}
@@ -0,0 +1,80 @@
+/**
+ * Source file for the LoadEvent
+ */
+#include "LoadEvent.hpp"
+
+namespace sgns
+{
+    namespace
+    {
+        const char* Describe(LoadPhase phase)
+        {
+            switch (phase)
+            {
+            case LoadPhase::Queued:
+                return "Queued";
+            case LoadPhase::Resolve:
+                return "Resolving";
+            case LoadPhase::Connect:
+                return "Connecting";
+            case LoadPhase::Handshake:
+                return "Handshaking";
+            case LoadPhase::FirstByte:
+                return "Waiting for data";
+            case LoadPhase::Transfer:
+                return "Transferring";
+            case LoadPhase::Parse:
+                return "Parsing";
+            case LoadPhase::Save:
+                return "Saving";
+            case LoadPhase::Done:
+                return "Done";
+            case LoadPhase::Retry:
+                return "Retrying";
+            }
+            return "Unknown";
+        }
+
+        class HTTPStatusErrorCategory : public boost::system::error_category
+        {
+        public:
+            const char* name() const noexcept override
+            {
+                return "http";
+            }
+            std::string message(int statusCode) const override
+            {
+                return "HTTP status " + std::to_string(statusCode);
+            }
+        };
+    }
+
+    const boost::system::error_category& HTTPStatusCategory()
+    {
+        static const HTTPStatusErrorCategory category;
+        return category;
+    }
+
+    std::string LoadEvent::ToString() const
+    {
+        std::string text = Describe(phase);
+        if (bytes != 0 || totalBytes != 0)
+        {
+            text += " " + std::to_string(bytes);
+            if (totalBytes != 0)
+            {
+                text += "/" + std::to_string(totalBytes);
+            }
+            text += " bytes";
+        }
+        if (delay.count() != 0)
+        {
+            text += " in " + std::to_string(delay.count()) + " ms";
+        }
+        if (error)
+        {
+            text += " failed: " + error.message();
+        }
+        return text;
+    }
+}
@@ -0,0 +1,188 @@
+/**
+ * Source file for the LoadMetrics
+ */
+#include <algorithm>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include "LoadMetrics.hpp"
+
+namespace sgns
+{
+    namespace
+    {
+        //Label values may hold anything a URL can, escape what the text format reserves
+        std::string EscapeLabel(const std::string& value)
+        {
+            std::string escaped;
+            escaped.reserve(value.size());
+            for (char c : value)
+            {
+                if (c == '\\' || c == '"')
+                {
+                    escaped.push_back('\\');
+                    escaped.push_back(c);
+                }
+                else if (c == '\n')
+                {
+                    escaped += "\\n";
+                }
+                else
+                {
+                    escaped.push_back(c);
+                }
+            }
+            return escaped;
+        }
+    }
+
+    const std::vector<double>& LatencyHistogram::Bounds()
+    {
+        static const std::vector<double> bounds = { 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30, 60 };
+        return bounds;
+    }
+
+    void LatencyHistogram::Observe(double seconds)
+    {
+        const auto& bounds = Bounds();
+        auto bucket = std::lower_bound(bounds.begin(), bounds.end(), seconds) - bounds.begin();
+        ++buckets[bucket];
+        ++count;
+        sum += seconds;
+    }
+
+    void LoadMetrics::RecordRequest(const std::string& scheme, const std::string& host)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++metrics_.targets[{ scheme, host }].requests;
+    }
+
+    void LoadMetrics::RecordBytes(const std::string& scheme, const std::string& host, uint64_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        metrics_.targets[{ scheme, host }].bytes += bytes;
+    }
+
+    void LoadMetrics::RecordError(const std::string& scheme, const std::string& host)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++metrics_.targets[{ scheme, host }].errors;
+    }
+
+    void LoadMetrics::RecordPhase(const std::string& scheme, LoadPhase phase, std::chrono::steady_clock::duration elapsed)
+    {
+        double seconds = std::chrono::duration<double>(elapsed).count();
+        std::lock_guard<std::mutex> lock(mutex_);
+        metrics_.phases[{ scheme, phase }].Observe(seconds);
+    }
+
+    void LoadMetrics::EndPhase(const std::string& scheme, LoadPhase phase, std::chrono::steady_clock::time_point& start)
+    {
+        auto now = std::chrono::steady_clock::now();
+        RecordPhase(scheme, phase, now - start);
+        start = now;
+    }
+
+    MetricsSnapshot LoadMetrics::Snapshot() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return metrics_;
+    }
+
+    void LoadMetrics::Reset()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        metrics_ = MetricsSnapshot();
+    }
+
+    std::string LoadMetrics::PrometheusText() const
+    {
+        auto snapshot = Snapshot();
+        std::ostringstream out;
+        struct Counter
+        {
+            const char* name;
+            const char* help;
+            uint64_t TargetCounters::* field;
+        };
+        const Counter counters[] = {
+            { "asyncio_requests_total", "Transfer attempts started", &TargetCounters::requests },
+            { "asyncio_bytes_total", "Bytes delivered by successful transfers", &TargetCounters::bytes },
+            { "asyncio_errors_total", "Transfer attempts that failed", &TargetCounters::errors },
+        };
+        for (const auto& counter : counters)
+        {
+            out << "# HELP " << counter.name << " " << counter.help << "\n";
+            out << "# TYPE " << counter.name << " counter\n";
+            for (const auto& [target, values] : snapshot.targets)
+            {
+                out << counter.name << "{scheme=\"" << EscapeLabel(target.first) << "\",host=\"" << EscapeLabel(target.second) << "\"} "
+                    << values.*counter.field << "\n";
+            }
+        }
+        out << "# HELP asyncio_phase_seconds Latency of each load phase\n";
+        out << "# TYPE asyncio_phase_seconds histogram\n";
+        const auto& bounds = LatencyHistogram::Bounds();
+        for (const auto& [key, histogram] : snapshot.phases)
+        {
+            auto labels = "scheme=\"" + EscapeLabel(key.first) + "\",phase=\"" + PhaseName(key.second) + "\"";
+            uint64_t cumulative = 0;
+            for (size_t i = 0; i < bounds.size(); ++i)
+            {
+                cumulative += histogram.buckets[i];
+                out << "asyncio_phase_seconds_bucket{" << labels << ",le=\"" << bounds[i] << "\"} " << cumulative << "\n";
+            }
+            out << "asyncio_phase_seconds_bucket{" << labels << ",le=\"+Inf\"} " << histogram.count << "\n";
+            //The sum keeps growing, print it exactly so scrapes do not see it stall or go backwards
+            auto precision = out.precision(std::numeric_limits<double>::max_digits10);
+            out << "asyncio_phase_seconds_sum{" << labels << "} " << histogram.sum << "\n";
+            out.precision(precision);
+            out << "asyncio_phase_seconds_count{" << labels << "} " << histogram.count << "\n";
+        }
+        return out.str();
+    }
+
+    const char* LoadMetrics::PhaseName(LoadPhase phase)
+    {
+        switch (phase)
+        {
+        case LoadPhase::Queued:
+            return "queued";
+        case LoadPhase::Resolve:
+            return "resolve";
+        case LoadPhase::Connect:
+            return "connect";
+        case LoadPhase::Handshake:
+            return "handshake";
+        case LoadPhase::FirstByte:
+            return "first_byte";
+        case LoadPhase::Transfer:
+            return "transfer";
+        case LoadPhase::Parse:
+            return "parse";
+        case LoadPhase::Save:
+            return "save";
+        case LoadPhase::Done:
+            return "done";
+        case LoadPhase::Retry:
+            return "retry";
+        }
+        return "unknown";
+    }
+
+    std::string LoadMetrics::HostOf(const std::string& scheme, const std::string& path)
+    {
+        if (scheme != "https" && scheme != "wss" && scheme != "sftp")
+        {
+            return "";
+        }
+        auto host = path.substr(0, path.find('/'));
+        //SFTP URLs carry user:pass@ in front of the host
+        auto at = host.rfind('@');
+        if (at != std::string::npos)
+        {
+            host = host.substr(at + 1);
+        }
+        return host.substr(0, host.find(':'));
+    }
+}
@@ -0,0 +1,265 @@
+/**
+ * Source file for the LoadRace
+ */
+#include <algorithm>
+#include <cctype>
+#include <openssl/evp.h>
+#include "boost/asio/post.hpp"
+#include "LoadRace.hpp"
+#include "FileManager.hpp"
+
+namespace sgns
+{
+    LoadRace::LoadRace(std::vector<std::string> urls, LoadRaceOptions options, std::shared_ptr<boost::asio::io_context> ioc)
+        : options_(std::move(options)), ioc_(std::move(ioc)), strand_(boost::asio::make_strand(*ioc_)), staggerTimer_(strand_)
+    {
+        std::transform(options_.sha256.begin(), options_.sha256.end(), options_.sha256.begin(), [](unsigned char c) {
+            return static_cast<char>(std::tolower(c));
+            });
+        candidates_.reserve(urls.size());
+        for (auto& url : urls)
+        {
+            Candidate candidate;
+            candidate.url = std::move(url);
+            candidates_.push_back(std::move(candidate));
+        }
+    }
+
+    void LoadRace::SetHandlers(WinnerHandler onWinner, StatusHandler onStatus)
+    {
+        onWinner_ = std::move(onWinner);
+        onStatus_ = std::move(onStatus);
+    }
+
+    void LoadRace::Start()
+    {
+        if (candidates_.empty())
+        {
+            Decide(npos, nullptr);
+            return;
+        }
+        //With a stagger the candidates go out one interval apart, otherwise as many as allowed go at once
+        Pump(options_.stagger.count() > 0);
+    }
+
+    void LoadRace::Pump(bool one)
+    {
+        std::vector<size_t> runnable;
+        bool more;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (decided_)
+            {
+                return;
+            }
+            while (next_ < candidates_.size() && (options_.maxParallel == 0 || running_ < options_.maxParallel))
+            {
+                runnable.push_back(next_++);
+                ++running_;
+                if (one)
+                {
+                    break;
+                }
+            }
+            more = next_ < candidates_.size();
+        }
+        //Nothing started means every slot is taken, the next failure pumps again
+        if (more && !runnable.empty() && options_.stagger.count() > 0)
+        {
+            //Rearming restarts the interval, so a failure that started a candidate early doesn't also bring the next one forward
+            auto self = shared_from_this();
+            boost::asio::post(strand_, [self]() {
+                self->staggerTimer_.expires_after(self->options_.stagger);
+                self->staggerTimer_.async_wait([self](const boost::system::error_code& ec) {
+                    if (!ec)
+                    {
+                        self->Pump(true);
+                    }
+                    });
+                });
+        }
+        for (auto index : runnable)
+        {
+            StartCandidate(index);
+        }
+    }
+
+    void LoadRace::StartCandidate(size_t index)
+    {
+        auto self = shared_from_this();
+        auto onStatus = [self, index](const CustomResult& status) {
+            self->ReportStatus(index, status);
+        };
+        std::shared_ptr<LoadRequest> request;
+        try
+        {
+            //Verification needs the raw bytes, only the winner gets parsed or saved.
+            //Without a status handler the load is spared building status text.
+            request = FileManager::GetInstance().LoadASync(candidates_[index].url, false, false, ioc_, onStatus_ ? FileManager::StatusCallback(onStatus) : nullptr,
+                [](std::shared_ptr<const LoadResult>) {}, "", nullptr, options_.priority);
+        }
+        catch (const std::exception& e)
+        {
+            onStatus(CustomResult(sgns::AsyncError::outcome::failure(e.what())));
+            FinishCandidate(index, LoadRequest::State::Failed, nullptr);
+            return;
+        }
+        bool decided;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            candidates_[index].request = request;
+            decided = decided_;
+        }
+        if (decided)
+        {
+            //Race was won or cancelled while this was starting
+            request->Cancel();
+        }
+        request->OnComplete([self, index](LoadRequest::State state, LoadRequest::LoadBuffers buffers) {
+            self->FinishCandidate(index, state, std::move(buffers));
+            });
+    }
+
+    void LoadRace::FinishCandidate(size_t index, LoadRequest::State state, LoadRequest::LoadBuffers buffers)
+    {
+        if (state != LoadRequest::State::Completed)
+        {
+            buffers = nullptr;
+        }
+        if (!buffers || options_.sha256.empty())
+        {
+            Settle(index, std::move(buffers));
+            return;
+        }
+        //Hashing a large file would hold up the io_context thread the load finished on
+        auto self = shared_from_this();
+        boost::asio::post(FileManager::GetInstance().GetCPUExecutor(), [self, index, buffers]() {
+            if (Sha256Hex(*buffers) == self->options_.sha256)
+            {
+                self->Settle(index, buffers);
+                return;
+            }
+            self->ReportStatus(index, CustomResult(sgns::AsyncError::outcome::failure("Digest mismatch from " + self->candidates_[index].url)));
+            //Don't let the bad copy answer later loads of the URL
+            FileManager::GetInstance().Evict(self->candidates_[index].url);
+            self->Settle(index, nullptr);
+            });
+    }
+
+    void LoadRace::Settle(size_t index, LoadRequest::LoadBuffers buffers)
+    {
+        if (buffers)
+        {
+            Decide(index, std::move(buffers));
+            return;
+        }
+        bool exhausted;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (decided_)
+            {
+                return;
+            }
+            --running_;
+            exhausted = running_ == 0 && next_ == candidates_.size();
+        }
+        if (exhausted)
+        {
+            ReportStatus(npos, CustomResult(sgns::AsyncError::outcome::failure("No source delivered the content")));
+            Decide(npos, nullptr);
+            return;
+        }
+        //Fail over to the next candidate
+        Pump(true);
+    }
+
+    void LoadRace::Decide(size_t index, LoadRequest::LoadBuffers buffers)
+    {
+        std::vector<std::shared_ptr<LoadRequest>> losers;
+        WinnerHandler onWinner;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (decided_)
+            {
+                return;
+            }
+            decided_ = true;
+            for (size_t i = 0; i < candidates_.size(); ++i)
+            {
+                if (i != index && candidates_[i].request)
+                {
+                    losers.push_back(candidates_[i].request);
+                }
+            }
+            //The handler may hold whoever holds the race, let go of it once it ran
+            onWinner.swap(onWinner_);
+        }
+        auto self = shared_from_this();
+        boost::asio::post(strand_, [self]() {
+            self->staggerTimer_.cancel();
+            });
+        for (auto& request : losers)
+        {
+            request->Cancel();
+        }
+        if (onWinner)
+        {
+            onWinner(index, std::move(buffers));
+        }
+    }
+
+    void LoadRace::Cancel()
+    {
+        Decide(npos, nullptr);
+    }
+
+    void LoadRace::ReportStatus(size_t index, const CustomResult& status)
+    {
+        {
+            //Losers report their cancellation, nobody needs to hear it
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (decided_)
+            {
+                return;
+            }
+        }
+        if (onStatus_)
+        {
+            onStatus_(index, status);
+        }
+    }
+
+    std::string LoadRace::Sha256Hex(const LoadResult& buffers)
+    {
+        EVP_MD_CTX* context = EVP_MD_CTX_new();
+        if (context == nullptr)
+        {
+            return "";
+        }
+        unsigned char digest[EVP_MAX_MD_SIZE];
+        unsigned int length = 0;
+        bool ok = EVP_DigestInit_ex(context, EVP_sha256(), nullptr) == 1;
+        for (const auto& entry : buffers.entries)
+        {
+            for (const auto& slice : entry.slices)
+            {
+                ok = ok && EVP_DigestUpdate(context, slice.data, slice.size) == 1;
+            }
+        }
+        ok = ok && EVP_DigestFinal_ex(context, digest, &length) == 1;
+        EVP_MD_CTX_free(context);
+        if (!ok)
+        {
+            return "";
+        }
+        static const char hex[] = "0123456789abcdef";
+        std::string result;
+        result.reserve(length * 2);
+        for (unsigned int i = 0; i < length; ++i)
+        {
+            result.push_back(hex[digest[i] >> 4]);
+            result.push_back(hex[digest[i] & 0x0f]);
+        }
+        return result;
+    }
+}
@@ -0,0 +1,253 @@
+/**
+ * Source file for the LoadRequest
+ */
+#include "LoadRequest.hpp"
+
+namespace sgns
+{
+    LoadRequest::LoadRequest(std::string url) : url_(std::move(url))
+    {
+    }
+
+    LoadRequest::State LoadRequest::GetState() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return state_;
+    }
+
+    bool LoadRequest::IsDone() const
+    {
+        return GetState() != State::Pending;
+    }
+
+    LoadRequest::LoadBuffers LoadRequest::GetResult() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return result_;
+    }
+
+    LoadRequest::State LoadRequest::Wait() const
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this] { return state_ != State::Pending; });
+        return state_;
+    }
+
+    bool LoadRequest::Cancel()
+    {
+        return Abort(State::Cancelled);
+    }
+
+    bool LoadRequest::Expire()
+    {
+        return Abort(State::TimedOut);
+    }
+
+    bool LoadRequest::Abort(State state)
+    {
+        std::vector<std::function<void()>> cancelHandlers;
+        std::vector<CompleteHandler> completeHandlers;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (state_ != State::Pending)
+            {
+                return false;
+            }
+            cancelled_ = true;
+            state_ = state;
+            cancelHandlers.swap(cancelHandlers_);
+            completeHandlers.swap(completeHandlers_);
+        }
+        done_.notify_all();
+        //Abort work first, so completion handlers see the request torn down
+        for (auto& handler : cancelHandlers)
+        {
+            handler();
+        }
+        for (auto& handler : completeHandlers)
+        {
+            handler(state, nullptr);
+        }
+        return true;
+    }
+
+    void LoadRequest::OnCancel(std::function<void()> handler)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (state_ == State::Pending)
+            {
+                cancelHandlers_.push_back(std::move(handler));
+                return;
+            }
+            if (!cancelled_)
+            {
+                //Finished normally, nothing left to abort
+                return;
+            }
+        }
+        handler();
+    }
+
+    void LoadRequest::OnComplete(CompleteHandler handler)
+    {
+        State state;
+        LoadBuffers result;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (state_ == State::Pending)
+            {
+                completeHandlers_.push_back(std::move(handler));
+                return;
+            }
+            state = state_;
+            result = result_;
+        }
+        handler(state, result);
+    }
+
+    bool LoadRequest::Complete(LoadBuffers buffers)
+    {
+        auto state = buffers ? State::Completed : State::Failed;
+        std::vector<CompleteHandler> handlers;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (state_ != State::Pending)
+            {
+                return false;
+            }
+            state_ = state;
+            result_ = buffers;
+            handlers.swap(completeHandlers_);
+            cancelHandlers_.clear();
+        }
+        done_.notify_all();
+        for (auto& handler : handlers)
+        {
+            handler(state, buffers);
+        }
+        return true;
+    }
+
+    void LoadRequest::SetChunkHandler(ChunkHandler handler)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        chunkHandler_ = std::move(handler);
+    }
+
+    bool LoadRequest::IsStreaming() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return static_cast<bool>(chunkHandler_);
+    }
+
+    bool LoadRequest::HasDeliveredChunks() const
+    {
+        return deliveredChunks_.load();
+    }
+
+    void LoadRequest::DeliverChunk(const LoadChunk& chunk, std::function<void()> resume)
+    {
+        ChunkHandler handler;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            handler = chunkHandler_;
+        }
+        if (!handler || cancelled_)
+        {
+            //Nobody to hold the transfer back
+            resume();
+            return;
+        }
+        deliveredChunks_ = true;
+        handler(chunk, std::move(resume));
+    }
+
+    namespace
+    {
+        /// Progress of DeliverChunks, shared by the loop and the resume of the chunk it is waiting on
+        struct ChunkRun
+        {
+            std::shared_ptr<LoadRequest> request;
+            std::function<bool(LoadChunk& chunk)> next;
+            std::function<void()> done;
+            /// @brief Set while DeliverChunk runs, whichever of the loop and resume clears it first leaves the other to continue
+            std::atomic<bool> delivering{ false };
+        };
+
+        void RunChunks(std::shared_ptr<ChunkRun> run)
+        {
+            LoadChunk chunk;
+            while (run->next(chunk))
+            {
+                run->delivering = true;
+                run->request->DeliverChunk(chunk, [run]() {
+                    if (!run->delivering.exchange(false))
+                    {
+                        //Resumed after the loop moved on, continue from here
+                        RunChunks(run);
+                    }
+                    });
+                if (run->delivering.exchange(false))
+                {
+                    //Not resumed yet, resume picks up from here
+                    return;
+                }
+                chunk = LoadChunk();
+            }
+            run->done();
+        }
+    }
+
+    void LoadRequest::DeliverChunks(std::function<bool(LoadChunk& chunk)> next, std::function<void()> done)
+    {
+        auto run = std::make_shared<ChunkRun>();
+        run->request = shared_from_this();
+        run->next = std::move(next);
+        run->done = std::move(done);
+        RunChunks(run);
+    }
+
+    void LoadRequest::SetEventHandler(EventHandler handler)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        eventHandler_ = std::move(handler);
+        hasEventHandler_.store(static_cast<bool>(eventHandler_), std::memory_order_release);
+    }
+
+    void LoadRequest::SetCachedValidator(std::string validator)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cachedValidator_ = std::move(validator);
+    }
+
+    std::string LoadRequest::GetCachedValidator() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return cachedValidator_;
+    }
+
+    void LoadRequest::SetValidator(std::string validator)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        validator_ = std::move(validator);
+    }
+
+    std::string LoadRequest::GetValidator() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return validator_;
+    }
+
+    void LoadRequest::SetNotModified()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        notModified_ = true;
+    }
+
+    bool LoadRequest::IsNotModified() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return notModified_;
+    }
+}
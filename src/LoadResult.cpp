@@ -0,0 +1,103 @@
+/**
+ * Source file for the LoadResult
+ */
+#include <cstring>
+#include <stdexcept>
+#include "LoadResult.hpp"
+
+namespace sgns
+{
+    BufferSlice BufferSlice::FromVector(std::vector<char>&& content)
+    {
+        auto owner = std::make_shared<std::vector<char>>(std::move(content));
+        return BufferSlice(owner, owner->data(), owner->size());
+    }
+
+    BufferSlice BufferSlice::FromStreambuf(std::shared_ptr<boost::asio::streambuf> buffer, size_t offset, size_t length)
+    {
+        if (offset + length > buffer->size())
+        {
+            throw std::out_of_range("Slice is past the end of the streambuf");
+        }
+        //The readable area of an asio::streambuf is a single contiguous buffer
+        auto start = static_cast<const char*>(buffer->data().data()) + offset;
+        return BufferSlice(std::move(buffer), start, length);
+    }
+
+    BufferSlice BufferSlice::SubSlice(size_t offset, size_t length) const
+    {
+        if (offset + length > size)
+        {
+            throw std::out_of_range("Slice is past the end of the segment");
+        }
+        return BufferSlice(owner, data + offset, length);
+    }
+
+    size_t BufferEntry::Size() const
+    {
+        size_t total = 0;
+        for (const auto& slice : slices)
+        {
+            total += slice.size;
+        }
+        return total;
+    }
+
+    BufferSlice BufferEntry::Contiguous() const
+    {
+        if (slices.empty())
+        {
+            return BufferSlice();
+        }
+        if (slices.size() == 1)
+        {
+            return slices.front();
+        }
+        std::vector<char> combined(Size());
+        CopyTo(combined.data());
+        return BufferSlice::FromVector(std::move(combined));
+    }
+
+    void BufferEntry::CopyTo(void* dest) const
+    {
+        auto out = static_cast<char*>(dest);
+        for (const auto& slice : slices)
+        {
+            std::memcpy(out, slice.data, slice.size);
+            out += slice.size;
+        }
+    }
+
+    std::vector<boost::asio::const_buffer> BufferEntry::AsBuffers() const
+    {
+        std::vector<boost::asio::const_buffer> buffers;
+        buffers.reserve(slices.size());
+        for (const auto& slice : slices)
+        {
+            buffers.push_back(slice.AsBuffer());
+        }
+        return buffers;
+    }
+
+    void LoadResult::Add(std::string name, BufferSlice slice)
+    {
+        std::vector<BufferSlice> slices;
+        slices.push_back(std::move(slice));
+        Add(std::move(name), std::move(slices));
+    }
+
+    void LoadResult::Add(std::string name, std::vector<BufferSlice> slices)
+    {
+        entries.push_back(BufferEntry{ std::move(name), std::move(slices) });
+    }
+
+    size_t LoadResult::TotalSize() const
+    {
+        size_t total = 0;
+        for (const auto& entry : entries)
+        {
+            total += entry.Size();
+        }
+        return total;
+    }
+}
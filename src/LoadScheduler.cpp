@@ -0,0 +1,171 @@
+/**
+ * Source file for the LoadScheduler
+ */
+#include <algorithm>
+#include "LoadScheduler.hpp"
+
+namespace sgns
+{
+    namespace
+    {
+        size_t ClassIndex(LoadPriority priority)
+        {
+            return static_cast<size_t>(priority);
+        }
+    }
+
+    void LoadScheduler::SetLimits(size_t maxActive, size_t maxPrefetch)
+    {
+        std::vector<std::function<void()>> runnable;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            maxActive_ = maxActive;
+            maxPrefetch_ = maxPrefetch;
+            runnable = TakeRunnableLocked();
+        }
+        StartAll(std::move(runnable));
+    }
+
+    LoadScheduler::Ticket LoadScheduler::NewTicket()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return nextTicket_++;
+    }
+
+    bool LoadScheduler::Submit(Ticket ticket, LoadPriority priority, std::function<void()> start)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!CanStartLocked(priority))
+            {
+                queues_[ClassIndex(priority)].push_back(Waiting{ ticket, std::move(start) });
+                return false;
+            }
+            ActivateLocked(ticket, priority);
+        }
+        start();
+        return true;
+    }
+
+    void LoadScheduler::Promote(Ticket ticket, LoadPriority priority)
+    {
+        std::vector<std::function<void()>> runnable;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (size_t index = ClassIndex(priority) + 1; index < queues_.size(); ++index)
+            {
+                auto& queue = queues_[index];
+                auto iter = std::find_if(queue.begin(), queue.end(), [ticket](const Waiting& waiting) { return waiting.ticket == ticket; });
+                if (iter == queue.end())
+                {
+                    continue;
+                }
+                auto waiting = std::move(*iter);
+                queue.erase(iter);
+                //It has waited at least as long as anything already in the new class
+                queues_[ClassIndex(priority)].push_front(std::move(waiting));
+                break;
+            }
+            runnable = TakeRunnableLocked();
+        }
+        StartAll(std::move(runnable));
+    }
+
+    void LoadScheduler::Release(Ticket ticket)
+    {
+        std::vector<std::function<void()>> runnable;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto iter = active_.find(ticket);
+            if (iter != active_.end())
+            {
+                --activeCount_[ClassIndex(iter->second)];
+                active_.erase(iter);
+            }
+            else
+            {
+                for (auto& queue : queues_)
+                {
+                    queue.erase(std::remove_if(queue.begin(), queue.end(), [ticket](const Waiting& waiting) { return waiting.ticket == ticket; }), queue.end());
+                }
+            }
+            runnable = TakeRunnableLocked();
+        }
+        StartAll(std::move(runnable));
+    }
+
+    size_t LoadScheduler::GetActiveCount() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return active_.size();
+    }
+
+    size_t LoadScheduler::GetQueuedCount() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t queued = 0;
+        for (const auto& queue : queues_)
+        {
+            queued += queue.size();
+        }
+        return queued;
+    }
+
+    bool LoadScheduler::CanStartLocked(LoadPriority priority) const
+    {
+        if (priority == LoadPriority::Interactive)
+        {
+            return true;
+        }
+        //Interactive transfers take slots too, so a burst of them holds everything else back
+        if (maxActive_ != 0 && active_.size() >= maxActive_)
+        {
+            return false;
+        }
+        if (priority == LoadPriority::Prefetch)
+        {
+            if (!queues_[ClassIndex(LoadPriority::Normal)].empty())
+            {
+                return false;
+            }
+            return maxPrefetch_ == 0 || activeCount_[ClassIndex(LoadPriority::Prefetch)] < maxPrefetch_;
+        }
+        return true;
+    }
+
+    void LoadScheduler::ActivateLocked(Ticket ticket, LoadPriority priority)
+    {
+        active_[ticket] = priority;
+        ++activeCount_[ClassIndex(priority)];
+    }
+
+    std::vector<std::function<void()>> LoadScheduler::TakeRunnableLocked()
+    {
+        std::vector<std::function<void()>> runnable;
+        for (size_t index = 0; index < queues_.size(); ++index)
+        {
+            auto priority = static_cast<LoadPriority>(index);
+            auto& queue = queues_[index];
+            while (!queue.empty() && CanStartLocked(priority))
+            {
+                ActivateLocked(queue.front().ticket, priority);
+                runnable.push_back(std::move(queue.front().start));
+                queue.pop_front();
+            }
+            if (!queue.empty())
+            {
+                //Less urgent classes wait behind this one
+                break;
+            }
+        }
+        return runnable;
+    }
+
+    void LoadScheduler::StartAll(std::vector<std::function<void()>> runnable)
+    {
+        for (auto& start : runnable)
+        {
+            start();
+        }
+    }
+}
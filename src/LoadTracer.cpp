@@ -0,0 +1,210 @@
+/**
+ * Source file for the LoadTracer
+ */
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include "LoadTracer.hpp"
+#include "LoadMetrics.hpp"
+
+namespace sgns
+{
+    namespace
+    {
+        //URLs and file names go into JSON strings as they are, escape what JSON reserves
+        std::string EscapeJSON(const std::string& value)
+        {
+            std::string escaped;
+            escaped.reserve(value.size());
+            for (unsigned char c : value)
+            {
+                if (c == '"' || c == '\\')
+                {
+                    escaped.push_back('\\');
+                    escaped.push_back(static_cast<char>(c));
+                }
+                else if (c < 0x20)
+                {
+                    char code[8];
+                    std::snprintf(code, sizeof(code), "\\u%04x", c);
+                    escaped += code;
+                }
+                else
+                {
+                    escaped.push_back(static_cast<char>(c));
+                }
+            }
+            return escaped;
+        }
+    }
+
+    void LoadTracer::Enable(size_t maxSpans)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        records_.clear();
+        tracks_.clear();
+        trackNames_.clear();
+        open_.clear();
+        dropped_ = 0;
+        maxSpans_ = maxSpans;
+        epoch_ = Clock::now();
+        enabled_ = true;
+    }
+
+    void LoadTracer::Disable()
+    {
+        enabled_ = false;
+    }
+
+    void LoadTracer::Span(std::string name, const char* category, const std::string& track, Clock::time_point start, Clock::time_point end, Args args)
+    {
+        if (!IsEnabled())
+        {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        AddLocked(Record{ std::move(name), category, TrackLocked(track), start, end, std::move(args) });
+    }
+
+    void LoadTracer::OnEvent(const std::string& track, const void* transfer, size_t attempt, const LoadEvent& event)
+    {
+        if (!IsEnabled())
+        {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto key = std::make_pair(transfer, attempt);
+        auto iter = open_.find(key);
+        if (iter != open_.end())
+        {
+            auto& open = iter->second;
+            if (open.phase == event.phase && !event.error)
+            {
+                open.bytes = event.bytes;
+                open.totalBytes = event.totalBytes;
+                return;
+            }
+            CloseLocked(iter, event);
+        }
+        if (attempt == 0 && event.phase == LoadPhase::Done)
+        {
+            //Hedges that lost and attempts cut off by a cancel end with their transfer
+            for (iter = open_.lower_bound(key); iter != open_.end() && iter->first.first == transfer;)
+            {
+                iter = CloseLocked(iter, event);
+            }
+        }
+        else if (attempt != 0)
+        {
+            //An attempt at work ends the wait of its transfer
+            iter = open_.find(std::make_pair(transfer, size_t(0)));
+            if (iter != open_.end())
+            {
+                CloseLocked(iter, event);
+            }
+        }
+        if (event.phase != LoadPhase::Done && !event.error)
+        {
+            open_[key] = OpenPhase{ event.phase, event.time, event.bytes, event.totalBytes, TrackLocked(track) };
+        }
+    }
+
+    std::map<LoadTracer::OpenKey, LoadTracer::OpenPhase>::iterator LoadTracer::CloseLocked(std::map<OpenKey, OpenPhase>::iterator iter, const LoadEvent& event)
+    {
+        const auto& open = iter->second;
+        Args args;
+        if (iter->first.second != 0)
+        {
+            args.emplace_back("attempt", std::to_string(iter->first.second));
+        }
+        if (open.bytes != 0)
+        {
+            args.emplace_back("bytes", std::to_string(open.bytes));
+        }
+        if (open.totalBytes != 0)
+        {
+            args.emplace_back("totalBytes", std::to_string(open.totalBytes));
+        }
+        if (event.error && event.phase == open.phase)
+        {
+            args.emplace_back("error", event.error.message());
+        }
+        AddLocked(Record{ LoadMetrics::PhaseName(open.phase), "load", open.track, open.start, event.time, std::move(args) });
+        return open_.erase(iter);
+    }
+
+    uint32_t LoadTracer::TrackLocked(const std::string& track)
+    {
+        auto iter = tracks_.find(track);
+        if (iter != tracks_.end())
+        {
+            return iter->second;
+        }
+        auto id = static_cast<uint32_t>(trackNames_.size() + 1);
+        tracks_.emplace(track, id);
+        trackNames_.push_back(track);
+        return id;
+    }
+
+    void LoadTracer::AddLocked(Record record)
+    {
+        if (records_.size() >= maxSpans_)
+        {
+            ++dropped_;
+            return;
+        }
+        records_.push_back(std::move(record));
+    }
+
+    std::string LoadTracer::ChromeTraceJSON() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::ostringstream out;
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        bool first = true;
+        //Name the rows after their tracks
+        for (size_t i = 0; i < trackNames_.size(); ++i)
+        {
+            out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << i + 1
+                << ",\"args\":{\"name\":\"" << EscapeJSON(trackNames_[i]) << "\"}}";
+            first = false;
+        }
+        for (const auto& record : records_)
+        {
+            auto ts = std::chrono::duration_cast<std::chrono::microseconds>(record.start - epoch_).count();
+            auto dur = std::chrono::duration_cast<std::chrono::microseconds>(record.end - record.start).count();
+            out << (first ? "" : ",") << "\n{\"name\":\"" << EscapeJSON(record.name) << "\",\"cat\":\"" << record.category
+                << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << record.track << ",\"ts\":" << ts << ",\"dur\":" << dur;
+            if (!record.args.empty())
+            {
+                out << ",\"args\":{";
+                for (size_t i = 0; i < record.args.size(); ++i)
+                {
+                    out << (i == 0 ? "" : ",") << "\"" << EscapeJSON(record.args[i].first) << "\":\"" << EscapeJSON(record.args[i].second) << "\"";
+                }
+                out << "}";
+            }
+            out << "}";
+            first = false;
+        }
+        out << "\n]}\n";
+        return out.str();
+    }
+
+    bool LoadTracer::WriteChromeTrace(const std::string& path) const
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file)
+        {
+            return false;
+        }
+        file << ChromeTraceJSON();
+        return static_cast<bool>(file);
+    }
+
+    size_t LoadTracer::GetDroppedCount() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return dropped_;
+    }
+}
@@ -1,6 +1,8 @@
+#include <algorithm>
 #include <sstream>
 #include <filesystem>
 #include <fstream>
+#include <mutex>
 #include <streambuf>
 #include <string>
 #include "FileManager.hpp"
@@ -8,6 +10,295 @@
 #include "FILECommon.hpp"
 namespace sgns
 {
+    namespace
+    {
+        const size_t kChunkSize = 1024 * 1024;
+        //Bytes per read into a buffer of the file's size, a multiple of the page size so reads stay aligned in the file
+        const size_t kReadSize = 4 * 1024 * 1024;
+
+        /**
+         * Close a device once its request is cancelled, so reads in flight stop rather than run to the end
+         */
+        template <typename Device>
+        void CloseOnCancel(std::shared_ptr<LoadRequest> request, std::shared_ptr<boost::asio::io_context> ioc, std::shared_ptr<Device> device)
+        {
+            if (!request)
+            {
+                return;
+            }
+            request->OnCancel([ioc, weakDevice = std::weak_ptr<Device>(device)]() {
+                boost::asio::post(*ioc, [weakDevice]() {
+                    if (auto device = weakDevice.lock())
+                    {
+                        device->Close();
+                    }
+                    });
+                });
+        }
+
+        bool IsCancelled(const std::shared_ptr<LoadRequest>& request)
+        {
+            return request && request->IsCancelled();
+        }
+
+        /**
+         * Read a local file a chunk at a time for a streaming request. The next read only starts once the
+         * consumer resumes, and the final result is the chain of chunks, so nothing is copied.
+         */
+        void ReadFileChunks(std::shared_ptr<FILEDevice> fileDevice, std::shared_ptr<boost::asio::io_context> ioc, std::shared_ptr<LoadRequest> request,
+            std::string name, std::shared_ptr<std::vector<BufferSlice>> slices, uint64_t offset, bool parse, bool save,
+            MNNLoader::CompletionCallback handle_read, MNNLoader::StatusCallback status)
+        {
+            //A cancelled request reads nothing more
+            if (request->IsCancelled())
+            {
+                handle_read(ioc, std::shared_ptr<const sgns::LoadResult>(), false, false);
+                return;
+            }
+            auto chunk = std::make_shared<std::vector<char>>(kChunkSize);
+            fileDevice->getFile().async_read_some(boost::asio::buffer(*chunk),
+                [fileDevice, ioc, request, name, slices, offset, parse, save, handle_read, status, chunk](const boost::system::error_code& error, std::size_t bytes_transferred) {
+                    if (request->IsCancelled())
+                    {
+                        handle_read(ioc, std::shared_ptr<const sgns::LoadResult>(), false, false);
+                    }
+                    else if (bytes_transferred > 0)
+                    {
+                        LoadChunk next;
+                        next.name = name;
+                        next.offset = offset;
+                        next.data = BufferSlice(chunk, chunk->data(), bytes_transferred);
+                        slices->push_back(next.data);
+                        request->DeliverChunk(next, [fileDevice, ioc, request, name, slices, offset, bytes_transferred, parse, save, handle_read, status]() {
+                            ReadFileChunks(fileDevice, ioc, request, name, slices, offset + bytes_transferred, parse, save, handle_read, status);
+                            });
+                    }
+                    else if (error == boost::asio::error::eof)
+                    {
+                        LoadChunk last;
+                        last.name = name;
+                        last.offset = offset;
+                        last.last = true;
+                        request->DeliverChunk(last, [ioc, name, slices, parse, save, handle_read]() {
+                            auto finaldata = std::make_shared<LoadResult>();
+                            finaldata->Add(name, std::move(*slices));
+                            handle_read(ioc, finaldata, parse, save);
+                            });
+                    }
+                    else
+                    {
+                        std::cerr << "File read error: " << error.message() << std::endl;
+                        status(CustomResult(sgns::AsyncError::outcome::failure("Local File Read Fail")));
+                        handle_read(ioc, std::shared_ptr<const sgns::LoadResult>(), false, false);
+                    }
+                });
+        }
+
+#ifndef _WIN32
+        /**
+         * A file streamed with direct I/O. Each chunk is a pool buffer, and the next one is read while the
+         * consumer has the current one, so the disk and the consumer work at the same time.
+         */
+        struct DirectStream
+        {
+            std::shared_ptr<DirectFILEDevice> device;
+            std::shared_ptr<AlignedBufferPool> pool;
+            std::shared_ptr<boost::asio::io_context> ioc;
+            std::shared_ptr<LoadRequest> request;
+            std::string name;
+            bool parse = false;
+            bool save = false;
+            MNNLoader::CompletionCallback handle_read;
+            MNNLoader::StatusCallback status;
+            std::vector<BufferSlice> slices;
+            uint64_t offset = 0;
+            std::mutex mutex;
+            /// @brief the read ahead finished, ready holds what it read
+            bool readDone = false;
+            /// @brief the consumer resumed and waits for the read ahead
+            bool consumerWaiting = true;
+            boost::system::error_code error;
+            std::shared_ptr<char> ready;
+            uint64_t readyBytes = 0;
+        };
+
+        void DeliverDirectChunk(std::shared_ptr<DirectStream> stream);
+
+        /**
+         * Mark the next chunk as read and deliver it if the consumer is already waiting for it
+         */
+        void DirectChunkRead(std::shared_ptr<DirectStream> stream, const boost::system::error_code& error, std::shared_ptr<char> data, uint64_t bytes)
+        {
+            bool deliver;
+            {
+                std::lock_guard<std::mutex> lock(stream->mutex);
+                stream->readDone = true;
+                stream->error = error;
+                stream->ready = std::move(data);
+                stream->readyBytes = bytes;
+                deliver = stream->consumerWaiting;
+                stream->consumerWaiting = false;
+            }
+            if (deliver)
+            {
+                DeliverDirectChunk(stream);
+            }
+        }
+
+        void ReadDirectAhead(std::shared_ptr<DirectStream> stream)
+        {
+            if (stream->request->IsCancelled())
+            {
+                DirectChunkRead(stream, boost::asio::error::operation_aborted, nullptr, 0);
+                return;
+            }
+            auto buffer = stream->pool->Acquire();
+            if (!buffer)
+            {
+                DirectChunkRead(stream, boost::system::errc::make_error_code(boost::system::errc::not_enough_memory), nullptr, 0);
+                return;
+            }
+            stream->device->ReadBlock(buffer, stream->pool->BufferSize(), [stream](const boost::system::error_code& error, std::shared_ptr<char> data, uint64_t bytes) {
+                DirectChunkRead(stream, error, std::move(data), bytes);
+                });
+        }
+
+        void DeliverDirectChunk(std::shared_ptr<DirectStream> stream)
+        {
+            std::shared_ptr<char> data;
+            uint64_t bytes;
+            boost::system::error_code error;
+            {
+                std::lock_guard<std::mutex> lock(stream->mutex);
+                data = std::move(stream->ready);
+                bytes = stream->readyBytes;
+                error = stream->error;
+                stream->readDone = false;
+            }
+            if (stream->request->IsCancelled())
+            {
+                stream->handle_read(stream->ioc, std::shared_ptr<const sgns::LoadResult>(), false, false);
+                return;
+            }
+            if (error)
+            {
+                std::cerr << "File read error: " << error.message() << std::endl;
+                stream->status(CustomResult(sgns::AsyncError::outcome::failure("Local File Read Fail")));
+                stream->handle_read(stream->ioc, std::shared_ptr<const sgns::LoadResult>(), false, false);
+                return;
+            }
+            LoadChunk chunk;
+            chunk.name = stream->name;
+            chunk.offset = stream->offset;
+            if (bytes == 0)
+            {
+                chunk.last = true;
+                stream->request->DeliverChunk(chunk, [stream]() {
+                    auto finaldata = std::make_shared<LoadResult>();
+                    finaldata->Add(stream->name, std::move(stream->slices));
+                    stream->handle_read(stream->ioc, finaldata, stream->parse, stream->save);
+                    });
+                return;
+            }
+            chunk.data = BufferSlice(data, data.get(), bytes);
+            stream->slices.push_back(chunk.data);
+            stream->offset += bytes;
+            if (bytes == stream->pool->BufferSize())
+            {
+                ReadDirectAhead(stream);
+            }
+            else
+            {
+                //A short read was the end of the file, there is nothing left to read ahead
+                DirectChunkRead(stream, boost::system::error_code(), nullptr, 0);
+            }
+            stream->request->DeliverChunk(chunk, [stream]() {
+                bool deliver;
+                {
+                    std::lock_guard<std::mutex> lock(stream->mutex);
+                    deliver = stream->readDone;
+                    stream->consumerWaiting = !deliver;
+                }
+                if (deliver)
+                {
+                    DeliverDirectChunk(stream);
+                }
+                });
+        }
+#endif
+
+        /**
+         * Progress of a directory load, files are started in order and finish in any order
+         */
+        struct DirectoryLoad
+        {
+            std::shared_ptr<boost::asio::io_context> ioc;
+            std::shared_ptr<LoadRequest> request;
+            bool parse = false;
+            bool save = false;
+            MNNLoader::CompletionCallback handle_read;
+            MNNLoader::StatusCallback status;
+            /// @brief Path of every file and its name relative to the directory
+            std::vector<std::pair<std::string, std::string>> files;
+            std::vector<std::vector<BufferSlice>> contents;
+            uint64_t totalBytes = 0;
+            std::mutex mutex;
+            size_t next = 0;
+            size_t inFlight = 0;
+            uint64_t bytesRead = 0;
+            bool failed = false;
+        };
+
+        void FinishDirectoryLoad(std::shared_ptr<DirectoryLoad> load)
+        {
+            if (load->failed)
+            {
+                load->status(CustomResult(sgns::AsyncError::outcome::failure("Local Directory Read Fail")));
+                load->handle_read(load->ioc, std::shared_ptr<const sgns::LoadResult>(), false, false);
+                return;
+            }
+            auto finaldata = std::make_shared<LoadResult>();
+            for (size_t i = 0; i < load->files.size(); ++i)
+            {
+                finaldata->Add(std::move(load->files[i].second), std::move(load->contents[i]));
+            }
+            load->handle_read(load->ioc, finaldata, load->parse, load->save);
+        }
+
+        /**
+         * Hand a mapped file to a streaming request a chunk at a time, each chunk a slice of the mapping
+         */
+        void DeliverMappedChunks(std::shared_ptr<const MappedFile> mapped, std::shared_ptr<boost::asio::io_context> ioc, std::shared_ptr<LoadRequest> request,
+            std::string name, bool parse, bool save, MNNLoader::CompletionCallback handle_read, MNNLoader::StatusCallback status)
+        {
+            auto offset = std::make_shared<uint64_t>(0);
+            auto finished = std::make_shared<bool>(false);
+            request->DeliverChunks([mapped, request, name, offset, finished](LoadChunk& chunk) {
+                if (*finished || request->IsCancelled())
+                {
+                    return false;
+                }
+                auto length = std::min<uint64_t>(kChunkSize, mapped->size() - *offset);
+                chunk.name = name;
+                chunk.offset = *offset;
+                chunk.data = BufferSlice(mapped, mapped->data() + *offset, length);
+                *offset += length;
+                chunk.last = *offset == mapped->size();
+                *finished = chunk.last;
+                return true;
+                }, [mapped, ioc, request, name, parse, save, handle_read]() {
+                    if (request->IsCancelled())
+                    {
+                        handle_read(ioc, std::shared_ptr<const sgns::LoadResult>(), false, false);
+                        return;
+                    }
+                    auto finaldata = std::make_shared<LoadResult>();
+                    finaldata->Add(name, BufferSlice(mapped, mapped->data(), mapped->size()));
+                    handle_read(ioc, finaldata, parse, save);
+                });
+        }
+    }
+
     MNNLoader* MNNLoader::_instance = nullptr;
     void MNNLoader::InitializeSingleton() {
         if (_instance == nullptr) {
@@ -30,48 +321,293 @@ namespace sgns
         {
             throw std::range_error("Can not open file");
         }
-        // Read all file to string
-        std::string dataContent((std::istreambuf_iterator<char>(inputFile)),
-                std::istreambuf_iterator<char>());
+        // Read all file to string, sized once from the file instead of grown a character at a time
+        std::error_code sizeError;
+        auto size = std::filesystem::file_size(filename, sizeError);
+        auto result = std::make_shared<string>(sizeError ? 0 : size, '\0');
+        inputFile.read(result->data(), static_cast<std::streamsize>(result->size()));
+        result->resize(static_cast<size_t>(inputFile.gcount()));
         inputFile.close();
-        std::shared_ptr<string> result = std::make_shared<string>(
-                dataContent);
         return result;
     }
 
-    std::shared_ptr<void> MNNLoader::LoadASync(std::string filename,bool parse,bool save,std::shared_ptr<boost::asio::io_context> ioc, CompletionCallback handle_read, StatusCallback status)
+    void MNNLoader::LoadDirectory(std::string directory, bool parse, bool save, std::shared_ptr<boost::asio::io_context> ioc, CompletionCallback handle_read, StatusCallback status, std::shared_ptr<sgns::LoadRequest> request)
+    {
+        auto load = std::make_shared<DirectoryLoad>();
+        load->ioc = ioc;
+        load->request = request;
+        load->parse = parse;
+        load->save = save;
+        load->handle_read = handle_read;
+        load->status = status;
+
+        //Collect the files first so the total is known and names come out in a stable order
+        std::filesystem::path root(directory);
+        std::error_code walkError;
+        for (std::filesystem::recursive_directory_iterator iter(root, std::filesystem::directory_options::skip_permission_denied, walkError), end;
+            !walkError && iter != end; iter.increment(walkError))
+        {
+            std::error_code entryError;
+            if (!iter->is_regular_file(entryError))
+            {
+                continue;
+            }
+            load->files.emplace_back(iter->path().string(), iter->path().lexically_relative(root).generic_string());
+            auto size = iter->file_size(entryError);
+            load->totalBytes += entryError ? 0 : size;
+        }
+        if (walkError)
+        {
+            std::cerr << "Directory read error: " << walkError.message() << std::endl;
+            status(CustomResult(sgns::AsyncError::outcome::failure("Local Directory Read Fail")));
+            handle_read(ioc, std::shared_ptr<const sgns::LoadResult>(), false, false);
+            return;
+        }
+        std::sort(load->files.begin(), load->files.end(), [](const auto& a, const auto& b) { return a.second < b.second; });
+        load->contents.resize(load->files.size());
+        if (load->files.empty())
+        {
+            boost::asio::post(*ioc, [load]() { FinishDirectoryLoad(load); });
+            return;
+        }
+
+        //Each file is a single file load of its own, so it gets the mapped, direct or io_uring path its size calls for.
+        //A finished read starts the next one, which keeps at most the concurrency limit of files open.
+        auto read_next = std::make_shared<std::function<void()>>();
+        std::weak_ptr<std::function<void()>> weak_read_next = read_next;
+        *read_next = [this, load, weak_read_next]() {
+            size_t index;
+            {
+                std::lock_guard<std::mutex> lock(load->mutex);
+                //Files that haven't started yet aren't read once the request is cancelled
+                if (load->failed || load->next == load->files.size() || IsCancelled(load->request))
+                {
+                    return;
+                }
+                index = load->next++;
+                ++load->inFlight;
+            }
+            auto read_next = weak_read_next.lock();
+            LoadASync(load->files[index].first, false, false, load->ioc,
+                [load, index, read_next](std::shared_ptr<boost::asio::io_context>, std::shared_ptr<const sgns::LoadResult> buffers, bool, bool) {
+                    bool finished;
+                    uint64_t bytesRead;
+                    {
+                        std::lock_guard<std::mutex> lock(load->mutex);
+                        if (!buffers || buffers->empty() || (load->request && load->request->IsCancelled()))
+                        {
+                            load->failed = true;
+                        }
+                        else
+                        {
+                            load->contents[index] = buffers->entries.front().slices;
+                            load->bytesRead += buffers->TotalSize();
+                        }
+                        bytesRead = load->bytesRead;
+                        --load->inFlight;
+                        finished = load->inFlight == 0 && (load->failed || load->next == load->files.size());
+                    }
+                    if (load->request)
+                    {
+                        load->request->Report(LoadPhase::Transfer, bytesRead, load->totalBytes);
+                    }
+                    if (finished)
+                    {
+                        FinishDirectoryLoad(load);
+                        return;
+                    }
+                    (*read_next)();
+                },
+                [](const CustomResult&) {}, nullptr);
+        };
+        auto concurrency = std::min(FileManager::GetInstance().GetDirectoryLoadConcurrency(), load->files.size());
+        for (size_t i = 0; i < concurrency; ++i)
+        {
+            (*read_next)();
+        }
+    }
+
+    std::shared_ptr<void> MNNLoader::LoadASync(std::string filename,bool parse,bool save,std::shared_ptr<boost::asio::io_context> ioc, CompletionCallback handle_read, StatusCallback status, std::shared_ptr<sgns::LoadRequest> request)
     {
         std::shared_ptr<string> result = std::make_shared < string>("init");
+        std::error_code directoryError;
+        if (std::filesystem::is_directory(filename, directoryError))
+        {
+            LoadDirectory(filename, parse, save, ioc, handle_read, status, request);
+            return result;
+        }
+        std::error_code sizeError;
+        auto fileSize = std::filesystem::file_size(filename, sizeError);
+        if (request)
+        {
+            request->Report(LoadPhase::Transfer, 0, sizeError ? 0 : fileSize);
+        }
+#ifndef _WIN32
+        //Very big files are read around the page cache, so a one-off load doesn't evict everything else
+        auto directSize = FileManager::GetInstance().GetDirectIOSize();
+        if (directSize != 0 && !sizeError && fileSize >= directSize)
+        {
+            auto directDevice = std::make_shared<DirectFILEDevice>(ioc, filename, 0, FileManager::GetInstance().GetDiskExecutor());
+            if (directDevice->IsOpen())
+            {
+                CloseOnCancel(request, ioc, directDevice);
+                auto name = std::filesystem::path(filename).filename().string();
+                if (request && request->IsStreaming())
+                {
+                    auto stream = std::make_shared<DirectStream>();
+                    stream->device = directDevice;
+                    stream->pool = AlignedBufferPool::Direct();
+                    stream->ioc = ioc;
+                    stream->request = request;
+                    stream->name = name;
+                    stream->parse = parse;
+                    stream->save = save;
+                    stream->handle_read = handle_read;
+                    stream->status = status;
+                    ReadDirectAhead(stream);
+                    return result;
+                }
+                directDevice->ReadAll([ioc, request, handle_read, status, parse, save, name](const boost::system::error_code& error, std::shared_ptr<char> data, uint64_t bytes) {
+                    if (IsCancelled(request))
+                    {
+                        handle_read(ioc, std::shared_ptr<const sgns::LoadResult>(), false, false);
+                        return;
+                    }
+                    if (error)
+                    {
+                        std::cerr << "File read error: " << error.message() << std::endl;
+                        status(CustomResult(sgns::AsyncError::outcome::failure("Local File Read Fail")));
+                        handle_read(ioc, std::shared_ptr<const sgns::LoadResult>(), false, false);
+                        return;
+                    }
+                    auto finaldata = std::make_shared<LoadResult>();
+                    finaldata->Add(name, BufferSlice(data, data.get(), bytes));
+                    handle_read(ioc, finaldata, parse, save);
+                    });
+                return result;
+            }
+        }
+#endif
+        //Big enough files are mapped rather than read, falling back to reading if that fails
+        auto mapSize = FileManager::GetInstance().GetMappedLoadSize();
+        if (mapSize != 0 && !sizeError && fileSize >= mapSize)
+        {
+            boost::system::error_code mapError;
+            auto mapped = MappedFile::Map(filename, mapError);
+            if (mapped)
+            {
+                auto name = std::filesystem::path(filename).filename().string();
+                //Complete from the io_context like a read would, not from inside LoadASync
+                boost::asio::post(*ioc, [mapped, ioc, request, name, parse, save, handle_read, status]() {
+                    if (IsCancelled(request))
+                    {
+                        handle_read(ioc, std::shared_ptr<const sgns::LoadResult>(), false, false);
+                        return;
+                    }
+                    if (request)
+                    {
+                        request->Report(LoadPhase::Transfer, mapped->size(), mapped->size());
+                    }
+                    if (request && request->IsStreaming())
+                    {
+                        DeliverMappedChunks(mapped, ioc, request, name, parse, save, handle_read, status);
+                        return;
+                    }
+                    auto finaldata = std::make_shared<LoadResult>();
+                    finaldata->Add(name, BufferSlice(mapped, mapped->data(), mapped->size()));
+                    handle_read(ioc, finaldata, parse, save);
+                    });
+                return result;
+            }
+            std::cerr << "Mapping " << filename << " failed, reading it instead: " << mapError.message() << std::endl;
+        }
+#if defined(BOOST_ASIO_HAS_IO_URING) && defined(BOOST_ASIO_HAS_FILE)
+        //With io_uring, read straight into a buffer of the file's size with several positioned reads in flight
+        if (!request || !request->IsStreaming())
+        {
+            auto randomDevice = std::make_shared<FILERandomAccessDevice>(ioc, filename, 0);
+            if (randomDevice->IsOpen())
+            {
+                CloseOnCancel(request, ioc, randomDevice);
+                auto content = std::make_shared<std::vector<char>>(randomDevice->Size());
+                randomDevice->Read(0, boost::asio::buffer(*content), [content, ioc, request, handle_read, status, parse, save, filename](const boost::system::error_code& error, uint64_t bytes) {
+                    if (IsCancelled(request))
+                    {
+                        handle_read(ioc, std::shared_ptr<const sgns::LoadResult>(), false, false);
+                        return;
+                    }
+                    if (error == boost::asio::error::eof)
+                    {
+                        //Shrunk since its size was taken, like a stream read the load is what was there
+                        content->resize(bytes);
+                    }
+                    else if (error)
+                    {
+                        std::cerr << "File read error: " << error.message() << std::endl;
+                        status(CustomResult(sgns::AsyncError::outcome::failure("Local File Read Fail")));
+                        handle_read(ioc, std::shared_ptr<const sgns::LoadResult>(), false, false);
+                        return;
+                    }
+                    auto finaldata = std::make_shared<LoadResult>();
+                    finaldata->Add(std::filesystem::path(filename).filename().string(), BufferSlice(content, content->data(), content->size()));
+                    handle_read(ioc, finaldata, parse, save);
+                    });
+                return result;
+            }
+        }
+#endif
         // Create a file device which will have a stream_descriptor or stream_file based on whether we are on posix OS or not.
         auto fileDevice = std::make_shared<FILEDevice>(ioc, filename, 0);
+        CloseOnCancel(request, ioc, fileDevice);
+        if (request && request->IsStreaming())
+        {
+            std::filesystem::path p(filename);
+            ReadFileChunks(fileDevice, ioc, request, p.filename().string(), std::make_shared<std::vector<BufferSlice>>(), 0, parse, save, handle_read, status);
+            return result;
+        }
+        //Reaching the end of the file finishes the read, any other error fails it
+        auto name = std::filesystem::path(filename).filename().string();
+        auto finish_read = [fileDevice, ioc, request, handle_read, status, parse, save, name](const boost::system::error_code& error, BufferSlice content) {
+            if (IsCancelled(request))
+            {
+                handle_read(ioc, std::shared_ptr<const sgns::LoadResult>(), false, false);
+                return;
+            }
+            if (error && error != boost::asio::error::eof)
+            {
+                std::cerr << "File read error: " << error.message() << std::endl;
+                status(CustomResult(sgns::AsyncError::outcome::failure("Local File Read Fail")));
+                handle_read(ioc, std::shared_ptr<const sgns::LoadResult>(), false, false);
+                return;
+            }
+            auto finaldata = std::make_shared<LoadResult>();
+            finaldata->Add(name, std::move(content));
+            handle_read(ioc, finaldata, parse, save);
+        };
+        //Reads stop at the first error, or once the request is cancelled
+        auto read_size = [request](const boost::system::error_code& error, std::size_t) -> std::size_t {
+            return error || IsCancelled(request) ? 0 : kReadSize;
+        };
+        auto size = fileDevice->Size();
+        if (size)
+        {
+            //Allocate the final buffer once at the file's size and read straight into it
+            auto content = std::make_shared<std::vector<char>>(*size);
+            boost::asio::async_read(fileDevice->getFile(), boost::asio::buffer(*content), read_size,
+                [content, finish_read](const boost::system::error_code& error, std::size_t bytes_transferred) {
+                    //A file that shrank since its size was taken ends early
+                    content->resize(bytes_transferred);
+                    finish_read(error, BufferSlice(content, content->data(), content->size()));
+                });
+            return result;
+        }
+        //No size to go by, i.e. a pipe, so grow a streambuf until the end
         auto buffer = std::make_shared<boost::asio::streambuf>();
-        status(CustomResult(sgns::AsyncError::outcome::success(Success{ "Starting local file read" })));
-        ////Async Read.
-       boost::asio::async_read(fileDevice->getFile(), *buffer,
-            boost::asio::transfer_all(),
-            [fileDevice, ioc, handle_read, status, parse, save, buffer, filename](const boost::system::error_code& error, std::size_t bytes_transferred) {
-                if (error.value() == 2)
-                {
-                    std::cout << "LOCAL Finish" << std::endl;
-                    //auto finalbuffer = std::make_shared<std::vector<char>>(boost::asio::buffers_begin(buffer->data()), boost::asio::buffers_end(buffer->data()));
-                    status(CustomResult(sgns::AsyncError::outcome::success(Success{ "Local File Finished Reading" })));
-                    auto finaldata = std::make_shared<std::pair<std::vector<std::string>, std::vector<std::vector<char>>>>();
-                    std::filesystem::path p(filename);
-                    finaldata->first.push_back(p.filename().string());
-                    size_t dataSize = buffer->size();
-                    finaldata->second.emplace_back(
-                        boost::asio::buffers_begin(buffer->data()),
-                        boost::asio::buffers_begin(buffer->data()) + dataSize
-                    );
-                    handle_read(ioc, finaldata, parse, save);
-                }
-                else {
-                    std::cerr << "File read error: " << error.message() << std::endl;
-                    status(CustomResult(sgns::AsyncError::outcome::failure("Local File Read Fail")));
-                    handle_read(ioc, std::shared_ptr<std::pair<std::vector<std::string>, std::vector<std::vector<char>>>>(), false, false);
-                }
+        boost::asio::async_read(fileDevice->getFile(), *buffer, read_size,
+            [buffer, finish_read](const boost::system::error_code& error, std::size_t bytes_transferred) {
+                //Hand the streambuf itself on, no copy
+                finish_read(error, BufferSlice::FromStreambuf(buffer, 0, buffer->size()));
             });
-       
         return result;
     }
 
@@ -5,6 +5,7 @@
 #include <iostream>
 #include <fstream>
 #include <streambuf>
+#include <atomic>
 #include <boost/uuid/uuid.hpp>
 #include <boost/uuid/uuid_generators.hpp>
 #include <boost/lexical_cast.hpp>
@@ -48,9 +49,9 @@ namespace sgns
 
     void MNNSaver::SaveASync(std::shared_ptr<boost::asio::io_context> ioc, 
         std::function<void(std::shared_ptr<boost::asio::io_context> ioc)> handle_write,
-        std::string filename, std::shared_ptr<std::pair<std::vector<std::string>, std::vector<std::vector<char>>>> data, std::string suffix)
+        std::string filename, std::shared_ptr<const sgns::LoadResult> data, std::string suffix)
     {
-        if (data->second.data() == nullptr)
+        if (data == nullptr)
         {
             throw range_error("Can not save with null data");
         }
@@ -60,30 +61,63 @@ namespace sgns
 
         
 
-        //size_t remainingWrites = data.first.size();
-        auto remainingWrites = std::make_shared<size_t>(data->first.size());
-        for (size_t i = 0; i < data->first.size(); ++i) {
+        //Writes complete on whichever io_context thread finishes them
+        if (data->empty())
+        {
+            handle_write(ioc);
+            return;
+        }
+        auto remainingWrites = std::make_shared<std::atomic<size_t>>(data->size());
+        for (const auto& entry : data->entries) {
             //Create Directories for files
-            const std::string& directoryWithFile = filename + data->first[i];
+            const std::string& directoryWithFile = filename + entry.name;
             std::cout << "dirwithfile: " << directoryWithFile << std::endl;
             std::filesystem::path filePath(directoryWithFile);
             std::filesystem::path directory = filePath.parent_path();
             std::filesystem::create_directories(directory);
 
-            //Create Steam for async writes
-            std::ofstream file(directoryWithFile, std::ios::binary);
-            auto fileDevice = std::make_shared<FILEDevice>(ioc, directoryWithFile, 1);
+            //Every file write is a span on the file's own row when tracing
+            auto writeStart = std::chrono::steady_clock::now();
+            auto track = FileManager::GetInstance().GetTracer().IsEnabled() ? directoryWithFile : std::string();
 
-            async_write(fileDevice->getFile(), boost::asio::buffer(data->second[i].data(), data->second[i].size()), boost::asio::transfer_exactly(data->second[i].size()), [fileDevice, ioc, handle_write, data, remainingWrites](const boost::system::error_code& error, std::size_t bytes_transferred)
+            //Gather write straight from the loaded slices, data is captured to keep them alive
+            auto handle_file_written = [ioc, handle_write, data, remainingWrites, writeStart, track](const boost::system::error_code& error, std::size_t bytes_transferred)
                 {
                     std::cout << "wrote" << std::endl;
-                    (*remainingWrites)--;
-                    if (*remainingWrites <= 0)
+                    if (!track.empty())
+                    {
+                        FileManager::GetInstance().GetTracer().Span("write", "save", track, writeStart, std::chrono::steady_clock::now(),
+                            { { "bytes", std::to_string(bytes_transferred) }, { "ok", error ? "false" : "true" } });
+                    }
+                    if (remainingWrites->fetch_sub(1) == 1)
                     {
                         //Handle when written all
                         handle_write(ioc);
                     }
+                };
+#ifndef _WIN32
+            //Very big files are written around the page cache through aligned staging buffers
+            auto directSize = FileManager::GetInstance().GetDirectIOSize();
+            if (directSize != 0 && entry.Size() >= directSize)
+            {
+                auto directDevice = std::make_shared<DirectFILEDevice>(ioc, directoryWithFile, 1, FileManager::GetInstance().GetDiskExecutor());
+                directDevice->Write(entry.AsBuffers(), handle_file_written);
+                continue;
+            }
+#endif
+#if defined(BOOST_ASIO_HAS_IO_URING) && defined(BOOST_ASIO_HAS_FILE)
+            //Positioned writes with several blocks in flight, the device creates and truncates the file
+            auto fileDevice = std::make_shared<FILERandomAccessDevice>(ioc, directoryWithFile, 1);
+            fileDevice->Write(0, entry.AsBuffers(), handle_file_written);
+#else
+            //Create Steam for async writes
+            std::ofstream file(directoryWithFile, std::ios::binary);
+            auto fileDevice = std::make_shared<FILEDevice>(ioc, directoryWithFile, 1);
+            async_write(fileDevice->getFile(), entry.AsBuffers(), boost::asio::transfer_exactly(entry.Size()), [fileDevice, handle_file_written](const boost::system::error_code& error, std::size_t bytes_transferred)
+                {
+                    handle_file_written(error, bytes_transferred);
                 });
+#endif
         }
     }
 
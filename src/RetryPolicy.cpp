@@ -0,0 +1,103 @@
+/**
+ * Source file for the RetryPolicy
+ */
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "RetryPolicy.hpp"
+
+namespace sgns
+{
+    RetryPolicy::RetryPolicy() : random_(std::random_device{}())
+    {
+        //Providers are often not announced yet when a CID is first asked for, keep looking for a while
+        RetryOptions dht;
+        dht.maxAttempts = 10;
+        dht.initialBackoff = std::chrono::seconds(1);
+        dht.maxBackoff = std::chrono::seconds(30);
+        options_["ipfs-dht"] = dht;
+    }
+
+    void RetryPolicy::SetOptions(const std::string& scheme, RetryOptions options)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        options_[scheme] = options;
+    }
+
+    RetryOptions RetryPolicy::GetOptions(const std::string& scheme) const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto iter = options_.find(scheme);
+        return iter == options_.end() ? RetryOptions() : iter->second;
+    }
+
+    void RetryPolicy::SetBudget(double ratio, double cap)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        budgetRatio_ = ratio;
+        budgetCap_ = cap;
+        budget_ = std::min(budget_, cap);
+    }
+
+    void RetryPolicy::RecordAttempt()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        budget_ = std::min(budgetCap_, budget_ + budgetRatio_);
+    }
+
+    bool RetryPolicy::TryWithdraw()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        //Tenths don't add up to exactly one in floating point
+        if (budget_ < 1 - 1e-9)
+        {
+            return false;
+        }
+        budget_ -= 1;
+        return true;
+    }
+
+    std::chrono::milliseconds RetryPolicy::Backoff(const std::string& scheme, size_t retry)
+    {
+        auto options = GetOptions(scheme);
+        double backoff = static_cast<double>(options.initialBackoff.count()) * std::pow(options.multiplier, static_cast<double>(retry));
+        backoff = std::min(backoff, static_cast<double>(options.maxBackoff.count()));
+        //Spread retries out so clients that failed together don't come back together
+        double jitter = std::clamp(options.jitter, 0.0, 1.0);
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::uniform_real_distribution<double> spread(1.0 - jitter, 1.0);
+        return std::chrono::milliseconds(static_cast<int64_t>(backoff * spread(random_)));
+    }
+
+    void RetryPolicy::RecordLatency(const std::string& scheme, std::chrono::milliseconds latency)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& samples = latencies_[scheme];
+        samples.push_back(latency);
+        if (samples.size() > kLatencySamples)
+        {
+            samples.pop_front();
+        }
+    }
+
+    std::chrono::milliseconds RetryPolicy::HedgeDelay(const std::string& scheme) const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto optionsIter = options_.find(scheme);
+        auto samplesIter = latencies_.find(scheme);
+        if (optionsIter == options_.end() || optionsIter->second.hedgePercentile <= 0 || samplesIter == latencies_.end())
+        {
+            return std::chrono::milliseconds(0);
+        }
+        const auto& options = optionsIter->second;
+        const auto& samples = samplesIter->second;
+        if (samples.size() < std::max<size_t>(options.hedgeMinSamples, 1))
+        {
+            return std::chrono::milliseconds(0);
+        }
+        std::vector<std::chrono::milliseconds> sorted(samples.begin(), samples.end());
+        auto rank = static_cast<size_t>(std::min(options.hedgePercentile, 1.0) * (sorted.size() - 1));
+        std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+        return std::max(sorted[rank], std::chrono::milliseconds(1));
+    }
+}
@@ -15,8 +15,10 @@ namespace sgns
         std::string sftp_pubkeyfile,
         std::string sftp_privkeyfile,
         std::string sftp_privkeypass,
-        bool parse, bool save) 
+        bool parse, bool save,
+        std::shared_ptr<LoadRequest> request)
     {
+        request_ = std::move(request);
         sftp_host_ = sftp_host;
         sftp_path_ = sftp_path;
         sftp_user_ = sftp_user;
@@ -32,281 +34,330 @@ namespace sgns
     void SFTPDevice::StartSFTPDownload(std::shared_ptr<boost::asio::io_context> ioc, std::shared_ptr<boost::asio::ip::tcp::socket> tcpSocket, LIBSSH2_SESSION* sftp2session, CompletionCallback handle_read, StatusCallback status)
     {
         if (downloading_) {
-            std::cerr << "Already downloading" << std::endl;
             return;
         }
         downloading_ = true;
-        ip::tcp::resolver resolver(*ioc);
+        ioc_ = ioc;
+        tcpSocket_ = tcpSocket;
+        sftp2session_ = sftp2session;
+        handle_read_ = std::move(handle_read);
+        status_ = std::move(status);
+        if (request_)
+        {
+            //Cancel whatever the coroutine is waiting on, it resumes with an error and fails out
+            request_->OnCancel([weakSelf = std::weak_ptr<SFTPDevice>(shared_from_this())]() {
+                if (auto self = weakSelf.lock())
+                {
+                    boost::asio::post(*self->ioc_, [self]() {
+                        boost::system::error_code ec;
+                        self->tcpSocket_->cancel(ec);
+                        if (self->throttleTimer_)
+                        {
+                            self->throttleTimer_->cancel();
+                        }
+                        });
+                }
+                });
+        }
+        //Wait for a connection slot before touching the network
+        Report(LoadPhase::Queued);
+        auto waiting = FileManager::GetInstance().GetGovernor().AcquireConnection("sftp", sftp_host_, ioc, [self = shared_from_this()](std::shared_ptr<ConnectionLease> lease) {
+            self->lease_ = std::move(lease);
+            self->StartSFTPConnect();
+            });
+        if (waiting != 0 && request_)
+        {
+            //Leave the queue on cancel, so the slot goes to a load that still wants it
+            request_->OnCancel([self = shared_from_this(), waiting]() {
+                if (FileManager::GetInstance().GetGovernor().WithdrawWaiting(waiting))
+                {
+                    boost::asio::post(*self->ioc_, [self]() {
+                        self->Fail("SFTP Load cancelled");
+                        });
+                }
+                });
+        }
+    }
+
+    void SFTPDevice::StartSFTPConnect()
+    {
+        if (request_ && request_->IsCancelled())
+        {
+            Fail("SFTP Load cancelled");
+            return;
+        }
+        ip::tcp::resolver resolver(*ioc_);
         boost::asio::ip::tcp::resolver::results_type resolvedaddr;
+        phaseStart_ = std::chrono::steady_clock::now();
+        Report(LoadPhase::Resolve);
         try {
             resolvedaddr = resolver.resolve(sftp_host_, "22");
-        }
-        catch (const boost::system::system_error& e) {
-            std::cerr << "Error resolving address: " << e.what() << std::endl;
-            status(CustomResult(sgns::AsyncError::outcome::failure("SFTP Could not resolve address")));
+            FileManager::GetInstance().GetMetrics().EndPhase("sftp", LoadPhase::Resolve, phaseStart_);
         }
         catch (const std::exception& e) {
-            std::cerr << "Exception: " << e.what() << std::endl;
-            status(CustomResult(sgns::AsyncError::outcome::failure("SFTP Could not resolve address")));
-        }
-        catch (...) {
-            std::cerr << "Unknown error occurred during address resolution." << std::endl;
-            status(CustomResult(sgns::AsyncError::outcome::failure("SFTP Could not resolve address")));
+            std::cerr << "Error resolving address: " << e.what() << std::endl;
+            Fail("SFTP Could not resolve address");
+            return;
         }
 
-        //auto tcpSocket = std::make_shared<boost::asio::ip::tcp::socket>(*ioc);
-        status(CustomResult(sgns::AsyncError::outcome::success(Success{ "Starting SFTP Connection" })));
-        async_connect(*tcpSocket, resolvedaddr, [self = shared_from_this(), ioc, sftp2session, tcpSocket, handle_read, status](const boost::system::error_code& connect_error, const auto&) {
-            if (!connect_error)
-            {
-                //Setup Socket
-                auto sock = tcpSocket->native_handle();
-                libssh2_session_set_blocking(sftp2session, 0);
-                status(CustomResult(sgns::AsyncError::outcome::success(Success{ "SFTP SSL Handshake Started" })));
-                self->StartSFTPHandshake(ioc, sftp2session, tcpSocket, sock, handle_read, status);
-            }
-            else {
-                std::cerr << "Error connecting to server: " << connect_error.message() << std::endl;
-                status(CustomResult(sgns::AsyncError::outcome::failure("SFTP Connection Error")));
-                handle_read(ioc, std::shared_ptr<std::pair<std::vector<std::string>, std::vector<std::vector<char>>>>(), false, false);
-            }
+        Report(LoadPhase::Connect);
+        async_connect(*tcpSocket_, resolvedaddr, [self = shared_from_this()](const boost::system::error_code& connect_error, const auto&) {
+            self->Step(connect_error);
             });
-
-    }
-    void SFTPDevice::StartSFTPHandshake(std::shared_ptr<boost::asio::io_context> ioc, LIBSSH2_SESSION* sftp2session, std::shared_ptr<boost::asio::ip::tcp::socket> tcpSocket, basic_socket<ip::tcp,any_io_executor>::native_handle_type sock, CompletionCallback handle_read, StatusCallback status)
-    {
-        int rc = libssh2_session_handshake(sftp2session, sock);
-
-        if (rc == 0) {
-            // Handshake successful, proceed with authentication
-            status(CustomResult(sgns::AsyncError::outcome::success(Success{ "Starting SFTP Auth" })));
-            StartSFTPAuth(ioc, sftp2session, tcpSocket, handle_read, status);
-        }
-        else if (rc == LIBSSH2_ERROR_EAGAIN) {
-            tcpSocket->async_wait(boost::asio::socket_base::wait_read, [self = shared_from_this(), ioc, sftp2session, tcpSocket, sock, handle_read, status](const boost::system::error_code& ec) {
-                if (!ec) {
-                    // Continue with handshake
-                    self->StartSFTPHandshake(ioc, sftp2session, tcpSocket, sock, handle_read, status);
-                }
-                else {
-                    // Handle error
-                    status(CustomResult(sgns::AsyncError::outcome::failure("SFTP Handshake Error")));
-                    handle_read(ioc, std::shared_ptr<std::pair<std::vector<std::string>, std::vector<std::vector<char>>>>(), false, false);
-                }
-                });
-        }
-        else
-        {
-            status(CustomResult(sgns::AsyncError::outcome::failure("SFTP Handshake Error")));
-            handle_read(ioc, std::shared_ptr<std::pair<std::vector<std::string>, std::vector<std::vector<char>>>>(), false, false);
-        }
     }
 
-    void SFTPDevice::StartSFTPAuth(std::shared_ptr<boost::asio::io_context> ioc, LIBSSH2_SESSION* sftp2session, std::shared_ptr<boost::asio::ip::tcp::socket> tcpSocket, CompletionCallback handle_read, StatusCallback status)
+    void SFTPDevice::Step(const boost::system::error_code& ec)
     {
-        int auth_result;
-        if (!sftp_privkeyfile_.empty())
+        if (request_ && request_->IsCancelled())
         {
-            auth_result = libssh2_userauth_publickey_fromfile(sftp2session, sftp_user_.c_str(), nullptr, sftp_privkeyfile_.c_str(), nullptr);
+            Fail("SFTP Load cancelled");
+            return;
         }
-        else {
-            if (!sftp_pubkeyfile_.empty()) {
-                auth_result = libssh2_userauth_publickey_fromfile(sftp2session, sftp_user_.c_str(), nullptr, sftp_pubkeyfile_.c_str(), sftp_privkeypass_.c_str());
+        int rc = 0;
+        BOOST_ASIO_CORO_REENTER(coro_)
+        {
+            if (ec)
+            {
+                std::cerr << "Error connecting to server: " << ec.message() << std::endl;
+                Report(LoadPhase::Connect, 0, 0, ec);
+                Fail("SFTP Connection Error");
+                return;
             }
-            else {
-                 auth_result = libssh2_userauth_password(sftp2session, sftp_user_.c_str(), sftp_pass_.c_str());
+            FileManager::GetInstance().GetMetrics().EndPhase("sftp", LoadPhase::Connect, phaseStart_);
+            libssh2_session_set_blocking(sftp2session_, 0);
+
+            //Every libssh2 call below returns EAGAIN until the socket lets it make progress, wait and call it again
+            Report(LoadPhase::Handshake);
+            while ((rc = libssh2_session_handshake(sftp2session_, tcpSocket_->native_handle())) == LIBSSH2_ERROR_EAGAIN)
+            {
+                BOOST_ASIO_CORO_YIELD WaitSocket();
+                if (ec)
+                {
+                    break;
+                }
+            }
+            if (ec || rc != 0)
+            {
+                Fail("SFTP Handshake Error");
+                return;
             }
-        }
 
-        if (auth_result == 0) {
-            // Auth successful, create sftp instance
-            status(CustomResult(sgns::AsyncError::outcome::success(Success{ "Creating SFTP Handler" })));
-            StartCreateSFTP(ioc, sftp2session, tcpSocket, handle_read, status);
+            while ((rc = Authenticate()) == LIBSSH2_ERROR_EAGAIN)
+            {
+                BOOST_ASIO_CORO_YIELD WaitSocket();
+                if (ec)
+                {
+                    break;
+                }
+            }
+            if (ec || rc != 0)
+            {
+                Fail("SFTP Fail, authentication fail");
+                return;
+            }
 
-        }
-        else if (auth_result == LIBSSH2_ERROR_EAGAIN) {
-            tcpSocket->async_wait(socket_base::wait_read, [self = shared_from_this(), ioc, sftp2session, tcpSocket, handle_read, status](const boost::system::error_code& ec) {
-                if (!ec) {
-                    // Continue with auth
-                    self->StartSFTPAuth(ioc, sftp2session, tcpSocket, handle_read, status);
+            //SSH handshake and auth together, the SFTP requests after count towards the first byte
+            FileManager::GetInstance().GetMetrics().EndPhase("sftp", LoadPhase::Handshake, phaseStart_);
+            Report(LoadPhase::FirstByte);
+            while ((sftp_ = libssh2_sftp_init(sftp2session_)) == nullptr && libssh2_session_last_errno(sftp2session_) == LIBSSH2_ERROR_EAGAIN)
+            {
+                BOOST_ASIO_CORO_YIELD WaitSocket();
+                if (ec)
+                {
+                    break;
                 }
-                else {
-                    // Handle error
-                    status(CustomResult(sgns::AsyncError::outcome::failure("SFTP Fail, authentication fail")));
-                    handle_read(ioc, std::shared_ptr<std::pair<std::vector<std::string>, std::vector<std::vector<char>>>>(), false, false);
+            }
+            if (sftp_ == nullptr)
+            {
+                Fail("SFTP Create Error");
+                return;
+            }
+
+            while ((sftpHandle_ = libssh2_sftp_open(sftp_, ("." + sftp_path_).c_str(), LIBSSH2_FXF_READ, 0)) == nullptr
+                && libssh2_session_last_errno(sftp2session_) == LIBSSH2_ERROR_EAGAIN)
+            {
+                BOOST_ASIO_CORO_YIELD WaitSocket();
+                if (ec)
+                {
+                    break;
                 }
-                });
-        }
-        else
-        {
-            status(CustomResult(sgns::AsyncError::outcome::failure("SFTP Fail, authentication fail")));
-            handle_read(ioc, std::shared_ptr<std::pair<std::vector<std::string>, std::vector<std::vector<char>>>>(), false, false);
-        }
-    }
+            }
+            if (sftpHandle_ == nullptr)
+            {
+                Fail("SFTP Open Error");
+                return;
+            }
 
-    void SFTPDevice::StartCreateSFTP(std::shared_ptr<boost::asio::io_context> ioc, LIBSSH2_SESSION* sftp2session, std::shared_ptr<boost::asio::ip::tcp::socket> tcpSocket, CompletionCallback handle_read, StatusCallback status)
-    {
-        auto sftp = libssh2_sftp_init(sftp2session);
-        if (sftp == nullptr) {
-            // Handle the error, if it is EAGAIN we need to continue
-            int sftp_error_code = libssh2_session_last_errno(sftp2session);
-            if (sftp_error_code == LIBSSH2_ERROR_EAGAIN)
+            while ((rc = libssh2_sftp_stat(sftp_, ("." + sftp_path_).c_str(), &sftpAttrs_)) == LIBSSH2_ERROR_EAGAIN)
+            {
+                BOOST_ASIO_CORO_YIELD WaitSocket();
+                if (ec)
+                {
+                    break;
+                }
+            }
+            if (ec || rc != 0)
             {
-                tcpSocket->async_wait(boost::asio::socket_base::wait_read, [self = shared_from_this(), ioc, sftp2session, tcpSocket, sftp, handle_read, status](const boost::system::error_code& ec) {
-                    if (!ec) {
-                        self->StartCreateSFTP(ioc, sftp2session, tcpSocket, handle_read, status);
+                Fail("SFTP File Size does not match");
+                return;
+            }
+            if (CheckNotModified())
+            {
+                StartSFTPCleanup();
+                handle_read_(ioc_, std::shared_ptr<const sgns::LoadResult>(), parse_, save_);
+                return;
+            }
+
+            //Got size, read straight into a buffer of that size
+            file_size_ = sftpAttrs_.filesize;
+            buffer_ = std::make_shared<std::vector<char>>(file_size_);
+            while (totalBytesRead_ < buffer_->size())
+            {
+                if (request_ && request_->IsCancelled())
+                {
+                    Fail("SFTP Load cancelled");
+                    return;
+                }
+                rc = libssh2_sftp_read(sftpHandle_, buffer_->data() + totalBytesRead_, buffer_->size() - totalBytesRead_);
+                if (rc == LIBSSH2_ERROR_EAGAIN)
+                {
+                    BOOST_ASIO_CORO_YIELD WaitSocket();
+                    if (ec)
+                    {
+                        Fail("SFTP Read Failed. Socket not readable");
+                        return;
+                    }
+                }
+                else if (rc <= 0)
+                {
+                    Fail("SFTP Read Failed.");
+                    return;
+                }
+                else
+                {
+                    if (!firstByte_)
+                    {
+                        firstByte_ = true;
+                        FileManager::GetInstance().GetMetrics().EndPhase("sftp", LoadPhase::FirstByte, phaseStart_);
                     }
-                    else {
-                        status(CustomResult(sgns::AsyncError::outcome::failure("SFTP Create Error")));
-                        handle_read(ioc, std::shared_ptr<std::pair<std::vector<std::string>, std::vector<std::vector<char>>>>(), false, false);
+                    totalBytesRead_ += rc;
+                    Report(LoadPhase::Transfer, totalBytesRead_, buffer_->size());
+                    throttleDelay_ = FileManager::GetInstance().GetGovernor().Consume("sftp", sftp_host_, rc);
+                    if (request_ && request_->IsStreaming())
+                    {
+                        //Hand the block on as it lands in the file buffer, the next read waits for the consumer
+                        BOOST_ASIO_CORO_YIELD request_->DeliverChunk(MakeChunk(totalBytesRead_ - rc, rc), [self = shared_from_this()]() {
+                            self->Step();
+                            });
                     }
-                    });
-            }
-            else {
-                status(CustomResult(sgns::AsyncError::outcome::failure("SFTP Create Error")));
-                handle_read(ioc, std::shared_ptr<std::pair<std::vector<std::string>, std::vector<std::vector<char>>>>(), false, false);
+                    if (throttleDelay_ > std::chrono::steady_clock::duration::zero())
+                    {
+                        //Over the bandwidth limit, hold the next read back
+                        BOOST_ASIO_CORO_YIELD WaitThrottle();
+                    }
+                }
             }
+            FinishSFTPRead();
         }
-        else {
-            // SFTP instance initialization succeeded
-            status(CustomResult(sgns::AsyncError::outcome::success(Success{ "Starting SFTP Open" })));
-            StartSFTPOpen(ioc, sftp2session, tcpSocket, sftp, handle_read, status);
+    }
+
+    void SFTPDevice::WaitSocket()
+    {
+        auto direction = (libssh2_session_block_directions(sftp2session_) & LIBSSH2_SESSION_BLOCK_OUTBOUND) ? socket_base::wait_write : socket_base::wait_read;
+        tcpSocket_->async_wait(direction, [self = shared_from_this()](const boost::system::error_code& ec) {
+            self->Step(ec);
+            });
+    }
+
+    void SFTPDevice::WaitThrottle()
+    {
+        if (!throttleTimer_)
+        {
+            throttleTimer_ = std::make_unique<boost::asio::steady_timer>(*ioc_);
         }
+        throttleTimer_->expires_after(throttleDelay_);
+        throttleTimer_->async_wait([self = shared_from_this()](const boost::system::error_code&) {
+            self->Step();
+            });
     }
 
-    void SFTPDevice::StartSFTPOpen(std::shared_ptr<boost::asio::io_context> ioc, LIBSSH2_SESSION* sftp2session, std::shared_ptr<boost::asio::ip::tcp::socket> tcpSocket, LIBSSH2_SFTP* sftp, CompletionCallback handle_read, StatusCallback status)
+    int SFTPDevice::Authenticate()
     {
-        std::string fullPath = "." + sftp_path_;
-        auto sftpHandle = libssh2_sftp_open(sftp, fullPath.c_str(), LIBSSH2_FXF_READ, 0);
-        if (sftpHandle == nullptr)
+        if (!sftp_privkeyfile_.empty())
         {
-            // Handle the error, if it is EAGAIN we need to continue
-            int sftp_error_code = libssh2_session_last_errno(sftp2session);
-            if (sftp_error_code == LIBSSH2_ERROR_EAGAIN)
-            {
-                tcpSocket->async_wait(boost::asio::socket_base::wait_read, [self = shared_from_this(), ioc, sftp2session, tcpSocket, sftp, handle_read, status](const boost::system::error_code& ec) {
-                    if (!ec) {
-                        self->StartSFTPOpen(ioc, sftp2session, tcpSocket, sftp, handle_read, status);
-                    }
-                    else {
-                        status(CustomResult(sgns::AsyncError::outcome::failure("SFTP Open Error")));
-                        handle_read(ioc, std::shared_ptr<std::pair<std::vector<std::string>, std::vector<std::vector<char>>>>(), false, false);
-                    }
-                    });
-            }
-            else {
-                status(CustomResult(sgns::AsyncError::outcome::failure("SFTP Open Error")));
-                handle_read(ioc, std::shared_ptr<std::pair<std::vector<std::string>, std::vector<std::vector<char>>>>(), false, false);
-            }
+            return libssh2_userauth_publickey_fromfile(sftp2session_, sftp_user_.c_str(), nullptr, sftp_privkeyfile_.c_str(), nullptr);
         }
-        else {
-            //SFTP Opened, get file size
-            status(CustomResult(sgns::AsyncError::outcome::success(Success{ "Getting SFTP File Size" })));
-            StartSFTPGetSize(ioc, sftp2session, tcpSocket, sftp, sftpHandle, handle_read, status);
+        if (!sftp_pubkeyfile_.empty())
+        {
+            return libssh2_userauth_publickey_fromfile(sftp2session_, sftp_user_.c_str(), nullptr, sftp_pubkeyfile_.c_str(), sftp_privkeypass_.c_str());
         }
+        return libssh2_userauth_password(sftp2session_, sftp_user_.c_str(), sftp_pass_.c_str());
     }
 
-    void SFTPDevice::StartSFTPGetSize(std::shared_ptr<boost::asio::io_context> ioc, LIBSSH2_SESSION* sftp2session, std::shared_ptr<boost::asio::ip::tcp::socket> tcpSocket, LIBSSH2_SFTP* sftp, LIBSSH2_SFTP_HANDLE* sftpHandle, CompletionCallback handle_read, StatusCallback status)
+    bool SFTPDevice::CheckNotModified()
     {
-        std::string fullPath = "." + sftp_path_;
-        // Get the size of the file
-        LIBSSH2_SFTP_ATTRIBUTES sftpAttrs;
-        int rc = libssh2_sftp_stat(sftp, fullPath.c_str(), &sftpAttrs);
-        if (rc == 0)
+        //Size and mtime validate a cached copy, skip the read if they haven't changed
+        if (!request_ || !(sftpAttrs_.flags & LIBSSH2_SFTP_ATTR_SIZE) || !(sftpAttrs_.flags & LIBSSH2_SFTP_ATTR_ACMODTIME))
         {
-            //Got size, start reading to buffer
-            file_size_ = sftpAttrs.filesize;
-            auto buffer = std::make_shared<std::vector<char>>(file_size_);
-            status(CustomResult(sgns::AsyncError::outcome::success(Success{ "Reading SFTP File" })));
-            StartSFTPGetBlocks(ioc, sftp2session, tcpSocket, sftp, sftpHandle, buffer, 0, handle_read, status);
+            return false;
         }
-        else if (rc == LIBSSH2_ERROR_EAGAIN)
+        auto validator = std::to_string(sftpAttrs_.filesize) + ":" + std::to_string(sftpAttrs_.mtime);
+        if (validator == request_->GetCachedValidator())
         {
-            //Continue getting size
-            tcpSocket->async_wait(socket_base::wait_read, [self = shared_from_this(), ioc, sftp2session, tcpSocket, sftp, sftpHandle, handle_read, status](const boost::system::error_code& ec) {
-                if (!ec) {
-                    self-> StartSFTPGetSize(ioc, sftp2session, tcpSocket, sftp, sftpHandle, handle_read, status);
-                }
-                else {
-                    status(CustomResult(sgns::AsyncError::outcome::failure("SFTP File Size does not match")));
-                    handle_read(ioc, std::shared_ptr<std::pair<std::vector<std::string>, std::vector<std::vector<char>>>>(), false, false);
-                }
-                });
-        }
-        else {
-            status(CustomResult(sgns::AsyncError::outcome::failure("SFTP File Size does not match")));
-            handle_read(ioc, std::shared_ptr<std::pair<std::vector<std::string>, std::vector<std::vector<char>>>>(), false, false);
+            request_->SetNotModified();
+            return true;
         }
+        request_->SetValidator(validator);
+        return false;
     }
 
-    void SFTPDevice::StartSFTPGetBlocks(std::shared_ptr<boost::asio::io_context> ioc, LIBSSH2_SESSION* sftp2session, std::shared_ptr<boost::asio::ip::tcp::socket> tcpSocket, LIBSSH2_SFTP* sftp, LIBSSH2_SFTP_HANDLE* sftpHandle, std::shared_ptr<std::vector<char>> buffer, size_t totalBytesRead, CompletionCallback handle_read, StatusCallback status)
+    LoadChunk SFTPDevice::MakeChunk(size_t offset, size_t size) const
     {
-        //libssh2_session_set_blocking(sftp2session_, 0);
-        int rc;
-        rc = libssh2_sftp_read(sftpHandle, buffer->data() + totalBytesRead, buffer->size() - totalBytesRead);
-        //std::cout << "Reading: " << rc << std::endl;
+        LoadChunk chunk;
+        chunk.name = std::filesystem::path(sftp_path_).filename().string();
+        chunk.offset = offset;
+        chunk.data = BufferSlice(buffer_, buffer_->data() + offset, size);
+        chunk.last = offset + size >= buffer_->size();
+        return chunk;
+    }
 
-        if (rc > 0) {
-            totalBytesRead += rc;
-            // Process data if available
-            if (totalBytesRead >= buffer->size())
-            {
-                //We've read all the data, send to parse/save
-                std::cout << "SFTP Finish" << std::endl;
-                status(CustomResult(sgns::AsyncError::outcome::success(Success{ "SFTP Read Finished" })));
-                auto finaldata = std::make_shared<std::pair<std::vector<std::string>, std::vector<std::vector<char>>>>();
-                std::filesystem::path p(sftp_path_);
-                finaldata->first.push_back(p.filename().string());
-                finaldata->second.push_back(*buffer);
-                handle_read(ioc, finaldata, parse_, save_);
+    void SFTPDevice::Fail(const std::string& message)
+    {
+        status_(CustomResult(sgns::AsyncError::outcome::failure(message)));
+        StartSFTPCleanup();
+        handle_read_(ioc_, std::shared_ptr<const sgns::LoadResult>(), false, false);
+    }
 
-            }
-            else {
-                //Async wait for the next part
-                tcpSocket->async_wait(boost::asio::socket_base::wait_read, [self = shared_from_this(), ioc, sftp2session, tcpSocket, sftp, sftpHandle, buffer, totalBytesRead, handle_read, status](const boost::system::error_code& ec) {
-                    if (!ec) {
-                        // Socket is readable, continue the SFTP read operation
-                        self->StartSFTPGetBlocks(ioc, sftp2session, tcpSocket, sftp, sftpHandle, buffer, totalBytesRead, handle_read, status);
-                    }
-                    else {
-                        // Handle error
-                        status(CustomResult(sgns::AsyncError::outcome::failure("SFTP Read Failure. Next Part not obtained")));
-                        self->StartSFTPCleanup(sftp2session, sftpHandle, sftp);
-                        handle_read(ioc, std::shared_ptr<std::pair<std::vector<std::string>, std::vector<std::vector<char>>>>(), false, false);
-                    }
-                    });
-            }
+    void SFTPDevice::FinishSFTPRead()
+    {
+        //We've read all the data, send to parse/save
+        FileManager::GetInstance().GetMetrics().EndPhase("sftp", LoadPhase::Transfer, phaseStart_);
+        StartSFTPCleanup();
+        auto finaldata = std::make_shared<LoadResult>();
+        std::filesystem::path p(sftp_path_);
+        //The read buffer becomes the result, no copy
+        finaldata->Add(p.filename().string(), BufferSlice(buffer_, buffer_->data(), buffer_->size()));
+        handle_read_(ioc_, finaldata, parse_, save_);
+    }
 
+    void SFTPDevice::StartSFTPCleanup()
+    {
+        if (sftpHandle_ != nullptr)
+        {
+            libssh2_sftp_close_handle(sftpHandle_);
+            sftpHandle_ = nullptr;
         }
-        else if (rc == LIBSSH2_ERROR_EAGAIN) {
-            // Operation would block, set up asynchronous wait
-            tcpSocket->async_wait(boost::asio::socket_base::wait_read, [self = shared_from_this(), ioc, sftp2session, tcpSocket, sftp, sftpHandle, buffer, totalBytesRead, handle_read, status](const boost::system::error_code& ec) {
-                if (!ec) {
-                    // Socket is readable, continue the SFTP read operation
-                    self->StartSFTPGetBlocks(ioc, sftp2session, tcpSocket, sftp, sftpHandle, buffer, totalBytesRead, handle_read, status);
-                }
-                else {
-                    // Handle error
-                    status(CustomResult(sgns::AsyncError::outcome::failure("SFTP Read Failed. Socket not readable")));
-                    self->StartSFTPCleanup(sftp2session, sftpHandle, sftp);
-                    handle_read(ioc, std::shared_ptr<std::pair<std::vector<std::string>, std::vector<std::vector<char>>>>(), false, false);
-                }
-                });
+        if (sftp_ != nullptr)
+        {
+            libssh2_sftp_shutdown(sftp_);
+            sftp_ = nullptr;
         }
-        else {
-            // Handle other errors
-            status(CustomResult(sgns::AsyncError::outcome::failure("SFTP Read Failed.")));
-            StartSFTPCleanup(sftp2session, sftpHandle, sftp);
-            handle_read(ioc, std::shared_ptr<std::pair<std::vector<std::string>, std::vector<std::vector<char>>>>(), false, false);
+        if (sftp2session_ != nullptr)
+        {
+            libssh2_session_disconnect(sftp2session_, "Normal Shutdown");
+            libssh2_session_free(sftp2session_);
+            sftp2session_ = nullptr;
+            libssh2_exit();
         }
     }
-
-    void SFTPDevice::StartSFTPCleanup(LIBSSH2_SESSION* sftp2session, LIBSSH2_SFTP_HANDLE* sftpHandle, LIBSSH2_SFTP* sftp)
-    {
-        libssh2_sftp_close_handle(sftpHandle);
-        libssh2_sftp_shutdown(sftp);
-        libssh2_session_disconnect(sftp2session, "Normal Shutdown");
-        libssh2_session_free(sftp2session);
-        libssh2_exit();
-    }
 }
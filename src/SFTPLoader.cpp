@@ -31,7 +31,7 @@ namespace sgns
         /* TODO: scorpioluck20 - Need to implement this. How we load file base on format file?*/
     }
 
-    std::shared_ptr<void> SFTPLoader::LoadASync(std::string filename, bool parse, bool save, std::shared_ptr<boost::asio::io_context> ioc, CompletionCallback handle_read, StatusCallback status)
+    std::shared_ptr<void> SFTPLoader::LoadASync(std::string filename, bool parse, bool save, std::shared_ptr<boost::asio::io_context> ioc, CompletionCallback handle_read, StatusCallback status, std::shared_ptr<sgns::LoadRequest> request)
     {
             //Parse hostname and path
         std::string sftp_host;
@@ -51,7 +51,7 @@ namespace sgns
         //std::cout << "privkeypass " << sftp_privkeypass << std::endl;
         LIBSSH2_SESSION* session = libssh2_session_init();
         auto tcpSocket = std::make_shared<boost::asio::ip::tcp::socket>(*ioc);
-        auto sftpDevice = std::make_shared<SFTPDevice>(sftp_host, sftp_path, sftp_user, sftp_pass, sftp_pubkeyfile, sftp_privkeyfile, sftp_privkeypass, parse, save);
+        auto sftpDevice = std::make_shared<SFTPDevice>(sftp_host, sftp_path, sftp_user, sftp_pass, sftp_pubkeyfile, sftp_privkeyfile, sftp_privkeypass, parse, save, request);
         sftpDevice->StartSFTPDownload(ioc,tcpSocket,session,handle_read,status);
 
         std::shared_ptr<string> result = std::make_shared < string>("test");
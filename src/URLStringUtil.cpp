@@ -3,6 +3,9 @@
 //
 
 #include "URLStringUtil.h"
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
 #include <stdexcept>
 
 extern void getURLComponents(std::string url, std::string &prefix, std::string& base, std::string& extension)
@@ -116,3 +119,57 @@ extern void parseIPFSUrl(std::string url, std::string& cid, std::string& file)
     cid = url.substr(0, index);
     file = url.substr(index+1, url.length());
 }
+
+extern std::string normalizeURL(const std::string& url)
+{
+    size_t index = url.find("://");
+    if (index == std::string::npos) {
+        throw std::invalid_argument("url");
+    }
+    std::string prefix = url.substr(0, index);
+    std::transform(prefix.begin(), prefix.end(), prefix.begin(), [](unsigned char c) { return std::tolower(c); });
+    std::string rest = url.substr(index + 3);
+    // Fragments never reach the server
+    index = rest.find("#");
+    if (index != std::string::npos) {
+        rest = rest.substr(0, index);
+    }
+    // Keep any query as is, only the path is normalized
+    std::string query;
+    index = rest.find("?");
+    if (index != std::string::npos) {
+        query = rest.substr(index);
+        rest = rest.substr(0, index);
+    }
+    if (prefix == "file") {
+        return prefix + "://" + std::filesystem::path(rest).lexically_normal().generic_string() + query;
+    }
+    if (prefix == "ipfs") {
+        // CIDs are case sensitive, leave them be
+        return prefix + "://" + rest + query;
+    }
+    // Network schemes, host is case insensitive and the default port is implied
+    std::string host = rest;
+    std::string path = "/";
+    index = rest.find("/");
+    if (index != std::string::npos) {
+        host = rest.substr(0, index);
+        path = rest.substr(index);
+    }
+    // Credentials in front of the host are case sensitive
+    std::string userinfo;
+    index = host.rfind("@");
+    if (index != std::string::npos) {
+        userinfo = host.substr(0, index + 1);
+        host = host.substr(index + 1);
+    }
+    std::transform(host.begin(), host.end(), host.begin(), [](unsigned char c) { return std::tolower(c); });
+    index = host.rfind(":");
+    if (index != std::string::npos) {
+        std::string port = host.substr(index + 1);
+        if ((port == "443" && (prefix == "https" || prefix == "wss")) || (port == "80" && (prefix == "http" || prefix == "ws")) || (port == "22" && prefix == "sftp")) {
+            host = host.substr(0, index);
+        }
+    }
+    return prefix + "://" + userinfo + host + std::filesystem::path(path).lexically_normal().generic_string() + query;
+}
@@ -1,17 +1,28 @@
 /**
  * Source file for the WSCommon
  */
+#include <algorithm>
 #include "WSCommon.hpp"
+#include "FileManager.hpp"
 
 namespace sgns
 {
     using namespace boost::asio;
+    namespace
+    {
+        const size_t kWSReadSize = 256 * 1024;
+        const char kWSEndMarker[] = "WSEOF";
+        const size_t kWSEndMarkerSize = sizeof(kWSEndMarker) - 1;
+    }
+
     WSDevice::WSDevice(
         std::string ws_host,
         std::string ws_path,
         std::string ws_port,
-        bool parse, bool save) 
+        bool parse, bool save,
+        std::shared_ptr<LoadRequest> request)
     {
+        request_ = std::move(request);
         ws_host_ = ws_host;
         ws_path_ = ws_path;
         ws_port_ = ws_port;
@@ -20,15 +31,43 @@ namespace sgns
     }
 
     void WSDevice::StartWSDownload(std::shared_ptr<boost::asio::io_context> ioc, CompletionCallback handle_read, StatusCallback status)
+    {
+        //Wait for a connection slot before touching the network
+        Report(LoadPhase::Queued);
+        auto waiting = FileManager::GetInstance().GetGovernor().AcquireConnection("wss", ws_host_, ioc, [self = shared_from_this(), ioc, handle_read, status](std::shared_ptr<ConnectionLease> lease) {
+            self->lease_ = std::move(lease);
+            if (self->request_ && self->request_->IsCancelled()) {
+                handle_read(ioc, std::shared_ptr<const sgns::LoadResult>(), false, false);
+                return;
+            }
+            self->StartWSConnect(ioc, handle_read, status);
+            });
+        if (waiting != 0 && request_) {
+            //Leave the queue on cancel, so the slot goes to a load that still wants it
+            request_->OnCancel([ioc, handle_read, waiting]() {
+                if (FileManager::GetInstance().GetGovernor().WithdrawWaiting(waiting)) {
+                    boost::asio::post(*ioc, [ioc, handle_read]() {
+                        handle_read(ioc, std::shared_ptr<const sgns::LoadResult>(), false, false);
+                        });
+                }
+                });
+        }
+    }
+
+    void WSDevice::StartWSConnect(std::shared_ptr<boost::asio::io_context> ioc, CompletionCallback handle_read, StatusCallback status)
     {
         //Resolve Address
         boost::asio::ip::tcp::resolver resolver(*ioc);
         boost::asio::ip::tcp::resolver::results_type results;
+        phaseStart_ = std::chrono::steady_clock::now();
+        Report(LoadPhase::Resolve);
         try {
             results = resolver.resolve(ws_host_, ws_port_);
+            FileManager::GetInstance().GetMetrics().EndPhase("wss", LoadPhase::Resolve, phaseStart_);
         }
         catch (const boost::system::system_error& e) {
             std::cerr << "Error resolving address: " << e.what() << std::endl;
+            Report(LoadPhase::Resolve, 0, 0, e.code());
             status(CustomResult(sgns::AsyncError::outcome::failure("WSS Could not resolve address")));
         }
         catch (const std::exception& e) {
@@ -54,12 +93,24 @@ namespace sgns
 
         //Create Socket
         auto ws = std::make_shared<boost::beast::websocket::stream<boost::asio::ssl::stream<boost::asio::ip::tcp::socket>>>(*ioc, *ctx);
+        //Closing the socket fails whatever operation is pending, which ends the chain below
+        if (request_) {
+            request_->OnCancel([ioc, weakWs = std::weak_ptr<boost::beast::websocket::stream<boost::asio::ssl::stream<boost::asio::ip::tcp::socket>>>(ws)]() {
+                boost::asio::post(*ioc, [weakWs]() {
+                    if (auto ws = weakWs.lock()) {
+                        boost::system::error_code ec;
+                        boost::beast::get_lowest_layer(*ws).close(ec);
+                    }
+                    });
+                });
+        }
         //Connect to server
-        status(CustomResult(sgns::AsyncError::outcome::success(Success{ "Starting WS Connection" })));
+        Report(LoadPhase::Connect);
         boost::asio::async_connect(ws->next_layer().next_layer(), results.begin(), results.end(), [self = shared_from_this(), ioc, ws, handle_read, status](const boost::system::error_code& error, const auto&) {
             if (!error) {
+                FileManager::GetInstance().GetMetrics().EndPhase("wss", LoadPhase::Connect, self->phaseStart_);
                 // Perform the SSL asynchronous handshake
-                status(CustomResult(sgns::AsyncError::outcome::success(Success{ "WS SSL Handshake Started" })));
+                self->Report(LoadPhase::Handshake);
                 ws->next_layer().async_handshake(boost::asio::ssl::stream_base::client, [self, ioc, ws, handle_read, status](const boost::system::error_code& handshakeError) {
                     if (!handshakeError) {
                         // Perform the WebSocket asynchronous handshake
@@ -67,15 +118,17 @@ namespace sgns
                     }
                     else {
                         std::cerr << "SSL handshake error: " << handshakeError.message() << std::endl;
+                        self->Report(LoadPhase::Handshake, 0, 0, handshakeError);
                         status(CustomResult(sgns::AsyncError::outcome::failure("WS Handshake Error")));
-                        handle_read(ioc, std::shared_ptr<std::pair<std::vector<std::string>, std::vector<std::vector<char>>>>(), false, false);
+                        handle_read(ioc, std::shared_ptr<const sgns::LoadResult>(), false, false);
                     }
                     });
             }
             else {
                 std::cerr << "Connect error: " << error.message() << std::endl;
+                self->Report(LoadPhase::Connect, 0, 0, error);
                 status(CustomResult(sgns::AsyncError::outcome::failure("WS Connection Error")));
-                handle_read(ioc, std::shared_ptr<std::pair<std::vector<std::string>, std::vector<std::vector<char>>>>(), false, false);
+                handle_read(ioc, std::shared_ptr<const sgns::LoadResult>(), false, false);
             }
             });
     }
@@ -86,52 +139,78 @@ namespace sgns
         StatusCallback status)
     {
         // Perform the WebSocket asynchronous handshake
-        status(CustomResult(sgns::AsyncError::outcome::success(Success{ "Starting WS Handshake" })));
         ws->async_handshake(ws_host_, ws_path_, [self = shared_from_this(), ioc, ws, handle_read, status](const boost::system::error_code& handshakeError) {
             if (!handshakeError) {
+                //TLS and the upgrade together
+                FileManager::GetInstance().GetMetrics().EndPhase("wss", LoadPhase::Handshake, self->phaseStart_);
                 //Request the file
-                status(CustomResult(sgns::AsyncError::outcome::success(Success{ "Getting WS File" })));
+                self->Report(LoadPhase::FirstByte);
                 std::string request = "GET_FILE";
                 ws->async_write(boost::asio::buffer(request), [self, ioc, ws, handle_read, status](const boost::system::error_code& write_error, std::size_t bytes_transferred) {
                     if (!write_error) {
                         //Read until WSEOF
-                        status(CustomResult(sgns::AsyncError::outcome::success(Success{ "Reading WS File" })));
                         auto buffer = std::make_shared<boost::asio::streambuf>();
-                        boost::asio::async_read_until(*ws, *buffer, "WSEOF", [self, ioc, ws, handle_read, status, buffer](const boost::system::error_code& read_error, std::size_t bytes_transferred) {
-                            if (!read_error)
-                            {
-                                //auto outbuf = std::make_shared<std::vector<char>>(boost::asio::buffers_begin(buffer->data()), boost::asio::buffers_end(buffer->data()) - 5);
-                                //std::cout << "WSS Finish" << std::endl;
-                                status(CustomResult(sgns::AsyncError::outcome::success(Success{ "Finished Reading WS File" })));
-                                auto finaldata = std::make_shared<std::pair<std::vector<std::string>, std::vector<std::vector<char>>>>();
-                                std::filesystem::path p(self->ws_path_);
-                                finaldata->first.push_back(p.filename().string());
-                                //finaldata->second.push_back(*outbuf);
-                                size_t dataSize = buffer->size()-5;
-                                finaldata->second.emplace_back(
-                                    boost::asio::buffers_begin(buffer->data()),
-                                    boost::asio::buffers_begin(buffer->data()) + dataSize
-                                );
-                                handle_read(ioc, finaldata, self->parse_, self->save_);
-                            }
-                            else {
-                                std::cerr << "File request read error: " << read_error.message() << std::endl;
-                                status(CustomResult(sgns::AsyncError::outcome::failure("WS Read Failed. No EOF")));
-                                handle_read(ioc, std::shared_ptr<std::pair<std::vector<std::string>, std::vector<std::vector<char>>>>(), false, false);
-                            }
-                            });
+                        self->ReadWSFile(ioc, ws, buffer, handle_read, status);
                     }
                     else {
                         std::cerr << "File request write error: " << write_error.message() << std::endl;
                         status(CustomResult(sgns::AsyncError::outcome::failure("WS Read Failed. Request file failed.")));
+                        handle_read(ioc, std::shared_ptr<const sgns::LoadResult>(), false, false);
                     }
                     });
             }
             else {
                 std::cerr << "WebSocket handshake error: " << handshakeError.message() << std::endl;
+                self->Report(LoadPhase::Handshake, 0, 0, handshakeError);
                 status(CustomResult(sgns::AsyncError::outcome::failure("WS Handshake Error")));
-                handle_read(ioc, std::shared_ptr<std::pair<std::vector<std::string>, std::vector<std::vector<char>>>>(), false, false);
+                handle_read(ioc, std::shared_ptr<const sgns::LoadResult>(), false, false);
+            }
+            });
+    }
+
+    void WSDevice::ReadWSFile(std::shared_ptr<boost::asio::io_context> ioc,
+        std::shared_ptr<boost::beast::websocket::stream<boost::asio::ssl::stream<boost::asio::ip::tcp::socket>>> ws,
+        std::shared_ptr<boost::asio::streambuf> buffer,
+        CompletionCallback handle_read,
+        StatusCallback status)
+    {
+        size_t searched = buffer->size();
+        ws->async_read_some(buffer->prepare(kWSReadSize), [self = shared_from_this(), ioc, ws, buffer, searched, handle_read, status](const boost::system::error_code& read_error, std::size_t bytes_transferred) {
+            buffer->commit(bytes_transferred);
+            if (bytes_transferred > 0 && !self->firstByte_) {
+                self->firstByte_ = true;
+                FileManager::GetInstance().GetMetrics().EndPhase("wss", LoadPhase::FirstByte, self->phaseStart_);
+            }
+            if (self->request_ && self->request_->IsCancelled()) {
+                status(CustomResult(sgns::AsyncError::outcome::failure("WS Load cancelled")));
+                handle_read(ioc, std::shared_ptr<const sgns::LoadResult>(), false, false);
+                return;
+            }
+            //The marker can straddle two reads, back up far enough to catch it
+            const char* begin = static_cast<const char*>(buffer->data().data());
+            const char* end = begin + buffer->size();
+            const char* from = begin + (searched > kWSEndMarkerSize - 1 ? searched - (kWSEndMarkerSize - 1) : 0);
+            const char* marker = std::search(from, end, kWSEndMarker, kWSEndMarker + kWSEndMarkerSize);
+            if (marker != end)
+            {
+                FileManager::GetInstance().GetMetrics().EndPhase("wss", LoadPhase::Transfer, self->phaseStart_);
+                auto finaldata = std::make_shared<LoadResult>();
+                std::filesystem::path p(self->ws_path_);
+                //Slice off the WSEOF marker, no copy
+                finaldata->Add(p.filename().string(), BufferSlice::FromStreambuf(buffer, 0, marker - begin));
+                handle_read(ioc, finaldata, self->parse_, self->save_);
+                return;
+            }
+            if (read_error) {
+                std::cerr << "File request read error: " << read_error.message() << std::endl;
+                status(CustomResult(sgns::AsyncError::outcome::failure("WS Read Failed. No EOF")));
+                handle_read(ioc, std::shared_ptr<const sgns::LoadResult>(), false, false);
+                return;
             }
+            self->Report(LoadPhase::Transfer, buffer->size());
+            FileManager::GetInstance().GetGovernor().Throttle("wss", self->ws_host_, bytes_transferred, ioc, [self, ioc, ws, buffer, handle_read, status]() {
+                self->ReadWSFile(ioc, ws, buffer, handle_read, status);
+                });
             });
     }
 }
\ No newline at end of file
@@ -32,7 +32,7 @@ namespace sgns
         /* TODO: scorpioluck20 - Need to implement this. How we load file base on format file?*/
     }
 
-    std::shared_ptr<void> WSLoader::LoadASync(std::string filename, bool parse, bool save, std::shared_ptr<boost::asio::io_context> ioc, CompletionCallback handle_read, StatusCallback status)
+    std::shared_ptr<void> WSLoader::LoadASync(std::string filename, bool parse, bool save, std::shared_ptr<boost::asio::io_context> ioc, CompletionCallback handle_read, StatusCallback status, std::shared_ptr<sgns::LoadRequest> request)
     {
         //Parse hostname and path
         std::string ws_host;
@@ -43,7 +43,7 @@ namespace sgns
         std::cout << "path " << ws_path << std::endl;
         std::cout << "port " << ws_port << std::endl;
 
-        auto httpDevice = std::make_shared<WSDevice>(ws_host, ws_path, ws_port, parse, save);
+        auto httpDevice = std::make_shared<WSDevice>(ws_host, ws_path, ws_port, parse, save, request);
         httpDevice->StartWSDownload(ioc, handle_read, status);
 
         std::shared_ptr<string> result = std::make_shared < string>("test");
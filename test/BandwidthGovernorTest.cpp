@@ -0,0 +1,145 @@
+/**
+ * Tests of the connection limits and byte rate buckets shared by the network loaders
+ */
+#include <gtest/gtest.h>
+#include "BandwidthGovernor.hpp"
+
+namespace
+{
+    using sgns::BandwidthGovernor;
+    using sgns::ConnectionLease;
+    using sgns::GovernorLimits;
+
+    GovernorLimits Connections(size_t maxConnections)
+    {
+        GovernorLimits limits;
+        limits.maxConnections = maxConnections;
+        return limits;
+    }
+
+    GovernorLimits Rate(uint64_t bytesPerSecond)
+    {
+        GovernorLimits limits;
+        limits.bytesPerSecond = bytesPerSecond;
+        return limits;
+    }
+}
+
+TEST(BandwidthGovernorTest, GrantsRightAwayWithoutLimits)
+{
+    BandwidthGovernor governor;
+    auto ioc = std::make_shared<boost::asio::io_context>();
+    std::shared_ptr<ConnectionLease> lease;
+    EXPECT_EQ(governor.AcquireConnection("https", "host", ioc, [&lease](std::shared_ptr<ConnectionLease> granted) { lease = granted; }), 0u);
+    ASSERT_NE(lease, nullptr);
+    EXPECT_EQ(governor.GetActiveConnections(), 1u);
+    lease.reset();
+    EXPECT_EQ(governor.GetActiveConnections(), 0u);
+}
+
+TEST(BandwidthGovernorTest, HostLimitQueuesUntilALeaseEnds)
+{
+    BandwidthGovernor governor;
+    governor.SetHostLimits("a", Connections(1));
+    auto ioc = std::make_shared<boost::asio::io_context>();
+    std::shared_ptr<ConnectionLease> first, second, other;
+    governor.AcquireConnection("https", "a", ioc, [&first](std::shared_ptr<ConnectionLease> lease) { first = lease; });
+    EXPECT_NE(governor.AcquireConnection("https", "a", ioc, [&second](std::shared_ptr<ConnectionLease> lease) { second = lease; }), 0u);
+    //Other hosts aren't held back
+    governor.AcquireConnection("https", "b", ioc, [&other](std::shared_ptr<ConnectionLease> lease) { other = lease; });
+    EXPECT_NE(first, nullptr);
+    EXPECT_EQ(second, nullptr);
+    EXPECT_NE(other, nullptr);
+    EXPECT_EQ(governor.GetWaitingConnections(), 1u);
+    first.reset();
+    //Granted waiters start from the io_context
+    EXPECT_EQ(second, nullptr);
+    ioc->run();
+    EXPECT_NE(second, nullptr);
+    EXPECT_EQ(governor.GetWaitingConnections(), 0u);
+}
+
+TEST(BandwidthGovernorTest, SchemeAndGlobalLimitsApplyToo)
+{
+    BandwidthGovernor governor;
+    governor.SetSchemeLimits("wss", Connections(1));
+    governor.SetGlobalLimits(Connections(2));
+    auto ioc = std::make_shared<boost::asio::io_context>();
+    std::vector<std::shared_ptr<ConnectionLease>> leases;
+    auto keep = [&leases](std::shared_ptr<ConnectionLease> lease) { leases.push_back(lease); };
+    governor.AcquireConnection("wss", "a", ioc, keep);
+    governor.AcquireConnection("wss", "b", ioc, keep);
+    governor.AcquireConnection("https", "c", ioc, keep);
+    governor.AcquireConnection("https", "d", ioc, keep);
+    EXPECT_EQ(leases.size(), 2u);
+    EXPECT_EQ(governor.GetWaitingConnections(), 2u);
+}
+
+TEST(BandwidthGovernorTest, RaisingALimitGrantsWaiters)
+{
+    BandwidthGovernor governor;
+    governor.SetHostLimits("a", Connections(1));
+    auto ioc = std::make_shared<boost::asio::io_context>();
+    std::vector<std::shared_ptr<ConnectionLease>> leases;
+    auto keep = [&leases](std::shared_ptr<ConnectionLease> lease) { leases.push_back(lease); };
+    governor.AcquireConnection("https", "a", ioc, keep);
+    governor.AcquireConnection("https", "a", ioc, keep);
+    governor.SetHostLimits("a", Connections(2));
+    ioc->run();
+    EXPECT_EQ(leases.size(), 2u);
+}
+
+TEST(BandwidthGovernorTest, WithdrawnWaitersAreNeverGranted)
+{
+    BandwidthGovernor governor;
+    governor.SetHostLimits("a", Connections(1));
+    auto ioc = std::make_shared<boost::asio::io_context>();
+    std::shared_ptr<ConnectionLease> first;
+    bool granted = false;
+    governor.AcquireConnection("https", "a", ioc, [&first](std::shared_ptr<ConnectionLease> lease) { first = lease; });
+    auto waiting = governor.AcquireConnection("https", "a", ioc, [&granted](std::shared_ptr<ConnectionLease>) { granted = true; });
+    EXPECT_TRUE(governor.WithdrawWaiting(waiting));
+    EXPECT_FALSE(governor.WithdrawWaiting(waiting));
+    first.reset();
+    ioc->run();
+    EXPECT_FALSE(granted);
+    EXPECT_EQ(governor.GetActiveConnections(), 0u);
+}
+
+TEST(BandwidthGovernorTest, ConsumeWithinTheBurstDoesNotWait)
+{
+    BandwidthGovernor governor;
+    governor.SetGlobalLimits(Rate(1000));
+    EXPECT_EQ(governor.Consume("https", "a", 500), std::chrono::steady_clock::duration::zero());
+    EXPECT_EQ(governor.Consume("https", "a", 400), std::chrono::steady_clock::duration::zero());
+}
+
+TEST(BandwidthGovernorTest, ConsumeOverTheRateWaitsForTheDebt)
+{
+    BandwidthGovernor governor;
+    governor.SetHostLimits("a", Rate(1000));
+    governor.Consume("https", "a", 1000);
+    auto wait = governor.Consume("https", "a", 500);
+    //Half a second to pay off 500 bytes at 1000 per second, less whatever refilled in between
+    EXPECT_GT(wait, std::chrono::milliseconds(400));
+    EXPECT_LE(wait, std::chrono::milliseconds(500));
+    //Other hosts have their own bucket
+    EXPECT_EQ(governor.Consume("https", "b", 5000), std::chrono::steady_clock::duration::zero());
+}
+
+TEST(BandwidthGovernorTest, ThrottleRunsNextAfterTheWait)
+{
+    BandwidthGovernor governor;
+    governor.SetGlobalLimits(Rate(10000));
+    auto ioc = std::make_shared<boost::asio::io_context>();
+    bool ranAtOnce = false;
+    governor.Throttle("https", "a", 10000, ioc, [&ranAtOnce]() { ranAtOnce = true; });
+    EXPECT_TRUE(ranAtOnce);
+    bool ran = false;
+    auto start = std::chrono::steady_clock::now();
+    governor.Throttle("https", "a", 1000, ioc, [&ran]() { ran = true; });
+    EXPECT_FALSE(ran);
+    ioc->run();
+    EXPECT_TRUE(ran);
+    EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(50));
+}
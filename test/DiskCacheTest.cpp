@@ -0,0 +1,189 @@
+/**
+ * Tests of the on-disk cache of network loads
+ */
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+#include "base_mnn_test.hpp"
+#include "DiskCache.hpp"
+
+namespace
+{
+    using sgns::DiskCache;
+    using sgns::LoadResult;
+
+    LoadResult MakeData(const std::string& name, size_t size, char fill)
+    {
+        LoadResult data;
+        data.Add(name, sgns::BufferSlice::FromVector(std::vector<char>(size, fill)));
+        return data;
+    }
+
+    std::string Contents(const sgns::BufferEntry& entry)
+    {
+        std::string contents(entry.Size(), '\0');
+        entry.CopyTo(contents.data());
+        return contents;
+    }
+
+    class DiskCacheTest : public test::BaseMNNTest
+    {
+    public:
+        DiskCacheTest() : BaseMNNTest("asynciomanager_diskcache_test")
+        {
+        }
+
+    protected:
+        std::string Directory() const
+        {
+            return (base_path / "cache").string();
+        }
+    };
+}
+
+TEST_F(DiskCacheTest, DisabledUntilOpened)
+{
+    DiskCache cache;
+    EXPECT_FALSE(cache.IsEnabled());
+    EXPECT_FALSE(cache.Store("https://host/a.mnn", MakeData("a.mnn", 10, 'a'), "etag:1"));
+    DiskCache::Entry entry;
+    EXPECT_FALSE(cache.Lookup("https://host/a.mnn", entry));
+}
+
+TEST_F(DiskCacheTest, StoreThenRead)
+{
+    DiskCache cache;
+    ASSERT_TRUE(cache.Open(Directory(), 1 << 20));
+    EXPECT_TRUE(cache.IsEnabled());
+    ASSERT_TRUE(cache.Store("https://host/a.mnn", MakeData("a.mnn", 100, 'a'), "etag:\"v1\""));
+    DiskCache::Entry entry;
+    ASSERT_TRUE(cache.Lookup("HTTPS://Host:443/a.mnn", entry));
+    EXPECT_EQ(entry.validator, "etag:\"v1\"");
+    EXPECT_EQ(entry.bytes, 100u);
+    auto data = cache.Read("https://host/a.mnn");
+    ASSERT_NE(data, nullptr);
+    ASSERT_EQ(data->size(), 1u);
+    EXPECT_EQ(data->entries[0].name, "a.mnn");
+    EXPECT_EQ(Contents(data->entries[0]), std::string(100, 'a'));
+    EXPECT_EQ(cache.GetBytes(), 100u);
+}
+
+TEST_F(DiskCacheTest, KeepsEveryFileOfAnEntry)
+{
+    DiskCache cache;
+    ASSERT_TRUE(cache.Open(Directory(), 1 << 20));
+    LoadResult data;
+    data.Add("dir/one.bin", sgns::BufferSlice::FromVector(std::vector<char>(10, '1')));
+    data.Add("dir/two.bin", sgns::BufferSlice::FromVector(std::vector<char>(20, '2')));
+    ASSERT_TRUE(cache.Store("wss://host/dir", data, ""));
+    auto read = cache.Read("wss://host/dir");
+    ASSERT_NE(read, nullptr);
+    ASSERT_EQ(read->size(), 2u);
+    EXPECT_EQ(read->entries[0].name, "dir/one.bin");
+    EXPECT_EQ(Contents(read->entries[0]), std::string(10, '1'));
+    EXPECT_EQ(read->entries[1].name, "dir/two.bin");
+    EXPECT_EQ(Contents(read->entries[1]), std::string(20, '2'));
+}
+
+TEST_F(DiskCacheTest, SurvivesAReopen)
+{
+    {
+        DiskCache cache;
+        ASSERT_TRUE(cache.Open(Directory(), 1 << 20));
+        ASSERT_TRUE(cache.Store("https://host/a.mnn", MakeData("a.mnn", 100, 'a'), "etag:1"));
+    }
+    //Leftovers of an interrupted write are cleared on open
+    createFile("cache/stray.tmp");
+    DiskCache cache;
+    ASSERT_TRUE(cache.Open(Directory(), 1 << 20));
+    DiskCache::Entry entry;
+    ASSERT_TRUE(cache.Lookup("https://host/a.mnn", entry));
+    EXPECT_EQ(entry.validator, "etag:1");
+    auto data = cache.Read("https://host/a.mnn");
+    ASSERT_NE(data, nullptr);
+    EXPECT_EQ(Contents(data->entries[0]), std::string(100, 'a'));
+    EXPECT_FALSE(exists(base_path / "cache" / "stray.tmp"));
+}
+
+TEST_F(DiskCacheTest, StoringAgainReplacesTheEntry)
+{
+    DiskCache cache;
+    ASSERT_TRUE(cache.Open(Directory(), 1 << 20));
+    ASSERT_TRUE(cache.Store("https://host/a.mnn", MakeData("a.mnn", 100, 'a'), "etag:1"));
+    ASSERT_TRUE(cache.Store("https://host/a.mnn", MakeData("a.mnn", 50, 'b'), "etag:2"));
+    DiskCache::Entry entry;
+    ASSERT_TRUE(cache.Lookup("https://host/a.mnn", entry));
+    EXPECT_EQ(entry.validator, "etag:2");
+    EXPECT_EQ(cache.GetBytes(), 50u);
+    EXPECT_EQ(Contents(cache.Read("https://host/a.mnn")->entries[0]), std::string(50, 'b'));
+}
+
+TEST_F(DiskCacheTest, EvictsTheLeastRecentlyUsedOverTheCap)
+{
+    DiskCache cache;
+    ASSERT_TRUE(cache.Open(Directory(), 250));
+    ASSERT_TRUE(cache.Store("https://host/a", MakeData("a", 100, 'a'), ""));
+    ASSERT_TRUE(cache.Store("https://host/b", MakeData("b", 100, 'b'), ""));
+    ASSERT_TRUE(cache.Store("https://host/c", MakeData("c", 100, 'c'), ""));
+    DiskCache::Entry entry;
+    EXPECT_FALSE(cache.Lookup("https://host/a", entry));
+    EXPECT_TRUE(cache.Lookup("https://host/c", entry));
+    EXPECT_LE(cache.GetBytes(), 250u);
+    //Bigger than the whole cache
+    EXPECT_FALSE(cache.Store("https://host/d", MakeData("d", 300, 'd'), ""));
+}
+
+TEST_F(DiskCacheTest, EraseRemovesTheEntry)
+{
+    DiskCache cache;
+    ASSERT_TRUE(cache.Open(Directory(), 1 << 20));
+    ASSERT_TRUE(cache.Store("https://host/a", MakeData("a", 100, 'a'), ""));
+    cache.Erase("https://host/a");
+    DiskCache::Entry entry;
+    EXPECT_FALSE(cache.Lookup("https://host/a", entry));
+    EXPECT_EQ(cache.Read("https://host/a"), nullptr);
+    EXPECT_EQ(cache.GetBytes(), 0u);
+}
+
+TEST_F(DiskCacheTest, RejectsNamesThatWouldBreakTheIndex)
+{
+    DiskCache cache;
+    ASSERT_TRUE(cache.Open(Directory(), 1 << 20));
+    EXPECT_FALSE(cache.Store("https://host/a", MakeData("bad\nname", 10, 'a'), ""));
+    EXPECT_FALSE(cache.Store("https://host/a", MakeData("a", 10, 'a'), "etag:\n"));
+}
+
+TEST_F(DiskCacheTest, ConcurrentStoresAndReads)
+{
+    DiskCache cache;
+    ASSERT_TRUE(cache.Open(Directory(), 1 << 20));
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t)
+    {
+        threads.emplace_back([&cache, t]() {
+            auto url = "https://host/" + std::to_string(t);
+            for (int i = 0; i < 20; ++i)
+            {
+                cache.Store(url, MakeData("f", 1000, static_cast<char>('a' + i % 26)), "etag:" + std::to_string(i));
+                auto data = cache.Read(url);
+                if (data)
+                {
+                    EXPECT_EQ(data->TotalSize(), 1000u);
+                }
+            }
+            });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    EXPECT_EQ(cache.GetBytes(), 8000u);
+    DiskCache reopened;
+    ASSERT_TRUE(reopened.Open(Directory(), 1 << 20));
+    for (int t = 0; t < 8; ++t)
+    {
+        DiskCache::Entry entry;
+        ASSERT_TRUE(reopened.Lookup("https://host/" + std::to_string(t), entry));
+        EXPECT_EQ(entry.validator, "etag:19");
+    }
+}
@@ -0,0 +1,558 @@
+/**
+ * Tests of FileManager loads of local files, through every read path the file loader has, and of batches,
+ * races and retries on top of them
+ */
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <csignal>
+#include <fstream>
+#include <future>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "base_mnn_test.hpp"
+#include "FILECommon.hpp"
+#include "FileManager.hpp"
+#include "MNNLoader.hpp"
+
+namespace
+{
+    using sgns::LoadRequest;
+
+    std::vector<char> MakeContents(size_t size, unsigned seed = 0)
+    {
+        std::vector<char> contents(size);
+        for (size_t i = 0; i < size; ++i)
+        {
+            contents[i] = static_cast<char>((i * 31 + seed) % 251);
+        }
+        return contents;
+    }
+
+    std::vector<char> Contents(const sgns::BufferEntry& entry)
+    {
+        std::vector<char> contents(entry.Size());
+        entry.CopyTo(contents.data());
+        return contents;
+    }
+
+    /// Whether the process has the file mapped, mapped loads keep it in /proc/self/maps while their result is held
+    bool IsMapped(const std::string& path)
+    {
+        std::ifstream maps("/proc/self/maps");
+        std::string line;
+        while (std::getline(maps, line))
+        {
+            if (line.size() >= path.size() && line.compare(line.size() - path.size(), path.size(), path) == 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    class FileManagerTest : public test::BaseMNNTest
+    {
+    public:
+        FileManagerTest() : BaseMNNTest("asynciomanager_filemanager_test")
+        {
+        }
+
+        void SetUp() override
+        {
+            BaseMNNTest::SetUp();
+            sgns::MNNLoader::InitializeSingleton();
+            ioc_ = std::make_shared<boost::asio::io_context>();
+            work_ = std::make_unique<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>>(ioc_->get_executor());
+            thread_ = std::thread([ioc = ioc_]() { ioc->run(); });
+            FileManager::GetInstance().GetMetrics().Reset();
+        }
+
+        void TearDown() override
+        {
+            work_.reset();
+            ioc_->stop();
+            thread_.join();
+            //The manager outlives the test, put back what the tests changed
+            auto& manager = FileManager::GetInstance();
+            manager.SetCacheByteBudget(0);
+            manager.SetMappedLoads(0);
+            manager.SetDirectIO(0);
+            manager.SetDirectoryLoadConcurrency(16);
+            manager.SetMaxOutstandingBlocks(0);
+            manager.GetRetryPolicy().SetOptions("file", sgns::RetryOptions());
+            manager.GetTracer().Disable();
+            BaseMNNTest::TearDown();
+        }
+
+    protected:
+        std::string WriteFile(const std::string& name, const std::vector<char>& contents)
+        {
+            auto path = base_path / name;
+            fs::create_directories(path.parent_path());
+            std::ofstream file(path.string(), std::ios::binary | std::ios::trunc);
+            file.write(contents.data(), contents.size());
+            return path.string();
+        }
+
+        static std::string URL(const std::string& path)
+        {
+            return "file://" + path;
+        }
+
+        std::shared_ptr<LoadRequest> Load(const std::string& url, LoadRequest::ChunkHandler onChunk = nullptr)
+        {
+            return FileManager::GetInstance().LoadASync(url, false, false, ioc_, nullptr, [](std::shared_ptr<const sgns::LoadResult>) {}, "", std::move(onChunk));
+        }
+
+        /// Load a file and wait for the result, empty if it failed
+        LoadRequest::LoadBuffers LoadAndWait(const std::string& url)
+        {
+            auto request = Load(url);
+            EXPECT_TRUE(request->WaitFor(std::chrono::seconds(10)));
+            return request->GetResult();
+        }
+
+        std::shared_ptr<boost::asio::io_context> ioc_;
+        std::unique_ptr<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>> work_;
+        std::thread thread_;
+    };
+}
+
+TEST_F(FileManagerTest, LoadsALocalFile)
+{
+    auto contents = MakeContents(100000);
+    auto path = WriteFile("model.mnn", contents);
+    auto result = LoadAndWait(URL(path));
+    ASSERT_NE(result, nullptr);
+    ASSERT_EQ(result->size(), 1u);
+    EXPECT_EQ(result->entries[0].name, "model.mnn");
+    EXPECT_EQ(Contents(result->entries[0]), contents);
+}
+
+TEST_F(FileManagerTest, MissingFileFails)
+{
+    auto request = Load(URL((base_path / "missing.mnn").string()));
+    ASSERT_TRUE(request->WaitFor(std::chrono::seconds(10)));
+    EXPECT_EQ(request->GetState(), LoadRequest::State::Failed);
+    EXPECT_EQ(request->GetResult(), nullptr);
+}
+
+TEST_F(FileManagerTest, EmptyFileLoadsEmpty)
+{
+    auto path = WriteFile("empty.bin", {});
+    auto result = LoadAndWait(URL(path));
+    ASSERT_NE(result, nullptr);
+    EXPECT_EQ(result->TotalSize(), 0u);
+}
+
+TEST_F(FileManagerTest, CacheServesUnchangedFilesOnly)
+{
+    auto& manager = FileManager::GetInstance();
+    manager.SetCacheByteBudget(1 << 20);
+    auto path = WriteFile("model.mnn", MakeContents(1000));
+    auto hits = manager.GetCache().GetStats().hits;
+    ASSERT_NE(LoadAndWait(URL(path)), nullptr);
+    ASSERT_NE(LoadAndWait(URL(path)), nullptr);
+    EXPECT_EQ(manager.GetCache().GetStats().hits, hits + 1);
+    //A rewrite changes the validator, the stale copy must not be served
+    auto rewritten = MakeContents(2000, 7);
+    WriteFile("model.mnn", rewritten);
+    auto result = LoadAndWait(URL(path));
+    ASSERT_NE(result, nullptr);
+    EXPECT_EQ(Contents(result->entries[0]), rewritten);
+}
+
+TEST_F(FileManagerTest, MappedLoadsShareThePagesAndStayUncached)
+{
+    auto& manager = FileManager::GetInstance();
+    manager.SetCacheByteBudget(1 << 24);
+    manager.SetMappedLoads(4096);
+    auto big = MakeContents(1 << 20);
+    auto bigPath = WriteFile("big.bin", big);
+    auto smallPath = WriteFile("small.bin", MakeContents(100));
+    auto insertions = manager.GetCache().GetStats().insertions;
+    {
+        auto result = LoadAndWait(URL(bigPath));
+        ASSERT_NE(result, nullptr);
+        EXPECT_EQ(Contents(result->entries[0]), big);
+#ifdef __linux__
+        EXPECT_TRUE(IsMapped(fs::canonical(bigPath).string()));
+#endif
+        ASSERT_NE(LoadAndWait(URL(smallPath)), nullptr);
+    }
+    //Only the small file was read and cached, the mapping went with the last holder of the result
+    EXPECT_EQ(manager.GetCache().GetStats().insertions, insertions + 1);
+#ifdef __linux__
+    EXPECT_FALSE(IsMapped(fs::canonical(bigPath).string()));
+#endif
+}
+
+TEST_F(FileManagerTest, DirectIOReadsUnalignedFiles)
+{
+    FileManager::GetInstance().SetDirectIO(4096);
+    //Not a multiple of the block size, the tail is read into an aligned buffer too
+    auto contents = MakeContents(3 * 1024 * 1024 + 123);
+    auto path = WriteFile("weights.bin", contents);
+    auto result = LoadAndWait(URL(path));
+    ASSERT_NE(result, nullptr);
+    EXPECT_EQ(Contents(result->entries[0]), contents);
+}
+
+TEST_F(FileManagerTest, DirectIOWritesThroughBothStages)
+{
+    FileManager::GetInstance().SetDirectIO(4096);
+    //Several stages in two source buffers, ending in an unaligned tail
+    auto first = MakeContents(5 * 1024 * 1024 + 7);
+    auto second = MakeContents(4 * 1024 * 1024 + 100, 3);
+    auto path = (base_path / "written.bin").string();
+    auto device = std::make_shared<sgns::DirectFILEDevice>(ioc_, path, 1, FileManager::GetInstance().GetDiskExecutor());
+    ASSERT_TRUE(device->IsOpen());
+    std::promise<std::pair<boost::system::error_code, uint64_t>> written;
+    device->Write({ boost::asio::buffer(first), boost::asio::buffer(second) }, [&written](const boost::system::error_code& error, uint64_t bytes) {
+        written.set_value({ error, bytes });
+        });
+    auto future = written.get_future();
+    ASSERT_EQ(future.wait_for(std::chrono::seconds(10)), std::future_status::ready);
+    auto [error, bytes] = future.get();
+    EXPECT_FALSE(error);
+    EXPECT_EQ(bytes, first.size() + second.size());
+    device.reset();
+    auto expected = first;
+    expected.insert(expected.end(), second.begin(), second.end());
+    auto result = LoadAndWait(URL(path));
+    ASSERT_NE(result, nullptr);
+    EXPECT_EQ(Contents(result->entries[0]), expected);
+}
+
+TEST_F(FileManagerTest, StreamingDeliversEveryByteInOrder)
+{
+    auto contents = MakeContents(3 * 1024 * 1024 + 5);
+    auto path = WriteFile("stream.bin", contents);
+    std::vector<char> streamed;
+    bool sawLast = false;
+    auto request = Load(URL(path), [&streamed, &sawLast](const sgns::LoadChunk& chunk, std::function<void()> resume) {
+        EXPECT_EQ(chunk.offset, streamed.size());
+        EXPECT_EQ(chunk.name, "stream.bin");
+        streamed.insert(streamed.end(), chunk.data.data, chunk.data.data + chunk.data.size);
+        sawLast = chunk.last;
+        resume();
+        });
+    ASSERT_TRUE(request->WaitFor(std::chrono::seconds(10)));
+    ASSERT_EQ(request->GetState(), LoadRequest::State::Completed);
+    EXPECT_TRUE(sawLast);
+    EXPECT_EQ(streamed, contents);
+    EXPECT_EQ(Contents(request->GetResult()->entries[0]), contents);
+}
+
+TEST_F(FileManagerTest, StreamingAMappedFile)
+{
+    FileManager::GetInstance().SetMappedLoads(4096);
+    auto contents = MakeContents(2 * 1024 * 1024 + 17);
+    auto path = WriteFile("mapped.bin", contents);
+    std::vector<char> streamed;
+    size_t lastChunks = 0;
+    auto request = Load(URL(path), [&streamed, &lastChunks](const sgns::LoadChunk& chunk, std::function<void()> resume) {
+        //Only the final chunk is marked last
+        EXPECT_EQ(lastChunks, 0u);
+        streamed.insert(streamed.end(), chunk.data.data, chunk.data.data + chunk.data.size);
+        lastChunks += chunk.last ? 1 : 0;
+        resume();
+        });
+    ASSERT_TRUE(request->WaitFor(std::chrono::seconds(10)));
+    ASSERT_EQ(request->GetState(), LoadRequest::State::Completed);
+    EXPECT_EQ(lastChunks, 1u);
+    EXPECT_EQ(streamed, contents);
+}
+
+TEST_F(FileManagerTest, StreamingACachedEmptyFileEndsWithALastChunk)
+{
+    auto& manager = FileManager::GetInstance();
+    manager.SetCacheByteBudget(1 << 20);
+    auto path = WriteFile("cached_empty.bin", {});
+    auto hits = manager.GetCache().GetStats().hits;
+    ASSERT_NE(LoadAndWait(URL(path)), nullptr);
+    //The hit has the whole file already, it is streamed as chunks of the cached result
+    size_t chunks = 0;
+    bool sawLast = false;
+    auto request = Load(URL(path), [&chunks, &sawLast](const sgns::LoadChunk& chunk, std::function<void()> resume) {
+        ++chunks;
+        EXPECT_EQ(chunk.data.size, 0u);
+        sawLast = chunk.last;
+        resume();
+        });
+    ASSERT_TRUE(request->WaitFor(std::chrono::seconds(10)));
+    ASSERT_EQ(request->GetState(), LoadRequest::State::Completed);
+    EXPECT_EQ(manager.GetCache().GetStats().hits, hits + 1);
+    EXPECT_EQ(chunks, 1u);
+    EXPECT_TRUE(sawLast);
+}
+
+TEST_F(FileManagerTest, ParseFailuresReachTheCaller)
+{
+    struct BrokenParser : public FileParser
+    {
+        std::shared_ptr<void> ParseData(std::shared_ptr<void>) override
+        {
+            throw std::runtime_error("not a model");
+        }
+        std::shared_ptr<void> ParseASync(std::shared_ptr<const sgns::LoadResult>) override
+        {
+            throw std::runtime_error("not a model");
+        }
+    };
+    static BrokenParser parser;
+    auto& manager = FileManager::GetInstance();
+    manager.RegisterParser("broken", &parser);
+    auto path = WriteFile("model.broken", MakeContents(100));
+    //The Done event comes after the request completes, so what the handlers fill in must outlive the test
+    struct Reported
+    {
+        std::mutex mutex;
+        std::vector<std::string> failures;
+        boost::system::error_code parseError;
+    };
+    auto reported = std::make_shared<Reported>();
+    auto request = manager.LoadASync(URL(path), true, false, ioc_,
+        [reported](const CustomResult& result) {
+            std::lock_guard<std::mutex> lock(reported->mutex);
+            if (result.has_error())
+            {
+                reported->failures.push_back(result.error());
+            }
+        },
+        [](std::shared_ptr<const sgns::LoadResult>) {}, "", nullptr, sgns::LoadPriority::Normal, std::chrono::milliseconds(0),
+        [reported](const sgns::LoadEvent& event) {
+            std::lock_guard<std::mutex> lock(reported->mutex);
+            if (event.phase == sgns::LoadPhase::Parse && event.error)
+            {
+                reported->parseError = event.error;
+            }
+        });
+    ASSERT_TRUE(request->WaitFor(std::chrono::seconds(10)));
+    EXPECT_EQ(request->GetResult(), nullptr);
+    std::lock_guard<std::mutex> lock(reported->mutex);
+    EXPECT_TRUE(reported->parseError);
+    ASSERT_FALSE(reported->failures.empty());
+    EXPECT_NE(reported->failures.front().find("not a model"), std::string::npos);
+}
+
+TEST_F(FileManagerTest, DirectoryLoadReturnsEveryFileByRelativeName)
+{
+    auto& manager = FileManager::GetInstance();
+    manager.SetDirectoryLoadConcurrency(2);
+    //Mixed sizes so the files go through different read paths
+    manager.SetMappedLoads(64 * 1024);
+    std::map<std::string, std::vector<char>> files = {
+        { "a.bin", MakeContents(10, 1) },
+        { "b.bin", MakeContents(100 * 1024, 2) },
+        { "sub/c.bin", MakeContents(1000, 3) },
+        { "sub/deeper/d.bin", MakeContents(0, 4) },
+        { "z.bin", MakeContents(5000, 5) },
+    };
+    for (const auto& [name, contents] : files)
+    {
+        WriteFile("model/" + name, contents);
+    }
+    auto result = LoadAndWait(URL((base_path / "model").string()));
+    ASSERT_NE(result, nullptr);
+    ASSERT_EQ(result->size(), files.size());
+    size_t i = 0;
+    for (const auto& [name, contents] : files)
+    {
+        EXPECT_EQ(result->entries[i].name, name);
+        EXPECT_EQ(Contents(result->entries[i]), contents);
+        ++i;
+    }
+}
+
+TEST_F(FileManagerTest, EmptyDirectoryLoadsEmpty)
+{
+    createDir("empty");
+    auto result = LoadAndWait(URL((base_path / "empty").string()));
+    ASSERT_NE(result, nullptr);
+    EXPECT_TRUE(result->empty());
+}
+
+TEST_F(FileManagerTest, ConcurrentLoadsShareOneTransfer)
+{
+    auto contents = MakeContents(1 << 20);
+    auto path = WriteFile("shared.bin", contents);
+    std::vector<std::shared_ptr<LoadRequest>> requests;
+    for (int i = 0; i < 8; ++i)
+    {
+        requests.push_back(Load(URL(path)));
+    }
+    for (auto& request : requests)
+    {
+        ASSERT_TRUE(request->WaitFor(std::chrono::seconds(10)));
+        ASSERT_NE(request->GetResult(), nullptr);
+        EXPECT_EQ(Contents(request->GetResult()->entries[0]), contents);
+    }
+    auto counters = FileManager::GetInstance().GetMetrics().Snapshot().targets[{ "file", "" }];
+    EXPECT_GE(counters.requests, 1u);
+    EXPECT_LE(counters.requests, 8u);
+    EXPECT_EQ(counters.errors, 0u);
+}
+
+TEST_F(FileManagerTest, CancelledLoadReportsCancelled)
+{
+    //A pipe only gets to the loader as it is written, and writes to it fail once the loader closed its end
+    auto path = (base_path / "cancel.fifo").string();
+    ASSERT_EQ(mkfifo(path.c_str(), 0600), 0);
+    signal(SIGPIPE, SIG_IGN);
+    int writer = -1;
+    //Opening either end waits for the other
+    std::thread opener([&writer, &path]() { writer = open(path.c_str(), O_WRONLY); });
+    std::mutex mutex;
+    std::condition_variable chunked;
+    std::function<void()> held;
+    auto request = Load(URL(path), [&mutex, &chunked, &held](const sgns::LoadChunk&, std::function<void()> resume) {
+        //Hold on to the first chunk so the load is still running when it is cancelled
+        std::lock_guard<std::mutex> lock(mutex);
+        held = resume;
+        chunked.notify_all();
+        });
+    opener.join();
+    ASSERT_NE(writer, -1);
+    auto contents = MakeContents(4096);
+    ASSERT_EQ(write(writer, contents.data(), contents.size()), static_cast<ssize_t>(contents.size()));
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        ASSERT_TRUE(chunked.wait_for(lock, std::chrono::seconds(10), [&held] { return held != nullptr; }));
+    }
+    EXPECT_TRUE(request->Cancel());
+    ASSERT_TRUE(request->WaitFor(std::chrono::seconds(10)));
+    EXPECT_EQ(request->GetState(), LoadRequest::State::Cancelled);
+    EXPECT_EQ(request->GetResult(), nullptr);
+    //Resuming after the cancel must not read on, the loader closes the file instead
+    held();
+    fcntl(writer, F_SETFL, O_NONBLOCK);
+    bool closed = false;
+    for (int i = 0; i < 1000 && !closed; ++i)
+    {
+        closed = write(writer, contents.data(), contents.size()) == -1 && errno == EPIPE;
+        if (!closed)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+    EXPECT_TRUE(closed);
+    close(writer);
+}
+
+TEST_F(FileManagerTest, FailedAttemptsAreRetried)
+{
+    auto& manager = FileManager::GetInstance();
+    sgns::RetryOptions options;
+    options.maxAttempts = 3;
+    options.initialBackoff = std::chrono::milliseconds(10);
+    manager.GetRetryPolicy().SetOptions("file", options);
+    manager.GetRetryPolicy().SetBudget(0.1, 10);
+    //The Done event comes after the request completes, so the events must outlive the test
+    struct Reported
+    {
+        std::mutex mutex;
+        std::vector<sgns::LoadEvent> events;
+    };
+    auto reported = std::make_shared<Reported>();
+    auto request = manager.LoadASync(URL((base_path / "missing.bin").string()), false, false, ioc_, nullptr, [](std::shared_ptr<const sgns::LoadResult>) {}, "",
+        nullptr, sgns::LoadPriority::Normal, std::chrono::milliseconds(0), [reported](const sgns::LoadEvent& event) {
+            std::lock_guard<std::mutex> lock(reported->mutex);
+            reported->events.push_back(event);
+        });
+    ASSERT_TRUE(request->WaitFor(std::chrono::seconds(10)));
+    EXPECT_EQ(request->GetState(), LoadRequest::State::Failed);
+    auto counters = manager.GetMetrics().Snapshot().targets[{ "file", "" }];
+    EXPECT_EQ(counters.requests, 3u);
+    EXPECT_EQ(counters.errors, 3u);
+    std::lock_guard<std::mutex> lock(reported->mutex);
+    EXPECT_EQ(std::count_if(reported->events.begin(), reported->events.end(), [](const sgns::LoadEvent& event) { return event.phase == sgns::LoadPhase::Retry; }), 2);
+}
+
+TEST_F(FileManagerTest, TracerRecordsTheLoad)
+{
+    auto& manager = FileManager::GetInstance();
+    manager.GetTracer().Enable();
+    auto path = WriteFile("traced.bin", MakeContents(1000));
+    ASSERT_NE(LoadAndWait(URL(path)), nullptr);
+    auto json = manager.GetTracer().ChromeTraceJSON();
+    EXPECT_NE(json.find(URL(path)), std::string::npos);
+    EXPECT_NE(json.find("\"name\":\"transfer\""), std::string::npos);
+    auto text = manager.GetMetrics().PrometheusText();
+    EXPECT_NE(text.find("asyncio_bytes_total{scheme=\"file\",host=\"\"} 1000\n"), std::string::npos);
+}
+
+TEST_F(FileManagerTest, LoadManyLoadsEveryItem)
+{
+    std::vector<std::string> urls;
+    for (int i = 0; i < 10; ++i)
+    {
+        urls.push_back(URL(WriteFile("batch/" + std::to_string(i) + ".bin", MakeContents(1000 + i, i))));
+    }
+    urls.push_back(URL((base_path / "batch" / "missing.bin").string()));
+    sgns::LoadBatchOptions options;
+    options.maxInFlight = 3;
+    std::atomic<size_t> items{ 0 };
+    std::atomic<bool> done{ false };
+    auto batch = FileManager::GetInstance().LoadMany(urls, options, ioc_,
+        [&items](size_t, const std::string&, LoadRequest::State, LoadRequest::LoadBuffers) { ++items; },
+        [&done](const sgns::LoadBatch&) { done = true; });
+    batch->Wait();
+    EXPECT_EQ(items, urls.size());
+    EXPECT_TRUE(batch->IsDone());
+    EXPECT_EQ(batch->GetFinishedCount(), urls.size());
+    for (size_t i = 0; i < 10; ++i)
+    {
+        ASSERT_EQ(batch->GetState(i), LoadRequest::State::Completed);
+        EXPECT_EQ(Contents(batch->GetResult(i)->entries[0]), MakeContents(1000 + i, i));
+    }
+    EXPECT_EQ(batch->GetState(10), LoadRequest::State::Failed);
+    EXPECT_EQ(batch->GetResult(10), nullptr);
+    //Wait returns only once the batch handler has run
+    EXPECT_TRUE(done);
+}
+
+TEST_F(FileManagerTest, LoadAnyTakesTheSourceWithTheRightDigest)
+{
+    std::vector<std::string> urls = {
+        URL((base_path / "missing.bin").string()),
+        URL(WriteFile("wrong.bin", { 'a', 'b', 'd' })),
+        URL(WriteFile("right.bin", { 'a', 'b', 'c' })),
+    };
+    sgns::LoadRaceOptions options;
+    //SHA-256 of "abc"
+    options.sha256 = "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad";
+    auto request = FileManager::GetInstance().LoadAny(urls, options, ioc_, nullptr, [](std::shared_ptr<const sgns::LoadResult>) {});
+    ASSERT_TRUE(request->WaitFor(std::chrono::seconds(10)));
+    ASSERT_EQ(request->GetState(), LoadRequest::State::Completed);
+    EXPECT_EQ(Contents(request->GetResult()->entries[0]), (std::vector<char>{ 'a', 'b', 'c' }));
+}
+
+TEST_F(FileManagerTest, LoadAnyFailsWhenNoSourceMatches)
+{
+    std::vector<std::string> urls = {
+        URL(WriteFile("one.bin", { 'x' })),
+        URL(WriteFile("two.bin", { 'y' })),
+    };
+    sgns::LoadRaceOptions options;
+    options.sha256 = "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad";
+    options.maxParallel = 1;
+    auto request = FileManager::GetInstance().LoadAny(urls, options, ioc_, nullptr, [](std::shared_ptr<const sgns::LoadResult>) {});
+    ASSERT_TRUE(request->WaitFor(std::chrono::seconds(10)));
+    EXPECT_EQ(request->GetState(), LoadRequest::State::Failed);
+}
+
+TEST_F(FileManagerTest, BitswapBlocksAreUnlimitedByDefault)
+{
+    auto& manager = FileManager::GetInstance();
+    //A default cap would hold every load back once that many blocks wait on slow peers
+    EXPECT_EQ(manager.GetMaxOutstandingBlocks(), 0u);
+    manager.SetMaxOutstandingBlocks(64);
+    EXPECT_EQ(manager.GetMaxOutstandingBlocks(), 64u);
+}
@@ -0,0 +1,29 @@
+/**
+ * Tests of the typed load events and the text built from them
+ */
+#include <gtest/gtest.h>
+#include "LoadEvent.hpp"
+
+namespace
+{
+    using sgns::LoadEvent;
+    using sgns::LoadPhase;
+    using std::chrono::milliseconds;
+}
+
+TEST(LoadEventTest, ToStringDescribesTheEvent)
+{
+    LoadEvent event;
+    event.phase = LoadPhase::Transfer;
+    event.bytes = 1024;
+    event.totalBytes = 4096;
+    EXPECT_EQ(event.ToString(), "Transferring 1024/4096 bytes");
+    LoadEvent retry;
+    retry.phase = LoadPhase::Retry;
+    retry.delay = milliseconds(250);
+    EXPECT_EQ(retry.ToString(), "Retrying in 250 ms");
+    LoadEvent failed;
+    failed.phase = LoadPhase::FirstByte;
+    failed.error = sgns::MakeHTTPStatusError(404);
+    EXPECT_EQ(failed.ToString(), "Waiting for data failed: HTTP status 404");
+}
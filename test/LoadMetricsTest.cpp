@@ -0,0 +1,102 @@
+/**
+ * Tests of the request counters, phase latency histograms and their Prometheus output
+ */
+#include <gtest/gtest.h>
+#include "LoadMetrics.hpp"
+
+namespace
+{
+    using sgns::LoadMetrics;
+    using sgns::LoadPhase;
+    using std::chrono::milliseconds;
+
+    bool Contains(const std::string& text, const std::string& part)
+    {
+        return text.find(part) != std::string::npos;
+    }
+}
+
+TEST(LoadMetricsTest, HostOfDropsUserAndPort)
+{
+    EXPECT_EQ(LoadMetrics::HostOf("https", "example.com:8443/a.mnn"), "example.com");
+    EXPECT_EQ(LoadMetrics::HostOf("sftp", "user:pass@host:22/a.mnn"), "host");
+    EXPECT_EQ(LoadMetrics::HostOf("file", "/models/a.mnn"), "");
+    EXPECT_EQ(LoadMetrics::HostOf("ipfs", "QmAbCdEf/a.mnn"), "");
+}
+
+TEST(LoadMetricsTest, CountersAddUpPerTarget)
+{
+    LoadMetrics metrics;
+    metrics.RecordRequest("https", "a");
+    metrics.RecordRequest("https", "a");
+    metrics.RecordBytes("https", "a", 100);
+    metrics.RecordError("https", "a");
+    metrics.RecordRequest("wss", "b");
+    auto snapshot = metrics.Snapshot();
+    auto& a = snapshot.targets[{ "https", "a" }];
+    EXPECT_EQ(a.requests, 2u);
+    EXPECT_EQ(a.bytes, 100u);
+    EXPECT_EQ(a.errors, 1u);
+    EXPECT_EQ((snapshot.targets[{ "wss", "b" }].requests), 1u);
+    metrics.Reset();
+    EXPECT_TRUE(metrics.Snapshot().targets.empty());
+}
+
+TEST(LoadMetricsTest, HistogramBucketsByUpperBound)
+{
+    LoadMetrics metrics;
+    metrics.RecordPhase("https", LoadPhase::Connect, milliseconds(1));
+    metrics.RecordPhase("https", LoadPhase::Connect, milliseconds(40));
+    metrics.RecordPhase("https", LoadPhase::Connect, std::chrono::seconds(120));
+    auto histogram = metrics.Snapshot().phases[{ "https", LoadPhase::Connect }];
+    const auto& bounds = sgns::LatencyHistogram::Bounds();
+    ASSERT_EQ(histogram.buckets.size(), bounds.size() + 1);
+    //A bound is inclusive
+    EXPECT_EQ(histogram.buckets[0], 1u);
+    EXPECT_EQ(histogram.buckets.back(), 1u);
+    EXPECT_EQ(histogram.count, 3u);
+    EXPECT_NEAR(histogram.sum, 120.041, 1e-9);
+}
+
+TEST(LoadMetricsTest, PrometheusTextHasEveryMetric)
+{
+    LoadMetrics metrics;
+    metrics.RecordRequest("https", "example.com");
+    metrics.RecordBytes("https", "example.com", 2048);
+    metrics.RecordPhase("https", LoadPhase::FirstByte, milliseconds(20));
+    metrics.RecordPhase("https", LoadPhase::FirstByte, milliseconds(200));
+    auto text = metrics.PrometheusText();
+    EXPECT_TRUE(Contains(text, "# TYPE asyncio_requests_total counter\n"));
+    EXPECT_TRUE(Contains(text, "asyncio_requests_total{scheme=\"https\",host=\"example.com\"} 1\n"));
+    EXPECT_TRUE(Contains(text, "asyncio_bytes_total{scheme=\"https\",host=\"example.com\"} 2048\n"));
+    EXPECT_TRUE(Contains(text, "asyncio_errors_total{scheme=\"https\",host=\"example.com\"} 0\n"));
+    EXPECT_TRUE(Contains(text, "# TYPE asyncio_phase_seconds histogram\n"));
+    //Buckets are cumulative
+    EXPECT_TRUE(Contains(text, "asyncio_phase_seconds_bucket{scheme=\"https\",phase=\"first_byte\",le=\"0.025\"} 1\n"));
+    EXPECT_TRUE(Contains(text, "asyncio_phase_seconds_bucket{scheme=\"https\",phase=\"first_byte\",le=\"0.25\"} 2\n"));
+    EXPECT_TRUE(Contains(text, "asyncio_phase_seconds_bucket{scheme=\"https\",phase=\"first_byte\",le=\"+Inf\"} 2\n"));
+    EXPECT_TRUE(Contains(text, "asyncio_phase_seconds_count{scheme=\"https\",phase=\"first_byte\"} 2\n"));
+}
+
+TEST(LoadMetricsTest, PrometheusLabelsAreEscaped)
+{
+    LoadMetrics metrics;
+    metrics.RecordRequest("https", "a\"b\\c");
+    EXPECT_TRUE(Contains(metrics.PrometheusText(), "host=\"a\\\"b\\\\c\""));
+}
+
+TEST(LoadMetricsTest, PrometheusSumIsExact)
+{
+    LoadMetrics metrics;
+    metrics.RecordPhase("https", LoadPhase::FirstByte, milliseconds(123456789));
+    metrics.RecordPhase("https", LoadPhase::FirstByte, milliseconds(1));
+    auto text = metrics.PrometheusText();
+    std::string prefix = "asyncio_phase_seconds_sum{scheme=\"https\",phase=\"first_byte\"} ";
+    auto start = text.find(prefix);
+    ASSERT_NE(start, std::string::npos);
+    auto sum = std::stod(text.substr(start + prefix.size()));
+    auto phases = metrics.Snapshot().phases;
+    EXPECT_EQ(sum, phases[std::make_pair(std::string("https"), LoadPhase::FirstByte)].sum);
+    //Bucket bounds keep their short form
+    EXPECT_TRUE(Contains(text, "le=\"0.025\""));
+}
@@ -0,0 +1,130 @@
+/**
+ * Tests of the transfer admission limits and priority classes
+ */
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include "LoadScheduler.hpp"
+
+namespace
+{
+    using sgns::LoadPriority;
+    using sgns::LoadScheduler;
+}
+
+TEST(LoadSchedulerTest, UnlimitedStartsEverything)
+{
+    LoadScheduler scheduler;
+    scheduler.SetLimits(0, 0);
+    int started = 0;
+    for (int i = 0; i < 10; ++i)
+    {
+        EXPECT_TRUE(scheduler.Submit(scheduler.NewTicket(), LoadPriority::Normal, [&started]() { ++started; }));
+    }
+    EXPECT_EQ(started, 10);
+    EXPECT_EQ(scheduler.GetActiveCount(), 10u);
+}
+
+TEST(LoadSchedulerTest, QueuesOverTheLimitUntilReleased)
+{
+    LoadScheduler scheduler;
+    scheduler.SetLimits(2, 0);
+    std::vector<int> started;
+    std::vector<LoadScheduler::Ticket> tickets;
+    for (int i = 0; i < 4; ++i)
+    {
+        tickets.push_back(scheduler.NewTicket());
+        scheduler.Submit(tickets.back(), LoadPriority::Normal, [&started, i]() { started.push_back(i); });
+    }
+    EXPECT_EQ(started, (std::vector<int>{ 0, 1 }));
+    EXPECT_EQ(scheduler.GetQueuedCount(), 2u);
+    scheduler.Release(tickets[0]);
+    EXPECT_EQ(started, (std::vector<int>{ 0, 1, 2 }));
+    scheduler.Release(tickets[1]);
+    scheduler.Release(tickets[2]);
+    EXPECT_EQ(started, (std::vector<int>{ 0, 1, 2, 3 }));
+    EXPECT_EQ(scheduler.GetQueuedCount(), 0u);
+}
+
+TEST(LoadSchedulerTest, InteractiveNeverWaits)
+{
+    LoadScheduler scheduler;
+    scheduler.SetLimits(1, 0);
+    EXPECT_TRUE(scheduler.Submit(scheduler.NewTicket(), LoadPriority::Normal, []() {}));
+    EXPECT_FALSE(scheduler.Submit(scheduler.NewTicket(), LoadPriority::Normal, []() {}));
+    EXPECT_TRUE(scheduler.Submit(scheduler.NewTicket(), LoadPriority::Interactive, []() {}));
+    EXPECT_EQ(scheduler.GetActiveCount(), 2u);
+}
+
+TEST(LoadSchedulerTest, NormalGoesBeforePrefetch)
+{
+    LoadScheduler scheduler;
+    scheduler.SetLimits(1, 0);
+    std::vector<std::string> started;
+    auto first = scheduler.NewTicket();
+    scheduler.Submit(first, LoadPriority::Normal, [&started]() { started.push_back("first"); });
+    scheduler.Submit(scheduler.NewTicket(), LoadPriority::Prefetch, [&started]() { started.push_back("prefetch"); });
+    auto normal = scheduler.NewTicket();
+    scheduler.Submit(normal, LoadPriority::Normal, [&started]() { started.push_back("normal"); });
+    scheduler.Release(first);
+    EXPECT_EQ(started, (std::vector<std::string>{ "first", "normal" }));
+    scheduler.Release(normal);
+    EXPECT_EQ(started, (std::vector<std::string>{ "first", "normal", "prefetch" }));
+}
+
+TEST(LoadSchedulerTest, PrefetchHasItsOwnLimit)
+{
+    LoadScheduler scheduler;
+    scheduler.SetLimits(0, 1);
+    EXPECT_TRUE(scheduler.Submit(scheduler.NewTicket(), LoadPriority::Prefetch, []() {}));
+    EXPECT_FALSE(scheduler.Submit(scheduler.NewTicket(), LoadPriority::Prefetch, []() {}));
+    EXPECT_TRUE(scheduler.Submit(scheduler.NewTicket(), LoadPriority::Normal, []() {}));
+}
+
+TEST(LoadSchedulerTest, PromoteMovesAQueuedTransferAhead)
+{
+    LoadScheduler scheduler;
+    scheduler.SetLimits(1, 0);
+    std::vector<std::string> started;
+    auto first = scheduler.NewTicket();
+    scheduler.Submit(first, LoadPriority::Normal, [&started]() { started.push_back("first"); });
+    scheduler.Submit(scheduler.NewTicket(), LoadPriority::Normal, [&started]() { started.push_back("normal"); });
+    auto prefetch = scheduler.NewTicket();
+    scheduler.Submit(prefetch, LoadPriority::Prefetch, [&started]() { started.push_back("prefetch"); });
+    //Someone now waits on the prefetched file
+    scheduler.Promote(prefetch, LoadPriority::Interactive);
+    EXPECT_EQ(started, (std::vector<std::string>{ "first", "prefetch" }));
+    scheduler.Release(first);
+    EXPECT_EQ(started, (std::vector<std::string>{ "first", "prefetch" }));
+    scheduler.Release(prefetch);
+    EXPECT_EQ(started, (std::vector<std::string>{ "first", "prefetch", "normal" }));
+}
+
+TEST(LoadSchedulerTest, ReleasingAQueuedTicketDropsIt)
+{
+    LoadScheduler scheduler;
+    scheduler.SetLimits(1, 0);
+    auto first = scheduler.NewTicket();
+    scheduler.Submit(first, LoadPriority::Normal, []() {});
+    bool started = false;
+    auto queued = scheduler.NewTicket();
+    scheduler.Submit(queued, LoadPriority::Normal, [&started]() { started = true; });
+    scheduler.Release(queued);
+    EXPECT_EQ(scheduler.GetQueuedCount(), 0u);
+    scheduler.Release(first);
+    EXPECT_FALSE(started);
+}
+
+TEST(LoadSchedulerTest, RaisingTheLimitStartsQueuedTransfers)
+{
+    LoadScheduler scheduler;
+    scheduler.SetLimits(1, 0);
+    int started = 0;
+    for (int i = 0; i < 3; ++i)
+    {
+        scheduler.Submit(scheduler.NewTicket(), LoadPriority::Normal, [&started]() { ++started; });
+    }
+    EXPECT_EQ(started, 1);
+    scheduler.SetLimits(3, 0);
+    EXPECT_EQ(started, 3);
+}
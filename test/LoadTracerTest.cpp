@@ -0,0 +1,129 @@
+/**
+ * Tests of the load spans and the Chrome trace export
+ */
+#include <gtest/gtest.h>
+#include "LoadTracer.hpp"
+
+namespace
+{
+    using sgns::LoadEvent;
+    using sgns::LoadPhase;
+    using sgns::LoadTracer;
+    using std::chrono::milliseconds;
+
+    LoadEvent MakeEvent(LoadPhase phase, std::chrono::steady_clock::time_point time, uint64_t bytes = 0, uint64_t totalBytes = 0)
+    {
+        LoadEvent event;
+        event.phase = phase;
+        event.time = time;
+        event.bytes = bytes;
+        event.totalBytes = totalBytes;
+        return event;
+    }
+
+    bool Contains(const std::string& text, const std::string& part)
+    {
+        return text.find(part) != std::string::npos;
+    }
+}
+
+TEST(LoadTracerTest, RecordsNothingUntilEnabled)
+{
+    LoadTracer tracer;
+    auto now = LoadTracer::Clock::now();
+    tracer.Span("parse", "load", "https://host/a.mnn", now, now + milliseconds(5));
+    EXPECT_FALSE(Contains(tracer.ChromeTraceJSON(), "\"parse\""));
+    tracer.Enable();
+    tracer.Span("parse", "load", "https://host/a.mnn", now, now + milliseconds(5));
+    tracer.Disable();
+    tracer.Span("save", "save", "https://host/a.mnn", now, now + milliseconds(5));
+    auto json = tracer.ChromeTraceJSON();
+    EXPECT_TRUE(Contains(json, "\"name\":\"parse\""));
+    EXPECT_FALSE(Contains(json, "\"name\":\"save\""));
+}
+
+TEST(LoadTracerTest, ChromeTraceNamesTracksAndTimesSpans)
+{
+    LoadTracer tracer;
+    tracer.Enable();
+    auto now = LoadTracer::Clock::now();
+    tracer.Span("parse", "load", "https://host/\"a\".mnn", now, now + milliseconds(5), { { "bytes", "10" } });
+    auto json = tracer.ChromeTraceJSON();
+    EXPECT_EQ(json.rfind("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", 0), 0u);
+    EXPECT_TRUE(Contains(json, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"https://host/\\\"a\\\".mnn\"}}"));
+    EXPECT_TRUE(Contains(json, "\"cat\":\"load\",\"ph\":\"X\",\"pid\":1,\"tid\":1,"));
+    EXPECT_TRUE(Contains(json, "\"dur\":5000,\"args\":{\"bytes\":\"10\"}}"));
+}
+
+TEST(LoadTracerTest, EventsBecomePhaseSpans)
+{
+    LoadTracer tracer;
+    tracer.Enable();
+    auto now = LoadTracer::Clock::now();
+    const std::string track = "https://host/a.mnn";
+    tracer.OnEvent(track, &track, 0, MakeEvent(LoadPhase::Connect, now));
+    tracer.OnEvent(track, &track, 0, MakeEvent(LoadPhase::Transfer, now + milliseconds(10), 0, 300));
+    //Progress extends the open phase
+    tracer.OnEvent(track, &track, 0, MakeEvent(LoadPhase::Transfer, now + milliseconds(20), 100, 300));
+    tracer.OnEvent(track, &track, 0, MakeEvent(LoadPhase::Transfer, now + milliseconds(30), 300, 300));
+    tracer.OnEvent(track, &track, 0, MakeEvent(LoadPhase::Done, now + milliseconds(40)));
+    auto json = tracer.ChromeTraceJSON();
+    EXPECT_TRUE(Contains(json, "{\"name\":\"connect\",\"cat\":\"load\""));
+    EXPECT_TRUE(Contains(json, "\"dur\":10000}"));
+    EXPECT_TRUE(Contains(json, "{\"name\":\"transfer\",\"cat\":\"load\""));
+    EXPECT_TRUE(Contains(json, "\"dur\":30000,\"args\":{\"bytes\":\"300\",\"totalBytes\":\"300\"}}"));
+    EXPECT_FALSE(Contains(json, "\"name\":\"done\""));
+}
+
+TEST(LoadTracerTest, FailedPhaseCarriesTheError)
+{
+    LoadTracer tracer;
+    tracer.Enable();
+    auto now = LoadTracer::Clock::now();
+    tracer.OnEvent("https://host/a.mnn", &tracer, 0, MakeEvent(LoadPhase::FirstByte, now));
+    auto failed = MakeEvent(LoadPhase::FirstByte, now + milliseconds(10));
+    failed.error = sgns::MakeHTTPStatusError(503);
+    tracer.OnEvent("https://host/a.mnn", &tracer, 0, failed);
+    EXPECT_TRUE(Contains(tracer.ChromeTraceJSON(), "\"args\":{\"error\":\"HTTP status 503\"}"));
+}
+
+TEST(LoadTracerTest, AttemptsKeepPhasesOfTheirOwn)
+{
+    LoadTracer tracer;
+    tracer.Enable();
+    auto now = LoadTracer::Clock::now();
+    const std::string track = "https://host/a.mnn";
+    int transfer = 0;
+    int other = 0;
+    tracer.OnEvent(track, &transfer, 0, MakeEvent(LoadPhase::Queued, now));
+    tracer.OnEvent(track, &transfer, 1, MakeEvent(LoadPhase::Connect, now + milliseconds(5)));
+    //A hedge and another transfer of the same URL don't end the first attempt's connect
+    tracer.OnEvent(track, &transfer, 2, MakeEvent(LoadPhase::Connect, now + milliseconds(10)));
+    tracer.OnEvent(track, &other, 1, MakeEvent(LoadPhase::Transfer, now + milliseconds(12)));
+    tracer.OnEvent(track, &transfer, 1, MakeEvent(LoadPhase::Transfer, now + milliseconds(20), 100, 100));
+    //The end of the transfer closes what the hedge left open
+    tracer.OnEvent(track, &transfer, 0, MakeEvent(LoadPhase::Done, now + milliseconds(30)));
+    auto json = tracer.ChromeTraceJSON();
+    EXPECT_TRUE(Contains(json, "{\"name\":\"queued\",\"cat\":\"load\""));
+    EXPECT_TRUE(Contains(json, "\"dur\":5000}"));
+    EXPECT_TRUE(Contains(json, "\"dur\":15000,\"args\":{\"attempt\":\"1\"}}"));
+    EXPECT_TRUE(Contains(json, "\"dur\":10000,\"args\":{\"attempt\":\"1\",\"bytes\":\"100\",\"totalBytes\":\"100\"}}"));
+    EXPECT_TRUE(Contains(json, "\"dur\":20000,\"args\":{\"attempt\":\"2\"}}"));
+    //The other transfer is still open
+    EXPECT_FALSE(Contains(json, "\"dur\":18000"));
+}
+
+TEST(LoadTracerTest, DropsSpansOverTheLimit)
+{
+    LoadTracer tracer;
+    tracer.Enable(2);
+    auto now = LoadTracer::Clock::now();
+    for (int i = 0; i < 5; ++i)
+    {
+        tracer.Span("parse", "load", "https://host/a.mnn", now, now);
+    }
+    EXPECT_EQ(tracer.GetDroppedCount(), 3u);
+    //Enabling again starts over
+    tracer.Enable(2);
+    EXPECT_EQ(tracer.GetDroppedCount(), 0u);
+}
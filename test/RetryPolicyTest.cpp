@@ -0,0 +1,118 @@
+/**
+ * Tests of the retry backoff, retry budget and hedge delay
+ */
+#include <gtest/gtest.h>
+#include "RetryPolicy.hpp"
+
+namespace
+{
+    using sgns::RetryOptions;
+    using sgns::RetryPolicy;
+    using std::chrono::milliseconds;
+}
+
+TEST(RetryPolicyTest, DefaultsToASingleAttempt)
+{
+    RetryPolicy policy;
+    EXPECT_EQ(policy.GetOptions("https").maxAttempts, 1u);
+    //DHT lookups keep trying until providers are announced
+    EXPECT_GT(policy.GetOptions("ipfs-dht").maxAttempts, 1u);
+}
+
+TEST(RetryPolicyTest, BackoffGrowsUpToTheCap)
+{
+    RetryPolicy policy;
+    RetryOptions options;
+    options.initialBackoff = milliseconds(100);
+    options.multiplier = 2;
+    options.maxBackoff = milliseconds(1000);
+    options.jitter = 0;
+    policy.SetOptions("https", options);
+    EXPECT_EQ(policy.Backoff("https", 0), milliseconds(100));
+    EXPECT_EQ(policy.Backoff("https", 1), milliseconds(200));
+    EXPECT_EQ(policy.Backoff("https", 3), milliseconds(800));
+    EXPECT_EQ(policy.Backoff("https", 4), milliseconds(1000));
+    EXPECT_EQ(policy.Backoff("https", 20), milliseconds(1000));
+}
+
+TEST(RetryPolicyTest, JitterOnlyShortensTheBackoff)
+{
+    RetryPolicy policy;
+    RetryOptions options;
+    options.initialBackoff = milliseconds(1000);
+    options.jitter = 0.5;
+    policy.SetOptions("https", options);
+    for (int i = 0; i < 100; ++i)
+    {
+        auto backoff = policy.Backoff("https", 0);
+        EXPECT_GE(backoff, milliseconds(500));
+        EXPECT_LE(backoff, milliseconds(1000));
+    }
+}
+
+TEST(RetryPolicyTest, BudgetLimitsRetriesToAShareOfAttempts)
+{
+    RetryPolicy policy;
+    policy.SetBudget(0.5, 2);
+    EXPECT_TRUE(policy.TryWithdraw());
+    EXPECT_TRUE(policy.TryWithdraw());
+    EXPECT_FALSE(policy.TryWithdraw());
+    policy.RecordAttempt();
+    EXPECT_FALSE(policy.TryWithdraw());
+    policy.RecordAttempt();
+    EXPECT_TRUE(policy.TryWithdraw());
+}
+
+TEST(RetryPolicyTest, BudgetRefillsInTenths)
+{
+    RetryPolicy policy;
+    policy.SetBudget(0.1, 1);
+    EXPECT_TRUE(policy.TryWithdraw());
+    for (int i = 0; i < 10; ++i)
+    {
+        policy.RecordAttempt();
+    }
+    EXPECT_TRUE(policy.TryWithdraw());
+}
+
+TEST(RetryPolicyTest, NoHedgeUntilEnoughSamples)
+{
+    RetryPolicy policy;
+    RetryOptions options;
+    options.hedgePercentile = 0.9;
+    options.hedgeMinSamples = 10;
+    policy.SetOptions("https", options);
+    for (int i = 1; i < 10; ++i)
+    {
+        policy.RecordLatency("https", milliseconds(i));
+    }
+    EXPECT_EQ(policy.HedgeDelay("https"), milliseconds(0));
+    policy.RecordLatency("https", milliseconds(10));
+    EXPECT_GT(policy.HedgeDelay("https"), milliseconds(0));
+}
+
+TEST(RetryPolicyTest, HedgeDelayIsThePercentile)
+{
+    RetryPolicy policy;
+    RetryOptions options;
+    options.hedgePercentile = 0.9;
+    options.hedgeMinSamples = 10;
+    policy.SetOptions("https", options);
+    for (int i = 100; i >= 1; --i)
+    {
+        policy.RecordLatency("https", milliseconds(i));
+    }
+    EXPECT_EQ(policy.HedgeDelay("https"), milliseconds(90));
+    //Other schemes keep their own samples
+    EXPECT_EQ(policy.HedgeDelay("sftp"), milliseconds(0));
+}
+
+TEST(RetryPolicyTest, HedgingIsOffByDefault)
+{
+    RetryPolicy policy;
+    for (int i = 0; i < 100; ++i)
+    {
+        policy.RecordLatency("https", milliseconds(50));
+    }
+    EXPECT_EQ(policy.HedgeDelay("https"), milliseconds(0));
+}
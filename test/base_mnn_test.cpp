@@ -0,0 +1,64 @@
+#include "base_mnn_test.hpp"
+#include <boost/filesystem/fstream.hpp>
+
+namespace test
+{
+  BaseMNNTest::BaseMNNTest(const fs::path &path)
+      : base_path(fs::temp_directory_path() / path)
+  {
+    clear();
+    mkdir();
+  }
+
+  BaseMNNTest::~BaseMNNTest()
+  {
+    clear();
+  }
+
+  void BaseMNNTest::clear()
+  {
+    boost::system::error_code ec;
+    fs::remove_all(base_path, ec);
+  }
+
+  void BaseMNNTest::mkdir()
+  {
+    fs::create_directories(base_path);
+  }
+
+  std::string BaseMNNTest::getPathString() const
+  {
+    return base_path.string();
+  }
+
+  fs::path BaseMNNTest::createDir(const fs::path &dirname) const
+  {
+    auto path = base_path / dirname;
+    fs::create_directories(path);
+    return path;
+  }
+
+  fs::path BaseMNNTest::createFile(const fs::path &filename) const
+  {
+    auto path = base_path / filename;
+    fs::create_directories(path.parent_path());
+    fs::ofstream file(path);
+    return path;
+  }
+
+  bool BaseMNNTest::exists(const fs::path &entity) const
+  {
+    return fs::exists(entity);
+  }
+
+  void BaseMNNTest::SetUp()
+  {
+    clear();
+    mkdir();
+  }
+
+  void BaseMNNTest::TearDown()
+  {
+    clear();
+  }
+} // namespace test